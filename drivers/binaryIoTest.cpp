@@ -1,47 +1,145 @@
+#ifndef HAVE_BINARY_IO
+#define HAVE_BINARY_IO
+#endif
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
 #include "IoBinary.h"
 #include "Vector.h"
 
-void readMe(const String& myfile)
+using PsimagLite::String;
+
+typedef PsimagLite::Vector<double>::Type VectorDoubleType;
+typedef PsimagLite::Matrix<float> MatrixFloatType;
+
+SizeType fileSize(const String& myfile)
 {
-	PsimagLite::IoBinary::In fin(myfile);
-	typename Vector<double>::Type v;
-	fin.read(v,"MyVector");
-	std::cout<<"MyVector\n";
-	std::cout<<v;
-	std::cout<<"------------------\n";
-
-	PsimagLite::Matrix<float> m;
-	fin.readMatrix(m,"MyMatrix");
-	std::cout<<"MyMatrix";
-	std::cout<<m;
-	std::cout<<"------------------\n";
+	struct stat info;
+	return (stat(myfile.c_str(),&info) == 0) ? info.st_size : 0;
+}
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" [-f file] [-n size] [-r records] [-b] [-c]\n";
+	std::cerr<<"Each record has a vector of size doubles, the first third of them zero,";
+	std::cerr<<" and a size x size matrix\n";
+	std::cerr<<"-b writes in a background thread, -c compresses vectors\n";
+	exit(1);
 }
 
-int main()
+void writeMe(const String& myfile, SizeType size, SizeType records, SizeType options)
 {
 	SizeType rank = 0;
-	String myfile = "myfile.txt";
-	PsimagLite::IoBinary::Out fout(myfile,rank);
+	PsimagLite::IoBinary::Out fout(myfile,rank,options);
 	String s = "Hello World!";
 	fout.print(s);
-	typename Vector<double>::Type m(10);
 
+	VectorDoubleType m(size);
+	MatrixFloatType a(size,size);
 	srand48(3490201);
-	for (SizeType i=0;i<m.size();i++)
-		m[i]=drand48();
-	fout.printVector(m,"MyVector");
-	std::cout<<"MyVector\n";
-	std::cout<<m;
-	std::cout<<"------------------\n";
-
-	PsimagLite::Matrix<float> a(10,20);
-	for (SizeType i=0;i<a.n_row();i++)
-		for (SizeType j=0;j<a.n_col();j++)
-			a(i,j)=drand48();
-
-	fout.printMatrix(a,"MyMatrix");
+	for (SizeType r = 0; r < records; ++r) {
+		for (SizeType i=0;i<m.size();i++)
+			m[i]=(3*i < size) ? 0.0 : drand48();
+		fout.printVector(m,"MyVector");
+
+		for (SizeType i=0;i<a.n_row();i++)
+			for (SizeType j=0;j<a.n_col();j++)
+				a(i,j)=drand48();
+		fout.printMatrix(a,"MyMatrix");
+		fout.print("Record",r);
+	}
+
 	fout.close();
+}
+
+// reads the records back, in order, and then the last one again, and
+// compares them with what writeMe wrote
+bool readMe(const String& myfile, SizeType size, SizeType records)
+{
+	PsimagLite::IoBinary::In fin(myfile);
+	VectorDoubleType v;
+	MatrixFloatType m;
+	bool same = (fin.count("MyVector") == records);
+	srand48(3490201);
+	for (SizeType r = 0; r < records; ++r) {
+		v.clear();
+		fin.read(v,"MyVector");
+		same &= (v.size() == size);
+		for (SizeType i=0;i<v.size();i++)
+			same &= (v[i] == ((3*i < size) ? 0.0 : drand48()));
+
+		MatrixFloatType mr;
+		fin.readMatrix(mr,"MyMatrix");
+		same &= (mr.n_row() == size && mr.n_col() == size);
+		for (SizeType i=0;i<mr.n_row();i++)
+			for (SizeType j=0;j<mr.n_col();j++)
+				same &= (mr(i,j) == static_cast<float>(drand48()));
+
+		SizeType rr = 0;
+		fin.readline(rr,"Record");
+		same &= (rr == r);
+		if (r + 1 == records) m = mr;
+	}
+
+	fin.rewind();
+	MatrixFloatType last;
+	fin.readMatrix(last,"MyMatrix",PsimagLite::IoBinary::In::LAST_INSTANCE);
+	same &= (last == m);
+
+	std::cout<<"MyMatrix("<<size/2<<","<<size/2<<") of the last record=";
+	std::cout<<last(size/2,size/2)<<"\n";
+	return same;
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	String myfile = "myfile.txt";
+	SizeType size = 10;
+	SizeType records = 1;
+	SizeType options = 0;
+
+	while ((opt = getopt(argc, argv, "f:n:r:bc")) != -1) {
+		switch (opt) {
+		case 'f':
+			myfile = optarg;
+			break;
+		case 'n':
+			size = atoi(optarg);
+			break;
+		case 'r':
+			records = atoi(optarg);
+			break;
+		case 'b':
+			options |= PsimagLite::IoBinary::Out::BACKGROUND_FLUSH;
+			break;
+		case 'c':
+			options |= PsimagLite::IoBinary::Out::COMPRESS_VECTORS;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (size == 0 || records == 0) usage(argv[0]);
+
+	double start = wallTime();
+	writeMe(myfile,size,records,options);
+	double writing = wallTime() - start;
 
-	readMe(myfile);
+	start = wallTime();
+	bool same = readMe(myfile,size,records);
+	double reading = wallTime() - start;
 
+	std::cout<<"records="<<records<<" size="<<size<<" same="<<same<<"\n";
+	std::cout<<"seconds writing="<<writing<<" reading="<<reading<<"\n";
+	std::cout<<"bytes="<<fileSize(myfile)<<"\n";
 }
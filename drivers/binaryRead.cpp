@@ -1,6 +1,11 @@
+#ifndef HAVE_BINARY_IO
+#define HAVE_BINARY_IO
+#endif
 #include "IoBinary.h"
 #include "Vector.h"
 
+using PsimagLite::String;
+
 typedef std::pair<SizeType,SizeType>PairType;
 
 int main(int argc,char *argv[])
@@ -0,0 +1,319 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Compares p Lanczos decompositions, one per starting vector, with one
+// block Lanczos decomposition of the p vectors, on a square lattice
+// with hoppings of range d. Times each end to end, up to G(z) on a grid,
+// as the fastest of three runs, and fails if the G(z) differ once the
+// scalar ones have converged, or if the block route is not faster
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include "Concurrency.h"
+#include "CrsMatrix.h"
+#include "LanczosSolver.h"
+#include "BlockLanczosSolver.h"
+#include "ParametersForSolver.h"
+#include "Random48.h"
+
+using namespace PsimagLite;
+
+typedef double RealType;
+typedef std::complex<RealType> ComplexType;
+typedef ParametersForSolver<RealType> SolverParametersType;
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -l side [-d range] [-p vectors] [-s steps]";
+	std::cerr<<" [-t threads] [-c]\n";
+	std::cerr<<"-c uses complex numbers\n";
+	exit(1);
+}
+
+/* weight/(z - a_0 - b_0^2/(z - a_1 - ...)) with the first size entries
+   of ab, by backward recursion; same as ContinuedFraction::iOfOmega with
+   isign = -1, without diagonalizing ab */
+template<typename TridiagonalMatrixType>
+ComplexType greenFunction(const TridiagonalMatrixType& ab,
+                          RealType weight,
+                          SizeType size,
+                          const ComplexType& z)
+{
+	ComplexType tail = 0.0;
+	for (SizeType k = size; k > 0; --k) {
+		RealType b = (k < size) ? ab.b(k - 1) : 0;
+		tail = 1.0/(z - ab.a(k - 1) - b*b*tail);
+	}
+
+	return weight*tail;
+}
+
+// sites within distance range (in each direction) of each other are
+// connected, so that each row has (2*range + 1)^2 non-zeros
+template<typename ComplexOrRealType>
+void fillLattice(CrsMatrix<ComplexOrRealType>& sparse, SizeType l, SizeType range)
+{
+	Random48<RealType> random(1234);
+	SizeType n = l*l;
+	SizeType counter = 0;
+	Vector<SizeType>::Type neighbors;
+	for (SizeType i = 0; i < n; ++i) {
+		sparse.setRow(i,counter);
+		SizeType x = i % l;
+		SizeType y = i / l;
+		neighbors.clear();
+		for (SizeType dy = 0; dy <= 2*range; ++dy) {
+			SizeType yy = (y + l + dy - range) % l;
+			for (SizeType dx = 0; dx <= 2*range; ++dx)
+				neighbors.push_back(yy*l + (x + l + dx - range) % l);
+		}
+
+		std::sort(neighbors.begin(), neighbors.end());
+		for (SizeType k = 0; k < neighbors.size(); ++k) {
+			if (k > 0 && neighbors[k] == neighbors[k - 1]) continue;
+			SizeType j = neighbors[k];
+			sparse.pushCol(j);
+			// symmetric in i and j
+			RealType value = (j == i) ? random() - 0.5 : -1.0/(1.0 + (i + j) % 3);
+			sparse.pushValue(value);
+			++counter;
+		}
+	}
+
+	sparse.setRow(n,counter);
+	sparse.checkValidity();
+}
+
+template<typename ComplexOrRealType>
+bool run(SizeType l, SizeType range, SizeType p, SizeType steps)
+{
+	typedef typename Vector<ComplexOrRealType>::Type VectorType;
+	typedef CrsMatrix<ComplexOrRealType> SparseMatrixType;
+	typedef LanczosSolver<SolverParametersType,SparseMatrixType,VectorType> LanczosSolverType;
+	typedef BlockLanczosSolver<SolverParametersType,SparseMatrixType,VectorType>
+	        BlockLanczosSolverType;
+	typedef typename LanczosSolverType::TridiagonalMatrixType TridiagonalMatrixType;
+	typedef typename BlockLanczosSolverType::DenseMatrixType DenseMatrixType;
+
+	SizeType n = l*l;
+	SparseMatrixType sparse(n,n);
+	fillLattice(sparse, l, range);
+
+	Random48<RealType> random(4321);
+	DenseMatrixType phi(n,p);
+	for (SizeType c = 0; c < p; ++c)
+		for (SizeType i = 0; i < n; ++i)
+			phi(i,c) = random() - 0.5;
+
+	// product alone: p vectors vs one block
+	DenseMatrixType yBlock(p,n);
+	DenseMatrixType xBlock(p,n);
+	for (SizeType i = 0; i < n; ++i)
+		for (SizeType c = 0; c < p; ++c)
+			yBlock(c,i) = phi(i,c);
+
+	VectorType x(n);
+	VectorType y(n);
+	SizeType repeat = 10;
+	double start = wallTime();
+	for (SizeType r = 0; r < repeat; ++r) {
+		for (SizeType c = 0; c < p; ++c) {
+			for (SizeType i = 0; i < n; ++i) y[i] = phi(i,c);
+			x.assign(n,0.0);
+			sparse.matrixVectorProduct(x,y);
+		}
+	}
+
+	double vectorProducts = (wallTime() - start)/repeat;
+	start = wallTime();
+	for (SizeType r = 0; r < repeat; ++r) {
+		xBlock.setTo(0.0);
+		sparse.matrixBlockProduct(xBlock,yBlock);
+	}
+
+	double blockProduct = (wallTime() - start)/repeat;
+
+	RealType maxDiff = 0;
+	for (SizeType i = 0; i < n; ++i)
+		maxDiff = std::max(maxDiff, std::abs(x[i] - xBlock(p - 1,i)));
+
+	// decompositions, and G_cc(z) = <phi_c|(z - H)^{-1}|phi_c> on a grid
+	// with delta=0.1, for each vector
+	SolverParametersType params;
+	params.steps = steps;
+	params.tolerance = 0;
+	params.lotaMemory = false;
+
+	typedef typename Vector<ComplexType>::Type VectorComplexType;
+	SizeType points = 40;
+	VectorComplexType z(points);
+	for (SizeType k = 0; k < points; ++k)
+		z[k] = ComplexType(-5 + 0.25*k,0.1);
+
+	Matrix<ComplexType> g1(points,p);
+	Matrix<ComplexType> g2(points,p);
+	typename Vector<TridiagonalMatrixType>::Type abs(p);
+	Vector<RealType>::Type weights(p);
+	// each path is timed as the fastest of a few runs, so that other
+	// load on the machine does not decide the comparison
+	const SizeType runs = 3;
+	double scalar = 0;
+	for (SizeType r = 0; r < runs; ++r) {
+		start = wallTime();
+		for (SizeType c = 0; c < p; ++c) {
+			LanczosSolverType lanczos(sparse,params);
+			VectorType init(n);
+			weights[c] = 0;
+			for (SizeType i = 0; i < n; ++i) {
+				init[i] = phi(i,c);
+				weights[c] += PsimagLite::real(PsimagLite::conj(init[i])*init[i]);
+			}
+
+			lanczos.decomposition(init,abs[c]);
+			for (SizeType k = 0; k < points; ++k)
+				g1(k,c) = greenFunction(abs[c],weights[c],abs[c].size(),z[k]);
+		}
+
+		double seconds = wallTime() - start;
+		if (r == 0 || seconds < scalar) scalar = seconds;
+	}
+
+	BlockLanczosSolverType blockLanczos(sparse,params);
+	typename Vector<TridiagonalMatrixType>::Type blockAbs(p);
+	Vector<RealType>::Type blockWeights(p);
+	double block = 0;
+	double reduce = 0;
+	for (SizeType r = 0; r < runs; ++r) {
+		start = wallTime();
+		blockLanczos.decomposition(phi);
+		double decomposition = wallTime() - start;
+
+		start = wallTime();
+		for (SizeType c = 0; c < p; ++c) {
+			blockLanczos.tridiagonal(blockAbs[c], blockWeights[c], c);
+			for (SizeType k = 0; k < points; ++k) {
+				g2(k,c) = greenFunction(blockAbs[c],
+				                        blockWeights[c],
+				                        blockAbs[c].size(),
+				                        z[k]);
+			}
+		}
+
+		double tridiagonal = wallTime() - start;
+		if (r == 0 || decomposition + tridiagonal < block + reduce) {
+			block = decomposition;
+			reduce = tridiagonal;
+		}
+	}
+
+	// the scalar G(z) are converged if dropping their last quarter of
+	// steps does not change them
+	RealType maxRelative = 0;
+	RealType maxChange = 0;
+	for (SizeType c = 0; c < p; ++c) {
+		SizeType fewer = abs[c].size() - abs[c].size()/4;
+		for (SizeType k = 0; k < points; ++k) {
+			ComplexType g0 = greenFunction(abs[c],weights[c],fewer,z[k]);
+			RealType norm = std::abs(g1(k,c));
+			maxChange = std::max(maxChange, std::abs(g1(k,c) - g0)/norm);
+			maxRelative = std::max(maxRelative, std::abs(g1(k,c) - g2(k,c))/norm);
+		}
+	}
+
+	std::cout<<"rank="<<n<<" nonzeros="<<sparse.nonZeros()<<" vectors="<<p;
+	std::cout<<" steps="<<steps<<" threads="<<Concurrency::npthreads<<"\n";
+	std::cout<<"seconds per product: "<<p<<" vectors= "<<vectorProducts;
+	std::cout<<" block= "<<blockProduct;
+	std::cout<<" speedup= "<<vectorProducts/blockProduct<<"\n";
+	std::cout<<"max difference in products= "<<maxDiff<<"\n";
+	std::cout<<"seconds up to G(z): "<<p<<" lanczos= "<<scalar;
+	std::cout<<" block lanczos= "<<(block + reduce)<<" ("<<block;
+	std::cout<<" decomposition + "<<reduce<<" tridiagonal and G)";
+	std::cout<<" speedup= "<<scalar/(block + reduce)<<"\n";
+	std::cout<<"block steps done= "<<blockLanczos.blocks();
+	std::cout<<" tridiagonal sizes: lanczos= "<<abs[0].size();
+	std::cout<<" block= "<<blockAbs[0].size()<<"\n";
+	std::cout<<"max relative change of lanczos G(z) over its last quarter of steps= ";
+	std::cout<<maxChange<<"\n";
+	std::cout<<"max relative difference in G(z)= "<<maxRelative<<"\n";
+
+	const RealType tolerance = 1e-6;
+	if (maxChange >= tolerance) {
+		std::cout<<"lanczos G(z) not converged, increase -s\n";
+		return false;
+	}
+
+	if (block + reduce >= scalar) {
+		std::cout<<"block lanczos is not faster than "<<p<<" lanczos\n";
+		return false;
+	}
+
+	return (maxRelative < tolerance);
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	SizeType l = 0;
+	SizeType range = 1;
+	SizeType p = 4;
+	SizeType steps = 400;
+	SizeType nthreads = 1;
+	bool isComplex = false;
+
+	while ((opt = getopt(argc, argv, "l:d:p:s:t:c")) != -1) {
+		switch (opt) {
+		case 'l':
+			l = atoi(optarg);
+			break;
+		case 'd':
+			range = atoi(optarg);
+			break;
+		case 'p':
+			p = atoi(optarg);
+			break;
+		case 's':
+			steps = atoi(optarg);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'c':
+			isComplex = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (l < 2*range + 1 || p == 0) usage(argv[0]);
+
+	Concurrency concurrency(&argc,&argv,nthreads);
+
+	bool ok = (isComplex) ? run<ComplexType>(l,range,p,steps)
+	                      : run<RealType>(l,range,p,steps);
+	std::cout<<((ok) ? "PASSED" : "FAILED")<<"\n";
+	return (ok) ? 0 : 1;
+}
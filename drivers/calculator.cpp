@@ -1,5 +1,67 @@
+#include <sys/time.h>
+#include <cstdlib>
 #include "ExpressionCalculator.h"
 
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+// Evaluates the expression for n times t, replacing %t in it each time,
+// with the program one time at a time, and with the program in a batch
+void timeIt(const PsimagLite::String& expression, SizeType n)
+{
+	typedef PsimagLite::ExpressionCalculator<double> ExpressionCalculatorType;
+	typedef PsimagLite::ExpressionProgram<double> ExpressionProgramType;
+	typedef PsimagLite::PrepassData<double> PrepassDataType;
+
+	PrepassDataType::VectorType times(n);
+	for (SizeType i = 0; i < n; ++i) times[i] = 0.001*i;
+
+	ExpressionCalculatorType::VectorStringType ve;
+	PsimagLite::split(ve, expression, ",");
+
+	double start = wallTime();
+	PrepassDataType::VectorType replaced(n);
+	for (SizeType i = 0; i < n; ++i) {
+		ExpressionCalculatorType::VectorStringType ve2 = ve;
+		PrepassDataType pd;
+		pd.names = "t";
+		pd.values.resize(1, times[i]);
+		PsimagLite::ExpressionPrepass<PrepassDataType>::prepass(ve2,pd);
+		replaced[i] = ExpressionCalculatorType(ve2)();
+	}
+
+	double replacing = wallTime() - start;
+
+	start = wallTime();
+	ExpressionProgramType program(ve, "t");
+	PrepassDataType::VectorType single(n);
+	for (SizeType i = 0; i < n; ++i)
+		single[i] = program(&times[i]);
+
+	double one = wallTime() - start;
+
+	start = wallTime();
+	PrepassDataType::VectorType batch(n);
+	program(&batch[0], &times[0], n);
+	double batched = wallTime() - start;
+
+	double maxDiff = 0;
+	bool same = true;
+	for (SizeType i = 0; i < n; ++i) {
+		maxDiff = std::max(maxDiff, fabs(replaced[i] - single[i]));
+		same &= (single[i] == batch[i]);
+	}
+
+	std::cout<<"n="<<n<<" batch same="<<same<<" max difference with ";
+	std::cout<<"replacing="<<maxDiff<<"\n";
+	std::cout<<"seconds replacing="<<replacing<<" program="<<one;
+	std::cout<<" batch="<<batched<<"\n";
+}
+
 int main(int argc, char **argv)
 {
 	if (argc < 2) return 1;
@@ -19,5 +81,7 @@ int main(int argc, char **argv)
 
 	ExpressionCalculatorType ec(ve);
 	std::cout<<argv[1]<<"\t"<<ec()<<"\n";
+
+	if (argc > 2) timeIt(argv[1], atoi(argv[2]));
 }
 
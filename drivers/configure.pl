@@ -43,7 +43,7 @@ sub createMakefile
 	continuedFractionCollection range kernelPolynomial
 	linearPrediction options randomTest svd testLapack threads loadImbalance testIsClass
 	testMemResolv1 sumDecomposition calculator closuresTest base64test checkRunId
-	testLanczos);
+	testLanczos testDavidson threadPool lanczosStep blockLanczos kpmDos sparseFormats ioSimpleIndex binaryIoTest binaryRead inputNgIndex thickRestart crsMatrixIndex geometryConnections);
 	my $combinedUnits = combine("",\@units,".o ");
 	my $combinedUnits2 = combine("./",\@units,".cpp ");
 
@@ -0,0 +1,286 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Builds the same banded matrix as CrsMatrix<T,int>, as CrsMatrix<T,long>,
+// and with compressed columns, and fails unless the vector and block
+// products, getCol, element, operator==, transposeConjugate and multiply
+// agree for the three, and unless compressing the columns shrank the heap.
+// A matrix with a corner entry must refuse to compress
+#include <unistd.h>
+#include <cstdlib>
+#include <new>
+#include "Concurrency.h"
+#include "CrsMatrix.h"
+#include "Random48.h"
+
+using namespace PsimagLite;
+
+typedef double RealType;
+typedef std::complex<RealType> ComplexType;
+
+// each block starts with its size; the header keeps the alignment of new
+static const std::size_t HEADER = 16;
+static long heapNow = 0;
+// called through a volatile pointer so that the compiler does not pair
+// it with operator new
+static void (*volatile releaseBlock)(void*) = free;
+
+void* operator new(std::size_t size) throw(std::bad_alloc)
+{
+	char* ptr = static_cast<char*>(malloc(size + HEADER));
+	if (!ptr) throw std::bad_alloc();
+	*reinterpret_cast<std::size_t*>(ptr) = size;
+	heapNow += size;
+	return ptr + HEADER;
+}
+
+void operator delete(void* p) throw()
+{
+	if (!p) return;
+	char* ptr = static_cast<char*>(p) - HEADER;
+	heapNow -= *reinterpret_cast<std::size_t*>(ptr);
+	releaseBlock(ptr);
+}
+
+void* operator new[](std::size_t size) throw(std::bad_alloc)
+{
+	return operator new(size);
+}
+
+void operator delete[](void* p) throw()
+{
+	operator delete(p);
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" [-n rank] [-w halfBandwidth] [-p blockSize] [-t threads]\n";
+	exit(1);
+}
+
+template<typename T>
+T randomValue(Random48<RealType>& random, T*)
+{
+	return random() - 0.5;
+}
+
+template<typename RealType_>
+std::complex<RealType_> randomValue(Random48<RealType>& random, std::complex<RealType_>*)
+{
+	RealType_ re = random() - 0.5;
+	return std::complex<RealType_>(re, random() - 0.5);
+}
+
+// rows have every other column within w of the diagonal, and a
+// corner entry at (0, n - 1) if corner is set
+template<typename T, typename IndexType>
+void buildMatrix(CrsMatrix<T,IndexType>& sparse, SizeType n, SizeType w, bool corner)
+{
+	Random48<RealType> random(1234);
+	IndexType counter = 0;
+	for (SizeType i = 0; i < n; ++i) {
+		sparse.setRow(i,counter);
+		SizeType start = (i > w) ? i - w : 0;
+		SizeType end = std::min(i + w + 1, n);
+		for (SizeType j = start; j < end; j += 2) {
+			sparse.pushCol(j);
+			sparse.pushValue(randomValue(random, static_cast<T*>(0)));
+			++counter;
+		}
+
+		if (corner && i == 0) {
+			sparse.pushCol(n - 1);
+			sparse.pushValue(1.0);
+			++counter;
+		}
+	}
+
+	sparse.setRow(n,counter);
+	sparse.checkValidity();
+}
+
+template<typename T, typename I, typename T2, typename I2>
+bool sameEntries(const CrsMatrix<T,I>& a, const CrsMatrix<T2,I2>& b)
+{
+	if (a.rows() != b.rows() || a.cols() != b.cols()) return false;
+	if (a.nonZeros() != b.nonZeros()) return false;
+	for (SizeType i = 0; i <= a.rows(); ++i)
+		if (static_cast<long>(a.getRowPtr(i)) != static_cast<long>(b.getRowPtr(i)))
+			return false;
+
+	for (I k = 0; k < a.getRowPtr(a.rows()); ++k) {
+		if (a.getCol(k) != b.getCol(k)) return false;
+		if (a.getValue(k) != b.getValue(k)) return false;
+	}
+
+	return true;
+}
+
+template<typename VectorType>
+RealType maxDiff(const VectorType& a, const VectorType& b)
+{
+	assert(a.size() == b.size());
+	RealType diff = 0;
+	for (SizeType i = 0; i < a.size(); ++i)
+		diff = std::max(diff, PsimagLite::norm(a[i] - b[i]));
+	return diff;
+}
+
+template<typename T>
+RealType maxDiff(const Matrix<T>& a, const Matrix<T>& b)
+{
+	assert(a.rows() == b.rows() && a.cols() == b.cols());
+	RealType diff = 0;
+	for (SizeType j = 0; j < a.cols(); ++j)
+		for (SizeType i = 0; i < a.rows(); ++i)
+			diff = std::max(diff, PsimagLite::norm(a(i,j) - b(i,j)));
+	return diff;
+}
+
+bool check(bool ok, const String& what, const String& label)
+{
+	std::cout<<label<<" "<<what<<" "<<((ok) ? "ok" : "WRONG")<<"\n";
+	return ok;
+}
+
+template<typename T>
+bool run(SizeType n, SizeType w, SizeType p, const String& label)
+{
+	typedef typename Vector<T>::Type VectorType;
+	typedef CrsMatrix<T,int> SparseMatrixType;
+	typedef CrsMatrix<T,long> SparseMatrixLongType;
+
+	SparseMatrixType a(n,n);
+	buildMatrix(a,n,w,false);
+	SparseMatrixLongType b(n,n);
+	buildMatrix(b,n,w,false);
+	SparseMatrixType c(a);
+
+	long before = heapNow;
+	bool ok = check(c.compressColumns() && c.columnsCompressed(), "compress", label);
+	long saved = before - heapNow;
+	long expected = static_cast<long>(a.nonZeros())*(sizeof(int) - sizeof(short));
+	std::cout<<label<<" heap shrank by "<<saved<<" bytes, expected "<<expected<<"\n";
+	ok &= check(saved == expected, "heap", label);
+
+	ok &= check(sameEntries(a,b) && sameEntries(a,c), "getCol", label);
+	ok &= check(a == c && c == a, "operator==", label);
+
+	Random48<RealType> random(4321);
+	bool elements = true;
+	for (SizeType t = 0; t < 1000; ++t) {
+		SizeType i = static_cast<SizeType>(random()*n);
+		SizeType j = (i + static_cast<SizeType>(random()*(2*w + 3)) + n - w - 1) % n;
+		elements &= (a.element(i,j) == b.element(i,j) && a.element(i,j) == c.element(i,j));
+	}
+
+	ok &= check(elements, "element", label);
+
+	VectorType y(n);
+	for (SizeType i = 0; i < n; ++i) y[i] = randomValue(random, static_cast<T*>(0));
+	VectorType xa(n, 0.0);
+	VectorType xb(n, 0.0);
+	VectorType xc(n, 0.0);
+	a.matrixVectorProduct(xa,y);
+	b.matrixVectorProduct(xb,y);
+	c.matrixVectorProduct(xc,y);
+	RealType diff = std::max(maxDiff(xa,xb), maxDiff(xa,xc));
+	std::cout<<label<<" vector product max difference "<<diff<<"\n";
+	ok &= check(diff < 1e-12, "vector product", label);
+
+	// p is a fixed size block, and p + 1 is not, except for p = 1, 7
+	for (SizeType q = p; q <= p + 1; ++q) {
+		Matrix<T> yy(q,n);
+		for (SizeType i = 0; i < n; ++i)
+			for (SizeType r = 0; r < q; ++r)
+				yy(r,i) = randomValue(random, static_cast<T*>(0));
+		Matrix<T> ya(q,n);
+		Matrix<T> yb(q,n);
+		Matrix<T> yc(q,n);
+		a.matrixBlockProduct(ya,yy);
+		b.matrixBlockProduct(yb,yy);
+		c.matrixBlockProduct(yc,yy);
+		diff = std::max(maxDiff(ya,yb), maxDiff(ya,yc));
+		std::cout<<label<<" block product p="<<q<<" max difference "<<diff<<"\n";
+		ok &= check(diff < 1e-12, "block product", label);
+	}
+
+	SparseMatrixType at;
+	SparseMatrixLongType bt;
+	SparseMatrixType ct;
+	transposeConjugate(at,a);
+	transposeConjugate(bt,b);
+	transposeConjugate(ct,c);
+	ok &= check(sameEntries(at,bt) && sameEntries(at,ct), "transposeConjugate", label);
+
+	SparseMatrixType aa;
+	SparseMatrixLongType bb;
+	SparseMatrixType cc;
+	multiply(aa,a,at);
+	multiply(bb,b,bt);
+	multiply(cc,c,ct);
+	ok &= check(sameEntries(aa,bb) && sameEntries(aa,cc), "multiply", label);
+
+	c.expandColumns();
+	ok &= check(!c.columnsCompressed() && a == c, "expandColumns", label);
+
+	SparseMatrixType d(n,n);
+	buildMatrix(d,n,w,true);
+	SparseMatrixType e(d);
+	bool refused = (n <= 32768 || (!e.compressColumns() && !e.columnsCompressed()));
+	ok &= check(refused && d == e, "corner entry", label);
+
+	return ok;
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	SizeType n = 100000;
+	SizeType w = 8;
+	SizeType p = 4;
+	SizeType nthreads = 1;
+
+	while ((opt = getopt(argc, argv, "n:w:p:t:")) != -1) {
+		switch (opt) {
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 'w':
+			w = atoi(optarg);
+			break;
+		case 'p':
+			p = atoi(optarg);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (n == 0 || p == 0 || nthreads == 0) usage(argv[0]);
+
+	Concurrency concurrency(&argc,&argv,nthreads);
+
+	bool ok = run<RealType>(n,w,p,"real");
+	ok &= run<ComplexType>(n,w,p,"complex");
+	std::cout<<((ok) ? "PASSED" : "FAILED")<<"\n";
+	return (ok) ? 0 : 1;
+}
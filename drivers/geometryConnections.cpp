@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Builds chains, ladders, ladderx, ktwoniffour and stars of several
+// sizes and periodicities, with connectors that have no zeros, and fails
+// unless the cached values of every pair of sites and orbitals are non
+// zero exactly when connected() says that the sites are connected
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include "InputNg.h"
+#include "Geometry/GeometryTerm.h"
+
+using namespace PsimagLite;
+
+class InputCheck {
+
+public:
+
+	bool check(const String&, const InputNgNumbers&, SizeType) const
+	{
+		return true;
+	}
+
+	bool check(const String&, const String&, SizeType) const { return true; }
+
+	void checkSimpleLabel(const String&, SizeType) const {}
+
+	String import() const { return ""; }
+};
+
+typedef InputNg<InputCheck> InputNgType;
+typedef GeometryTerm<double,InputNgType::Readable> GeometryTermType;
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" [-f file]\n";
+	std::cerr<<"The inputs are written to file\n";
+	exit(1);
+}
+
+// one case per line: kind, sites, directions and extra lines
+struct Case {
+	const char* kind;
+	SizeType sites;
+	SizeType dirs;
+	const char* extra;
+};
+
+void writeInput(const String& file, const Case& c)
+{
+	std::ofstream fout(file.c_str());
+	fout<<"TotalNumberOfSites="<<c.sites<<"\n";
+	fout<<"NumberOfTerms=1\n";
+	fout<<"DegreesOfFreedom=2\n";
+	fout<<"GeometryKind="<<c.kind<<"\n";
+	fout<<"GeometryOptions=ConstantValues\n";
+	fout<<c.extra;
+	for (SizeType dir = 0; dir < c.dirs; ++dir) {
+		fout<<"Connectors 2 2";
+		for (SizeType i = 1; i <= 4; ++i) fout<<" "<<(4*dir + i);
+		fout<<"\n";
+	}
+}
+
+bool checkTerm(const GeometryTermType& term, SizeType n)
+{
+	SizeType wrong = 0;
+	for (SizeType i1 = 0; i1 < n; ++i1) {
+		for (SizeType i2 = 0; i2 < n; ++i2) {
+			bool connected = term.connected(i1,i2);
+			for (SizeType e1 = 0; e1 < term.orbitals(i1); ++e1) {
+				for (SizeType e2 = 0; e2 < term.orbitals(i2); ++e2) {
+					bool cached = (term(i1,e1,i2,e2) != 0.0);
+					if (cached == connected) continue;
+					if (wrong++ < 10)
+						std::cout<<"sites "<<i1<<" "<<i2<<" orbitals "<<e1<<" "<<e2
+						        <<" connected="<<connected<<" value="<<term(i1,e1,i2,e2)<<"\n";
+				}
+			}
+		}
+	}
+
+	return (wrong == 0);
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	String file = "geometryConnections.inp";
+
+	while ((opt = getopt(argc, argv, "f:")) != -1) {
+		switch (opt) {
+		case 'f':
+			file = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	Case cases[] = {
+	    {"chain", 10, 1, ""},
+	    {"chain", 10, 1, "IsPeriodicX=1\n"},
+	    {"chain", 9, 1, "LongChainDistance=2\n"},
+	    {"chain", 11, 1, "IsPeriodicX=1\nLongChainDistance=3\n"},
+	    {"ladder", 12, 2, "LadderLeg=2\n"},
+	    {"ladder", 12, 2, "LadderLeg=2\nIsPeriodicX=1\n"},
+	    {"ladder", 16, 2, "LadderLeg=4\nIsPeriodicY=0\n"},
+	    {"ladder", 16, 2, "LadderLeg=4\nIsPeriodicX=1\nIsPeriodicY=1\n"},
+	    {"ladder", 24, 2, "LadderLeg=6\nIsPeriodicX=1\nIsPeriodicY=1\n"},
+	    {"ladderx", 12, 4, "LadderLeg=2\n"},
+	    {"ladderx", 16, 4, "LadderLeg=4\nIsPeriodicX=1\nIsPeriodicY=1\n"},
+	    {"ktwoniffour", 13, 4, "SignChange=1\n"},
+	    {"ktwoniffour", 21, 4, "SignChange=-1\n"},
+	    {"star", 7, 1, ""},
+	    {"star", 12, 1, ""}
+	};
+
+	SizeType total = sizeof(cases)/sizeof(Case);
+	bool ok = true;
+	for (SizeType i = 0; i < total; ++i) {
+		writeInput(file,cases[i]);
+		InputCheck inputCheck;
+		InputNgType::Writeable ioWriteable(file,inputCheck);
+		InputNgType::Readable io(ioWriteable);
+		GeometryTermType::Auxiliary aux(false,0,1,cases[i].sites);
+		GeometryTermType term(io,aux);
+		bool same = checkTerm(term,cases[i].sites);
+		std::cout<<term.label()<<" sites="<<cases[i].sites<<" ";
+		std::cout<<((same) ? "ok" : "WRONG")<<"\n";
+		ok &= same;
+	}
+
+	std::cout<<((ok) ? "PASSED" : "FAILED")<<"\n";
+	return (ok) ? 0 : 1;
+}
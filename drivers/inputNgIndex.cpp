@@ -0,0 +1,231 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Writes an input file with a label per site and a hopping matrix per
+// bond, all with the same label, and optionally a large matrix, reads
+// it with InputNg, and checks it; then checks a file without the large
+// matrix with an InputCheck that checks tokens instead of numbers
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include "InputNg.h"
+
+using namespace PsimagLite;
+
+class InputCheck {
+
+public:
+
+	// matrices do not follow the number of numbers rule
+	bool check(const String& label, const InputNgNumbers& numbers, SizeType) const
+	{
+		if (label != "Connectors" && label != "BigMatrix") return false;
+		SizeType rows = numbers.integer(0);
+		SizeType cols = numbers.integer(1);
+		if (numbers.size() != rows*cols + 2)
+			throw RuntimeError("InputCheck: wrong size for " + label + "\n");
+		return true;
+	}
+
+	bool check(const String&, const String&, SizeType) const { return true; }
+
+	void checkSimpleLabel(const String&, SizeType) const {}
+
+	String import() const { return ""; }
+};
+
+// as an InputCheck written before InputNgNumbers
+class InputCheckTokens {
+
+public:
+
+	bool check(const String& label, const Vector<String>::Type& tokens, SizeType) const
+	{
+		if (label != "Connectors") return false;
+		if (tokens.size() != 6 || tokens[0] != "2" || tokens[1] != "2")
+			throw RuntimeError("InputCheckTokens: wrong tokens for " + label + "\n");
+		return true;
+	}
+
+	bool check(const String&, const String&, SizeType) const { return true; }
+
+	void checkSimpleLabel(const String&, SizeType) const {}
+
+	String import() const { return ""; }
+};
+
+typedef InputNg<InputCheck> InputNgType;
+typedef InputNg<InputCheckTokens> InputNgTokensType;
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -f file [-n sites] [-m size]\n";
+	std::cerr<<"-m adds a size x size matrix\n";
+	exit(1);
+}
+
+double hopping(SizeType site, SizeType i, SizeType j)
+{
+	return site + 0.25*i + 0.125*j;
+}
+
+double bigMatrix(SizeType i, SizeType j)
+{
+	return 1.0/(1.0 + i) - 0.001*j;
+}
+
+void writeInput(const String& file, SizeType sites, SizeType size)
+{
+	std::ofstream fout(file.c_str());
+	fout.precision(12);
+	fout<<"TotalNumberOfSites="<<sites<<"\n";
+	fout<<"Model=HubbardOneBand\n";
+	fout<<"potentialV "<<sites;
+	for (SizeType site = 0; site < sites; ++site) fout<<" "<<(0.5*site);
+	fout<<"\n";
+
+	for (SizeType site = 0; site < sites; ++site) {
+		fout<<"SiteLabel"<<site<<"=site"<<site<<"\n";
+		fout<<"Connectors 2 2";
+		for (SizeType i = 0; i < 2; ++i)
+			for (SizeType j = 0; j < 2; ++j)
+				fout<<" "<<hopping(site,i,j);
+		fout<<"\n";
+	}
+
+	if (size == 0) return;
+	fout<<"BigMatrix "<<size<<" "<<size<<"\n";
+	for (SizeType i = 0; i < size; ++i) {
+		for (SizeType j = 0; j < size; ++j)
+			fout<<bigMatrix(i,j)<<" ";
+		fout<<"\n";
+	}
+}
+
+// reads all labels, in the order of the file, and returns false if
+// something is not what writeInput wrote
+template<typename ReadableType>
+bool readInput(ReadableType& io, SizeType sites, SizeType size)
+{
+	bool ok = true;
+	SizeType n = 0;
+	io.readline(n,"TotalNumberOfSites=");
+	ok &= (n == sites);
+
+	String model;
+	io.readline(model,"Model=");
+	ok &= (model == "HubbardOneBand");
+
+	Vector<double>::Type v;
+	io.read(v,"potentialV");
+	ok &= (v.size() == sites);
+	for (SizeType site = 0; site < v.size(); ++site) ok &= (v[site] == 0.5*site);
+
+	for (SizeType site = 0; site < sites; ++site) {
+		String label;
+		io.readline(label,"SiteLabel" + ttos(site) + "=");
+		ok &= (label == "site" + ttos(site));
+
+		Matrix<double> m;
+		io.readMatrix(m,"Connectors");
+		for (SizeType i = 0; i < 2; ++i)
+			for (SizeType j = 0; j < 2; ++j)
+				ok &= (m(i,j) == hopping(site,i,j));
+	}
+
+	if (size == 0) return ok;
+	Matrix<double> m;
+	io.readMatrix(m,"BigMatrix");
+	ok &= (m.rows() == size && m.cols() == size);
+	// bigMatrix was written with 12 digits
+	double sum = 0;
+	for (SizeType i = 0; i < m.rows(); ++i) {
+		for (SizeType j = 0; j < m.cols(); ++j) {
+			ok &= (fabs(m(i,j) - bigMatrix(i,j)) < 1e-11);
+			sum += m(i,j);
+		}
+	}
+
+	std::cout.precision(17);
+	std::cout<<"BigMatrix sum="<<sum<<"\n";
+	std::cout.precision(6);
+
+	return ok;
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	String file;
+	SizeType sites = 1000;
+	SizeType size = 0;
+
+	while ((opt = getopt(argc, argv, "f:n:m:")) != -1) {
+		switch (opt) {
+		case 'f':
+			file = optarg;
+			break;
+		case 'n':
+			sites = atoi(optarg);
+			break;
+		case 'm':
+			size = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (file == "" || sites == 0) usage(argv[0]);
+
+	writeInput(file,sites,size);
+
+	double start = wallTime();
+	InputCheck inputCheck;
+	InputNgType::Writeable ioWriteable(file,inputCheck);
+	InputNgType::Readable io(ioWriteable);
+	double loading = wallTime() - start;
+
+	start = wallTime();
+	bool ok = readInput(io,sites,size);
+	double reading = wallTime() - start;
+
+	std::cout<<"sites="<<sites<<" size="<<size<<" ok="<<ok<<"\n";
+	std::cout<<"seconds loading="<<loading<<" reading="<<reading<<"\n";
+
+	String fileTokens = file + ".tokens";
+	writeInput(fileTokens,sites,0);
+	InputCheckTokens inputCheckTokens;
+	InputNgTokensType::Writeable ioWriteableTokens(fileTokens,inputCheckTokens);
+	InputNgTokensType::Readable ioTokens(ioWriteableTokens);
+	bool okTokens = readInput(ioTokens,sites,0);
+	std::cout<<"checking tokens ok="<<okTokens<<"\n";
+
+	ok &= okTokens;
+	std::cout<<((ok) ? "PASSED" : "FAILED")<<"\n";
+	return (ok) ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Writes records with labels and data to a file, and reads labels back
+// with IoSimple::In, with its label index and by reading the file; then
+// rewrites the file in place, with the same size and the same whole
+// seconds of modification time, and fails unless the index is made again
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include "IoSimple.h"
+
+using namespace PsimagLite;
+
+typedef IoSimple::In::LongIntegerType LongIntegerType;
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -f file [-n records] [-s size] [-r reads]\n";
+	std::cerr<<"Each record has a vector of size numbers\n";
+	exit(1);
+}
+
+// rewritten changes the energies, but neither their lengths nor the
+// size of the file
+void writeFile(const String& file, SizeType records, SizeType size, bool rewritten)
+{
+	IoSimple::Out io(file);
+	Vector<double>::Type v(size);
+	for (SizeType r = 0; r < records; ++r) {
+		for (SizeType i = 0; i < size; ++i) v[i] = r + 0.001*i;
+		io<<"#Record="<<r<<"\n";
+		io<<"#Energy="<<(-10.0*r - ((rewritten) ? 2 : 1))<<"\n";
+		io.printVector(v,"#Data");
+	}
+}
+
+bool sameReads(const Vector<double>::Type& scanned,
+               const Vector<double>::Type& indexed,
+               SizeType nreads)
+{
+	bool same = true;
+	for (SizeType k = 0; k < nreads; ++k)
+		same &= (scanned[k] == indexed[k]);
+	return same && (scanned[nreads + 1] == indexed[nreads + 1]);
+}
+
+// the energies of the records in reads, the last one and the count,
+// with the index or by reading the file
+void readFile(Vector<double>::Type& energies,
+              const String& file,
+              const Vector<SizeType>::Type& reads,
+              bool indexed)
+{
+	IoSimple::In io(file);
+	energies.clear();
+	for (SizeType k = 0; k < reads.size(); ++k) {
+		double e = 0;
+		io.rewind();
+		if (indexed)
+			io.readline(e,"#Energy=",reads[k]);
+		else
+			io.readlineByScanning(e,"#Energy=",reads[k]);
+		energies.push_back(e);
+	}
+
+	io.rewind();
+	double last = 0;
+	if (indexed) {
+		io.readline(last,"#Energy=",IoSimple::In::LAST_INSTANCE);
+		io.rewind();
+		energies.push_back(io.count("#Record="));
+	} else {
+		io.readlineByScanning(last,"#Energy=",IoSimple::In::LAST_INSTANCE);
+		energies.push_back(0);
+	}
+
+	energies.push_back(last);
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	String file;
+	SizeType records = 1000;
+	SizeType size = 100;
+	SizeType nreads = 20;
+
+	while ((opt = getopt(argc, argv, "f:n:s:r:")) != -1) {
+		switch (opt) {
+		case 'f':
+			file = optarg;
+			break;
+		case 'n':
+			records = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'r':
+			nreads = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (file == "" || records == 0) usage(argv[0]);
+
+	writeFile(file,records,size,false);
+
+	Vector<SizeType>::Type reads(nreads);
+	for (SizeType k = 0; k < nreads; ++k)
+		reads[k] = (k*7919) % records;
+
+	Vector<double>::Type scanned;
+	double start = wallTime();
+	readFile(scanned,file,reads,false);
+	double scanning = wallTime() - start;
+
+	Vector<double>::Type indexed;
+	start = wallTime();
+	readFile(indexed,file,reads,true);
+	double indexing = wallTime() - start;
+
+	start = wallTime();
+	readFile(indexed,file,reads,true);
+	double again = wallTime() - start;
+
+	bool same = sameReads(scanned,indexed,nreads);
+
+	std::cout<<"records="<<records<<" reads="<<nreads<<" count="<<indexed[nreads];
+	std::cout<<" last="<<indexed[nreads + 1]<<" same="<<same<<"\n";
+	std::cout<<"seconds scanning="<<scanning<<" indexed="<<indexing;
+	std::cout<<" indexed again="<<again<<"\n";
+
+	struct stat info;
+	if (stat(file.c_str(), &info) != 0) return 1;
+	LongIntegerType sizeBefore = info.st_size;
+	writeFile(file,records,size,true);
+	struct timeval times[2];
+	times[0].tv_sec = times[1].tv_sec = info.st_mtime;
+	times[0].tv_usec = times[1].tv_usec = 0;
+	if (utimes(file.c_str(), times) != 0 || stat(file.c_str(), &info) != 0) return 1;
+
+	readFile(scanned,file,reads,false);
+	readFile(indexed,file,reads,true);
+	bool rewritten = (static_cast<LongIntegerType>(info.st_size) == sizeBefore &&
+	                  sameReads(scanned,indexed,nreads));
+	std::cout<<"rewritten in place with the same size, same="<<rewritten<<"\n";
+
+	bool ok = (same && rewritten);
+	std::cout<<((ok) ? "PASSED" : "FAILED")<<"\n";
+	return (ok) ? 0 : 1;
+}
@@ -28,7 +28,8 @@ Please see full open source license included in file LICENSE.
 void usage(const char *progName)
 {
 	std::cerr<<"Usage: "<<progName<<" -f file  -b omega1";
-	std::cerr<<" -e omega2 -s omegaStep \n";
+	std::cerr<<" -e omega2 -s omegaStep [-F]\n";
+	std::cerr<<"-F sums the moments with a cosine transform and interpolates\n";
 	std::cerr<<"Conditions: omega1<omega2 omegaStep>0 \n";
 }
 
@@ -48,7 +49,8 @@ int main(int argc,char *argv[])
 	RealType lambda = 0.0;
 	bool makeZero = false;
 	SizeType cutoff = 0;
-	while ((opt = getopt(argc, argv,"f:b:e:s:c:l:zd")) != -1) {
+	SizeType reconstruction = KernelParametersType::CLENSHAW;
+	while ((opt = getopt(argc, argv,"f:b:e:s:c:l:zdF")) != -1) {
 		switch (opt) {
 		case 'f':
 			file = optarg;
@@ -75,6 +77,9 @@ int main(int argc,char *argv[])
 		case 'z':
 			makeZero = true;
 			break;
+		case 'F':
+			reconstruction = KernelParametersType::DCT;
+			break;
 		default:
 			usage(argv[0]);
 			return 1;
@@ -96,7 +101,7 @@ int main(int argc,char *argv[])
 
 	ChebyshevSerializerType::PlotParamsType params(wbegin,wend,wstep,0.0,0.0,0);
 	ChebyshevSerializerType::PlotDataType v;
-	KernelParametersType kernelParams(type,cutoff,lambda);
+	KernelParametersType kernelParams(type,cutoff,lambda,reconstruction);
 	chebyshevSerializer.plot(v,params,kernelParams);
 	for (SizeType x=0;x<v.size();x++) {
 		RealType tmp = v[x].second;
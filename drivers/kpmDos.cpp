@@ -0,0 +1,244 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Density of states of a square lattice with random on-site energies
+// by the stochastic kernel polynomial method; the moments are written
+// to a file that kernelPolynomial reads, and the spectrum bounds in it
+// are used again if the file is there, for the same lattice. Fails unless
+// bounds of half the width make the moments throw, and unless records
+// with and without fingerprint, written one after the other to
+// file + ".records", are read back one after the other
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include "Concurrency.h"
+#include "CrsMatrix.h"
+#include "ChebyshevDensityOfStates.h"
+#include "ParametersForSolver.h"
+#include "IoSimple.h"
+#include "Random48.h"
+
+using namespace PsimagLite;
+
+typedef double RealType;
+typedef std::complex<RealType> ComplexType;
+typedef ParametersForSolver<RealType> SolverParametersType;
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -l side -f file [-s steps] [-r vectors]";
+	std::cerr<<" [-w disorder] [-t threads] [-c]\n";
+	std::cerr<<"2*steps moments are written to file\n";
+	std::cerr<<"-c uses complex numbers\n";
+	exit(1);
+}
+
+template<typename ComplexOrRealType>
+void fillLattice(CrsMatrix<ComplexOrRealType>& sparse, SizeType l, RealType disorder)
+{
+	Random48<RealType> random(1234);
+	SizeType n = l*l;
+	SizeType counter = 0;
+	for (SizeType i = 0; i < n; ++i) {
+		sparse.setRow(i,counter);
+		SizeType x = i % l;
+		SizeType y = i / l;
+		Vector<SizeType>::Type neighbors;
+		neighbors.push_back(i);
+		neighbors.push_back(y*l + (x + 1) % l);
+		neighbors.push_back(y*l + (x + l - 1) % l);
+		neighbors.push_back(((y + 1) % l)*l + x);
+		neighbors.push_back(((y + l - 1) % l)*l + x);
+		std::sort(neighbors.begin(), neighbors.end());
+		for (SizeType k = 0; k < neighbors.size(); ++k) {
+			if (k > 0 && neighbors[k] == neighbors[k - 1]) continue;
+			SizeType j = neighbors[k];
+			sparse.pushCol(j);
+			sparse.pushValue((j == i) ? disorder*(random() - 0.5) : -1.0);
+			++counter;
+		}
+	}
+
+	sparse.setRow(n,counter);
+	sparse.checkValidity();
+}
+
+// a record as written before fingerprints were saved
+template<typename PostProcType>
+void saveWithoutFingerprint(IoSimple::Out& io,
+                            const typename PostProcType::VectorType& moments,
+                            const SolverParametersType& params)
+{
+	io.print(PostProcType::stringMarker());
+	io.print("#ChebyshevEnergy=",params.Eg);
+	io.print("#ChebyshevOneOverA=",params.oneOverA);
+	io.print("#ChebyshevB=",params.b);
+	io.printVector(moments,"#ChebyshevMoments");
+}
+
+template<typename PostProcType>
+bool checkRecords(const String& file, const SolverParametersType& params)
+{
+	typename PostProcType::VectorType moments(4,0.5);
+	typename PostProcType::MatrixType unused;
+	{
+		IoSimple::Out io(file);
+		saveWithoutFingerprint<PostProcType>(io,moments,params);
+		PostProcType noFingerprint(moments,unused,params);
+		noFingerprint.save(io);
+		PostProcType withFingerprint(moments,unused,params);
+		withFingerprint.fingerprint(42);
+		withFingerprint.save(io);
+	}
+
+	IoSimple::In io(file);
+	bool ok = true;
+	try {
+		for (SizeType i = 0; i < 3; ++i) {
+			io.advance(PostProcType::stringMarker());
+			PostProcType record(io);
+			ok &= (record.fingerprint() == ((i == 2) ? 42 : 0));
+		}
+	} catch (std::exception&) {
+		ok = false;
+	}
+
+	std::cout<<"records read one after the other "<<((ok) ? "ok" : "WRONG")<<"\n";
+	return ok;
+}
+
+template<typename ComplexOrRealType>
+bool run(SizeType l,
+         SizeType steps,
+         SizeType vectors,
+         RealType disorder,
+         const String& file)
+{
+	typedef typename Vector<ComplexOrRealType>::Type VectorType;
+	typedef CrsMatrix<ComplexOrRealType> SparseMatrixType;
+	typedef ChebyshevDensityOfStates<SolverParametersType,SparseMatrixType,VectorType>
+	        ChebyshevDensityOfStatesType;
+	typedef typename ChebyshevDensityOfStatesType::PostProcType PostProcType;
+
+	SparseMatrixType sparse(l*l,l*l);
+	fillLattice(sparse,l,disorder);
+
+	SolverParametersType params;
+	params.steps = steps;
+
+	// spectrum bounds of a previous run on the same matrix, if any
+	std::ifstream fin(file.c_str());
+	if (fin.good()) {
+		fin.close();
+		typedef typename ChebyshevDensityOfStatesType::ChebyshevSolverType
+		        ChebyshevSolverType;
+		IoSimple::In io(file);
+		io.advance(PostProcType::stringMarker(),IoSimple::In::LAST_INSTANCE);
+		PostProcType cached(io);
+		if (cached.cachedBounds(params,ChebyshevSolverType::fingerprint(sparse)))
+			std::cout<<"Spectrum bounds from "<<file<<"\n";
+	}
+
+	ChebyshevDensityOfStatesType dos(sparse,params,vectors);
+
+	double start = wallTime();
+	PostProcType* postProc = dos.postProc();
+	double elapsed = wallTime() - start;
+
+	if (Concurrency::root()) {
+		std::cout<<"rank="<<sparse.rows()<<" moments="<<2*steps;
+		std::cout<<" vectors="<<vectors<<" threads="<<Concurrency::npthreads;
+		std::cout<<" seconds="<<elapsed<<"\n";
+		IoSimple::Out io(file);
+		postProc->save(io);
+	}
+
+	delete postProc;
+
+	SolverParametersType narrow = params;
+	narrow.oneOverA *= 2;
+	ChebyshevDensityOfStatesType narrowDos(sparse,narrow,1);
+	bool thrown = false;
+	try {
+		delete narrowDos.postProc();
+	} catch (RuntimeError&) {
+		thrown = true;
+	}
+
+	std::cout<<"bounds of half the width rejected "<<((thrown) ? "ok" : "WRONG")<<"\n";
+	if (!Concurrency::root()) return thrown;
+
+	return thrown & checkRecords<PostProcType>(file + ".records",params);
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	SizeType l = 0;
+	SizeType steps = 200;
+	SizeType vectors = 10;
+	SizeType nthreads = 1;
+	RealType disorder = 0.0;
+	String file;
+	bool isComplex = false;
+
+	while ((opt = getopt(argc, argv, "l:f:s:r:w:t:c")) != -1) {
+		switch (opt) {
+		case 'l':
+			l = atoi(optarg);
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		case 's':
+			steps = atoi(optarg);
+			break;
+		case 'r':
+			vectors = atoi(optarg);
+			break;
+		case 'w':
+			disorder = atof(optarg);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'c':
+			isComplex = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (l == 0 || file == "") usage(argv[0]);
+
+	Concurrency concurrency(&argc,&argv,nthreads);
+
+	bool ok = (isComplex) ? run<ComplexType>(l,steps,vectors,disorder,file)
+	                      : run<RealType>(l,steps,vectors,disorder,file);
+	std::cout<<((ok) ? "PASSED" : "FAILED")<<"\n";
+	return (ok) ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Compares the fused Lanczos step of LanczosVectors with the
+// unfused one (copy to basis, H*y, dot, axpy and norm, scale and swap).
+// It fails if, starting each step from the same x and y, a of the two
+// differ by more than 1e-12 relative to the largest of |a| and b, or b
+// differ by more than 1e-12 relative to b. A
+// shift -e added to the diagonal makes |a| large compared to b, so that
+// the fused step recomputes b^2 exactly.
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include "Concurrency.h"
+#include "CrsMatrix.h"
+#include "LanczosVectors.h"
+#include "Random48.h"
+
+using namespace PsimagLite;
+
+typedef double RealType;
+typedef std::complex<RealType> ComplexType;
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -n rank [-s steps] [-t threads] [-e shift] [-c]\n";
+	std::cerr<<"-c uses complex numbers\n";
+	exit(1);
+}
+
+// the step as it was done before the fused kernel
+template<typename MatrixType, typename VectorType>
+void unfusedStep(const MatrixType& mat,
+                 VectorType& x,
+                 VectorType& y,
+                 Matrix<typename VectorType::value_type>& basis,
+                 SizeType j,
+                 RealType& atmp,
+                 RealType& btmp)
+{
+	typedef typename VectorType::value_type VectorElementType;
+	SizeType n = mat.rows();
+
+	for (SizeType i = 0; i < n; i++)
+		basis(i,j) = y[i];
+
+	mat.matrixVectorProduct(x, y);
+
+	atmp = 0.0;
+	for (SizeType i = 0; i < n; i++)
+		atmp += PsimagLite::real(y[i]*PsimagLite::conj(x[i]));
+
+	btmp = 0.0;
+	for (SizeType i = 0; i < n; i++) {
+		x[i] -= atmp * y[i];
+		btmp += PsimagLite::real(x[i]*PsimagLite::conj(x[i]));
+	}
+
+	btmp = sqrt(btmp);
+	RealType inverseBtmp = 1.0/btmp;
+	for (SizeType i = 0; i < n; i++) {
+		VectorElementType tmp = y[i];
+		y[i] = x[i] * inverseBtmp;
+		x[i] = -btmp * tmp;
+	}
+}
+
+template<typename ComplexOrRealType>
+bool run(SizeType n, SizeType steps, RealType shift)
+{
+	typedef typename Vector<ComplexOrRealType>::Type VectorType;
+	typedef CrsMatrix<ComplexOrRealType> SparseMatrixType;
+	typedef LanczosVectors<SparseMatrixType,VectorType> LanczosVectorsType;
+	typedef typename LanczosVectorsType::DenseMatrixType DenseMatrixType;
+	typedef LanczosStepKernel<RealType> LanczosStepKernelType;
+
+	SizeType factor = sizeof(ComplexOrRealType)/sizeof(RealType);
+
+	// tight-binding chain with random on-site energies
+	Random48<RealType> random(1234);
+	SparseMatrixType sparse(n,n);
+	SizeType counter = 0;
+	for (SizeType i = 0; i < n; ++i) {
+		sparse.setRow(i,counter);
+		if (i > 0) {
+			sparse.pushCol(i - 1);
+			sparse.pushValue(-1.0);
+			++counter;
+		}
+
+		sparse.pushCol(i);
+		sparse.pushValue(random() - 0.5 + shift);
+		++counter;
+		if (i + 1 < n) {
+			sparse.pushCol(i + 1);
+			sparse.pushValue(-1.0);
+			++counter;
+		}
+	}
+
+	sparse.setRow(n,counter);
+
+	VectorType y0(n);
+	RealType norm = 0;
+	for (SizeType i = 0; i < n; ++i) {
+		y0[i] = random() - 0.5;
+		norm += PsimagLite::real(y0[i]*PsimagLite::conj(y0[i]));
+	}
+
+	for (SizeType i = 0; i < n; ++i) y0[i] /= sqrt(norm);
+
+	Vector<RealType>::Type a1(steps), b1(steps), a2(steps), b2(steps);
+
+	DenseMatrixType basis1(n,steps);
+	VectorType x(n,0.0);
+	VectorType y = y0;
+	double start = wallTime();
+	for (SizeType j = 0; j < steps; ++j)
+		unfusedStep(sparse,x,y,basis1,j,a1[j],b1[j]);
+	double unfused = (wallTime() - start)/steps;
+
+	DenseMatrixType basis2(n,steps);
+	LanczosVectorsType lanczosVectors(sparse,true,steps,&basis2);
+	x.assign(n,0.0);
+	y = y0;
+	start = wallTime();
+	for (SizeType j = 0; j < steps; ++j)
+		lanczosVectors.oneStepDecompositionAndSave(x,y,a2[j],b2[j],j);
+	double fused = (wallTime() - start)/steps;
+
+	RealType maxDiff = 0;
+	SizeType recomputed = 0;
+	for (SizeType j = 0; j < steps; ++j) {
+		maxDiff = std::max(maxDiff, fabs(a1[j] - a2[j]));
+		maxDiff = std::max(maxDiff, fabs(b1[j] - b2[j]));
+		// <x,x> = a^2 + b^2 >= 16 b^2
+		if (a1[j]*a1[j] >= 15*b1[j]*b1[j]) ++recomputed;
+	}
+
+	// one step at a time, from the state of the unfused recurrence
+	RealType maxStepDiff = 0;
+	x.assign(n,0.0);
+	y = y0;
+	for (SizeType j = 0; j < steps; ++j) {
+		VectorType x2 = x;
+		VectorType y2 = y;
+		RealType a = 0;
+		RealType b = 0;
+		unfusedStep(sparse,x,y,basis1,j,a,b);
+		sparse.matrixVectorProduct(x2, y2);
+		RealType a3 = 0;
+		RealType b3 = 0;
+		LanczosStepKernelType kernel(reinterpret_cast<RealType*>(&x2[0]),
+		                             reinterpret_cast<RealType*>(&y2[0]),
+		                             0,
+		                             factor*n);
+		kernel.step(a3,b3);
+		maxStepDiff = std::max(maxStepDiff, fabs(a - a3)/std::max(fabs(a), b));
+		maxStepDiff = std::max(maxStepDiff, fabs(b - b3)/b);
+	}
+
+	// bytes moved by the streaming passes; H*y is the same for both
+	double bytesUnfused = 11.0*n*sizeof(ComplexOrRealType);
+	double bytesFused = LanczosStepKernelType::realsMovedPerStep(factor*n,true)
+	        *sizeof(RealType);
+	double bytesMatVec = counter*(sizeof(ComplexOrRealType) + sizeof(int))
+	        + 3.0*n*sizeof(ComplexOrRealType);
+
+	std::cout<<"rank="<<n<<" steps="<<steps;
+	std::cout<<" threads="<<Concurrency::npthreads<<"\n";
+	std::cout<<"bytes per step in H*y= "<<bytesMatVec<<"\n";
+	std::cout<<"bytes per step in vector passes: unfused= "<<bytesUnfused;
+	std::cout<<" fused= "<<bytesFused<<"\n";
+	std::cout<<"seconds per step: unfused= "<<unfused<<" fused= "<<fused<<"\n";
+	std::cout<<"GB/s: unfused= "<<1e-9*(bytesUnfused + bytesMatVec)/unfused;
+	std::cout<<" fused= "<<1e-9*(bytesFused + bytesMatVec)/fused<<"\n";
+	std::cout<<"steps with b^2 recomputed= "<<recomputed<<"\n";
+	std::cout<<"max difference in a and b= "<<maxDiff<<"\n";
+	std::cout<<"max difference in a and b of one step, relative= "<<maxStepDiff<<"\n";
+
+	return (maxStepDiff <= 1e-12);
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	SizeType n = 0;
+	SizeType steps = 20;
+	SizeType nthreads = 1;
+	bool isComplex = false;
+	RealType shift = 0;
+
+	while ((opt = getopt(argc, argv, "n:s:t:e:c")) != -1) {
+		switch (opt) {
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 's':
+			steps = atoi(optarg);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'e':
+			shift = atof(optarg);
+			break;
+		case 'c':
+			isComplex = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (n == 0) usage(argv[0]);
+
+	Concurrency concurrency(&argc,&argv,nthreads);
+
+	bool ok = (isComplex) ? run<ComplexType>(n,steps,shift) : run<RealType>(n,steps,shift);
+	std::cout<<((ok) ? "PASSED" : "FAILED")<<"\n";
+	return (ok) ? 0 : 1;
+}
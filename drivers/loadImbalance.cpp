@@ -18,28 +18,38 @@ Please see full open source license included in file LICENSE.
 #include "Concurrency.h"
 #include <iostream>
 #include <cstdlib>
+#include <sys/time.h>
 #define USE_PTHREADS_OR_NOT_NG
 #include "Parallelizer.h"
+#include "LoadBalancerWorkStealing.h"
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
 
 class MyHelper {
 
 	typedef PsimagLite::Concurrency ConcurrencyType;
 	typedef PsimagLite::Vector<SizeType>::Type VectorSizeType;
+	typedef PsimagLite::Vector<double>::Type VectorDoubleType;
 
 public:
 
-	MyHelper(SizeType ntasks, SizeType nthreads)
+	MyHelper(SizeType ntasks, SizeType nthreads, SizeType workScale)
 	    : weight_(ntasks),
-	      x_(nthreads,0)
+	      x_(nthreads,0),
+	      finish_(nthreads,0),
+	      workScale_(workScale),
+	      start_(wallTime())
 	{
 		srand48(1234);
 		for (SizeType i = 0; i < ntasks; ++i) {
 			double x = 10*drand48();
 			weight_[i] = 1 + static_cast<SizeType>(x);
-			std::cout<<weight_[i]<<" ";
 		}
-
-		std::cout<<"\n";
 	}
 
 	SizeType tasks() const { return weight_.size(); }
@@ -53,8 +63,11 @@ public:
 
 	void doTask(SizeType taskNumber, SizeType threadNum)
 	{
-		for (SizeType i = 0; i < weight_[taskNumber]; ++i)
-			x_[threadNum] += (taskNumber + i);
+		SizeType n = weight_[taskNumber]*workScale_;
+		for (SizeType i = 0; i < n; ++i)
+			x_[threadNum] += (taskNumber + i/workScale_);
+
+		finish_[threadNum] = wallTime() - start_;
 	}
 
 	void sync()
@@ -63,39 +76,90 @@ public:
 			x_[0] += x_[i];
 	}
 
+	// time of the last thread to finish over the average finishing time
+	double imbalance() const
+	{
+		double max = 0;
+		double sum = 0;
+		for (SizeType i = 0; i < finish_.size(); ++i) {
+			max = std::max(max, finish_[i]);
+			sum += finish_[i];
+		}
+
+		return (sum > 0) ? max*finish_.size()/sum : 1;
+	}
+
+	double wallTimeSinceStart() const { return wallTime() - start_; }
+
 private:
 
 	VectorSizeType weight_;
 	VectorSizeType x_;
+	VectorDoubleType finish_;
+	SizeType workScale_;
+	double start_;
 }; // class MyHelper
 
+void report(const PsimagLite::String& name, MyHelper& helper)
+{
+	helper.sync();
+	std::cout<<name<<": sum of all tasks= "<<helper.result();
+	std::cout<<" wallTime= "<<helper.wallTimeSinceStart()<<"s";
+	std::cout<<" imbalance= "<<helper.imbalance()<<"\n";
+}
 
 int main(int argc,char *argv[])
 {
 	typedef PsimagLite::Concurrency ConcurrencyType;
+	typedef PsimagLite::Vector<SizeType>::Type VectorSizeType;
 
-
-	if (argc!=3) {
-		std::cout<<"USAGE: "<<argv[0]<<" nthreads ntasks\n";
+	if (argc < 3) {
+		std::cout<<"USAGE: "<<argv[0]<<" nthreads ntasks [workScale]\n";
 		return 1;
 	}
 
 	SizeType nthreads  = atoi(argv[1]);
 	SizeType ntasks = atoi(argv[2]);
+	SizeType workScale = (argc > 3) ? atoi(argv[3]) : 1;
 
 	ConcurrencyType concurrency(&argc,&argv,nthreads);
 
 	typedef MyHelper HelperType;
 	typedef PsimagLite::Parallelizer<HelperType> ParallelizerType;
+#ifdef USE_PTHREADS
+	typedef PsimagLite::PthreadsNg<HelperType, PsimagLite::LoadBalancerWorkStealing>
+	        StealingType;
+#else
+	typedef PsimagLite::NoPthreadsNg<HelperType, PsimagLite::LoadBalancerWorkStealing>
+	        StealingType;
+#endif
+
 	ParallelizerType threadObject(PsimagLite::Concurrency::npthreads,
 	                              PsimagLite::MPI::COMM_WORLD);
 
-	HelperType helper(ntasks, nthreads);
+	HelperType helper(ntasks, nthreads, workScale);
+	for (SizeType i = 0; i < ntasks; ++i)
+		std::cout<<helper.weights()[i]<<" ";
+	std::cout<<"\n";
 
 	std::cout<<"Using "<<threadObject.name();
 	std::cout<<" with "<<threadObject.threads()<<" threads.\n";
 	threadObject.loopCreate(helper, helper.weights());
-	helper.sync();
-	std::cout<<"Sum of all tasks= "<<helper.result()<<"\n";
+	report("LoadBalancerDefault, exact weights", helper);
+
+	// weights are usually estimates; here they are all wrong
+	VectorSizeType flatWeights(ntasks, 1);
+
+	HelperType helper2(ntasks, nthreads, workScale);
+	threadObject.loopCreate(helper2, flatWeights);
+	report("LoadBalancerDefault, flat weights", helper2);
+
+	HelperType helper3(ntasks, nthreads, workScale);
+	StealingType stealingObject(PsimagLite::Concurrency::npthreads,
+	                            0,
+	                            PsimagLite::Concurrency::setAffinitiesDefault);
+	PsimagLite::LoadBalancerWorkStealing loadBalancer(flatWeights, nthreads);
+	stealingObject.loopCreate(helper3, loadBalancer);
+	report("LoadBalancerWorkStealing, flat weights", helper3);
+	std::cout<<"Steals= "<<loadBalancer.steals()<<"\n";
 }
-
@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Compares matrixVectorProduct of CrsMatrix, SellMatrix and BsrMatrix,
+// and the format SparseMatrixAuto chooses, for a chain with several
+// orbitals per site, and the Lanczos ground state energies with them
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include "Concurrency.h"
+#include "CrsMatrix.h"
+#include "SellMatrix.h"
+#include "BsrMatrix.h"
+#include "SparseMatrixAuto.h"
+#include "LanczosSolver.h"
+#include "ParametersForSolver.h"
+#include "Random48.h"
+
+using namespace PsimagLite;
+
+typedef double RealType;
+typedef std::complex<RealType> ComplexType;
+typedef ParametersForSolver<RealType> SolverParametersType;
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -n sites [-o orbitals] [-r repetitions]";
+	std::cerr<<" [-t threads] [-c]\n";
+	std::cerr<<"-c uses complex numbers\n";
+	exit(1);
+}
+
+// orbitals are dense on each site and connect to all orbitals of the
+// nearest neighbors of a periodic chain
+template<typename ComplexOrRealType>
+void fillChain(CrsMatrix<ComplexOrRealType>& sparse, SizeType sites, SizeType orbitals)
+{
+	Random48<RealType> random(1234);
+	SizeType n = sites*orbitals;
+	sparse.resize(n,n);
+	SizeType counter = 0;
+	for (SizeType i = 0; i < n; ++i) {
+		sparse.setRow(i,counter);
+		SizeType site = i/orbitals;
+		Vector<SizeType>::Type neighbors;
+		neighbors.push_back(site);
+		neighbors.push_back((site + 1) % sites);
+		neighbors.push_back((site + sites - 1) % sites);
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		for (SizeType k = 0; k < neighbors.size(); ++k) {
+			for (SizeType orb = 0; orb < orbitals; ++orb) {
+				SizeType j = neighbors[k]*orbitals + orb;
+				sparse.pushCol(j);
+				RealType hop = 1.0/(1.0 + (i % orbitals) + orb);
+				sparse.pushValue((neighbors[k] == site) ? random() - 0.5 : -hop);
+				++counter;
+			}
+		}
+	}
+
+	sparse.setRow(n,counter);
+	sparse.checkValidity();
+}
+
+template<typename MatrixType, typename VectorType>
+RealType timeProduct(const MatrixType& mat,
+                     VectorType& x,
+                     const VectorType& y,
+                     SizeType repetitions)
+{
+	std::fill(x.begin(), x.end(), 0.0);
+	double start = wallTime();
+	for (SizeType r = 0; r < repetitions; ++r)
+		mat.matrixVectorProduct(x, y);
+	return wallTime() - start;
+}
+
+template<typename VectorType>
+RealType maxDifference(const VectorType& a, const VectorType& b)
+{
+	RealType diff = 0;
+	for (SizeType i = 0; i < a.size(); ++i)
+		diff = std::max(diff, static_cast<RealType>(std::abs(a[i] - b[i])));
+	return diff;
+}
+
+template<typename MatrixType, typename VectorType>
+RealType groundState(const MatrixType& mat)
+{
+	SolverParametersType params;
+	LanczosSolver<SolverParametersType,MatrixType,VectorType> lanczosSolver(mat,params);
+	RealType e = 0;
+	VectorType z(mat.rows(),0.0);
+	lanczosSolver.computeGroundState(e,z);
+	return e;
+}
+
+template<typename ComplexOrRealType>
+void run(SizeType sites, SizeType orbitals, SizeType repetitions)
+{
+	typedef typename Vector<ComplexOrRealType>::Type VectorType;
+	typedef CrsMatrix<ComplexOrRealType> SparseMatrixType;
+	typedef SparseMatrixAuto<ComplexOrRealType> SparseMatrixAutoType;
+
+	SparseMatrixType crs;
+	fillChain(crs,sites,orbitals);
+	SellMatrix<ComplexOrRealType> sell(crs);
+	BsrMatrix<ComplexOrRealType> bsr(crs,orbitals);
+	SparseMatrixAutoType automatic(crs);
+
+	SizeType n = crs.rows();
+	VectorType y(n);
+	for (SizeType i = 0; i < n; ++i) y[i] = sin(0.1*i);
+	VectorType x0(n), x(n);
+
+	std::cout<<"rank="<<n<<" nonzeros="<<crs.nonZeros();
+	std::cout<<" threads="<<Concurrency::npthreads<<"\n";
+	std::cout<<"CRS  seconds="<<timeProduct(crs,x0,y,repetitions)<<"\n";
+
+	RealType elapsed = timeProduct(sell,x,y,repetitions);
+	std::cout<<"SELL seconds="<<elapsed<<" diff="<<maxDifference(x,x0);
+	std::cout<<" padding="<<static_cast<RealType>(sell.storedEntries())/sell.nonZeros()<<"\n";
+
+	elapsed = timeProduct(bsr,x,y,repetitions);
+	std::cout<<"BSR  seconds="<<elapsed<<" diff="<<maxDifference(x,x0);
+	std::cout<<" blockSize="<<bsr.blockSize()<<"\n";
+
+	elapsed = timeProduct(automatic,x,y,repetitions);
+	std::cout<<"auto format="<<SparseMatrixAutoType::formatName(automatic.format());
+	std::cout<<" blockSize="<<automatic.blockSize();
+	std::cout<<" seconds="<<elapsed<<" diff="<<maxDifference(x,x0)<<"\n";
+
+	RealType eCrs = groundState<SparseMatrixType,VectorType>(crs);
+	RealType eAuto = groundState<SparseMatrixAutoType,VectorType>(automatic);
+	std::cout.precision(12);
+	std::cout<<"ground state CRS="<<eCrs<<" auto="<<eAuto<<"\n";
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	SizeType sites = 0;
+	SizeType orbitals = 1;
+	SizeType repetitions = 100;
+	SizeType nthreads = 1;
+	bool isComplex = false;
+
+	while ((opt = getopt(argc, argv, "n:o:r:t:c")) != -1) {
+		switch (opt) {
+		case 'n':
+			sites = atoi(optarg);
+			break;
+		case 'o':
+			orbitals = atoi(optarg);
+			break;
+		case 'r':
+			repetitions = atoi(optarg);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'c':
+			isComplex = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (sites < 3 || orbitals == 0) usage(argv[0]);
+
+	Concurrency concurrency(&argc,&argv,nthreads);
+
+	if (isComplex)
+		run<ComplexType>(sites,orbitals,repetitions);
+	else
+		run<RealType>(sites,orbitals,repetitions);
+}
@@ -0,0 +1,227 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Compares DavidsonSolver and LanczosSolver on a diagonally dominant matrix,
+// and DavidsonSolver without preconditioner on a matrix without fullDiag(),
+// and fails if the energies differ by more than the tolerance. Lanczos may
+// take up to rank steps, and does not store its vectors, so that it converges
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include "LanczosSolver.h"
+#include "DavidsonSolver.h"
+#include "CrsMatrix.h"
+#include "Random48.h"
+#include "ParametersForSolver.h"
+
+using namespace PsimagLite;
+
+typedef double RealType;
+typedef double ComplexOrRealType;
+typedef ParametersForSolver<RealType> ParametersForSolverType;
+typedef Vector<ComplexOrRealType>::Type VectorType;
+typedef CrsMatrix<ComplexOrRealType> SparseMatrixType;
+
+// Counts the number of times H*v is requested
+class CountingMatrix {
+
+public:
+
+	CountingMatrix(const SparseMatrixType& m)
+	    : m_(m), counter_(0)
+	{}
+
+	SizeType rows() const { return m_.rows(); }
+
+	template<typename SomeVectorType>
+	void matrixVectorProduct(SomeVectorType& x, const SomeVectorType& y) const
+	{
+		++counter_;
+		m_.matrixVectorProduct(x,y);
+	}
+
+	template<typename SomeVectorType>
+	void fullDiag(SomeVectorType& d) const
+	{
+		m_.fullDiag(d);
+	}
+
+	SizeType counter() const { return counter_; }
+
+	void resetCounter() { counter_ = 0; }
+
+private:
+
+	const SparseMatrixType& m_;
+	mutable SizeType counter_;
+}; // class CountingMatrix
+
+// As CountingMatrix, but without fullDiag()
+class CountingMatrixNoDiagonal {
+
+public:
+
+	CountingMatrixNoDiagonal(CountingMatrix& m) : m_(m) {}
+
+	SizeType rows() const { return m_.rows(); }
+
+	template<typename SomeVectorType>
+	void matrixVectorProduct(SomeVectorType& x, const SomeVectorType& y) const
+	{
+		m_.matrixVectorProduct(x,y);
+	}
+
+private:
+
+	const CountingMatrix& m_;
+}; // class CountingMatrixNoDiagonal
+
+typedef LanczosOrDavidsonBase<ParametersForSolverType,CountingMatrix,VectorType>
+SparseSolverType;
+typedef LanczosSolver<ParametersForSolverType,CountingMatrix,VectorType>
+LanczosSolverType;
+typedef DavidsonSolver<ParametersForSolverType,CountingMatrix,VectorType>
+DavidsonSolverType;
+typedef DavidsonSolver<ParametersForSolverType,CountingMatrixNoDiagonal,VectorType>
+DavidsonNoDiagonalSolverType;
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" -n rank [-b bandwidth] [-m max_offdiagonal]";
+	std::cerr<<" [-k davidson_block_size] [-r seed] [-e tolerance]\n";
+	exit(1);
+}
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+template<typename SomeSolverType>
+RealType run(const String& name,
+             SomeSolverType& solver,
+             CountingMatrix& matrix)
+{
+	RealType gsEnergy = 0;
+	VectorType gsVector(matrix.rows(),0.0);
+	matrix.resetCounter();
+	double start = wallTime();
+	solver.computeGroundState(gsEnergy,gsVector);
+	double elapsed = wallTime() - start;
+	std::cout.precision(12);
+	std::cout<<name<<" energy="<<gsEnergy;
+	std::cout<<" matrixVectorProducts="<<matrix.counter();
+	std::cout<<" wallTime="<<elapsed<<"s\n";
+	return gsEnergy;
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	SizeType n = 0;
+	SizeType bandwidth = 4;
+	RealType maxValue = 0.1;
+	SizeType blockSize = 1;
+	SizeType seed = 3443331;
+	RealType tolerance = 1e-8;
+
+	while ((opt = getopt(argc, argv, "n:b:m:k:r:e:")) != -1) {
+		switch (opt) {
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 'b':
+			bandwidth = atoi(optarg);
+			break;
+		case 'm':
+			maxValue = atof(optarg);
+			break;
+		case 'k':
+			blockSize = atoi(optarg);
+			break;
+		case 'r':
+			seed = atoi(optarg);
+			break;
+		case 'e':
+			tolerance = atof(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (n == 0) usage(argv[0]);
+
+	// symmetric band matrix with a large, spread out, diagonal
+	Random48<RealType> random(seed);
+	Matrix<ComplexOrRealType> offdiagonal(n,bandwidth);
+	for (SizeType i = 0; i < n; ++i)
+		for (SizeType b = 0; b < bandwidth; ++b)
+			offdiagonal(i,b) = maxValue*(random() - 0.5);
+
+	SparseMatrixType sparse(n,n);
+	SizeType counter = 0;
+	for (SizeType i = 0; i < n; ++i) {
+		sparse.setRow(i,counter);
+		SizeType start = (i > bandwidth) ? i - bandwidth : 0;
+		SizeType end = std::min(n, i + bandwidth + 1);
+		for (SizeType j = start; j < end; ++j) {
+			ComplexOrRealType val = 0;
+			if (j == i) val = static_cast<RealType>(i) + random();
+			else if (j < i) val = offdiagonal(j,i - j - 1);
+			else val = offdiagonal(i,j - i - 1);
+
+			sparse.pushValue(val);
+			sparse.pushCol(j);
+			++counter;
+		}
+	}
+
+	sparse.setRow(n,counter);
+	sparse.checkValidity();
+	assert(isHermitian(sparse));
+
+	CountingMatrix matrix(sparse);
+
+	ParametersForSolverType params;
+	params.lotaMemory = false;
+	params.steps = n;
+
+	LanczosSolverType lanczosSolver(matrix,params);
+	RealType energy = run("Lanczos",lanczosSolver,matrix);
+
+	params.lotaMemory = true;
+	params.steps = ParametersForSolverType::LanczosSteps;
+	params.davidsonBlockSize = blockSize;
+	DavidsonSolverType davidsonSolver(matrix,params);
+	RealType energyDavidson = run("Davidson",davidsonSolver,matrix);
+
+	params.steps = n;
+	CountingMatrixNoDiagonal matrixNoDiagonal(matrix);
+	DavidsonNoDiagonalSolverType davidsonNoDiagonal(matrixNoDiagonal,params);
+	RealType energyNoDiagonal = run("Davidson without diagonal",davidsonNoDiagonal,matrix);
+
+	RealType scale = std::max(RealType(1.0),fabs(energy));
+	bool ok = (fabs(energy - energyDavidson) < tolerance*scale &&
+	           fabs(energy - energyNoDiagonal) < tolerance*scale);
+	std::cout<<((ok) ? "PASSED" : "FAILED")<<"\n";
+	return (ok) ? 0 : 1;
+}
+
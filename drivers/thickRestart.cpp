@@ -0,0 +1,170 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Runs thick-restart Lanczos with lotaMemory set, and fails if the
+// energy differs from the one of plain Lanczos, or if the heap grew by
+// more than one basis of steps vectors plus eight vectors, counting all
+// operator new calls
+#include <unistd.h>
+#include <cstdlib>
+#include <new>
+#include "CrsMatrix.h"
+#include "LanczosSolver.h"
+#include "ParametersForSolver.h"
+#include "Random48.h"
+
+using namespace PsimagLite;
+
+typedef double RealType;
+typedef ParametersForSolver<RealType> SolverParametersType;
+typedef Vector<RealType>::Type VectorType;
+typedef CrsMatrix<RealType> SparseMatrixType;
+typedef LanczosSolver<SolverParametersType,SparseMatrixType,VectorType> LanczosSolverType;
+
+// each block starts with its size; the header keeps the alignment of new
+static const std::size_t HEADER = 16;
+static std::size_t heapNow = 0;
+static std::size_t heapPeak = 0;
+// called through a volatile pointer so that the compiler does not pair
+// it with operator new
+static void (*volatile releaseBlock)(void*) = free;
+
+void* operator new(std::size_t size) throw(std::bad_alloc)
+{
+	char* ptr = static_cast<char*>(malloc(size + HEADER));
+	if (!ptr) throw std::bad_alloc();
+	*reinterpret_cast<std::size_t*>(ptr) = size;
+	heapNow += size;
+	if (heapNow > heapPeak) heapPeak = heapNow;
+	return ptr + HEADER;
+}
+
+void operator delete(void* p) throw()
+{
+	if (!p) return;
+	char* ptr = static_cast<char*>(p) - HEADER;
+	heapNow -= *reinterpret_cast<std::size_t*>(ptr);
+	releaseBlock(ptr);
+}
+
+void* operator new[](std::size_t size) throw(std::bad_alloc)
+{
+	return operator new(size);
+}
+
+void operator delete[](void* p) throw()
+{
+	operator delete(p);
+}
+
+void usage(const char *progName)
+{
+	std::cerr<<"Usage: "<<progName<<" [-n rank] [-s steps]\n";
+	exit(1);
+}
+
+// chain with random on-site energies and one deep site, so that the
+// ground state is well separated
+void buildMatrix(SparseMatrixType& sparse, SizeType n)
+{
+	Random48<RealType> random(1234);
+	SizeType counter = 0;
+	for (SizeType i = 0; i < n; ++i) {
+		sparse.setRow(i,counter);
+		if (i > 0) {
+			sparse.pushCol(i - 1);
+			sparse.pushValue(-1.0);
+			++counter;
+		}
+
+		sparse.pushCol(i);
+		sparse.pushValue((i == n/2) ? -5.0 : random());
+		++counter;
+		if (i + 1 < n) {
+			sparse.pushCol(i + 1);
+			sparse.pushValue(-1.0);
+			++counter;
+		}
+	}
+
+	sparse.setRow(n,counter);
+	sparse.checkValidity();
+}
+
+int main(int argc,char *argv[])
+{
+	int opt = 0;
+	SizeType n = 100000;
+	SizeType steps = 12;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 's':
+			steps = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (n == 0 || steps < 3) usage(argv[0]);
+
+	SparseMatrixType sparse(n,n);
+	buildMatrix(sparse,n);
+
+	SolverParametersType params;
+	params.steps = steps;
+	params.tolerance = 1e-12;
+	params.lotaMemory = true;
+	params.options = "lanczosThickRestart";
+
+	std::size_t before = heapNow;
+	heapPeak = heapNow;
+	RealType energy = 0;
+	VectorType z(n);
+	{
+		LanczosSolverType solver(sparse,params);
+		solver.computeGroundState(energy,z);
+		std::cout<<"thick restarts="<<solver.thickRestarts()<<"\n";
+	}
+
+	std::size_t peak = heapPeak - before;
+	std::size_t basis = static_cast<std::size_t>(n)*steps*sizeof(RealType);
+	std::size_t allowed = basis + 8*n*sizeof(RealType) + 64*steps*steps*sizeof(RealType);
+
+	SolverParametersType params2;
+	params2.steps = 10*steps;
+	params2.tolerance = 1e-12;
+	params2.lotaMemory = false;
+	RealType energy2 = 0;
+	VectorType z2(n);
+	LanczosSolverType solver2(sparse,params2);
+	solver2.computeGroundState(energy2,z2);
+
+	std::cout.precision(14);
+	std::cout<<"energy thick restart="<<energy<<" plain="<<energy2<<"\n";
+	std::cout<<"peak heap growth="<<peak<<" bytes, one basis="<<basis;
+	std::cout<<" bytes, allowed="<<allowed<<" bytes\n";
+
+	bool ok = (fabs(energy - energy2) < 1e-8 && peak <= allowed);
+	std::cout<<((ok) ? "PASSED" : "FAILED")<<"\n";
+	return (ok) ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+// Measures startup latency and per-loop overhead of the PthreadsNg pool,
+// and compares with creating and joining fresh pthreads on every loop;
+// then checks that loops started from two threads at once both run on
+// the pool, and not in the threads that started them, and that switching
+// affinities between loops does not create threads
+#include "Concurrency.h"
+#include <iostream>
+#include <cstdlib>
+#include <sys/time.h>
+#define USE_PTHREADS_OR_NOT_NG
+#include "Parallelizer.h"
+
+class MyHelper {
+
+	typedef PsimagLite::Vector<SizeType>::Type VectorSizeType;
+
+public:
+
+	MyHelper(SizeType ntasks, SizeType nthreads)
+	    : ntasks_(ntasks), x_(nthreads,0)
+	{}
+
+	SizeType tasks() const { return ntasks_; }
+
+	SizeType result() const
+	{
+		SizeType sum = 0;
+		for (SizeType i = 0; i < x_.size(); ++i)
+			sum += x_[i];
+		return sum;
+	}
+
+	void doTask(SizeType taskNumber, SizeType threadNum)
+	{
+		x_[threadNum] += taskNumber;
+	}
+
+private:
+
+	SizeType ntasks_;
+	VectorSizeType x_;
+}; // class MyHelper
+
+double wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv,0);
+	return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+#ifdef USE_PTHREADS
+struct FreshStruct {
+	MyHelper* helper;
+	SizeType threadNum;
+	SizeType nthreads;
+};
+
+void* freshFunction(void* ptr)
+{
+	FreshStruct* fs = static_cast<FreshStruct*>(ptr);
+	SizeType ntasks = fs->helper->tasks();
+	for (SizeType t = fs->threadNum; t < ntasks; t += fs->nthreads)
+		fs->helper->doTask(t, fs->threadNum);
+	return 0;
+}
+
+// what PthreadsNg used to do: create and join threads on every loop
+void freshLoop(MyHelper& helper, SizeType nthreads)
+{
+	PsimagLite::Vector<pthread_t>::Type ids(nthreads);
+	PsimagLite::Vector<FreshStruct>::Type fs(nthreads);
+	for (SizeType j = 0; j < nthreads; ++j) {
+		fs[j].helper = &helper;
+		fs[j].threadNum = j;
+		fs[j].nthreads = nthreads;
+		pthread_create(&ids[j], 0, freshFunction, &fs[j]);
+	}
+
+	for (SizeType j = 0; j < nthreads; ++j)
+		pthread_join(ids[j], 0);
+}
+
+// counts the tasks that run in the thread that started the loop
+class CallerHelper {
+
+public:
+
+	CallerHelper(SizeType ntasks)
+	    : ntasks_(ntasks), caller_(pthread_self()), inCaller_(0)
+	{
+		pthread_mutex_init(&mutex_, 0);
+	}
+
+	~CallerHelper() { pthread_mutex_destroy(&mutex_); }
+
+	SizeType tasks() const { return ntasks_; }
+
+	SizeType inCaller() const { return inCaller_; }
+
+	void doTask(SizeType, SizeType)
+	{
+		if (!pthread_equal(pthread_self(), caller_)) return;
+		pthread_mutex_lock(&mutex_);
+		++inCaller_;
+		pthread_mutex_unlock(&mutex_);
+	}
+
+private:
+
+	SizeType ntasks_;
+	pthread_t caller_;
+	SizeType inCaller_;
+	pthread_mutex_t mutex_;
+}; // class CallerHelper
+
+struct CallerStruct {
+	SizeType nthreads;
+	SizeType loops;
+	SizeType inCaller;
+};
+
+void* callerFunction(void* ptr)
+{
+	CallerStruct* cs = static_cast<CallerStruct*>(ptr);
+	PsimagLite::Parallelizer<CallerHelper> threadObject(cs->nthreads,
+	                                                    PsimagLite::MPI::COMM_WORLD);
+	CallerHelper helper(cs->nthreads);
+	for (SizeType i = 0; i < cs->loops; ++i)
+		threadObject.loopCreate(helper);
+	cs->inCaller = helper.inCaller();
+	return 0;
+}
+
+// two threads start loops at the same time; returns the number of tasks
+// that ran in the thread that started their loop
+SizeType concurrentCallers(SizeType nthreads, SizeType loops)
+{
+	pthread_t ids[2];
+	CallerStruct cs[2];
+	for (SizeType j = 0; j < 2; ++j) {
+		cs[j].nthreads = nthreads;
+		cs[j].loops = loops;
+		cs[j].inCaller = 0;
+		pthread_create(&ids[j], 0, callerFunction, &cs[j]);
+	}
+
+	for (SizeType j = 0; j < 2; ++j)
+		pthread_join(ids[j], 0);
+
+	return cs[0].inCaller + cs[1].inCaller;
+}
+#endif
+
+int main(int argc,char *argv[])
+{
+	typedef PsimagLite::Concurrency ConcurrencyType;
+
+	if (argc < 3) {
+		std::cout<<"USAGE: "<<argv[0]<<" nthreads loops [ntasks]\n";
+		return 1;
+	}
+
+	SizeType nthreads = atoi(argv[1]);
+	SizeType loops = atoi(argv[2]);
+	SizeType ntasks = (argc > 3) ? atoi(argv[3]) : nthreads;
+	ConcurrencyType concurrency(&argc,&argv,nthreads);
+
+	typedef PsimagLite::Parallelizer<MyHelper> ParallelizerType;
+	ParallelizerType threadObject(ConcurrencyType::npthreads,
+	                              PsimagLite::MPI::COMM_WORLD);
+
+	std::cout<<"Using "<<threadObject.name();
+	std::cout<<" with "<<threadObject.threads()<<" threads.\n";
+
+	MyHelper helper(ntasks, nthreads);
+	double start = wallTime();
+	threadObject.loopCreate(helper);
+	double first = wallTime() - start;
+
+	start = wallTime();
+	for (SizeType i = 0; i < loops; ++i)
+		threadObject.loopCreate(helper);
+	double perLoop = (loops > 0) ? (wallTime() - start)/loops : 0;
+
+	SizeType expected = (loops + 1)*ntasks*(ntasks - 1)/2;
+	std::cout<<"Sum of all tasks= "<<helper.result();
+	std::cout<<" (expected "<<expected<<")\n";
+	std::cout<<"First loop (includes startup)= "<<1e6*first<<" us\n";
+	std::cout<<"Per loop= "<<1e6*perLoop<<" us\n";
+
+#ifdef USE_PTHREADS
+	std::cout<<"Threads created by the pool= ";
+	std::cout<<PsimagLite::PthreadsNgPool::instance().threadsCreated()<<"\n";
+
+	MyHelper helper2(ntasks, nthreads);
+	start = wallTime();
+	for (SizeType i = 0; i < loops; ++i)
+		freshLoop(helper2, nthreads);
+	double perLoopFresh = (loops > 0) ? (wallTime() - start)/loops : 0;
+	std::cout<<"Per loop creating and joining threads= "<<1e6*perLoopFresh<<" us\n";
+
+	SizeType inCaller = (nthreads > 1) ? concurrentCallers(nthreads, loops) : 0;
+	std::cout<<"Concurrent callers: tasks run in the calling thread= "<<inCaller;
+	std::cout<<" (expected 0)\n";
+	if (inCaller != 0) return 1;
+
+	SizeType created = PsimagLite::PthreadsNgPool::instance().threadsCreated();
+	MyHelper helper3(ntasks, nthreads);
+	for (SizeType i = 0; i < loops; ++i) {
+		threadObject.setAffinities(i & 1);
+		threadObject.loopCreate(helper3);
+	}
+
+	threadObject.setAffinities(false);
+	SizeType createdAffinities = PsimagLite::PthreadsNgPool::instance().threadsCreated();
+	std::cout<<"Threads created while switching affinities= "<<(createdAffinities - created);
+	std::cout<<" (expected 0)\n";
+	if (createdAffinities != created) return 1;
+	if (helper3.result() != loops*ntasks*(ntasks - 1)/2) return 1;
+#endif
+
+	return (helper.result() == expected) ? 0 : 1;
+}
@@ -2,6 +2,9 @@
 #define AINURSTATE_H
 #include "../Vector.h"
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include "../Map.h"
 #include "../PsimagLite.h"
 
 namespace PsimagLite {
@@ -20,6 +23,29 @@ struct TypesEqual<T, T> {
 class AinurState {
 
 	typedef Vector<String>::Type VectorStringType;
+	typedef Map<String,SizeType>::Type MapStringSizeType;
+
+	// A value converted once, when it is assigned, if it is an integer, a
+	// vector of numbers, or a matrix of numbers, which is kept by rows;
+	// other values are converted from their strings each time they are read
+	struct CompiledValue {
+
+		enum KindEnum {NONE, INTEGER, VECTOR, MATRIX};
+
+		CompiledValue()
+		    : kind(NONE), integer(0), integers(false), rows(0), cols(0)
+		{}
+
+		KindEnum kind;
+		int integer;
+		// true if all numbers are written as integers
+		bool integers;
+		SizeType rows;
+		SizeType cols;
+		Vector<double>::Type numbers;
+	};
+
+	typedef Vector<CompiledValue>::Type VectorCompiledValueType;
 
 	struct myprint
 	{
@@ -105,8 +131,10 @@ public:
 	{
 		assignStorageByName(k);
 		typesSpec_.push_back(d);
-		std::cerr<<"TYPE SPEC= "<<d<<"\n";
+		if (verbose())
+			std::cerr<<"TYPE SPEC= "<<d<<"\n";
 		values_.push_back(ZERO_CHAR_STRING_);
+		compiled_.push_back(CompiledValue());
 	}
 
 	void printAll(std::ostream& os) const
@@ -124,11 +152,12 @@ public:
 		if (x < 0)
 			err(errLabel(ERR_READ_UNDECLARED, label));
 		assert(static_cast<SizeType>(x) < values_.size());
-		String val = values_[x];
+		const String& val = values_[x];
 		if (isEmptyValue(val))
 			err(errLabel(ERR_READ_NO_VALUE, label));
 
 		assert(static_cast<SizeType>(x) < typesSpec_.size());
+		if (readCompiled(t, compiled_[x])) return;
 		convertInternal(t, val);
 	}
 
@@ -171,18 +200,156 @@ private:
 		int x = storageIndexByName(key);
 		if (x >= 0)
 			err(errLabel(ERR_PARSE_DECLARED, key));
+		x = keys_.size();
 		keys_.push_back(key);
-		return keys_.size() - 1;
+		indexOfKey_[key] = x;
+		return x;
 	}
 
-	int storageIndexByName(String key) const
+	int storageIndexByName(const String& key) const
 	{
-		VectorStringType::const_iterator it = std::find(keys_.begin(),
-		                                                keys_.end(),
-		                                                key);
-		if (it == keys_.end())
+		MapStringSizeType::const_iterator it = indexOfKey_.find(key);
+		if (it == indexOfKey_.end())
 			return -1;
-		return it - keys_.begin();
+		return it->second;
+	}
+
+	void compile(SizeType x)
+	{
+		assert(x < compiled_.size());
+		CompiledValue& value = compiled_[x];
+		value = CompiledValue();
+		const char* p = skipSpaces(values_[x].c_str());
+		if (*p != '[') {
+			char* end = 0;
+			long l = strtol(p, &end, 10);
+			if (end == p || *skipSpaces(end) != 0) return;
+			value.integer = l;
+			value.kind = CompiledValue::INTEGER;
+			return;
+		}
+
+		p = skipSpaces(p + 1);
+		value.integers = true;
+		if (*p != '[') {
+			p = compileRow(value, p);
+			if (p == 0 || *skipSpaces(p) != 0) return;
+			value.kind = CompiledValue::VECTOR;
+			return;
+		}
+
+		while (*p == '[') {
+			SizeType before = value.numbers.size();
+			p = compileRow(value, skipSpaces(p + 1));
+			if (p == 0) return;
+			SizeType cols = value.numbers.size() - before;
+			if (cols == 0 || (value.rows > 0 && cols != value.cols)) return;
+			value.cols = cols;
+			++value.rows;
+			p = skipSpaces(p);
+			if (*p == ',') p = skipSpaces(p + 1);
+		}
+
+		if (*p != ']' || *skipSpaces(p + 1) != 0) return;
+		value.kind = CompiledValue::MATRIX;
+	}
+
+	// Appends the numbers of a b, c] to value.numbers, and returns what
+	// follows the ], or 0 if it is not a list of numbers
+	static const char* compileRow(CompiledValue& value, const char* p)
+	{
+		if (*p == ']') return p + 1;
+		while (true) {
+			const char* start = p;
+			while (isdigit(*p) || *p == '.' || *p == '+' || *p == '-' ||
+			       *p == 'e' || *p == 'E')
+				++p;
+
+			char* end = 0;
+			double number = strtod(start, &end);
+			if (p == start || end != p) return 0;
+			value.numbers.push_back(number);
+			value.integers &= isInteger(start, p);
+			p = skipSpaces(p);
+			if (*p == ']') return p + 1;
+			if (*p != ',') return 0;
+			p = skipSpaces(p + 1);
+		}
+	}
+
+	// digits, with an optional sign, that an int holds
+	static bool isInteger(const char* start, const char* end)
+	{
+		if (*start == '+' || *start == '-') ++start;
+		if (start == end || end - start > 9) return false;
+		for (; start < end; ++start)
+			if (!isdigit(*start)) return false;
+		return true;
+	}
+
+	static const char* skipSpaces(const char* p)
+	{
+		while (*p != 0 && isspace(*p)) ++p;
+		return p;
+	}
+
+	// false if t must be converted from the string of the value
+	template<typename T>
+	bool readCompiled(T& t,
+	                  const CompiledValue& value,
+	                  typename EnableIf<Loki::TypeTraits<T>::isIntegral,
+	                  int>::Type = 0) const
+	{
+		if (value.kind != CompiledValue::INTEGER) return false;
+		t = value.integer;
+		return true;
+	}
+
+	template<typename T>
+	bool readCompiled(T&,
+	                  const CompiledValue&,
+	                  typename EnableIf<!Loki::TypeTraits<T>::isIntegral,
+	                  int>::Type = 0) const
+	{
+		return false;
+	}
+
+	template<typename T>
+	bool readCompiled(std::vector<T>& t,
+	                  const CompiledValue& value,
+	                  typename EnableIf<Loki::TypeTraits<T>::isArith,
+	                  int>::Type = 0) const
+	{
+		if (value.kind != CompiledValue::VECTOR) return false;
+		if (Loki::TypeTraits<T>::isIntegral && !value.integers) return false;
+		SizeType n = value.numbers.size();
+		t.resize(n);
+		for (SizeType i = 0; i < n; ++i)
+			t[i] = compiledNumber<T>(value, i);
+		return true;
+	}
+
+	template<typename T>
+	bool readCompiled(Matrix<T>& t,
+	                  const CompiledValue& value,
+	                  typename EnableIf<Loki::TypeTraits<T>::isArith,
+	                  int>::Type = 0) const
+	{
+		if (value.kind != CompiledValue::MATRIX) return false;
+		if (Loki::TypeTraits<T>::isIntegral && !value.integers) return false;
+		t.resize(value.rows, value.cols);
+		for (SizeType i = 0; i < value.rows; ++i)
+			for (SizeType j = 0; j < value.cols; ++j)
+				t(i, j) = compiledNumber<T>(value, i*value.cols + j);
+		return true;
+	}
+
+	template<typename T>
+	static T compiledNumber(const CompiledValue& value, SizeType i)
+	{
+		double number = value.numbers[i];
+		if (value.integers) return static_cast<T>(static_cast<int>(number));
+		return static_cast<T>(number);
 	}
 
 
@@ -242,6 +409,8 @@ private:
 	VectorStringType typesSpec_;
 	VectorStringType keys_;
 	VectorStringType values_;
+	MapStringSizeType indexOfKey_;
+	VectorCompiledValueType compiled_;
 };
 
 }
@@ -63,6 +63,7 @@ void AinurState::assign(String k, String v)
 
 	assert(static_cast<SizeType>(x) < values_.size());
 	values_[x] = v;
+	compile(x);
 }
 
 template <typename T>
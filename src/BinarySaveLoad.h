@@ -87,6 +87,8 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include <iostream>
 #include <vector>
 #include <complex>
+#include <unistd.h>
+#include "Vector.h"
 #include "TypeToString.h"
 
 namespace PsimagLite {
@@ -105,29 +107,29 @@ public:
 		mywrite(fd,(const void *)&x,sizeof(x));
 	}
 
-	static void save(int fd,const typename Vector<int>::Type& vec)
+	static void save(int fd,const Vector<int>::Type& vec)
 	{
-		vsave_(fd,vec);
+		vsave_<int>(fd,vec);
 	}
 
-	static void save(int fd,const typename Vector<SizeType>::Type& vec)
+	static void save(int fd,const Vector<SizeType>::Type& vec)
 	{
-		vsave_(fd,vec);
+		vsave_<SizeType>(fd,vec);
 	}
 
-	static void save(int fd,const typename Vector<double>::Type& vec)
+	static void save(int fd,const Vector<double>::Type& vec)
 	{
-		vsave_(fd,vec);
+		vsave_<double>(fd,vec);
 	}
 
-	static void save(int fd,const typename Vector<float>::Type& vec)
+	static void save(int fd,const Vector<float>::Type& vec)
 	{
-		vsave_(fd,vec);
+		vsave_<float>(fd,vec);
 	}
 
-	static void save(int fd,const typename Vector<std::complex<double> >::Type& vec)
+	static void save(int fd,const Vector<std::complex<double> >::Type& vec)
 	{
-		vsave_(fd,vec);
+		vsave_<std::complex<double> >(fd,vec);
 	}
 
 	template<typename NonNativeType>
@@ -138,7 +140,7 @@ public:
 
 	static void mywrite(int fd,const void *buf,SizeType count)
 	{
-		sSizeType ret = write(fd,buf,count);
+		ssize_t ret = write(fd,buf,count);
 		failIfNegative(ret,__FILE__,__LINE__);
 	}
 
@@ -159,7 +161,7 @@ private:
 	}
 
 
-	static void failIfNegative(const sSizeType& x,const String& thisFile,int lineno)
+	static void failIfNegative(const ssize_t& x,const String& thisFile,int lineno)
 	{
 		if (x>=0) return;
 		String str(thisFile);
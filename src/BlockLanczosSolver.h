@@ -0,0 +1,526 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file BlockLanczosSolver.h
+ *
+ *  Block Lanczos decomposition of p starting vectors at once
+ *
+ *  The p vectors phi_c are advanced together, so that each step does
+ *  one product of the matrix with a block of p vectors instead of p
+ *  products with one vector. With Q_0 R_0 = (phi_0 ... phi_{p-1}),
+ *
+ *        H Q_j = Q_{j-1} B_j^\dagger + Q_j A_j + Q_{j+1} B_{j+1}
+ *
+ *  where A_j is p x p and hermitian, and B_{j+1} is p x p and upper
+ *  triangular (from the QR factorization of the residual block). The
+ *  block tridiagonal matrix T with blocks A_j and B_j is hermitian and
+ *  banded, with p sub-diagonals, and is stored in lower band storage.
+ *
+ *  tridiagonal() gives the TridiagonalMatrix that ContinuedFraction
+ *  takes, for any combination sum_c u_c phi_c of the starting vectors,
+ *  from the Lanczos recursion of T on R_0 u in its first block, with
+ *  weight |R_0 u|^2.
+ *
+ *  MatrixType must have rows() and
+ *      matrixBlockProduct(Matrix<T>& x, const Matrix<T>& y)
+ *  that does x += H y for the p x rows() blocks x and y (vector c
+ *  in row c), as CrsMatrix does.
+ */
+#ifndef PSI_BLOCK_LANCZOS_SOLVER_H
+#define PSI_BLOCK_LANCZOS_SOLVER_H
+#include <cassert>
+#include <cmath>
+#include "Vector.h"
+#include "Matrix.h"
+#include "ProgressIndicator.h"
+#include "TridiagonalMatrix.h"
+#include "ContinuedFraction.h"
+#include "BLAS.h"
+#include "BlockLanczosStepKernel.h"
+
+namespace PsimagLite {
+
+template<typename SolverParametersType,typename MatrixType,typename VectorType>
+class BlockLanczosSolver {
+
+	typedef typename SolverParametersType::RealType RealType;
+	typedef typename VectorType::value_type VectorElementType;
+	typedef BlockLanczosStepKernel<VectorElementType> BlockLanczosStepKernelType;
+
+public:
+
+	typedef Matrix<VectorElementType> DenseMatrixType;
+	typedef TridiagonalMatrix<RealType> TridiagonalMatrixType;
+	typedef ContinuedFraction<TridiagonalMatrixType> PostProcType;
+
+	BlockLanczosSolver(const MatrixType& mat,
+	                   const SolverParametersType& params)
+	    : progress_("BlockLanczosSolver",params.threadId),
+	      mat_(mat),
+	      steps_(params.steps),
+	      p_(0),
+	      blocks_(0)
+	{}
+
+	/* Column c of initVectors is the starting vector phi_c. Does up to
+	   params.steps block steps, each with one product of the matrix with
+	   the block; stops earlier if the Krylov space is exhausted.
+	*/
+	void decomposition(const DenseMatrixType& initVectors)
+	{
+		SizeType n = mat_.rows();
+		SizeType p = initVectors.cols();
+		if (initVectors.rows() != n || p == 0) {
+			String msg("BlockLanczosSolver: starting vectors are ");
+			msg += ttos(initVectors.rows()) + " x " + ttos(p);
+			msg += " but matrix size " + ttos(n) + "\n";
+			throw RuntimeError(msg);
+		}
+
+		p_ = p;
+		SizeType maxBlocks = std::min(steps_, n/p);
+		if (maxBlocks == 0) maxBlocks = 1;
+
+		// blocks are stored transposed, vector c in row c
+		DenseMatrixType block0(p, n);
+		DenseMatrixType block1(p, n);
+		DenseMatrixType block2(p, n);
+		DenseMatrixType* q = &block0;
+		DenseMatrixType* w = &block1;
+		DenseMatrixType* next = &block2;
+
+		for (SizeType i = 0; i < n; ++i)
+			for (SizeType c = 0; c < p; ++c)
+				(*q)(c, i) = initVectors(i, c);
+
+		DenseMatrixType g(p, p);
+		gram(g, *q);
+		if (!qrFromGram(*q, r0_, g, maxDiagonal(g))) {
+			throw RuntimeError("BlockLanczosSolver: starting vectors are "
+			                   "linearly dependent\n");
+		}
+
+		lowerBand_.reset(p + 1, maxBlocks*p);
+		lowerBand_.setTo(0.0);
+		w->setTo(0.0);
+		DenseMatrixType a(p, p);
+		DenseMatrixType b(p, p);
+		DenseMatrixType aw(p, p);
+		DenseMatrixType ww(p, p);
+
+		bool fused = (p <= BlockLanczosStepKernelType::MAX_BLOCK);
+		SizeType j = 0;
+		bool exhausted = false;
+		for (; j < maxBlocks; ++j) {
+			// w = H q - (previous block) b^\dagger
+			mat_.matrixBlockProduct(*w, *q);
+
+			BlockLanczosStepKernelType kernel(&(*q)(0, 0), &(*w)(0, 0), &(*next)(0, 0), p, n);
+			if (fused) {
+				kernel.dots(aw, ww);
+			} else {
+				project(aw, *w, *q);
+				gram(ww, *w);
+			}
+
+			hermitian(a, aw);
+			setDiagonalBlock(j, a);
+			if (j + 1 == maxBlocks) break;
+
+			// g = (w - q a)^\dagger (w - q a), computed again if digits were lost
+			bool subtracted = false;
+			for (SizeType d = 0; d < p; ++d) {
+				for (SizeType c = 0; c < p; ++c) {
+					VectorElementType sum = ww(c, d);
+					for (SizeType k = 0; k < p; ++k)
+						sum -= PsimagLite::conj(a(k, c))*a(k, d);
+					g(c, d) = sum;
+				}
+
+				if (PsimagLite::real(g(d, d)) <= 1e-4*PsimagLite::real(ww(d, d)))
+					subtracted = true;
+			}
+
+			if (subtracted) {
+				subtractCurrent(*w, *q, a);
+				gram(g, *w);
+			}
+
+			RealType scale2 = std::max(maxDiagonal(ww), maxNorm2(a));
+			RealType cond2 = 0;
+			if (!cholesky(b, g, scale2, cond2)) {
+				exhausted = true;
+				break;
+			}
+
+			if (fused && cond2 > 1e-8) {
+				kernel.update(a, b, !subtracted);
+			} else {
+				if (!subtracted) subtractCurrent(*w, *q, a);
+				if (!qrFromGram(*w, b, g, scale2)) {
+					exhausted = true;
+					break;
+				}
+
+				firstTermOfNext(*next, *q, b);
+			}
+
+			setOffDiagonalBlock(j, b);
+
+			DenseMatrixType* tmp = q;
+			q = w;
+			w = next;
+			next = tmp;
+		}
+
+		blocks_ = (j < maxBlocks) ? j + 1 : maxBlocks;
+
+		OstringStream msg;
+		msg<<"Block decomposition done for mat.rank="<<n<<" with "<<p;
+		msg<<" vectors after "<<blocks_<<" block steps";
+		if (exhausted) msg<<" (Krylov space exhausted)";
+		progress_.printline(msg,std::cout);
+	}
+
+	// vectors per block
+	SizeType blockSize() const { return p_; }
+
+	// block steps done by the last decomposition
+	SizeType blocks() const { return blocks_; }
+
+	// T(col + k, col) = lowerBand()(k, col) for 0 <= k <= blockSize()
+	const DenseMatrixType& lowerBand() const { return lowerBand_; }
+
+	// (phi_0 ... phi_{p-1}) = Q_0 R_0, with R_0 upper triangular
+	const DenseMatrixType& initialR() const { return r0_; }
+
+	void buildDenseMatrix(DenseMatrixType& t) const
+	{
+		SizeType total = blocks_*p_;
+		t.reset(total, total);
+		t.setTo(0.0);
+		for (SizeType col = 0; col < total; ++col) {
+			for (SizeType k = 0; k <= p_ && col + k < total; ++k) {
+				t(col + k, col) = lowerBand_(k, col);
+				if (k > 0) t(col, col + k) = PsimagLite::conj(lowerBand_(k, col));
+			}
+		}
+	}
+
+	/* Tridiagonal matrix and weight of the starting vector sum_c u_c phi_c,
+	   for ContinuedFraction; u has blockSize() entries. The result is the
+	   Lanczos tridiagonal of T from R_0 u, with blocks() entries: block
+	   steps that match the moments of H up to the power 2*blocks() - 1
+	   give the same tridiagonal as a scalar Lanczos decomposition with
+	   blocks() steps, so that ContinuedFraction takes no longer than it
+	   does for one. Each step is a product of the band of T with a vector
+	   that has p more non zeros than the one before, O(blocks*p) memory
+	   and O((blocks*p)^2) operations in all.
+	*/
+	void tridiagonal(TridiagonalMatrixType& ab,
+	                 RealType& weight,
+	                 const VectorType& u) const
+	{
+		assert(u.size() == p_);
+		SizeType total = blocks_*p_;
+		VectorType v(total, 0.0);
+		weight = 0;
+		for (SizeType c = 0; c < p_; ++c) {
+			VectorElementType sum = 0.0;
+			for (SizeType d = c; d < p_; ++d)
+				sum += r0_(c, d)*u[d];
+			v[c] = sum;
+			weight += abs2(sum);
+		}
+
+		ab.resize(0);
+		if (weight == 0) return;
+
+		RealType scale = 0;
+		for (SizeType col = 0; col < total; ++col)
+			for (SizeType k = 0; k <= p_ && col + k < total; ++k)
+				scale = std::max(scale, abs2(lowerBand_(k, col)));
+
+		scale = sqrt(scale);
+		RealType norm = sqrt(weight);
+		for (SizeType c = 0; c < p_; ++c) v[c] /= norm;
+
+		VectorType vPrev(total, 0.0);
+		VectorType w(total);
+		RealType bPrev = 0;
+		for (SizeType step = 0; step < blocks_; ++step) {
+			// v has non zeros only in its first step + 1 blocks
+			SizeType active = std::min(total, (step + 2)*p_);
+			bandProduct(w, v, active);
+			RealType a = 0;
+			for (SizeType i = 0; i < active; ++i)
+				a += PsimagLite::real(PsimagLite::conj(v[i])*w[i]);
+
+			RealType b2 = 0;
+			for (SizeType i = 0; i < active; ++i) {
+				w[i] -= a*v[i] + bPrev*vPrev[i];
+				b2 += abs2(w[i]);
+			}
+
+			RealType b = sqrt(b2);
+			bool last = (step + 1 == blocks_ || b <= 1e-10*scale);
+			ab.push(a, (last) ? 0 : b);
+			if (last) break;
+
+			for (SizeType i = 0; i < active; ++i) {
+				vPrev[i] = v[i];
+				v[i] = w[i]/b;
+			}
+
+			bPrev = b;
+		}
+	}
+
+	// Same as above, for the starting vector phi_c
+	void tridiagonal(TridiagonalMatrixType& ab,
+	                 RealType& weight,
+	                 SizeType c) const
+	{
+		VectorType u(p_, 0.0);
+		assert(c < p_);
+		u[c] = 1.0;
+		tridiagonal(ab, weight, u);
+	}
+
+private:
+
+	BlockLanczosSolver(const BlockLanczosSolver&);
+
+	BlockLanczosSolver& operator=(const BlockLanczosSolver&);
+
+	/* Dense operations on blocks use BLAS; blocks are stored transposed,
+	   so that w^\dagger w is the transpose of w_t w_t^\dagger, etc. */
+
+	// g = w^\dagger w
+	static void gram(DenseMatrixType& g, const DenseMatrixType& w)
+	{
+		int p = w.rows();
+		DenseMatrixType tmp(p, p);
+		psimag::BLAS::GEMM('N', 'C', p, p, w.cols(), 1.0, &w(0, 0), p,
+		                   &w(0, 0), p, 0.0, &tmp(0, 0), p);
+		for (int d = 0; d < p; ++d)
+			for (int c = 0; c < p; ++c)
+				g(c, d) = tmp(d, c);
+	}
+
+	/* g = b^\dagger b, b upper triangular; returns false if a pivot is
+	   below the square root of 1e-20*scale2, then w has no new directions.
+	   cond2 is the squared ratio of smallest to largest pivot.
+	*/
+	static bool cholesky(DenseMatrixType& b,
+	                     const DenseMatrixType& g,
+	                     RealType scale2,
+	                     RealType& cond2)
+	{
+		SizeType p = g.rows();
+		b.reset(p, p);
+		b.setTo(0.0);
+		RealType minPivot2 = 0;
+		RealType maxPivot2 = 0;
+		for (SizeType d = 0; d < p; ++d) {
+			RealType pivot2 = PsimagLite::real(g(d, d));
+			for (SizeType k = 0; k < d; ++k)
+				pivot2 -= abs2(b(k, d));
+
+			if (pivot2 <= 1e-20*scale2) return false;
+
+			if (d == 0 || pivot2 < minPivot2) minPivot2 = pivot2;
+			if (pivot2 > maxPivot2) maxPivot2 = pivot2;
+
+			RealType pivot = sqrt(pivot2);
+			b(d, d) = pivot;
+			for (SizeType e = d + 1; e < p; ++e) {
+				VectorElementType sum = g(d, e);
+				for (SizeType k = 0; k < d; ++k)
+					sum -= PsimagLite::conj(b(k, d))*b(k, e);
+				b(d, e) = sum/pivot;
+			}
+		}
+
+		cond2 = minPivot2/maxPivot2;
+		return true;
+	}
+
+	// w = w b^{-1}, that is, w_t = (b^T)^{-1} w_t
+	static void applyInverse(DenseMatrixType& w, const DenseMatrixType& b)
+	{
+		int p = w.rows();
+		psimag::BLAS::TRSM('L', 'U', 'T', 'N', p, w.cols(), 1.0, &b(0, 0), p,
+		                   &w(0, 0), p);
+	}
+
+	/* Cholesky QR of w given g = w^\dagger w: w = q b, q overwrites w.
+	   Repeated once if w is ill-conditioned, since the q of a single
+	   Cholesky QR loses orthogonality as the square of the condition.
+	*/
+	static bool qrFromGram(DenseMatrixType& w,
+	                       DenseMatrixType& b,
+	                       const DenseMatrixType& g,
+	                       RealType scale2)
+	{
+		RealType cond2 = 0;
+		if (!cholesky(b, g, scale2, cond2)) return false;
+
+		applyInverse(w, b);
+		if (cond2 > 1e-8) return true;
+
+		SizeType p = w.rows();
+		DenseMatrixType g2(p, p);
+		DenseMatrixType b2(p, p);
+		gram(g2, w);
+		if (!cholesky(b2, g2, 1.0, cond2)) return false;
+
+		applyInverse(w, b2);
+		DenseMatrixType b1 = b;
+		b.setTo(0.0);
+		for (SizeType d = 0; d < p; ++d)
+			for (SizeType c = 0; c <= d; ++c)
+				for (SizeType k = c; k <= d; ++k)
+					b(c, d) += b2(c, k)*b1(k, d);
+
+		return true;
+	}
+
+	// a = (aw + aw^\dagger)/2, hermitian up to rounding
+	static void hermitian(DenseMatrixType& a, const DenseMatrixType& aw)
+	{
+		SizeType p = aw.rows();
+		for (SizeType d = 0; d < p; ++d) {
+			a(d, d) = PsimagLite::real(aw(d, d));
+			for (SizeType c = 0; c < d; ++c) {
+				VectorElementType value = 0.5*(aw(c, d) + PsimagLite::conj(aw(d, c)));
+				a(c, d) = value;
+				a(d, c) = PsimagLite::conj(value);
+			}
+		}
+	}
+
+	// aw = q^\dagger w
+	static void project(DenseMatrixType& aw,
+	                    const DenseMatrixType& w,
+	                    const DenseMatrixType& q)
+	{
+		int p = w.rows();
+		DenseMatrixType tmp(p, p);
+		psimag::BLAS::GEMM('N', 'C', p, p, w.cols(), 1.0, &w(0, 0), p,
+		                   &q(0, 0), p, 0.0, &tmp(0, 0), p);
+		for (int d = 0; d < p; ++d)
+			for (int c = 0; c < p; ++c)
+				aw(c, d) = tmp(d, c);
+	}
+
+	// w -= q a
+	static void subtractCurrent(DenseMatrixType& w,
+	                            const DenseMatrixType& q,
+	                            const DenseMatrixType& a)
+	{
+		int p = w.rows();
+		psimag::BLAS::GEMM('T', 'N', p, w.cols(), p, -1.0, &a(0, 0), p,
+		                   &q(0, 0), p, 1.0, &w(0, 0), p);
+	}
+
+	// next = -q b^\dagger
+	static void firstTermOfNext(DenseMatrixType& next,
+	                            const DenseMatrixType& q,
+	                            const DenseMatrixType& b)
+	{
+		int p = q.rows();
+		DenseMatrixType bConj(p, p);
+		for (int d = 0; d < p; ++d)
+			for (int c = 0; c < p; ++c)
+				bConj(c, d) = PsimagLite::conj(b(c, d));
+
+		psimag::BLAS::GEMM('N', 'N', p, q.cols(), p, -1.0, &bConj(0, 0), p,
+		                   &q(0, 0), p, 0.0, &next(0, 0), p);
+	}
+
+	static RealType abs2(const VectorElementType& value)
+	{
+		return PsimagLite::real(PsimagLite::conj(value)*value);
+	}
+
+	static RealType maxDiagonal(const DenseMatrixType& g)
+	{
+		RealType result = 0;
+		for (SizeType c = 0; c < g.rows(); ++c)
+			result = std::max(result, PsimagLite::real(g(c, c)));
+		return result;
+	}
+
+	static RealType maxNorm2(const DenseMatrixType& a)
+	{
+		RealType result = 0;
+		for (SizeType d = 0; d < a.cols(); ++d)
+			for (SizeType c = 0; c < a.rows(); ++c)
+				result = std::max(result, abs2(a(c, d)));
+		return result;
+	}
+
+	void setDiagonalBlock(SizeType j, const DenseMatrixType& a)
+	{
+		for (SizeType d = 0; d < p_; ++d)
+			for (SizeType c = d; c < p_; ++c)
+				lowerBand_(c - d, j*p_ + d) = a(c, d);
+	}
+
+	// T(j + 1, j) = b, which is upper triangular
+	void setOffDiagonalBlock(SizeType j, const DenseMatrixType& b)
+	{
+		for (SizeType d = 0; d < p_; ++d)
+			for (SizeType c = 0; c <= d; ++c)
+				lowerBand_(p_ + c - d, j*p_ + d) = b(c, d);
+	}
+
+	// w = T v on the first active entries, for v zero beyond them
+	void bandProduct(VectorType& w, const VectorType& v, SizeType active) const
+	{
+		for (SizeType i = 0; i < active; ++i) w[i] = 0.0;
+		for (SizeType col = 0; col < active; ++col) {
+			const VectorElementType* band = &lowerBand_(0, col);
+			const VectorElementType vCol = v[col];
+			VectorElementType sum = band[0]*vCol;
+			SizeType kend = std::min(p_, active - 1 - col);
+			for (SizeType k = 1; k <= kend; ++k) {
+				w[col + k] += band[k]*vCol;
+				sum += PsimagLite::conj(band[k])*v[col + k];
+			}
+
+			w[col] += sum;
+		}
+	}
+
+	ProgressIndicator progress_;
+	const MatrixType& mat_;
+	SizeType steps_;
+	SizeType p_;
+	SizeType blocks_;
+	DenseMatrixType lowerBand_;
+	DenseMatrixType r0_;
+}; // class BlockLanczosSolver
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_BLOCK_LANCZOS_SOLVER_H
@@ -0,0 +1,324 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file BlockLanczosStepKernel.h
+ *
+ *  Streaming part of a block Lanczos step, after w += H q
+ *
+ *  Blocks of p vectors are stored transposed, as p x n column-major
+ *  arrays, so that row i of all vectors is contiguous.
+ *  Pass 1 reads q and w once and returns a = q^\dagger w and
+ *  g = w^\dagger w, from which (w - q a)^\dagger (w - q a) = g - a^\dagger a.
+ *  Pass 2 reads q and w once and writes, in the same loop,
+ *  w = (w - q a) b^{-1}, the next block of vectors, and next = -q b^\dagger,
+ *  the first term of the next residual, so that the previous block of
+ *  vectors is never read again.
+ *  Like LanczosStepKernel, long blocks are split in chunks among
+ *  Concurrency::npthreads threads; partial sums are added in chunk order.
+ */
+#ifndef PSI_BLOCK_LANCZOS_STEP_KERNEL_H
+#define PSI_BLOCK_LANCZOS_STEP_KERNEL_H
+#include <cassert>
+#include "Vector.h"
+#include "Matrix.h"
+#include "Concurrency.h"
+#ifdef USE_PTHREADS
+#include "PthreadsNg.h"
+#endif
+
+namespace PsimagLite {
+
+template<typename ComplexOrRealType>
+class BlockLanczosStepKernel {
+
+	typedef typename Vector<ComplexOrRealType>::Type VectorType;
+	typedef typename Real<ComplexOrRealType>::Type RealType;
+
+	enum {DOTS, UPDATE};
+
+public:
+
+	typedef Matrix<ComplexOrRealType> DenseMatrixType;
+
+	// Below this number of numbers per thread, threads are not worth it
+	enum {MIN_LENGTH_PER_THREAD = 65536};
+
+	// Largest block size this kernel takes
+	enum {MAX_BLOCK = 16};
+
+	BlockLanczosStepKernel(const ComplexOrRealType* q,
+	                       ComplexOrRealType* w,
+	                       ComplexOrRealType* next,
+	                       SizeType p,
+	                       SizeType n)
+	    : q_(q),
+	      w_(w),
+	      next_(next),
+	      p_(p),
+	      n_(n),
+	      nchunks_(1),
+	      what_(DOTS),
+	      a_(0),
+	      b_(0),
+	      subtract_(false),
+	      partial_(0)
+	{
+		SizeType nthreads = Concurrency::npthreads;
+		if (nthreads > 1 && n*p >= MIN_LENGTH_PER_THREAD*nthreads)
+			nchunks_ = nthreads;
+	}
+
+	// a = q^\dagger w and g = w^\dagger w, both hermitian
+	void dots(DenseMatrixType& a, DenseMatrixType& g)
+	{
+		SizeType pp = p_*p_;
+		VectorType partial(2*pp*nchunks_, 0.0);
+		partial_ = &partial[0];
+		what_ = DOTS;
+		run();
+		partial_ = 0;
+
+		a.reset(p_, p_);
+		g.reset(p_, p_);
+		a.setTo(0.0);
+		g.setTo(0.0);
+		for (SizeType ch = 0; ch < nchunks_; ++ch) {
+			const ComplexOrRealType* sums = &partial[2*pp*ch];
+			for (SizeType d = 0; d < p_; ++d) {
+				for (SizeType c = 0; c < p_; ++c)
+					a(c, d) += sums[c + d*p_];
+				for (SizeType c = 0; c <= d; ++c)
+					g(c, d) += sums[pp + c + d*p_];
+			}
+		}
+
+		for (SizeType d = 0; d < p_; ++d)
+			for (SizeType c = 0; c < d; ++c)
+				g(d, c) = PsimagLite::conj(g(c, d));
+	}
+
+	/* w = (w - q a) b^{-1} and next = -q b^\dagger, where b is upper
+	   triangular; if subtract is false w is w - q a already */
+	void update(const DenseMatrixType& a, const DenseMatrixType& b, bool subtract)
+	{
+		a_ = &a;
+		b_ = &b;
+		subtract_ = subtract;
+		what_ = UPDATE;
+		run();
+		a_ = b_ = 0;
+	}
+
+	SizeType tasks() const { return nchunks_; }
+
+	void doTask(SizeType taskNumber, SizeType)
+	{
+		SizeType start = (n_*taskNumber)/nchunks_;
+		SizeType end = (n_*(taskNumber + 1))/nchunks_;
+
+		ComplexOrRealType* sums = (what_ == DOTS) ? &partial_[2*p_*p_*taskNumber] : 0;
+		switch (p_) {
+		case 1:
+			rowsFixed<1>(sums, start, end);
+			break;
+		case 2:
+			rowsFixed<2>(sums, start, end);
+			break;
+		case 3:
+			rowsFixed<3>(sums, start, end);
+			break;
+		case 4:
+			rowsFixed<4>(sums, start, end);
+			break;
+		case 6:
+			rowsFixed<6>(sums, start, end);
+			break;
+		case 8:
+			rowsFixed<8>(sums, start, end);
+			break;
+		default:
+			rowsFixed<0>(sums, start, end);
+			break;
+		}
+	}
+
+private:
+
+	// P > 0 is the block size known at compile time, P = 0 means p_
+	template<SizeType P>
+	void rowsFixed(ComplexOrRealType* sums, SizeType start, SizeType end) const
+	{
+		if (what_ == DOTS)
+			dotsRows<P>(sums, start, end);
+		else
+			updateRows<P>(start, end);
+	}
+
+	void run()
+	{
+		if (nchunks_ == 1) {
+			doTask(0, 0);
+			return;
+		}
+
+#ifdef USE_PTHREADS
+		PthreadsNg<BlockLanczosStepKernel> threads(nchunks_,
+		                                           0,
+		                                           Concurrency::setAffinitiesDefault);
+		threads.loopCreate(*this);
+#else
+		for (SizeType c = 0; c < nchunks_; ++c) doTask(c, 0);
+#endif
+	}
+
+	template<SizeType P>
+	void dotsRows(ComplexOrRealType* sums, SizeType start, SizeType end) const
+	{
+		enum {CAPACITY = (P > 0) ? P : MAX_BLOCK};
+		const SizeType p = (P > 0) ? P : p_;
+		assert(p <= CAPACITY);
+		ComplexOrRealType aw[CAPACITY*CAPACITY];
+		ComplexOrRealType ww[CAPACITY*CAPACITY];
+		for (SizeType k = 0; k < p*p; ++k) aw[k] = ww[k] = 0.0;
+
+		// rows are copied to local arrays, which cannot alias the sums
+		ComplexOrRealType qi[CAPACITY];
+		ComplexOrRealType wi[CAPACITY];
+		for (SizeType i = start; i < end; ++i) {
+			for (SizeType c = 0; c < p; ++c) {
+				qi[c] = PsimagLite::conj(q_[i*p + c]);
+				wi[c] = w_[i*p + c];
+			}
+
+			for (SizeType d = 0; d < p; ++d) {
+				const ComplexOrRealType wd = wi[d];
+				for (SizeType c = 0; c < p; ++c)
+					aw[c + d*p] += multiply(qi[c], wd);
+				for (SizeType c = 0; c <= d; ++c)
+					ww[c + d*p] += multiply(PsimagLite::conj(wi[c]), wd);
+			}
+		}
+
+		for (SizeType k = 0; k < p*p; ++k) {
+			sums[k] = aw[k];
+			sums[p*p + k] = ww[k];
+		}
+	}
+
+	/* w = (w - q a) b^{-1} = w b^{-1} - q (a b^{-1}), with b^{-1} and
+	   a b^{-1} computed once, so that the entries of a row do not wait
+	   for each other as in a substitution; the caller uses this only for
+	   a well conditioned b */
+	template<SizeType P>
+	void updateRows(SizeType start, SizeType end) const
+	{
+		enum {CAPACITY = (P > 0) ? P : MAX_BLOCK};
+		const SizeType p = (P > 0) ? P : p_;
+		assert(p <= CAPACITY);
+		ComplexOrRealType bInverse[CAPACITY*CAPACITY];
+		ComplexOrRealType abInverse[CAPACITY*CAPACITY];
+		ComplexOrRealType bConj[CAPACITY*CAPACITY];
+		for (SizeType d = 0; d < p; ++d) {
+			for (SizeType c = 0; c < p; ++c) {
+				bConj[c + d*p] = PsimagLite::conj((*b_)(c, d));
+				bInverse[c + d*p] = 0.0;
+			}
+
+			// column d of b^{-1}, by back substitution
+			bInverse[d + d*p] = 1.0/PsimagLite::real((*b_)(d, d));
+			for (SizeType c = d; c > 0; --c) {
+				ComplexOrRealType sum = 0.0;
+				for (SizeType k = c; k <= d; ++k)
+					sum -= multiply((*b_)(c - 1, k), bInverse[k + d*p]);
+				bInverse[c - 1 + d*p] = sum/PsimagLite::real((*b_)(c - 1, c - 1));
+			}
+		}
+
+		for (SizeType d = 0; d < p; ++d) {
+			for (SizeType c = 0; c < p; ++c) {
+				ComplexOrRealType sum = 0.0;
+				if (subtract_)
+					for (SizeType k = 0; k <= d; ++k)
+						sum += multiply((*a_)(c, k), bInverse[k + d*p]);
+				abInverse[c + d*p] = sum;
+			}
+		}
+
+		// rows are copied to local arrays, which cannot alias the outputs
+		ComplexOrRealType qi[CAPACITY];
+		ComplexOrRealType wi[CAPACITY];
+		for (SizeType i = start; i < end; ++i) {
+			ComplexOrRealType* wOut = w_ + i*p;
+			ComplexOrRealType* nexti = next_ + i*p;
+			for (SizeType c = 0; c < p; ++c) {
+				qi[c] = q_[i*p + c];
+				wi[c] = wOut[c];
+			}
+
+			for (SizeType d = 0; d < p; ++d) {
+				ComplexOrRealType sum = 0.0;
+				for (SizeType c = 0; c <= d; ++c)
+					sum += multiply(wi[c], bInverse[c + d*p]);
+				for (SizeType c = 0; c < p; ++c)
+					sum -= multiply(qi[c], abInverse[c + d*p]);
+				wOut[d] = sum;
+			}
+
+			for (SizeType c = 0; c < p; ++c) {
+				ComplexOrRealType sum = 0.0;
+				for (SizeType d = c; d < p; ++d)
+					sum -= multiply(bConj[c + d*p], qi[d]);
+				nexti[c] = sum;
+			}
+		}
+	}
+
+	template<typename T>
+	static T multiply(const T& a, const T& b)
+	{
+		return a*b;
+	}
+
+	// Same as a*b for finite numbers, but without the (non-inlined)
+	// NaN recovery of complex multiplication
+	template<typename T>
+	static std::complex<T> multiply(const std::complex<T>& a, const std::complex<T>& b)
+	{
+		return std::complex<T>(a.real()*b.real() - a.imag()*b.imag(),
+		                       a.real()*b.imag() + a.imag()*b.real());
+	}
+
+	const ComplexOrRealType* q_;
+	ComplexOrRealType* w_;
+	ComplexOrRealType* next_;
+	SizeType p_;
+	SizeType n_;
+	SizeType nchunks_;
+	SizeType what_;
+	const DenseMatrixType* a_;
+	const DenseMatrixType* b_;
+	bool subtract_;
+	ComplexOrRealType* partial_;
+}; // class BlockLanczosStepKernel
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_BLOCK_LANCZOS_STEP_KERNEL_H
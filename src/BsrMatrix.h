@@ -0,0 +1,285 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file BsrMatrix.h
+ *
+ *  A sparse matrix in block compressed row (BSR) format, for
+ *  matrixVectorProduct only
+ *
+ *  The matrix is cut in b x b blocks, and those with at least one
+ *  non-zero are stored as dense b x b arrays, row-major, in compressed
+ *  rows of blocks with increasing block columns. There is one column
+ *  index per block instead of one per non-zero, and the b entries of y
+ *  that a block multiplies are read once for its b rows. Rows and
+ *  columns must be multiples of b; several orbitals per site give such
+ *  blocks, with b the number of orbitals.
+ *  Rows of blocks are split among threads as rows are in
+ *  CrsMatrixVectorProduct.
+ */
+#ifndef PSI_BSR_MATRIX_H
+#define PSI_BSR_MATRIX_H
+#include <algorithm>
+#include <cassert>
+#include "Vector.h"
+#include "Concurrency.h"
+#include "TypeToString.h"
+#include "CrsMatrix.h"
+#ifdef USE_PTHREADS
+#include "PthreadsNg.h"
+#endif
+
+namespace PsimagLite {
+
+template<typename T>
+class BsrMatrix {
+
+	typedef typename Vector<T>::Type VectorType;
+	typedef Vector<int>::Type VectorIntType;
+	typedef Vector<SizeType>::Type VectorSizeType;
+	typedef CrsMatrixVectorProduct<T, VectorType> CrsMatrixVectorProductType;
+
+public:
+
+	typedef T value_type;
+
+	BsrMatrix() : nrow_(0), ncol_(0), b_(1), nonzeros_(0) {}
+
+	BsrMatrix(const CrsMatrix<T>& crs, SizeType blockSize)
+	    : nrow_(crs.rows()), ncol_(crs.cols()), b_(blockSize), nonzeros_(crs.nonZeros())
+	{
+		if (b_ == 0 || nrow_ % b_ != 0 || ncol_ % b_ != 0)
+			throw RuntimeError("BsrMatrix: block size " + ttos(b_) +
+			                   " does not divide " + ttos(nrow_) + "x" + ttos(ncol_) + "\n");
+
+		SizeType blockRows = nrow_/b_;
+		VectorIntType position(ncol_/b_, -1);
+		VectorIntType blockCols;
+		blockRowPtr_.resize(blockRows + 1);
+		blockRowPtr_[0] = 0;
+		for (SizeType bi = 0; bi < blockRows; ++bi) {
+			blocksOfRow(blockCols, crs, bi, b_);
+
+			SizeType offset = blockRowPtr_[bi];
+			blockRowPtr_[bi + 1] = offset + blockCols.size();
+			blockCol_.insert(blockCol_.end(), blockCols.begin(), blockCols.end());
+			values_.resize(values_.size() + blockCols.size()*b_*b_, 0.0);
+			for (SizeType k = 0; k < blockCols.size(); ++k)
+				position[blockCols[k]] = offset + k;
+
+			for (SizeType r = 0; r < b_; ++r) {
+				SizeType row = bi*b_ + r;
+				for (int k = crs.getRowPtr(row); k < crs.getRowPtr(row + 1); ++k) {
+					SizeType col = crs.getCol(k);
+					SizeType block = position[col/b_];
+					values_[block*b_*b_ + r*b_ + col % b_] += crs.getValue(k);
+				}
+			}
+
+			for (SizeType k = 0; k < blockCols.size(); ++k)
+				position[blockCols[k]] = -1;
+		}
+	}
+
+	SizeType rows() const { return nrow_; }
+
+	SizeType cols() const { return ncol_; }
+
+	SizeType nonZeros() const { return nonzeros_; }
+
+	SizeType blockSize() const { return b_; }
+
+	SizeType blocks() const { return blockCol_.size(); }
+
+	// Non-zeros over stored entries, if crs were stored with this block
+	// size, without building it
+	static double fillRatio(const CrsMatrix<T>& crs, SizeType blockSize)
+	{
+		if (blockSize == 0 || crs.rows() % blockSize != 0 || crs.cols() % blockSize != 0)
+			return 0.0;
+
+		VectorIntType blockCols;
+		SizeType blocks = 0;
+		for (SizeType bi = 0; bi < crs.rows()/blockSize; ++bi) {
+			blocksOfRow(blockCols, crs, bi, blockSize);
+			blocks += blockCols.size();
+		}
+
+		return (blocks == 0) ? 1.0 : static_cast<double>(crs.nonZeros())/
+		                             (blocks*blockSize*blockSize);
+	}
+
+	/** performs x = x + A * y
+		 ** where x and y are vectors and A is this matrix */
+	template<typename VectorLikeType>
+	void matrixVectorProduct(VectorLikeType& x, const VectorLikeType& y) const
+	{
+		assert(x.size() == nrow_ && y.size() == ncol_);
+		if (values_.size() == 0) return;
+		SizeType blockRows = nrow_/b_;
+		SizeType nthreads = Concurrency::npthreads;
+		if (nthreads < 2 ||
+		        values_.size() < CrsMatrixVectorProductType::MIN_NONZEROS_PER_THREAD*nthreads) {
+			blockRowsOf(x, y, 0, blockRows);
+			return;
+		}
+
+		Helper<VectorLikeType> helper(*this, x, y, nthreads);
+#ifdef USE_PTHREADS
+		PthreadsNg<Helper<VectorLikeType> > threads(helper.tasks(),
+		                                            0,
+		                                            Concurrency::setAffinitiesDefault);
+		threads.loopCreate(helper);
+#else
+		for (SizeType task = 0; task < helper.tasks(); ++task) helper.doTask(task, 0);
+#endif
+	}
+
+private:
+
+	template<typename VectorLikeType>
+	class Helper {
+
+	public:
+
+		Helper(const BsrMatrix& m,
+		       VectorLikeType& x,
+		       const VectorLikeType& y,
+		       SizeType nthreads)
+		    : m_(m), x_(x), y_(y)
+		{
+			CrsMatrixVectorProductType::nonzeroChunks(chunkStart_,
+			                                          m.blockRowPtr_,
+			                                          m.blockRowPtr_.size() - 1,
+			                                          nthreads);
+		}
+
+		SizeType tasks() const { return chunkStart_.size() - 1; }
+
+		void doTask(SizeType taskNumber, SizeType)
+		{
+			m_.blockRowsOf(x_, y_, chunkStart_[taskNumber], chunkStart_[taskNumber + 1]);
+		}
+
+	private:
+
+		const BsrMatrix& m_;
+		VectorLikeType& x_;
+		const VectorLikeType& y_;
+		VectorSizeType chunkStart_;
+	}; // class Helper
+
+	// distinct block columns of the rows of block row bi, in increasing order
+	static void blocksOfRow(VectorIntType& blockCols,
+	                        const CrsMatrix<T>& crs,
+	                        SizeType bi,
+	                        SizeType b)
+	{
+		blockCols.clear();
+		for (SizeType row = bi*b; row < (bi + 1)*b; ++row)
+			for (int k = crs.getRowPtr(row); k < crs.getRowPtr(row + 1); ++k)
+				blockCols.push_back(crs.getCol(k)/b);
+
+		std::sort(blockCols.begin(), blockCols.end());
+		blockCols.erase(std::unique(blockCols.begin(), blockCols.end()), blockCols.end());
+	}
+
+	template<typename VectorLikeType>
+	void blockRowsOf(VectorLikeType& x,
+	                 const VectorLikeType& y,
+	                 SizeType start,
+	                 SizeType end) const
+	{
+		switch (b_) {
+		case 1:
+			return blockRowsFixed<1>(x, y, start, end);
+		case 2:
+			return blockRowsFixed<2>(x, y, start, end);
+		case 3:
+			return blockRowsFixed<3>(x, y, start, end);
+		case 4:
+			return blockRowsFixed<4>(x, y, start, end);
+		case 6:
+			return blockRowsFixed<6>(x, y, start, end);
+		case 8:
+			return blockRowsFixed<8>(x, y, start, end);
+		default:
+			return blockRowsFixed<0>(x, y, start, end);
+		}
+	}
+
+	// B > 0 is the block size known at compile time, so that the B sums
+	// stay in registers; B = 0 means b_
+	template<SizeType B, typename VectorLikeType>
+	void blockRowsFixed(VectorLikeType& x,
+	                    const VectorLikeType& y,
+	                    SizeType start,
+	                    SizeType end) const
+	{
+		typedef typename VectorLikeType::value_type ValueType;
+		const SizeType b = (B > 0) ? B : b_;
+		typename Vector<ValueType>::Type sumStorage((B > 0) ? 0 : b);
+		ValueType sumFixed[(B > 0) ? B : 1];
+		ValueType* sum = (B > 0) ? sumFixed : &sumStorage[0];
+
+		for (SizeType bi = start; bi < end; ++bi) {
+			for (SizeType r = 0; r < b; ++r) sum[r] = x[bi*b + r];
+			for (int k = blockRowPtr_[bi]; k < blockRowPtr_[bi + 1]; ++k) {
+				const T* block = &values_[k*b*b];
+				const SizeType col = blockCol_[k]*b;
+				for (SizeType r = 0; r < b; ++r)
+					for (SizeType c = 0; c < b; ++c)
+						multiplyAdd(sum[r], block[r*b + c], y[col + c]);
+			}
+
+			for (SizeType r = 0; r < b; ++r) x[bi*b + r] = sum[r];
+		}
+	}
+
+	template<typename A, typename B, typename C>
+	static void multiplyAdd(A& sum, const B& a, const C& b)
+	{
+		sum += a*b;
+	}
+
+	// Same as sum += a*b for finite numbers, without the NaN recovery
+	// of complex multiplication
+	template<typename RealType>
+	static void multiplyAdd(std::complex<RealType>& sum,
+	                        const std::complex<RealType>& a,
+	                        const std::complex<RealType>& b)
+	{
+		RealType re = a.real()*b.real() - a.imag()*b.imag();
+		RealType im = a.real()*b.imag() + a.imag()*b.real();
+		sum = std::complex<RealType>(sum.real() + re, sum.imag() + im);
+	}
+
+	SizeType nrow_;
+	SizeType ncol_;
+	SizeType b_;
+	SizeType nonzeros_;
+	VectorIntType blockRowPtr_;
+	VectorIntType blockCol_;
+	VectorType values_;
+}; // class BsrMatrix
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_BSR_MATRIX_H
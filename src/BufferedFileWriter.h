@@ -0,0 +1,260 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file BufferedFileWriter.h
+ *
+ *  Writes to a file descriptor through a buffer of BUFFER_SIZE bytes
+ *
+ *  The file is written BUFFER_SIZE bytes at a time, at offsets that are
+ *  multiples of BUFFER_SIZE from where writing started, except for the
+ *  last write of flush(). With a background thread (USE_PTHREADS only),
+ *  a full buffer is handed to the thread, which writes it while the
+ *  other buffer is filled; an error of the thread is thrown by the next
+ *  write or flush.
+ */
+#ifndef PSI_BUFFERED_FILE_WRITER_H
+#define PSI_BUFFERED_FILE_WRITER_H
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include "Vector.h"
+#include "TypeToString.h"
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+
+namespace PsimagLite {
+
+class BufferedFileWriter {
+
+public:
+
+	enum {BUFFER_SIZE = 1048576};
+
+	BufferedFileWriter()
+	    : fd_(-1), used_(0), background_(false), pending_(0), error_(0), stop_(false)
+	{}
+
+	~BufferedFileWriter()
+	{
+		stopThread();
+	}
+
+	// Writes of the previous file, if any, must have been flushed
+	void attach(int fd, bool background)
+	{
+		stopThread();
+		fd_ = fd;
+		used_ = 0;
+		error_ = 0;
+		front_.resize(BUFFER_SIZE);
+#ifdef USE_PTHREADS
+		background_ = background;
+		if (background_) startThread();
+#endif
+	}
+
+	// Flushes, and stops the background thread
+	void detach()
+	{
+		if (fd_ < 0) return;
+		flush();
+		stopThread();
+		fd_ = -1;
+	}
+
+	void write(const void* buf, SizeType count)
+	{
+		const char* ptr = static_cast<const char*>(buf);
+		while (count > 0) {
+			SizeType n = std::min(count, static_cast<SizeType>(BUFFER_SIZE - used_));
+			memcpy(&front_[used_], ptr, n);
+			used_ += n;
+			ptr += n;
+			count -= n;
+			if (used_ == BUFFER_SIZE) writeFront();
+		}
+	}
+
+	// Returns when all that was written is in the file
+	void flush()
+	{
+		if (used_ > 0) writeFront();
+		waitForThread();
+		checkError();
+	}
+
+private:
+
+	BufferedFileWriter(const BufferedFileWriter&);
+
+	BufferedFileWriter& operator=(const BufferedFileWriter&);
+
+	void writeFront()
+	{
+		if (!background_) {
+			error_ = writeAll(&front_[0], used_);
+			used_ = 0;
+			checkError();
+			return;
+		}
+
+#ifdef USE_PTHREADS
+		pthread_mutex_lock(&mutex_);
+		while (pending_ > 0)
+			pthread_cond_wait(&doneCond_, &mutex_);
+
+		front_.swap(back_);
+		pending_ = used_;
+		pthread_cond_signal(&workCond_);
+		pthread_mutex_unlock(&mutex_);
+
+		front_.resize(BUFFER_SIZE);
+		used_ = 0;
+		checkError();
+#endif
+	}
+
+	int writeAll(const char* ptr, SizeType count) const
+	{
+		while (count > 0) {
+			ssize_t ret = ::write(fd_, ptr, count);
+			if (ret < 0 && errno == EINTR) continue;
+			if (ret <= 0) return (ret < 0) ? errno : EIO;
+			ptr += ret;
+			count -= ret;
+		}
+
+		return 0;
+	}
+
+	void checkError()
+	{
+#ifdef USE_PTHREADS
+		if (background_) pthread_mutex_lock(&mutex_);
+#endif
+		int error = error_;
+		error_ = 0;
+#ifdef USE_PTHREADS
+		if (background_) pthread_mutex_unlock(&mutex_);
+#endif
+		if (error == 0) return;
+		throw RuntimeError("BufferedFileWriter: write failed: " +
+		                   String(strerror(error)) + "\n");
+	}
+
+	void waitForThread()
+	{
+#ifdef USE_PTHREADS
+		if (!background_) return;
+		pthread_mutex_lock(&mutex_);
+		while (pending_ > 0)
+			pthread_cond_wait(&doneCond_, &mutex_);
+		pthread_mutex_unlock(&mutex_);
+#endif
+	}
+
+#ifdef USE_PTHREADS
+	void startThread()
+	{
+		stop_ = false;
+		pending_ = 0;
+		back_.resize(BUFFER_SIZE);
+		pthread_mutex_init(&mutex_, 0);
+		pthread_cond_init(&workCond_, 0);
+		pthread_cond_init(&doneCond_, 0);
+		int ret = pthread_create(&thread_, 0, threadFunction, this);
+		if (ret == 0) return;
+
+		destroyThreadState();
+		background_ = false;
+	}
+
+	static void* threadFunction(void* ptr)
+	{
+		static_cast<BufferedFileWriter*>(ptr)->threadLoop();
+		return 0;
+	}
+
+	void threadLoop()
+	{
+		pthread_mutex_lock(&mutex_);
+		while (true) {
+			while (pending_ == 0 && !stop_)
+				pthread_cond_wait(&workCond_, &mutex_);
+
+			if (pending_ == 0) break;
+
+			SizeType count = pending_;
+			pthread_mutex_unlock(&mutex_);
+			int error = writeAll(&back_[0], count);
+			pthread_mutex_lock(&mutex_);
+			if (error_ == 0) error_ = error;
+			pending_ = 0;
+			pthread_cond_signal(&doneCond_);
+		}
+
+		pthread_mutex_unlock(&mutex_);
+	}
+
+	void destroyThreadState()
+	{
+		pthread_cond_destroy(&doneCond_);
+		pthread_cond_destroy(&workCond_);
+		pthread_mutex_destroy(&mutex_);
+	}
+#endif
+
+	// what is in front_ and not written is lost
+	void stopThread()
+	{
+#ifdef USE_PTHREADS
+		if (!background_) return;
+		pthread_mutex_lock(&mutex_);
+		stop_ = true;
+		pthread_cond_signal(&workCond_);
+		pthread_mutex_unlock(&mutex_);
+		pthread_join(thread_, 0);
+		destroyThreadState();
+		background_ = false;
+#endif
+	}
+
+	int fd_;
+	Vector<char>::Type front_;
+	SizeType used_;
+	bool background_;
+	Vector<char>::Type back_;
+	SizeType pending_;
+	int error_;
+	bool stop_;
+#ifdef USE_PTHREADS
+	pthread_t thread_;
+	pthread_mutex_t mutex_;
+	pthread_cond_t workCond_;
+	pthread_cond_t doneCond_;
+#endif
+}; // class BufferedFileWriter
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_BUFFERED_FILE_WRITER_H
@@ -0,0 +1,234 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file ChebyshevDensityOfStates.h
+ *
+ *  Density of states by the kernel polynomial method, with the trace
+ *  estimated stochastically: the Chebyshev moments
+ *  mu_n = Tr T_n(H~)/rank are averaged over R random-phase vectors r,
+ *  mu_n ~ (1/R) sum_r <r|T_n(H~)|r>, with |r_i| = 1/sqrt(rank).
+ *
+ *  The moment-doubling identities
+ *  mu_{2n} = 2 <phi_n|phi_n> - mu_0 and
+ *  mu_{2n+1} = 2 <phi_{n+1}|phi_n> - mu_1, with |phi_n> = T_n(H~)|r>,
+ *  give 2*params.steps moments from params.steps products with H, done
+ *  by ChebyshevSolver::oneStepDecomposition, which also does the scaling
+ *  H~ = (H - b)*oneOverA. A vector whose |phi_n| grows, because the
+ *  bounds do not enclose the spectrum, stops, and moments() throws.
+ *
+ *  Random vectors are split among MPI ranks (vector v goes to rank
+ *  v % nprocs) and then among Concurrency::npthreads threads. Vector v
+ *  is drawn from its own MersenneTwister, seeded from (seed, v), so that
+ *  the moments do not depend on the number of threads or ranks, up to
+ *  the order of the sums.
+ */
+#ifndef PSI_CHEBYSHEV_DENSITY_OF_STATES_H
+#define PSI_CHEBYSHEV_DENSITY_OF_STATES_H
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include "Vector.h"
+#include "Concurrency.h"
+#include "Mpi.h"
+#include "MersenneTwister.h"
+#include "ChebyshevSolver.h"
+#ifdef USE_PTHREADS
+#include "PthreadsNg.h"
+#endif
+
+namespace PsimagLite {
+
+template<typename SolverParametersType,typename MatrixType,typename VectorType>
+class ChebyshevDensityOfStates {
+
+	typedef typename SolverParametersType::RealType RealType;
+	typedef typename VectorType::value_type VectorElementType;
+	typedef typename Vector<RealType>::Type VectorRealType;
+	typedef typename Vector<VectorType>::Type VectorVectorType;
+	typedef typename Vector<VectorRealType>::Type VectorVectorRealType;
+
+public:
+
+	typedef ChebyshevSolver<SolverParametersType,MatrixType,VectorType> ChebyshevSolverType;
+	typedef typename ChebyshevSolverType::PostProcType PostProcType;
+
+	// params.b and params.oneOverA are set by ChebyshevSolver, unless given
+	ChebyshevDensityOfStates(const MatrixType& mat,
+	                         SolverParametersType& params,
+	                         SizeType randomVectors,
+	                         unsigned int seed = 1234)
+	    : mat_(mat),
+	      params_(params),
+	      solver_(mat,params),
+	      randomVectors_(randomVectors),
+	      seed_(seed),
+	      rank_(Concurrency::rank()),
+	      nprocs_(Concurrency::nprocs()),
+	      x_(),
+	      y_(),
+	      z_(),
+	      sums_(),
+	      outOfBounds_()
+	{
+		if (randomVectors_ == 0)
+			throw RuntimeError("ChebyshevDensityOfStates: no random vectors\n");
+	}
+
+	// 2*params.steps moments, the same on all ranks
+	void moments(VectorRealType& mu)
+	{
+		SizeType nthreads = std::max(std::min(Concurrency::npthreads,tasks()),
+		                             static_cast<SizeType>(1));
+		SizeType n = mat_.rows();
+		x_.assign(nthreads,VectorType(n));
+		y_.assign(nthreads,VectorType(n));
+		z_.assign(nthreads,VectorType(n));
+		sums_.assign(nthreads,VectorRealType(2*params_.steps,0.0));
+		outOfBounds_.assign(nthreads,0);
+
+		if (nthreads == 1) {
+			for (SizeType task = 0; task < tasks(); ++task) doTask(task,0);
+		} else {
+#ifdef USE_PTHREADS
+			PthreadsNg<ChebyshevDensityOfStates> threads(nthreads,
+			                                             0,
+			                                             Concurrency::setAffinitiesDefault);
+			threads.loopCreate(*this);
+#else
+			for (SizeType task = 0; task < tasks(); ++task) doTask(task,0);
+#endif
+		}
+
+		mu.assign(2*params_.steps,0.0);
+		for (SizeType t = 0; t < sums_.size(); ++t)
+			for (SizeType i = 0; i < mu.size(); ++i)
+				mu[i] += sums_[t][i];
+
+		MPI::allReduce(mu);
+
+		// all ranks throw if a vector of any of them was out of bounds
+		SizeType step = *std::max_element(outOfBounds_.begin(),outOfBounds_.end());
+		VectorRealType outOfBounds(1,step);
+		MPI::allReduce(outOfBounds);
+		if (outOfBounds[0] > 0)
+			throw RuntimeError(solver_.outOfBounds((step > 0) ? step : outOfBounds[0]));
+
+		for (SizeType i = 0; i < mu.size(); ++i)
+			mu[i] /= randomVectors_;
+
+		x_.clear();
+		y_.clear();
+		z_.clear();
+		sums_.clear();
+	}
+
+	// the moments as a serializer, for ChebyshevSerializer::plot or to save
+	// for the kernelPolynomial driver; it keeps the spectrum bounds for mat_
+	PostProcType* postProc()
+	{
+		VectorRealType mu;
+		moments(mu);
+		PostProcType* postProc = new PostProcType(mu,
+		                                          typename PostProcType::MatrixType(),
+		                                          params_);
+		postProc->fingerprint(ChebyshevSolverType::fingerprint(mat_));
+		return postProc;
+	}
+
+	// random vectors of this rank
+	SizeType tasks() const
+	{
+		return (randomVectors_ > rank_) ? (randomVectors_ - rank_ - 1)/nprocs_ + 1 : 0;
+	}
+
+	void doTask(SizeType taskNumber, SizeType threadNum)
+	{
+		SizeType v = rank_ + taskNumber*nprocs_;
+		VectorType& x = x_[threadNum];
+		VectorType& y = y_[threadNum];
+		VectorType& z = z_[threadNum];
+		VectorRealType& sums = sums_[threadNum];
+
+		MersenneTwister rng(seedOf(v));
+		RealType factor = 1.0/sqrt(static_cast<RealType>(y.size()));
+		for (SizeType i = 0; i < y.size(); ++i) {
+			randomPhase(y[i],rng);
+			y[i] *= factor;
+		}
+
+		std::fill(x.begin(),x.end(),0.0);
+		RealType mu0 = 0;
+		RealType mu1 = 0;
+		for (SizeType j = 0; j < params_.steps; ++j) {
+			RealType atmp = 0;
+			RealType btmp = 0;
+			solver_.oneStepDecomposition(x,y,z,atmp,btmp,j == 0);
+			if (j == 0) {
+				mu0 = atmp;
+				mu1 = btmp;
+			} else if (!solver_.withinBounds(atmp,mu0)) {
+				outOfBounds_[threadNum] = j;
+				return;
+			}
+
+			sums[2*j] += 2*atmp - mu0;
+			sums[2*j + 1] += 2*btmp - mu1;
+		}
+	}
+
+private:
+
+	// nearby v give unrelated seeds
+	unsigned int seedOf(SizeType v) const
+	{
+		unsigned int h = static_cast<unsigned int>(v + 1)*2654435761u;
+		h ^= h >> 16;
+		return seed_ ^ h;
+	}
+
+	static void randomPhase(RealType& value, MersenneTwister& rng)
+	{
+		value = (rng() < 0.5) ? -1.0 : 1.0;
+	}
+
+	static void randomPhase(std::complex<RealType>& value, MersenneTwister& rng)
+	{
+		RealType phi = 2*M_PI*rng();
+		value = std::complex<RealType>(cos(phi),sin(phi));
+	}
+
+	const MatrixType& mat_;
+	SolverParametersType& params_;
+	ChebyshevSolverType solver_;
+	SizeType randomVectors_;
+	unsigned int seed_;
+	SizeType rank_;
+	SizeType nprocs_;
+	VectorVectorType x_;
+	VectorVectorType y_;
+	VectorVectorType z_;
+	VectorVectorRealType sums_;
+	Vector<SizeType>::Type outOfBounds_;
+}; // class ChebyshevDensityOfStates
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_CHEBYSHEV_DENSITY_OF_STATES_H
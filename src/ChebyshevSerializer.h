@@ -40,6 +40,7 @@ Please see full open source license included in file LICENSE.
 #include "ParametersForSolver.h"
 #include "PlotParams.h"
 #include "ChebyshevFunction.h"
+#include "FastFourierTransform.h"
 #include <cassert>
 
 namespace PsimagLite {
@@ -49,15 +50,21 @@ struct KernelPolynomialParameters {
 
 	enum {JACKSON,LORENTZ,DIRICHLET};
 
+	// CLENSHAW sums the moments at each omega, with the Clenshaw recurrence
+	// DCT sums them once at Chebyshev nodes and interpolates
+	enum {CLENSHAW,DCT};
+
 	KernelPolynomialParameters(SizeType type1,
 	                           SizeType cutoff1,
-	                           const RealType& lambda1)
-	    : type(type1),cutoff(cutoff1),lambda(lambda1)
+	                           const RealType& lambda1,
+	                           SizeType reconstruction1 = CLENSHAW)
+	    : type(type1),cutoff(cutoff1),lambda(lambda1),reconstruction(reconstruction1)
 	{}
 
 	SizeType type;
 	SizeType cutoff;
 	RealType lambda;
+	SizeType reconstruction;
 }; // struct KernelPolynomialParameters
 
 template<typename VectorType_>
@@ -66,6 +73,10 @@ class ChebyshevSerializer  {
 	typedef typename VectorType_::value_type VectorElementType;
 	typedef typename Real<VectorElementType>::Type RealType;
 
+	// nodes per moment for KernelParametersType::DCT; the error of the
+	// cubic interpolation of the highest moment goes as its inverse^4
+	enum {NODES_PER_MOMENT = 8};
+
 	static const String stringMarker_;
 
 public:
@@ -83,14 +94,32 @@ public:
 	                    const ParametersType& params)
 	    : progress_("ChebyshevSerializer"),
 	      moments_(ab),
-	      params_(params)
+	      params_(params),
+	      fingerprint_(0)
 	{}
 
 	template<typename IoInputType>
 	ChebyshevSerializer(IoInputType& io)
-	    : progress_("ChebyshevSerializer"),params_(io,"#Chebyshev")
+	    : progress_("ChebyshevSerializer"),params_(),fingerprint_(0)
 	{
+		// in the order of save, from the current position of io
+		io.readline(params_.Eg,"#ChebyshevEnergy=");
+		io.readline(params_.oneOverA,"#ChebyshevOneOverA=");
+		io.readline(params_.b,"#ChebyshevB=");
 		io.read(moments_,"#ChebyshevMoments");
+
+		// absent in older files, so it is only looked for right after the
+		// moments; anything else there, the marker of the next record for
+		// example, is left for the next reader
+		String token;
+		io>>token;
+		String label("#ChebyshevFingerprint=");
+		if (token.substr(0,label.size()) == label) {
+			IstringStream is(token.substr(label.size()));
+			is>>fingerprint_;
+		} else if (token != "") {
+			io.move(-static_cast<int>(token.size()));
+		}
 	}
 
 	template<typename IoOutputType>
@@ -103,6 +132,31 @@ public:
 		io.print("#ChebyshevB=",params_.b);
 
 		io.printVector(moments_,"#ChebyshevMoments");
+
+		// always written, 0 if unknown, so that a reader never takes the
+		// one of the next record
+		OstringStream msg;
+		msg.precision(17);
+		msg<<fingerprint_;
+		io.print("#ChebyshevFingerprint=",msg.str());
+	}
+
+	// ChebyshevSolver::fingerprint of the matrix of the moments, 0 if unknown
+	void fingerprint(const RealType& fingerprint) { fingerprint_ = fingerprint; }
+
+	const RealType& fingerprint() const { return fingerprint_; }
+
+	// Sets the spectrum bounds of params to the ones of these moments if
+	// these are for the matrix with this fingerprint; ChebyshevSolver then
+	// uses them instead of computing them
+	bool cachedBounds(ParametersType& params, const RealType& fingerprint) const
+	{
+		if (fingerprint_ == 0 || params_.oneOverA <= 0) return false;
+		if (fabs(fingerprint_ - fingerprint) > 1e-12*fabs(fingerprint)) return false;
+
+		params.b = params_.b;
+		params.oneOverA = params_.oneOverA;
+		return true;
 	}
 
 	static const String& stringMarker() { return stringMarker_; }
@@ -119,6 +173,10 @@ public:
 		typename Vector<RealType>::Type gnmun(gn.size());
 		computeGnMuN(gnmun,gn);
 
+		typename Vector<RealType>::Type atNodes;
+		if (kernelParams.reconstruction == KernelParametersType::DCT)
+			calcFAtNodes(atNodes,gnmun);
+
 		SizeType counter = 0;
 		SizeType n = SizeType((params.omega2 - params.omega1)/params.deltaOmega);
 		if (result.size()==0) result.resize(n);
@@ -128,7 +186,13 @@ public:
 			RealType x = (omega+offset-params_.b)*params_.oneOverA;
 
 			RealType den = (x>1.0 || x<-1.0) ? 0.0 : sqrt(1.0 - x*x);
-			RealType tmp = (fabs(den)>1e-6) ? calcF(x,gnmun)/den : 0.0;
+			RealType tmp = 0.0;
+			if (fabs(den)>1e-6) {
+				RealType f = (atNodes.size() > 0) ? interpolate(x,atNodes)
+				                                  : calcF(x,gnmun);
+				tmp = f/den;
+			}
+
 			std::pair<RealType,RealType> p(omega,tmp);
 			result[counter++] = p;
 
@@ -151,12 +215,63 @@ public:
 
 private:
 
+	// 2*(gnmn[0]/2 + sum_i gnmn[i] T_i(x)) by Clenshaw's recurrence, O(N)
 	RealType calcF(const RealType& x,
 	               const typename Vector<RealType>::Type& gnmn) const
 	{
-		RealType sum = 0.5*gnmn[0];
-		for (SizeType i=1;i<gnmn.size();i++) sum += gnmn[i]*chebyshev_(i,x);
-		return 2.0*sum;
+		RealType b1 = 0.0;
+		RealType b2 = 0.0;
+		for (SizeType i=gnmn.size();i>1;i--) {
+			RealType b0 = 2.0*gnmn[i-1] + 2.0*x*b1 - b2;
+			b2 = b1;
+			b1 = b0;
+		}
+
+		return ((gnmn.size() > 0) ? gnmn[0] : 0.0) + x*b1 - b2;
+	}
+
+	/* calcF at the Chebyshev nodes x_j = cos(theta_j),
+	   theta_j = pi (j + 1/2)/nodes, with one cosine transform; there are
+	   at least NODES_PER_MOMENT nodes per moment, and a power of 2 */
+	void calcFAtNodes(typename Vector<RealType>::Type& atNodes,
+	                  const typename Vector<RealType>::Type& gnmn) const
+	{
+		SizeType nodes = 2;
+		while (nodes < NODES_PER_MOMENT*gnmn.size()) nodes <<= 1;
+
+		typename Vector<RealType>::Type c(gnmn.size());
+		for (SizeType i=0;i<c.size();i++)
+			c[i] = (i == 0) ? gnmn[0] : 2.0*gnmn[i];
+
+		FastFourierTransform<RealType>::cosineTransform(atNodes,c,nodes);
+	}
+
+	/* calcF at x from its values at the nodes, by cubic interpolation in
+	   theta = acos(x), where the nodes are equally spaced and calcF is a
+	   smooth cosine series, even around theta = 0 and theta = pi */
+	RealType interpolate(const RealType& x,
+	                     const typename Vector<RealType>::Type& atNodes) const
+	{
+		int nodes = atNodes.size();
+		RealType t = acos(x)*nodes/M_PI - 0.5;
+		int j0 = static_cast<int>(floor(t));
+		RealType u = t - j0;
+
+		RealType w[4];
+		w[0] = -u*(u - 1.0)*(u - 2.0)/6.0;
+		w[1] = (u + 1.0)*(u - 1.0)*(u - 2.0)/2.0;
+		w[2] = -(u + 1.0)*u*(u - 2.0)/2.0;
+		w[3] = (u + 1.0)*u*(u - 1.0)/6.0;
+
+		RealType sum = 0.0;
+		for (int k = 0; k < 4; ++k) {
+			int j = j0 - 1 + k;
+			if (j < 0) j = -1 - j;
+			if (j >= nodes) j = 2*nodes - 1 - j;
+			sum += w[k]*atNodes[j];
+		}
+
+		return sum;
 	}
 
 	void computeGnMuN(typename Vector<RealType>::Type& gnmn,
@@ -205,6 +320,7 @@ private:
 	ProgressIndicator progress_;
 	typename Vector<RealType>::Type moments_;
 	ParametersType params_;
+	RealType fingerprint_;
 	ChebyshevFunction<RealType> chebyshev_;
 }; // class ChebyshevSerializer
 
@@ -123,6 +123,15 @@ public:
 
 	enum {WITH_INFO=1,DEBUG=2,ALLOWS_ZERO=4};
 
+	// Lanczos steps for the spectrum bounds
+	enum {BOUNDS_STEPS=40};
+
+	// fraction of the width of the spectrum added on each side
+	static const RealType BOUNDS_MARGIN;
+
+	// largest |phi_n|^2/|phi_0|^2 taken as bounded, see withinBounds
+	static const RealType MAX_GROWTH;
+
 	ChebyshevSolver(MatrixType const &mat,
 	                SolverParametersType& params,
 	                DenseMatrixType* storageForLanczosVectors=0)
@@ -131,9 +140,9 @@ public:
 	      params_(params),
 	      mode_(WITH_INFO),
 	      rng_(343311),
-	      lanczosVectors_(mat,params.lotaMemory,params.steps,storageForLanczosVectors)
+	      storageForLanczosVectors_(storageForLanczosVectors),
+	      lanczosVectors_(0)
 	{
-		params.steps=400;
 		setMode(params.options);
 		computeAandB();
 		PsimagLite::OstringStream msg;
@@ -141,6 +150,11 @@ public:
 		progress_.printline(msg,std::cout);
 	}
 
+	~ChebyshevSolver()
+	{
+		delete lanczosVectors_;
+	}
+
 	void computeGroundState(RealType&, VectorType&)
 	{
 		unimplemented("computeGroundState");
@@ -171,25 +185,52 @@ public:
 
 	//! ab.a contains the even moments
 	//! ab.b contains the odd moments
+	//! The vectors are kept, for reorthogonalizationMatrix(), only here;
+	//! oneStepDecomposition alone, as in the KPM paths, allocates none
 	void decomposition(const VectorType& initVector,
 	                   TridiagonalMatrixType& ab)
 	{
 		VectorType x(initVector.size(),0.0);
 		VectorType y = initVector;
+		VectorType z(initVector.size());
 
-		lanczosVectors_.reset(y.size(),params_.steps);
+		if (!lanczosVectors_)
+			lanczosVectors_ = new LanczosVectorsType(mat_,
+			                                         params_.lotaMemory,
+			                                         params_.steps,
+			                                         storageForLanczosVectors_,
+			                                         params_.options);
+
+		lanczosVectors_->reset(y.size(),params_.steps);
 		ab.resize(2*params_.steps,0);
-		for (SizeType j=0; j < lanczosVectors_.cols(); j++) {
-			for (SizeType i = 0; i < mat_.rows(); i++)
-				lanczosVectors_(i,j) = y[i];
+		for (SizeType j=0; j < params_.steps; j++) {
+			lanczosVectors_->saveVector(y,j);
 			RealType atmp = 0;
 			RealType btmp = 0;
-			oneStepDecomposition(x,y,atmp,btmp,j==0);
+			oneStepDecomposition(x,y,z,atmp,btmp,j==0);
+			if (j > 0 && !withinBounds(atmp,ab[0]))
+				throw RuntimeError(outOfBounds(j));
 			ab[2*j] = 2*atmp-ab[0];
 			ab[2*j+1] = 2*btmp-ab[1];
 		}
 	}
 
+	/* With the spectrum of H~ = (H - b)*oneOverA in [-1,1], |T_n(H~)| <= 1
+	   and atmp = |phi_n|^2 cannot exceed mu0 = |phi_0|^2; it grows
+	   exponentially in n if the bounds do not enclose the spectrum */
+	bool withinBounds(const RealType& atmp, const RealType& mu0) const
+	{
+		return (atmp <= MAX_GROWTH*mu0);
+	}
+
+	String outOfBounds(SizeType step) const
+	{
+		String s("ChebyshevSolver: |phi_n| grew at step " + ttos(step));
+		s += ", the spectrum is not within eMin=" + ttos(params_.b - 1.0/params_.oneOverA);
+		s += " eMax=" + ttos(params_.b + 1.0/params_.oneOverA) + "\n";
+		return s;
+	}
+
 	//! atmp = < phi_n | phi_n>
 	//! btmp = < phi_n | phi_{n+1}>
 	void oneStepDecomposition(VectorType& x,
@@ -198,11 +239,26 @@ public:
 	                          RealType& btmp,
 	                          bool isFirst) const
 	{
-		VectorType z(x.size(),0.0);
+		VectorType z(x.size());
+		oneStepDecomposition(x,y,z,atmp,btmp,isFirst);
+	}
+
+	//! Same as above, with z a scratch vector of the same size as x,
+	//! so that loops over steps do not allocate; const and thread safe
+	//! for different x, y and z
+	void oneStepDecomposition(VectorType& x,
+	                          VectorType& y,
+	                          VectorType& z,
+	                          RealType& atmp,
+	                          RealType& btmp,
+	                          bool isFirst) const
+	{
+		z.resize(x.size());
+		std::fill(z.begin(),z.end(),0.0);
 		mat_.matrixVectorProduct (z, y); // z+= Hy
 		// scale matrix:
-		z -= params_.b*y;
-		z *= params_.oneOverA;
+		for (SizeType i = 0; i < z.size(); i++)
+			z[i] = (z[i] - params_.b*y[i])*params_.oneOverA;
 
 		RealType val = (isFirst) ? 1.0 : 2.0;
 
@@ -223,13 +279,41 @@ public:
 
 	SizeType steps() const {return params_.steps; }
 
+	// empty, as without lotaMemory, if decomposition() was not called
 	const DenseMatrixRealType& reorthogonalizationMatrix()
 	{
-		return lanczosVectors_.reorthogonalizationMatrix();
+		if (!lanczosVectors_) return noReortho_;
+		return lanczosVectors_->reorthogonalizationMatrix();
+	}
+
+	/* A number that identifies mat, to match cached spectrum bounds:
+	   sum_i w_i (re + im) of (mat*u)_i, with u and w fixed and incommensurate,
+	   so that it depends on all matrix elements and their positions;
+	   one product with mat */
+	static RealType fingerprint(const MatrixType& mat)
+	{
+		SizeType n = mat.rows();
+		VectorType u(n);
+		VectorType hu(n,0.0);
+		for (SizeType i = 0; i < n; i++)
+			u[i] = cos(0.7*i + 0.1);
+
+		mat.matrixVectorProduct(hu,u);
+
+		RealType sum = n;
+		for (SizeType i = 0; i < n; i++)
+			sum += sin(1.3*i + 0.2)*PsimagLite::real(hu[i])
+			        + cos(1.9*i + 0.3)*PsimagLite::imag(hu[i]);
+
+		return sum;
 	}
 
 private:
 
+	ChebyshevSolver(const ChebyshevSolver&);
+
+	ChebyshevSolver& operator=(const ChebyshevSolver&);
+
 	void unimplemented(const String& s) const
 	{
 		String s2("Hmmm...this ain't looking good...");
@@ -271,61 +355,64 @@ private:
 		unimplemented("computeGroundStateTest");
 	}
 
-	class InternalMatrix {
-	public:
-		InternalMatrix(const MatrixType& mat)
-		    : matx_(mat),y_(matx_.rows())
-		{}
-
-		SizeType rows() const { return matx_.rows(); }
-
-		void matrixVectorProduct (VectorType &x,const VectorType &y) const
-		{
-			for (SizeType i=0;i<y_.size();i++) y_[i] = -y[i];
-			matx_.matrixVectorProduct(x,y_);
-		}
-
-		VectorElementType operator()(SizeType i,SizeType j) const
-		{
-			return matx_(i,j);
-		}
-
-	private:
-		const MatrixType& matx_;
-		mutable VectorType y_;
-	}; // class InternalMatrix
-
+	/* Spectrum bounds from BOUNDS_STEPS Lanczos steps from a random vector:
+	   the extreme Ritz values of the tridiagonal matrix T, moved out by the
+	   norm |b| of the residual H V - V T, where b is the last b of T, and by
+	   BOUNDS_MARGIN of the width. That is not a proof that the spectrum is
+	   inside, so the moments check it as they go (see withinBounds). Skipped,
+	   and params used as they are, if params.oneOverA was given, for example
+	   from a ChebyshevSerializer saved for the same matrix (see cachedBounds)
+	*/
 	void computeAandB()
 	{
+		if (params_.oneOverA > 0) {
+			PsimagLite::OstringStream msg;
+			msg<<"Spectrum bounds given, eMin="<<params_.b - 1.0/params_.oneOverA;
+			msg<<" eMax="<<params_.b + 1.0/params_.oneOverA;
+			progress_.printline(msg,std::cout);
+			return;
+		}
+
 		PsimagLite::OstringStream msg;
 		msg<<"Asking LanczosSolver to compute spectrum bounds...";
 		progress_.printline(msg,std::cout);
 
-		SolverParametersType params;
-		InternalMatrix mat2(mat_);
-		RealType eMax = 0;
-		LanczosSolver<SolverParametersType,InternalMatrix,VectorType>
-		        lanczosSolver2(mat2,params);
-
-		VectorType z2(mat_.rows(),0);
-		lanczosSolver2.computeGroundState(eMax,z2);
-
-		VectorType z(mat_.rows(),0);
-		LanczosSolver<SolverParametersType,MatrixType,VectorType>
-		        lanczosSolver(mat_,params);
-		RealType eMin = 0;
-		lanczosSolver.computeGroundState(eMin,z);
+		typedef LanczosSolver<SolverParametersType,MatrixType,VectorType> LanczosSolverType;
+		typedef typename LanczosSolverType::TridiagonalMatrixType LanczosTridiagonalType;
 
-		eMax = -eMax;
-		eMax *= 3;
-		eMin *= 3;
-		assert(eMax-eMin>1e-2);
+		SolverParametersType params;
+		params.steps = std::min(static_cast<SizeType>(BOUNDS_STEPS),mat_.rows());
+		params.tolerance = 0; // all steps, no ground state convergence test
+		params.threadId = params_.threadId;
+		LanczosSolverType lanczosSolver(mat_,params);
+
+		VectorType initVector(mat_.rows());
+		for (SizeType i = 0; i < initVector.size(); i++)
+			initVector[i] = rng_() - 0.5;
+
+		LanczosTridiagonalType ab;
+		lanczosSolver.decomposition(initVector,ab);
+
+		SizeType n = ab.size();
+		Matrix<RealType> t;
+		ab.buildDenseMatrix(t);
+		typename Vector<RealType>::Type eigs(n);
+		diag(t,eigs,'N');
+
+		RealType lastB = fabs(ab.b(n - 1));
+		RealType eMin = eigs[0] - lastB;
+		RealType eMax = eigs[n - 1] + lastB;
+		RealType margin = BOUNDS_MARGIN*(eMax - eMin);
+		if (margin < 1e-6) margin = 1e-6;
+		eMin -= margin;
+		eMax += margin;
 
 		params_.oneOverA=2.0/(eMax-eMin);
 		params_.b=(eMax+eMin)/2;
 
 		PsimagLite::OstringStream msg2;
 		msg2<<"Spectrum bounds computed, eMax="<<eMax<<" eMin="<<eMin;
+		msg2<<" after "<<n<<" Lanczos steps";
 		progress_.printline(msg2,std::cout);
 	}
 
@@ -334,9 +421,20 @@ private:
 	SolverParametersType& params_;
 	SizeType mode_;
 	RngType rng_;
-	LanczosVectorsType lanczosVectors_;
+	DenseMatrixType* storageForLanczosVectors_;
+	LanczosVectorsType* lanczosVectors_;
+	DenseMatrixRealType noReortho_;
 	//! Scaling factors for the Chebyshev expansion
 }; // class ChebyshevSolver
+
+template<typename SolverParametersType,typename MatrixType,typename VectorType>
+const typename SolverParametersType::RealType
+ChebyshevSolver<SolverParametersType,MatrixType,VectorType>::BOUNDS_MARGIN = 0.01;
+
+template<typename SolverParametersType,typename MatrixType,typename VectorType>
+const typename SolverParametersType::RealType
+ChebyshevSolver<SolverParametersType,MatrixType,VectorType>::MAX_GROWTH = 2.0;
+
 } // namespace PsimagLite
 /*@}*/
 #endif //CHEBYSHEV_SOLVER_H_
@@ -37,6 +37,18 @@ public:
 	typedef RealType Type;
 };
 
+template<typename ComplexOrRealType>
+class SinglePrecision {
+public:
+	typedef float Type;
+};
+
+template<typename RealType>
+class SinglePrecision<std::complex<RealType> > {
+public:
+	typedef std::complex<float> Type;
+};
+
 template<typename T>
 class IsComplexNumber {
 public:
@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file CompressLz.h
+ *
+ *  Byte-oriented LZ77 compression of blocks, in the block format of LZ4
+ *
+ *  A block is a list of sequences; each is a token byte, whose high
+ *  4 bits are the number of literals and whose low 4 bits are the match
+ *  length minus MIN_MATCH (15 meaning that more bytes of 255 follow, up
+ *  to one that is less), the literals, and the match as a 2-byte little
+ *  endian offset back into the output. The last sequence has literals
+ *  only, and the last LAST_LITERALS bytes are always literals. Matches
+ *  are found with a hash table of 4-byte prefixes, skipping faster over
+ *  data that does not compress.
+ */
+#ifndef PSI_COMPRESS_LZ_H
+#define PSI_COMPRESS_LZ_H
+#include <cstring>
+#include "Vector.h"
+#include "TypeToString.h"
+
+namespace PsimagLite {
+
+class CompressLz {
+
+	typedef unsigned char ByteType;
+
+	enum {MIN_MATCH = 4, LAST_LITERALS = 5, MATCH_LIMIT = 12};
+
+	enum {HASH_BITS = 12, MAX_OFFSET = 65535, SKIP_TRIGGER = 6};
+
+public:
+
+	// Largest output of compress for n bytes
+	static SizeType bound(SizeType n)
+	{
+		return n + n/255 + 16;
+	}
+
+	// Compresses n bytes of src into dest, which must have bound(n) bytes,
+	// and returns the size of the output
+	static SizeType compress(char* dest, const char* src, SizeType n)
+	{
+		const ByteType* in = reinterpret_cast<const ByteType*>(src);
+		ByteType* out = reinterpret_cast<ByteType*>(dest);
+		ByteType* op = out;
+		SizeType anchor = 0;
+
+		if (n >= MATCH_LIMIT + 1) {
+			Vector<int>::Type table(1 << HASH_BITS, -1);
+			const SizeType matchStartLimit = n - MATCH_LIMIT;
+			const SizeType matchEndLimit = n - LAST_LITERALS;
+			SizeType ip = 0;
+			SizeType misses = 0;
+			while (ip < matchStartLimit) {
+				SizeType h = hash(read32(in + ip));
+				int ref = table[h];
+				table[h] = ip;
+				if (ref < 0 || ip - ref > MAX_OFFSET || read32(in + ref) != read32(in + ip)) {
+					ip += 1 + (misses++ >> SKIP_TRIGGER);
+					continue;
+				}
+
+				misses = 0;
+				SizeType length = MIN_MATCH;
+				while (ip + length < matchEndLimit && in[ref + length] == in[ip + length])
+					++length;
+
+				op = sequence(op, in + anchor, ip - anchor, ip - ref, length);
+				ip += length;
+				anchor = ip;
+			}
+		}
+
+		SizeType literals = n - anchor;
+		ByteType* token = op++;
+		*token = lengthBytes(op, literals) << 4;
+		memcpy(op, in + anchor, literals);
+		op += literals;
+		return op - out;
+	}
+
+	// Decompresses srcSize bytes of src into exactly destSize bytes of dest;
+	// throws if src is not a block of that size
+	static void decompress(char* dest, SizeType destSize, const char* src, SizeType srcSize)
+	{
+		const ByteType* ip = reinterpret_cast<const ByteType*>(src);
+		const ByteType* const inEnd = ip + srcSize;
+		ByteType* out = reinterpret_cast<ByteType*>(dest);
+		ByteType* op = out;
+		ByteType* const outEnd = out + destSize;
+
+		while (ip < inEnd) {
+			SizeType token = *ip++;
+			SizeType literals = readLength(ip, inEnd, token >> 4);
+			if (literals > SizeType(inEnd - ip) || literals > SizeType(outEnd - op))
+				corrupted(destSize);
+
+			memcpy(op, ip, literals);
+			op += literals;
+			ip += literals;
+			if (ip == inEnd) break;
+
+			if (inEnd - ip < 2) corrupted(destSize);
+			SizeType offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			SizeType length = readLength(ip, inEnd, token & 15) + MIN_MATCH;
+			if (offset == 0 || offset > SizeType(op - out) || length > SizeType(outEnd - op))
+				corrupted(destSize);
+
+			// byte by byte, because the match may overlap its own output
+			const ByteType* ref = op - offset;
+			for (SizeType i = 0; i < length; ++i) op[i] = ref[i];
+			op += length;
+		}
+
+		if (op != outEnd) corrupted(destSize);
+	}
+
+private:
+
+	static unsigned int read32(const ByteType* p)
+	{
+		unsigned int x = 0;
+		memcpy(&x, p, sizeof(x));
+		return x;
+	}
+
+	static SizeType hash(unsigned int x)
+	{
+		return (x*2654435761U) >> (32 - HASH_BITS);
+	}
+
+	// the 4 bits of length for a token, after writing any extra bytes
+	static SizeType lengthBytes(ByteType*& op, SizeType length)
+	{
+		if (length < 15) return length;
+		for (length -= 15; length >= 255; length -= 255) *op++ = 255;
+		*op++ = length;
+		return 15;
+	}
+
+	static ByteType* sequence(ByteType* op,
+	                          const ByteType* literals,
+	                          SizeType literalLength,
+	                          SizeType offset,
+	                          SizeType matchLength)
+	{
+		ByteType* token = op++;
+		SizeType high = lengthBytes(op, literalLength);
+		memcpy(op, literals, literalLength);
+		op += literalLength;
+		*op++ = offset & 255;
+		*op++ = offset >> 8;
+		SizeType low = lengthBytes(op, matchLength - MIN_MATCH);
+		*token = (high << 4) | low;
+		return op;
+	}
+
+	static SizeType readLength(const ByteType*& ip, const ByteType* inEnd, SizeType length)
+	{
+		if (length < 15) return length;
+		while (ip < inEnd) {
+			SizeType more = *ip++;
+			length += more;
+			if (more < 255) return length;
+		}
+
+		corrupted(0);
+		return 0;
+	}
+
+	static void corrupted(SizeType destSize)
+	{
+		throw RuntimeError("CompressLz::decompress(): corrupted block of " +
+		                   ttos(destSize) + " bytes\n");
+	}
+}; // class CompressLz
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_COMPRESS_LZ_H
@@ -53,6 +53,11 @@ public:
 	typedef typename Vector<std::pair<RealType,ComplexType> >::Type PlotDataType;
 	typedef PlotParams<RealType> PlotParamsType;
 	typedef ParametersForSolver<RealType> ParametersType;
+	typedef typename Vector<ComplexType>::Type VectorComplexType;
+	typedef typename Vector<RealType>::Type VectorRealType;
+
+	// number of z values per block in addIOfOmega
+	enum {BLOCK = 64};
 
 	ContinuedFraction(const TridiagonalMatrixType& ab,
 	                  const MatrixType& reortho,
@@ -150,31 +155,37 @@ public:
 
 	void plotReal(PlotDataType& result,const PlotParamsType& params) const
 	{
-		SizeType counter = 0;
-		SizeType n = SizeType((params.omega2 - params.omega1)/params.deltaOmega);
-		if (result.size()==0) result.resize(n);
-		for (RealType omega=params.omega1;omega<params.omega2;omega+=params.deltaOmega) {
-			ComplexType z(omega,params.delta);
-			ComplexType res = iOfOmega(z,Eg_,isign_);
-			std::pair<RealType,ComplexType> p(omega,res);
-			result[counter++] = p;
-			if (counter>=result.size()) break;
-		}
+		if (result.size()==0) result.resize(plotSize(params,false));
+		plotBatched(result,params,false);
 	}
 
 	void plotMatsubara(PlotDataType& result,const PlotParamsType& params) const
 	{
-		SizeType counter = 0;
-		SizeType n = params.numberOfMatsubaras;
-		if (result.size()==0) result.resize(n);
-		for (SizeType omegaIndex = 0; omegaIndex < params.numberOfMatsubaras; ++omegaIndex) {
-			ComplexType z(params.delta, matsubara(omegaIndex,params));
-			ComplexType res = iOfOmega(z,Eg_,isign_);
-			std::pair<RealType,ComplexType> p(PsimagLite::imag(z),res);
-			result[counter++] = p;
-			if (counter>=result.size()) break;
-		}
+		if (result.size()==0) result.resize(plotSize(params,true));
+		plotBatched(result,params,true);
+	}
+
+	// true if plot() uses Matsubara frequencies for these params
+	bool isMatsubara(const PlotParamsType& params) const
+	{
+		return (freqEnum_ == FREQ_MATSUBARA || params.numberOfMatsubaras > 0);
+	}
+
+	// number of points of plot() when result is empty
+	SizeType plotSize(const PlotParamsType& params) const
+	{
+		return plotSize(params,isMatsubara(params));
 	}
+
+	// The z of plot() and their x coordinates, at most maxSize of them
+	void frequencies(VectorComplexType& z,
+	                 VectorRealType& x,
+	                 const PlotParamsType& params,
+	                 SizeType maxSize) const
+	{
+		frequencies(z,x,params,maxSize,isMatsubara(params));
+	}
+
 	//! Cases:
 	//! (1) < phi0|A (z+(E0-e_k))^{-1}|A^\dagger|phi0> and
 	//! (2) < phi0|A^\dagger (z-(E0-e_k))^{-1}|A|phi0>
@@ -194,12 +205,105 @@ public:
 		return sum*weight_;
 	}
 
+	/* sums[k] += iOfOmega(z[k],offset,isign) for k < n.
+	   z is taken BLOCK values at a time: for each pole, all the z of the
+	   block are updated in a loop of real arithmetic over local arrays,
+	   1/(z - p) = (x - p - i y)/((x - p)^2 + y^2), which the compiler
+	   vectorizes, instead of one complex division per pole and z */
+	void addIOfOmega(ComplexType* sums,
+	                 const ComplexType* z,
+	                 SizeType n,
+	                 RealType offset,
+	                 int isign) const
+	{
+		if (weight_==0) return;
+
+		const SizeType poles = intensity_.size();
+		RealType x[BLOCK];
+		RealType y[BLOCK];
+		RealType re[BLOCK];
+		RealType im[BLOCK];
+		for (SizeType start = 0; start < n; start += BLOCK) {
+			const SizeType m = std::min(static_cast<SizeType>(BLOCK),n - start);
+			for (SizeType k = 0; k < m; ++k) {
+				x[k] = PsimagLite::real(z[start + k]);
+				y[k] = PsimagLite::imag(z[start + k]);
+				re[k] = im[k] = 0;
+			}
+
+			for (SizeType l = 0; l < poles; ++l) {
+				const RealType pole = isign*(offset - eigs_[l]);
+				const RealType w = intensity_[l];
+				for (SizeType k = 0; k < m; ++k) {
+					const RealType dx = x[k] - pole;
+					const RealType factor = w/(dx*dx + y[k]*y[k]);
+					re[k] += dx*factor;
+					im[k] -= y[k]*factor;
+				}
+			}
+
+			for (SizeType k = 0; k < m; ++k)
+				sums[start + k] += ComplexType(re[k]*weight_,im[k]*weight_);
+		}
+	}
+
 	SizeType size() const { return ab_.size(); }
 
 	FreqEnum freqType() const  { return freqEnum_; }
 
+	const RealType& energy() const { return Eg_; }
+
+	int isign() const { return isign_; }
+
 private:
 
+	SizeType plotSize(const PlotParamsType& params,bool matsubaras) const
+	{
+		if (matsubaras) return params.numberOfMatsubaras;
+		return SizeType((params.omega2 - params.omega1)/params.deltaOmega);
+	}
+
+	void frequencies(VectorComplexType& z,
+	                 VectorRealType& x,
+	                 const PlotParamsType& params,
+	                 SizeType maxSize,
+	                 bool matsubaras) const
+	{
+		z.clear();
+		x.clear();
+		if (maxSize == 0) return;
+
+		if (matsubaras) {
+			SizeType n = std::min(maxSize,static_cast<SizeType>(params.numberOfMatsubaras));
+			for (SizeType omegaIndex = 0; omegaIndex < n; ++omegaIndex) {
+				z.push_back(ComplexType(params.delta, matsubara(omegaIndex,params)));
+				x.push_back(PsimagLite::imag(z.back()));
+			}
+
+			return;
+		}
+
+		// same accumulation of omega as always, so that x does not change
+		for (RealType omega=params.omega1;omega<params.omega2;omega+=params.deltaOmega) {
+			z.push_back(ComplexType(omega,params.delta));
+			x.push_back(omega);
+			if (z.size()>=maxSize) break;
+		}
+	}
+
+	void plotBatched(PlotDataType& result,
+	                 const PlotParamsType& params,
+	                 bool matsubaras) const
+	{
+		VectorComplexType z;
+		VectorRealType x;
+		frequencies(z,x,params,result.size(),matsubaras);
+		VectorComplexType sums(z.size(),0.0);
+		if (z.size() > 0) addIOfOmega(&sums[0],&z[0],z.size(),Eg_,isign_);
+		for (SizeType k = 0; k < z.size(); ++k)
+			result[k] = std::pair<RealType,ComplexType>(x[k],sums[k]);
+	}
+
 	void diagonalize()
 	{
 		if (weight_==0) return;
@@ -34,6 +34,10 @@ Please see full open source license included in file LICENSE.
 #include "TypeToString.h"
 #include "ProgressIndicator.h"
 #include "FreqEnum.h"
+#include "Concurrency.h"
+#ifdef USE_PTHREADS
+#include "PthreadsNg.h"
+#endif
 
 namespace PsimagLite {
 
@@ -49,6 +53,12 @@ public:
 	typedef typename ContinuedFractionType::MatrixType MatrixType;
 	typedef typename ContinuedFractionType::PlotDataType PlotDataType;
 	typedef typename ContinuedFractionType::PlotParamsType PlotParamsType;
+	typedef typename ContinuedFractionType::VectorComplexType VectorComplexType;
+	typedef typename ContinuedFractionType::VectorRealType VectorRealType;
+	typedef typename Vector<ContinuedFractionType>::Type VectorContinuedFractionType;
+
+	// grid points per task of plot
+	enum {CHUNK = 1024};
 
 	ContinuedFractionCollection(FreqEnum freqEnum)
 	    : freqEnum_(freqEnum), progress_("ContinuedFractionCollection")
@@ -87,13 +97,51 @@ public:
 		data_.push_back(cf);
 	}
 
+	/* The sum of the plots of all fractions. The grid is split in chunks
+	   of CHUNK points, one task each, and each task adds the fractions in
+	   order to its chunk of one buffer, so that the result does not depend
+	   on the number of threads */
 	void plot(PlotDataType& result,
 	          const PlotParamsType& params) const
 	{
-		for (SizeType i=0;i<data_.size();i++) {
-			PlotDataType result1;
-			data_[i].plot(result1,params);
-			accumulate(result, result1);
+		if (data_.size() == 0) return;
+
+		VectorComplexType z;
+		VectorRealType x;
+		data_[0].frequencies(z,x,params,data_[0].plotSize(params));
+		for (SizeType i = 1; i < data_.size(); ++i)
+			if (data_[i].isMatsubara(params) != data_[0].isMatsubara(params))
+				throw RuntimeError("CF: x coordinate different\n");
+
+		SizeType n = data_[0].plotSize(params);
+		if (result.size() == 0) {
+			result.resize(n);
+			for (SizeType k = 0; k < x.size(); ++k)
+				result[k] = std::pair<RealType,ComplexType>(x[k],0.0);
+		} else if (result.size() != n) {
+			String s = "ContinuedFractionCollection::plot(...)";
+			s += " vectors must be of same length\n";
+			throw RuntimeError(s.c_str());
+		}
+
+		VectorComplexType sums(z.size(),0.0);
+		PlotHelper helper(data_,z,sums);
+		SizeType nthreads = std::min(Concurrency::npthreads,helper.tasks());
+		if (nthreads > 1) {
+#ifdef USE_PTHREADS
+			PthreadsNg<PlotHelper> threads(nthreads,0,Concurrency::setAffinitiesDefault);
+			threads.loopCreate(helper);
+#else
+			for (SizeType task = 0; task < helper.tasks(); ++task) helper.doTask(task,0);
+#endif
+		} else {
+			for (SizeType task = 0; task < helper.tasks(); ++task) helper.doTask(task,0);
+		}
+
+		for (SizeType k = 0; k < z.size(); ++k) {
+			if (result[k].first != x[k])
+				throw RuntimeError("CF: x coordinate different\n");
+			result[k].second += sums[k];
 		}
 	}
 
@@ -111,35 +159,41 @@ public:
 
 private:
 
-	void accumulate(PlotDataType& v1,const PlotDataType& v2) const
-	{
-		bool wasEmpty = false;
-		if (v1.size()==0) {
-			wasEmpty = true;
-			v1.resize(v2.size());
-		} else {
-			if (v1.size()!=v2.size()) {
-				String s = "ContinuedFractionCollection::acc...(...)";
-				s += " vectors must be of same length\n";
-				throw RuntimeError(s.c_str());
-			}
-		}
-		for (SizeType i=0;i<v1.size();i++) {
-
-			if (wasEmpty) {
-				v1[i].first = v2[i].first;
-				v1[i].second = v2[i].second;
-			} else {
-				if (v1[i].first!=v2[i].first)
-					throw RuntimeError("CF: x coordinate different\n");
-				v1[i].second += v2[i].second;
-			}
+	class PlotHelper {
+
+	public:
+
+		PlotHelper(const VectorContinuedFractionType& data,
+		           const VectorComplexType& z,
+		           VectorComplexType& sums)
+		    : data_(data),z_(z),sums_(sums)
+		{}
+
+		SizeType tasks() const { return (z_.size() + CHUNK - 1)/CHUNK; }
+
+		void doTask(SizeType taskNumber, SizeType)
+		{
+			SizeType start = taskNumber*CHUNK;
+			SizeType n = std::min(static_cast<SizeType>(CHUNK),
+			                      static_cast<SizeType>(z_.size() - start));
+			for (SizeType i = 0; i < data_.size(); ++i)
+				data_[i].addIOfOmega(&sums_[start],
+				                     &z_[start],
+				                     n,
+				                     data_[i].energy(),
+				                     data_[i].isign());
 		}
-	}
+
+	private:
+
+		const VectorContinuedFractionType& data_;
+		const VectorComplexType& z_;
+		VectorComplexType& sums_;
+	}; // class PlotHelper
 
 	FreqEnum freqEnum_;
 	ProgressIndicator progress_;
-	typename Vector<ContinuedFractionType>::Type data_;
+	VectorContinuedFractionType data_;
 }; // class ContinuedFractionCollection
 } // namespace PsimagLite
 /*@}*/
@@ -81,12 +81,17 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #ifndef CRSMATRIX_HEADER_H
 #define CRSMATRIX_HEADER_H
 #include <algorithm>
+#include <climits>
 #include "BLAS.h"
 #include "Matrix.h"
 #include "Complex.h"
 #include <cassert>
 #include "loki/TypeTraits.h"
+#include "loki/TypeManip.h"
 #include "Mpi.h"
+#include "CrsMatrixVectorProduct.h"
+#include "CrsMatrixBlockProduct.h"
+#include "CrsMatrixSparseOps.h"
 
 namespace PsimagLite {
 
@@ -124,14 +129,37 @@ namespace PsimagLite {
 		colind = [ 0  4  0  1  5  1  2  3  0 ... 4  5  1  4  5 ]\\
 		rowptr = [ 0  2  5  8 12 16 19 ]\\
 	\end{tt}
+
+	IndexType is the type of $rowptr$, and of positions in $values$; use a
+	64-bit type, such as long, for matrices with more than $2^{31}$ non-zeros.
+	Columns are always int. The companion functions below take any
+	IndexType.
+
+	compressColumns() replaces $colind$ by 16-bit differences of the
+	columns with the row index, which the vector and block products read;
+	see CrsMatrixVectorProduct.h.
 	*/
-template<class T>
+template<class T, typename IndexType_ = int>
 class CrsMatrix {
 
+public:
+
+	typedef IndexType_ IndexType;
+
+private:
+
+	typedef typename Vector<IndexType>::Type VectorIndexType;
+	typedef Vector<int>::Type VectorIntType;
+	typedef Vector<short>::Type VectorDeltaType;
+
 public:
 
 	typedef T MatrixElementType;
 	typedef T value_type;
+	// type of nonZeros(), SizeType unless IndexType is wider
+	typedef typename Loki::Select<(sizeof(IndexType) > sizeof(SizeType)),
+	IndexType,
+	SizeType>::Result NonzerosType;
 
 	CrsMatrix() : nrow_(0),ncol_(0) { }
 
@@ -144,28 +172,30 @@ public:
 	}
 
 	template<typename S>
-	CrsMatrix(const CrsMatrix<S>& a)
+	CrsMatrix(const CrsMatrix<S,IndexType>& a)
 	{
 		colind_=a.colind_;
 		rowptr_=a.rowptr_;
 		values_=a.values_;
 		nrow_ = a.nrow_;
 		ncol_ = a.ncol_;
+		colDeltas_ = a.colDeltas_;
 	}
 
 	template<typename S>
-	CrsMatrix(const CrsMatrix<std::complex<S> >& a)
+	CrsMatrix(const CrsMatrix<std::complex<S>,IndexType>& a)
 	{
 		colind_=a.colind_;
 		rowptr_=a.rowptr_;
 		values_=a.values_;
 		nrow_ = a.nrow_;
 		ncol_ = a.ncol_;
+		colDeltas_ = a.colDeltas_;
 	}
 
 	explicit CrsMatrix(const Matrix<T>& a)
 	{
-		int counter=0;
+		IndexType counter=0;
 		double eps = 0;
 
 		resize(a.rows(),a.cols());
@@ -227,9 +257,13 @@ public:
 		end = reinterpret_cast<const char *>(&ncol_);
 		total += mres.memResolv(&nrow_, end-start, str + " nrow");
 
-		total += mres.memResolv(&ncol_,
+		start = end;
+		end = reinterpret_cast<const char *>(&colDeltas_);
+		total += mres.memResolv(&ncol_, end-start, str + " ncol");
+
+		total += mres.memResolv(&colDeltas_,
 		                        sizeof(*this) - total,
-		                        str + " ncol");
+		                        str + " colDeltas");
 
 		return total;
 	}
@@ -237,6 +271,7 @@ public:
 	void resize(SizeType nrow,SizeType ncol)
 	{
 		colind_.clear();
+		colDeltas_.clear();
 		values_.clear();
 		rowptr_.clear();
 		rowptr_.resize(nrow+1);
@@ -247,29 +282,31 @@ public:
 	void clear()
 	{
 		colind_.clear();
+		colDeltas_.clear();
 		values_.clear();
 		rowptr_.clear();
 		nrow_=ncol_=0;
 	}
 
-	void resize(SizeType nrow,SizeType ncol,SizeType nonzero)
+	void resize(SizeType nrow,SizeType ncol,IndexType nonzero)
 	{
 		resize(nrow,ncol);
 		colind_.resize(nonzero);
 		values_.resize(nonzero);
 	}
 
-	void setRow(SizeType n,SizeType v)
+	void setRow(SizeType n,IndexType v)
 	{
 		assert(n<rowptr_.size());
 		rowptr_[n]=v;
 	}
 
-	void setCol(int n,int v) {
+	void setCol(IndexType n,int v) {
+		if (colDeltas_.size() > 0) expandColumns();
 		colind_[n]=v;
 	}
 
-	void setValues(int n,const T &v) {
+	void setValues(IndexType n,const T &v) {
 		values_[n]=v;
 	}
 
@@ -279,13 +316,23 @@ public:
 	}
 
 
-	bool operator==(const CrsMatrix<T>& op) const
+	// compressed and plain columns compare equal if they are the same columns
+	bool operator==(const CrsMatrix& op) const
 	{
-		return (nrow_ == op.nrow_ &&
-		        ncol_ == op.ncol_ &&
-		        rowptr_ == op.rowptr_ &&
-		        colind_ == op.colind_ &&
-		        values_ == op.values_);
+		if (nrow_ != op.nrow_ ||
+		        ncol_ != op.ncol_ ||
+		        rowptr_ != op.rowptr_ ||
+		        values_ != op.values_)
+			return false;
+
+		if (columnsCompressed() == op.columnsCompressed())
+			return (colind_ == op.colind_ && colDeltas_ == op.colDeltas_);
+
+		for (SizeType i = 0; i < nrow_; ++i)
+			for (IndexType k = rowptr_[i]; k < rowptr_[i + 1]; ++k)
+				if (column(i,k) != op.column(i,k)) return false;
+
+		return true;
 	}
 
 	template<typename VerySparseMatrixType>
@@ -296,10 +343,10 @@ public:
 			throw RuntimeError("CrsMatrix: VerySparseMatrix must be sorted\n");
 
 		clear();
-		SizeType nonZeros = m.nonZero();
+		IndexType nonZeros = m.nonZero();
 		resize(m.rows(),m.cols(),nonZeros);
 
-		SizeType counter=0;
+		IndexType counter=0;
 		for (SizeType i=0;i<m.rows();++i) {
 			setRow(i,counter);
 
@@ -324,11 +371,51 @@ public:
 
 	T element(int i,int j) const
 	{
-		for (int k=rowptr_[i];k<rowptr_[i+1];k++) if (colind_[k]==j) return values_[k];
+		for (IndexType k=rowptr_[i];k<rowptr_[i+1];k++) if (column(i,k)==j) return values_[k];
 		return static_cast<T>(0.0);
 	}
 
-	SizeType nonZeros() const { return colind_.size(); }
+	NonzerosType nonZeros() const { return values_.size(); }
+
+	/** Stores the columns as 16-bit differences with the row instead of
+		 ** as int, and frees the int columns; returns false, and changes
+		 ** nothing, if a difference does not fit in 16 bits. Call it once
+		 ** the matrix is built: the products read the differences, getCol()
+		 ** needs a bisection of the rows, and setCol() and pushCol() call
+		 ** expandColumns() first */
+	bool compressColumns()
+	{
+		if (columnsCompressed()) return true;
+
+		VectorDeltaType deltas(colind_.size());
+		for (SizeType i = 0; i < nrow_; ++i) {
+			for (IndexType k = rowptr_[i]; k < rowptr_[i + 1]; ++k) {
+				int delta = colind_[k] - static_cast<int>(i);
+				if (delta < SHRT_MIN || delta > SHRT_MAX) return false;
+				deltas[k] = delta;
+			}
+		}
+
+		colDeltas_.swap(deltas);
+		VectorIntType().swap(colind_);
+		return true;
+	}
+
+	//! Undoes compressColumns()
+	void expandColumns()
+	{
+		if (!columnsCompressed()) return;
+
+		VectorIntType colind(colDeltas_.size());
+		for (SizeType i = 0; i < nrow_; ++i)
+			for (IndexType k = rowptr_[i]; k < rowptr_[i + 1]; ++k)
+				colind[k] = column(i,k);
+
+		colind_.swap(colind);
+		VectorDeltaType().swap(colDeltas_);
+	}
+
+	bool columnsCompressed() const { return colDeltas_.size() > 0; }
 
 	/** performs x = x + A * y
 		 ** where x and y are vectors and A is a sparse matrix in
@@ -337,26 +424,54 @@ public:
 	void matrixVectorProduct(VectorLikeType& x, const VectorLikeType& y) const
 	{
 		assert(x.size()==y.size());
-		for (SizeType i = 0; i < y.size(); i++) {
-			assert(i+1<rowptr_.size());
-			for (int j = rowptr_[i]; j < rowptr_[i + 1]; j++) {
-				assert(SizeType(j)<values_.size());
-				assert(SizeType(j)<colind_.size());
-				assert(SizeType(colind_[j])<y.size());
-				x[i] += values_[j] * y[colind_[j]];
-			}
-		}
+		CrsMatrixVectorProduct<T, VectorLikeType, IndexType>::product(x,
+		                                                              y,
+		                                                              rowptr_,
+		                                                              colind_,
+		                                                              colDeltas_,
+		                                                              values_,
+		                                                              y.size());
+	}
+
+	/** performs x = x + A * y for a block of vectors, where
+		 ** vector c is row c of x and of y (both p x cols()), so
+		 ** that A is read once for the whole block */
+	void matrixBlockProduct(Matrix<T>& x, const Matrix<T>& y) const
+	{
+		assert(x.rows() == y.rows());
+		assert(x.cols() == nrow_ && y.cols() == ncol_);
+		CrsMatrixBlockProduct<T, IndexType>::product(x,
+		                                             y,
+		                                             rowptr_,
+		                                             colind_,
+		                                             colDeltas_,
+		                                             values_,
+		                                             nrow_);
+	}
+
+	//! Fills d with the real part of the diagonal of this matrix
+	template<typename SomeVectorType>
+	void fullDiag(SomeVectorType& d) const
+	{
+		assert(nrow_ == ncol_);
+		d.resize(nrow_);
+		for (SizeType i = 0; i < nrow_; ++i)
+			d[i] = PsimagLite::real(element(i,i));
 	}
 
 #ifndef NO_DEPRECATED_ALLOWED
-	int nonZero() const { return colind_.size(); } // DEPRECATED, use nonZeros()
+	int nonZero() const { return values_.size(); } // DEPRECATED, use nonZeros()
 #endif
 
 	SizeType rows() const { return nrow_; }
 
 	SizeType cols() const { return ncol_; }
 
-	void pushCol(SizeType i) { colind_.push_back(i); }
+	void pushCol(SizeType i)
+	{
+		if (colDeltas_.size() > 0) expandColumns();
+		colind_.push_back(i);
+	}
 
 	void pushValue(T const &value) { values_.push_back(value); }
 
@@ -368,6 +483,7 @@ public:
 		rowptr_.resize(row+1);
 		values_.resize(row);
 		colind_.resize(row);
+		colDeltas_.clear();
 
 		for (SizeType i=0;i<row;i++) {
 			values_[i]=value;
@@ -377,11 +493,31 @@ public:
 		rowptr_[row]=row;
 	}
 
-	const int& getRowPtr(SizeType i) const { assert(i<rowptr_.size()); return rowptr_[i]; }
+	const IndexType& getRowPtr(SizeType i) const
+	{
+		assert(i<rowptr_.size());
+		return rowptr_[i];
+	}
+
+	int getCol(IndexType i) const
+	{
+		if (!columnsCompressed()) {
+			assert(static_cast<typename VectorIndexType::size_type>(i)<colind_.size());
+			return colind_[i];
+		}
 
-	const int& getCol(SizeType i) const { assert(i<colind_.size()); return colind_[i]; }
+		// the row of entry i is the last one that starts at or before i
+		assert(static_cast<typename VectorIndexType::size_type>(i)<colDeltas_.size());
+		SizeType row = std::upper_bound(rowptr_.begin(), rowptr_.end(), i)
+		        - rowptr_.begin() - 1;
+		return column(row,i);
+	}
 
-	const T& getValue(SizeType i) const { assert(i<values_.size()); return values_[i]; }
+	const T& getValue(IndexType i) const
+	{
+		assert(static_cast<typename VectorIndexType::size_type>(i)<values_.size());
+		return values_[i];
+	}
 
 	Matrix<T> toDense() const
 	{
@@ -398,8 +534,9 @@ public:
 		assert(nrow_>0 && ncol_>0);
 		for (SizeType i=0;i<n;i++) {
 			typename Vector<SizeType>::Type p(ncol_,0);
-			for (int k=rowptr_[i];k<rowptr_[i+1];k++) {
-				SizeType col = colind_[k];
+			for (IndexType k=rowptr_[i];k<rowptr_[i+1];k++) {
+				SizeType col = column(i,k);
+				assert(col<ncol_);
 				assert(p[col]==0);
 				p[col] = 1;
 			}
@@ -460,6 +597,7 @@ public:
 		MPI::send(rowptr_,root,tag+2,mpiComm);
 		MPI::send(colind_,root,tag+3,mpiComm);
 		MPI::send(values_,root,tag+4,mpiComm);
+		MPI::send(colDeltas_,root,tag+5,mpiComm);
 	}
 
 	void recv(int root,int tag,MPI::CommType mpiComm)
@@ -469,6 +607,7 @@ public:
 		MPI::recv(rowptr_,root,tag+2,mpiComm);
 		MPI::recv(colind_,root,tag+3,mpiComm);
 		MPI::recv(values_,root,tag+4,mpiComm);
+		MPI::recv(colDeltas_,root,tag+5,mpiComm);
 	}
 
 	friend bool isZero(const CrsMatrix& A, double eps = 0.0)
@@ -482,11 +621,11 @@ public:
 		return true;
 	}
 
-	template<typename S>
-	friend typename Real<S>::Type norm2(const CrsMatrix<S>& m);
+	template<typename S, typename I>
+	friend typename Real<S>::Type norm2(const CrsMatrix<S,I>& m);
 
-	template<typename S>
-	friend std::ostream &operator<<(std::ostream &os,const CrsMatrix<S> &m);
+	template<typename S, typename I>
+	friend std::ostream &operator<<(std::ostream &os,const CrsMatrix<S,I> &m);
 
 	template<class S>
 	friend void difference(const CrsMatrix<S>& A,const CrsMatrix<S>& B);
@@ -500,16 +639,23 @@ public:
 	template<typename S>
 	friend void MpiRecv(CrsMatrix<S> *v,int iproc,int i);
 
-	template<typename CrsMatrixType>
-	friend std::istream &operator>>(std::istream &is,CrsMatrix<CrsMatrixType>& m);
+	template<typename S, typename I>
+	friend std::istream &operator>>(std::istream &is,CrsMatrix<S,I>& m);
 
-	template<typename S>
-	friend void bcast(CrsMatrix<S>& m);
+	template<typename S, typename I>
+	friend void bcast(CrsMatrix<S,I>& m);
 
 private:
 
+	// column of entry k, which is in row row
+	int column(SizeType row, IndexType k) const
+	{
+		return (colDeltas_.size() > 0) ? colDeltas_[k] + static_cast<int>(row)
+		                               : colind_[k];
+	}
+
 	template<typename T1>
-	void add(CrsMatrix<T>& c, const CrsMatrix<T>& m, const T1& t1) const
+	void add(CrsMatrix& c, const CrsMatrix& m, const T1& t1) const
 	{
 		assert(m.rows() == m.cols());
 		const T1 one = 1.0;
@@ -519,21 +665,23 @@ private:
 
 	//serializr start class CrsMatrix
 	//serializr normal rowptr_
-	typename Vector<int>::Type rowptr_;
+	VectorIndexType rowptr_;
 	//serializr normal colind_
-	typename Vector<int>::Type colind_;
+	VectorIntType colind_;
 	//serializr normal values_
 	typename Vector<T>::Type values_;
 	//serializr normal nrow_
 	SizeType nrow_;
 	//serializr normal ncol_
 	SizeType ncol_;
+	//serializr normal colDeltas_
+	VectorDeltaType colDeltas_;
 }; // class CrsMatrix
 
 // Companion functions below:
 
-template<typename T>
-std::ostream &operator<<(std::ostream &os,const CrsMatrix<T> &m)
+template<typename T, typename IndexType>
+std::ostream &operator<<(std::ostream &os,const CrsMatrix<T,IndexType> &m)
 {
 	SizeType n=m.rows();
 	if (n==0) {
@@ -545,20 +693,21 @@ std::ostream &operator<<(std::ostream &os,const CrsMatrix<T> &m)
 	for (SizeType i=0;i<n+1;i++) os<<m.rowptr_[i]<<" ";
 	os<<"\n";
 
-	SizeType nonzero=m.nonZero();
+	typename CrsMatrix<T,IndexType>::NonzerosType nonzero=m.nonZeros();
 	os<<nonzero<<"\n";
-	for (SizeType i=0;i<nonzero;i++) os<<m.colind_[i]<<" ";
+	for (SizeType i=0;i<n;i++)
+		for (IndexType k=m.rowptr_[i];k<m.rowptr_[i+1];k++) os<<m.column(i,k)<<" ";
 	os<<"\n";
 
 	os<<nonzero<<"\n";
-	for (SizeType i=0;i<nonzero;i++) os<<m.values_[i]<<" ";
+	for (IndexType i=0;i<IndexType(nonzero);i++) os<<m.values_[i]<<" ";
 	os<<"\n";
 
 	return os;
 }
 
-template<typename T>
-std::istream &operator>>(std::istream &is,CrsMatrix<T>& m)
+template<typename T, typename IndexType>
+std::istream &operator>>(std::istream &is,CrsMatrix<T,IndexType>& m)
 {
 	int n;
 	is>>n;
@@ -575,7 +724,7 @@ std::istream &operator>>(std::istream &is,CrsMatrix<T>& m)
 	m.resize(n,ncol);
 	for (SizeType i=0;i<m.rowptr_.size();i++) is>>m.rowptr_[i];
 
-	SizeType nonzero;
+	typename CrsMatrix<T,IndexType>::NonzerosType nonzero;
 	is>>nonzero;
 	m.colind_.resize(nonzero);
 	for (SizeType i=0;i<m.colind_.size();i++) is>>m.colind_[i];
@@ -587,30 +736,31 @@ std::istream &operator>>(std::istream &is,CrsMatrix<T>& m)
 	return is;
 }
 
-template<typename T>
-class IsMatrixLike<CrsMatrix<T> > {
+template<typename T, typename IndexType>
+class IsMatrixLike<CrsMatrix<T,IndexType> > {
 public:
 	enum { True = true};
 };
 
-template<typename S>
-void bcast(CrsMatrix<S>& m)
+template<typename S, typename IndexType>
+void bcast(CrsMatrix<S,IndexType>& m)
 {
 	MPI::bcast(m.rowptr_);
 	MPI::bcast(m.colind_);
 	MPI::bcast(m.values_);
 	MPI::bcast(m.nrow_);
 	MPI::bcast(m.ncol_);
+	MPI::bcast(m.colDeltas_);
 }
 
 //! Transforms a Compressed-Row-Storage (CRS) into a full Matrix (Fast version)
-template<typename T>
-void crsMatrixToFullMatrix(Matrix<T>& m,const CrsMatrix<T>& crsMatrix)
+template<typename T, typename IndexType>
+void crsMatrixToFullMatrix(Matrix<T>& m,const CrsMatrix<T,IndexType>& crsMatrix)
 {
 	m.reset(crsMatrix.rows(),crsMatrix.cols());
 	for (SizeType i = 0; i < crsMatrix.rows() ; i++) {
 		for (SizeType k=0;k<crsMatrix.cols();k++) m(i,k)=0;
-		for (int k=crsMatrix.getRowPtr(i);k<crsMatrix.getRowPtr(i+1);k++)
+		for (IndexType k=crsMatrix.getRowPtr(i);k<crsMatrix.getRowPtr(i+1);k++)
 			m(i,crsMatrix.getCol(k))=crsMatrix.getValue(k);
 	}
 
@@ -618,12 +768,12 @@ void crsMatrixToFullMatrix(Matrix<T>& m,const CrsMatrix<T>& crsMatrix)
 
 //! Transforms a full matrix into a Compressed-Row-Storage (CRS) Matrix
 // Use the constructor if possible
-template<typename T>
-void fullMatrixToCrsMatrix(CrsMatrix<T>& crsMatrix, const Matrix<T>& a)
+template<typename T, typename IndexType>
+void fullMatrixToCrsMatrix(CrsMatrix<T,IndexType>& crsMatrix, const Matrix<T>& a)
 {
 	crsMatrix.resize(a.rows(),a.cols());
 
-	SizeType counter = 0;
+	IndexType counter = 0;
 	for (SizeType i = 0; i < a.rows(); i++) {
 		crsMatrix.setRow(i,counter);
 		for (SizeType j=0;j<a.cols();j++) {
@@ -645,119 +795,45 @@ void fullMatrixToCrsMatrix(CrsMatrix<T>& crsMatrix, const Matrix<T>& a)
 		where na=rank(A)
 	  */
 
-template<typename T,typename VectorLikeType>
+template<typename T,typename IndexType,typename VectorLikeType>
 typename EnableIf<IsVectorLike<VectorLikeType>::True &&
 Loki::TypeTraits<typename VectorLikeType::value_type>::isFloat,
 void>::Type
-externalProduct(CrsMatrix<T>& B,
-                const CrsMatrix<T>& A,
+externalProduct(CrsMatrix<T,IndexType>& B,
+                const CrsMatrix<T,IndexType>& A,
                 int nout,
                 const VectorLikeType& signs,
                 bool order=true)
 {
-	int na=A.rows();
-	T tmp;
 	assert(A.rows()==A.cols());
-	B.resize(na*nout,na*nout);
-
-	int i,ii,jj,alpha,k,j,beta;
-	int counter=0;
-	for (ii=0;ii<na*nout;ii++) {
-		if (order) {
-			// ii = i+alpha*na;
-			alpha = int(ii/na);
-			i = ii-alpha*na;
-		} else {
-			//ii = alpha + i*nout;
-			i = int(ii/nout);
-			alpha = ii - i*nout;
-		}
-		B.setRow(ii,counter);
-		for (k=A.getRowPtr(i);k<A.getRowPtr(i+1);k++) {
-			j = A.getCol(k);
-			beta=alpha;
-			if (order) jj = j+beta*na;
-			else       jj = beta+j*nout;
-			//B.setCol(counter,jj);
-			B.pushCol(jj);
-			tmp = A.getValue(k);
-			if (!order) tmp*=signs[alpha];
-			//B.setValues(counter,tmp);
-			B.pushValue(tmp);
-			counter++;
-		}
-	}
-	B.setRow(na*nout,counter);
+	CrsMatrixKronecker<CrsMatrix<T,IndexType> >::identity(B,A,nout,signs,order);
 }
 
 //! Computes C = A external product B
-template<class T>
-void externalProduct(CrsMatrix<T>  &C,CrsMatrix<T> const &A,CrsMatrix<T> const &B)
+//! C(alpha + beta*na, a + b*A.cols()) = A(alpha,a)*B(beta,b), na = A.rows()
+template<class T, typename IndexType>
+void externalProduct(CrsMatrix<T,IndexType>  &C,
+                     CrsMatrix<T,IndexType> const &A,
+                     CrsMatrix<T,IndexType> const &B)
 {
-	assert(A.row()==A.col());
-	assert(B.row()==B.col());
-	int n=A.getSize()*B.getSize();
-	C.resize(n);
-	int na = A.getSize();
-	T tmp;
-	int i,k,kk,alpha,beta,j,counter=0;
-
-	for (i=0;i<n;i++) {
-		C.setRow(i,counter);
-		// i = alpha + beta * na
-		beta = int(i/na);
-		alpha = i - beta * na;
-		for (k=A.getRowPtr(alpha);k<A.getRowPtr(alpha+1);k++) {
-			for (kk=B.getRowPtr(beta);kk<B.getRowPtr(beta+1);kk++) {
-				j = A.getCol(k) + B.getCol(kk) *na;
-				C.pushCol(j);
-				tmp = A.getValue(k) * B.getValue(kk);
-				C.pushValue(tmp);
-				counter++;
-			}
-		}
-	}
-	C.setRow(n,counter);
+	typename Vector<int>::Type noSigns;
+	CrsMatrixKronecker<CrsMatrix<T,IndexType> >::template product<int>(C,A,B,noSigns,false);
 }
 
 //! Computes C = A external product B (with signs)
-template<class T>
-void externalProduct(CrsMatrix<T>  &C,
-                     CrsMatrix<T> const &A,
-                     CrsMatrix<T> const &B,
+//! times signs[alpha], or signs[beta] if option is true
+template<class T, typename IndexType>
+void externalProduct(CrsMatrix<T,IndexType>  &C,
+                     CrsMatrix<T,IndexType> const &A,
+                     CrsMatrix<T,IndexType> const &B,
                      const typename Vector<int>::Type& signs,
                      bool option=false)
 {
-	assert(A.row()==A.col());
-	assert(B.row()==B.col());
-	int n=A.getSize()*B.getSize();
-	C.resize(n);
-	int na = A.getSize();
-	T tmp;
-	int i,k,kk,alpha,beta,j,counter=0;
-
-	for (i=0;i<n;i++) {
-		C.setRow(i,counter);
-		// i = alpha + beta * na
-		beta = int(i/na);
-		alpha = i - beta * na;
-		for (k=A.getRowPtr(alpha);k<A.getRowPtr(alpha+1);k++) {
-			for (kk=B.getRowPtr(beta);kk<B.getRowPtr(beta+1);kk++) {
-				j = A.getCol(k) + B.getCol(kk) *na;
-				C.pushCol(j);
-				int sign = signs[alpha];
-				if (option) sign=signs[beta];
-				tmp = A.getValue(k) * B.getValue(kk)*sign;
-				C.pushValue(tmp);
-				counter++;
-			}
-		}
-	}
-	C.setRow(n,counter);
+	CrsMatrixKronecker<CrsMatrix<T,IndexType> >::template product<int>(C,A,B,signs,option);
 }
 
-template<typename T>
-void printFullMatrix(const CrsMatrix<T>& s,
+template<typename T, typename IndexType>
+void printFullMatrix(const CrsMatrix<T,IndexType>& s,
                      const String& name,
                      SizeType how=0,
                      double eps = 1e-20)
@@ -778,153 +854,54 @@ void printFullMatrix(const CrsMatrix<T>& s,
 }
 
 //! C = A*B,  all matrices are CRS matrices
-//! idea is from http://web.maths.unsw.edu.au/~farid/Papers/Hons/node23.html
-template<typename S,typename S3,typename S2>
-void multiply(CrsMatrix<S> &C,
-              CrsMatrix<S3> const &A,
-              CrsMatrix<S2> const &B)
+//! Symbolic and numeric phases, threaded over rows of C, see CrsMatrixSparseOps.h;
+//! columns of each row of C are sorted
+template<typename S,typename I,typename S3,typename I3,typename S2,typename I2>
+void multiply(CrsMatrix<S,I> &C,
+              CrsMatrix<S3,I3> const &A,
+              CrsMatrix<S2,I2> const &B)
 {
-	int j,s,mlast,itemp,jbk;
-	SizeType n = A.rows();
-	typename Vector<int>::Type ptr(B.cols(),-1),index(B.cols(),0);
-	typename Vector<S>::Type temp(B.cols(),0);
-	S tmp;
-
-	C.resize(n,B.cols());
-
-	// mlast pointer to the last place we updated in the C vector
-	mlast = 0;
-	// for (SizeType l=0;l<n;l++) ptr[l] = -1;
-	// over the rows of A
-	for (SizeType i=0;i<n;i++) {
-		C.setRow(i,mlast);
-		// start calculations for row
-		itemp = 0;
-		for (j = A.getRowPtr(i);j< A.getRowPtr(i+1);j++) {
-			SizeType istart = B.getRowPtr(A.getCol(j));
-			SizeType iend = B.getRowPtr(A.getCol(j)+1);
-			for (SizeType k = istart; k< iend;k++) {
-				jbk=B.getCol(k);
-				tmp = A.getValue(j)*B.getValue(k);
-				if (ptr[jbk]<0) {
-					ptr[jbk] = itemp;
-					temp[ptr[jbk]] = tmp ;
-					index[ptr[jbk]] = jbk;
-					itemp++;
-				} else  {
-					temp[ptr[jbk]]+= tmp;
-				}
-			}
-		}
-		// before you leave this row update array c , jc
-		for (s=0;s<itemp;s++) {
-			C.pushValue(temp[s]);
-			C.pushCol(index[s]);
-			ptr[index[s]]= -1;
-		}
-		mlast += itemp;
-	}
-	C.setRow(n,mlast);
-	C.checkValidity();
+	CrsMatrixSparseProduct<CrsMatrix<S,I>,CrsMatrix<S3,I3>,CrsMatrix<S2,I2> >::multiply(C,A,B);
 }
 
 // vector2 = sparseMatrix * vector1
-template<class S>
+template<class S, typename IndexType>
 void multiply(typename Vector<S>::Type& v2,
-              const CrsMatrix<S>& m,
+              const CrsMatrix<S,IndexType>& m,
               const typename Vector<S>::Type& v1)
 {
 	SizeType n = m.rows();
 	v2.resize(n);
 	for (SizeType i=0;i<n;i++) {
 		v2[i]=0;
-		for (int j=m.getRowPtr(i);j<m.getRowPtr(i+1);j++) {
+		for (IndexType j=m.getRowPtr(i);j<m.getRowPtr(i+1);j++) {
 			v2[i] += m.getValue(j)*v1[m.getCol(j)];
 		}
 	}
 }
 
-//! Sets B=transpose(conjugate(A))
-template<typename S,typename S2>
-void transposeConjugate(CrsMatrix<S>& B, const CrsMatrix<S2>& A)
+//! Sets B=transpose(conjugate(A)), without the zeros of A
+template<typename S,typename I,typename S2,typename I2>
+void transposeConjugate(CrsMatrix<S,I>& B, const CrsMatrix<S2,I2>& A)
 {
-	SizeType n=A.rows();
-	Vector<Vector<int>::Type >::Type col(n);
-	typename Vector<typename Vector<S2>::Type>::Type value(n);
-
-	// B(j,i) = conj(A(i,j))
-	for (SizeType i=0;i<n;i++) {
-		for (int k=A.getRowPtr(i);k<A.getRowPtr(i+1);k++) {
-			col[A.getCol(k)].push_back(i);
-			S2 w = A.getValue(k);
-			value[A.getCol(k)].push_back(w);
-		}
-	}
-
-	B.resize(A.cols(),A.rows());
-
-	SizeType counter=0;
-	for (SizeType i=0; i<B.rows(); ++i) {
-
-		B.setRow(i,counter);
-		for (SizeType j=0;j<col[i].size();j++) {
-			if (value[i][j]==static_cast<S>(0.0)) continue;
-			B.pushCol(col[i][j]);
-			B.pushValue(PsimagLite::conj(value[i][j]));
-			counter++;
-		}
-	}
-
-	B.setRow(B.rows(),counter);
+	CrsMatrixTranspose<CrsMatrix<S,I>,CrsMatrix<S2,I2> >::transposeConjugate(B,A,true);
 }
 
-//! Sets B=transpose(conjugate(A))
-template<typename S,typename S2>
-void transposeConjugate(CrsMatrix<S>& B,
-                        const CrsMatrix<S2>& A,
-                        typename Vector<typename Vector<int>::Type >::Type& col,
-                        typename Vector<typename Vector<S2>::Type >::Type& value)
+//! Sets B=transpose(conjugate(A)), zeros included
+//! (the last two arguments were scratch space, and are no longer used)
+template<typename S,typename I,typename S2,typename I2>
+void transposeConjugate(CrsMatrix<S,I>& B,
+                        const CrsMatrix<S2,I2>& A,
+                        typename Vector<typename Vector<int>::Type >::Type&,
+                        typename Vector<typename Vector<S2>::Type >::Type&)
 {
-	SizeType n=A.rows();
-	assert(col.size()==n);
-	assert(value.size()==n);
-	for (SizeType i=0;i<n;i++) {
-		col[i].clear();
-		value[i].clear();
-	}
-
-	// B(j,i) = conj(A(i,j))
-	SizeType counter=0;
-	for (SizeType i=0;i<n;i++) {
-		for (int k=A.getRowPtr(i);k<A.getRowPtr(i+1);k++) {
-			col[A.getCol(k)].push_back(i);
-			S2 w = A.getValue(k);
-			value[A.getCol(k)].push_back(w);
-			counter++;
-		}
-	}
-
-	B.clear();
-	B.resize(A.cols(),A.rows(),counter);
-
-	counter=0;
-	for (SizeType i=0;i<B.rows();i++) {
-
-		B.setRow(i,counter);
-		for (SizeType j=0;j<col[i].size();j++) {
-			B.setCol(counter,col[i][j]);
-			B.setValues(counter,PsimagLite::conj(value[i][j]));
-			counter++;
-		}
-	}
-
-	B.setRow(B.rows(),counter);
+	CrsMatrixTranspose<CrsMatrix<S,I>,CrsMatrix<S2,I2> >::transposeConjugate(B,A,false);
 }
 
 //! Sets A = B(i,perm(j)), A and B CRS matrices
-template<class S>
-void permute(CrsMatrix<S>& A,
-             const CrsMatrix<S>& B,
+template<class S, typename IndexType>
+void permute(CrsMatrix<S,IndexType>& A,
+             const CrsMatrix<S,IndexType>& B,
              const Vector<SizeType>::Type& perm)
 {
 	SizeType  n = B.rows();
@@ -936,10 +913,10 @@ void permute(CrsMatrix<S>& A,
 	assert(perm.size() == permInverse.size());
 	for (SizeType i=0;i<n;i++) permInverse[perm[i]]=i;
 
-	SizeType counter=0;
+	IndexType counter=0;
 	for (SizeType i=0;i<n;i++) {
 		A.setRow(i,counter);
-		for (int k=B.getRowPtr(i);k<B.getRowPtr(i+1);k++) {
+		for (IndexType k=B.getRowPtr(i);k<B.getRowPtr(i+1);k++) {
 			A.pushCol(permInverse[B.getCol(k)]);
 			S tmp = B.getValue(k);
 			A.pushValue(tmp);
@@ -951,20 +928,20 @@ void permute(CrsMatrix<S>& A,
 }
 
 //! Sets A = B(perm(i),j), A and B CRS matrices
-template<class S>
-void permuteInverse(CrsMatrix<S>& A,
-                    const CrsMatrix<S>& B,
+template<class S, typename IndexType>
+void permuteInverse(CrsMatrix<S,IndexType>& A,
+                    const CrsMatrix<S,IndexType>& B,
                     const Vector<SizeType>::Type& perm)
 {
 	SizeType n = B.rows();
 	A.resize(n,B.cols());
 	assert(B.rows()==B.cols());
 
-	SizeType counter=0;
+	IndexType counter=0;
 	for (SizeType i=0;i<n;i++) {
 		SizeType ii = perm[i];
 		A.setRow(i,counter);
-		for (int k=B.getRowPtr(ii);k<B.getRowPtr(ii+1);k++) {
+		for (IndexType k=B.getRowPtr(ii);k<B.getRowPtr(ii+1);k++) {
 			A.pushCol(B.getCol(k));
 			S tmp = B.getValue(k);
 			A.pushValue(tmp);
@@ -975,11 +952,11 @@ void permuteInverse(CrsMatrix<S>& A,
 }
 
 //! Sets A=B*b1+C*c1, restriction: B.size has to be larger or equal than C.size
-template<typename T, typename T1>
-void operatorPlus(CrsMatrix<T>& A,
-                  const CrsMatrix<T>& B,
+template<typename T, typename IndexType, typename T1>
+void operatorPlus(CrsMatrix<T,IndexType>& A,
+                  const CrsMatrix<T,IndexType>& B,
                   T1& b1,
-                  const CrsMatrix<T>& C,
+                  const CrsMatrix<T,IndexType>& C,
                   T1& c1)
 {
 	SizeType n = B.rows();
@@ -994,45 +971,47 @@ void operatorPlus(CrsMatrix<T>& A,
 	typename Vector<int>::Type index;
 	A.resize(n,B.cols());
 
-	SizeType counter=0;
+	IndexType counter=0;
 	for (SizeType k2=0;k2<n;k2++) valueTmp[k2]= static_cast<T>(0.0);
 
 	for (SizeType i = 0; i < n; i++) {
-		int k;
+		IndexType k;
 		A.setRow(i,counter);
 
 		if (i<C.rows()) {
 			// inspect this
 			index.clear();
 			for (k=B.getRowPtr(i);k<B.getRowPtr(i+1);k++) {
-				if (B.getCol(k)<0 || SizeType(B.getCol(k))>=n)
+				int col = B.getCol(k);
+				if (col<0 || SizeType(col)>=n)
 					throw RuntimeError("operatorPlus (1)\n");
-				valueTmp[B.getCol(k)]=B.getValue(k)*b1;
-				index.push_back(B.getCol(k));
+				valueTmp[col]=B.getValue(k)*b1;
+				index.push_back(col);
 			}
 
 			// inspect C
 			for (k=C.getRowPtr(i);k<C.getRowPtr(i+1);k++) {
 				tmp = C.getValue(k)*c1;
-				if (C.getCol(k)>=int(valueTmp.size()) || C.getCol(k)<0)
+				int col = C.getCol(k);
+				if (col>=int(valueTmp.size()) || col<0)
 					throw RuntimeError("operatorPlus (2)\n");
 
-				valueTmp[C.getCol(k)] += tmp;
-				index.push_back(C.getCol(k));
+				valueTmp[col] += tmp;
+				index.push_back(col);
 			}
 			std::sort(index.begin(),index.end());
-			k= -1;
+			int col = -1;
 			for (SizeType kk=0;kk<index.size();kk++) {
-				if (k==index[kk]) continue;
-				k=index[kk];
-				if (k<0 || SizeType(k)>=n)
+				if (col==index[kk]) continue;
+				col=index[kk];
+				if (col<0 || SizeType(col)>=n)
 					throw RuntimeError("operatorPlus (3)\n");
-				tmp = valueTmp[k];
+				tmp = valueTmp[col];
 				if (tmp!=static_cast<T>(0.0)) {
-					A.pushCol(k);
+					A.pushCol(col);
 					A.pushValue(tmp);
 					counter++;
-					valueTmp[k]=static_cast<T>(0.0);
+					valueTmp[col]=static_cast<T>(0.0);
 				}
 			}
 		} else {
@@ -1048,12 +1027,12 @@ void operatorPlus(CrsMatrix<T>& A,
 	A.setRow(n,counter);
 }
 
-template<typename T>
-bool isHermitian(const CrsMatrix<T>& A,bool=false)
+template<typename T, typename IndexType>
+bool isHermitian(const CrsMatrix<T,IndexType>& A,bool=false)
 {
 	if (A.rows()!=A.cols()) return false;
 	for (SizeType i=0;i<A.rows();i++) {
-		for (int k=A.getRowPtr(i);k<A.getRowPtr(i+1);k++) {
+		for (IndexType k=A.getRowPtr(i);k<A.getRowPtr(i+1);k++) {
 			if (PsimagLite::norm(A.getValue(k)-PsimagLite::conj(A.element(A.getCol(k),i)))<1e-6)
 				continue;
 			assert(false);
@@ -1063,18 +1042,18 @@ bool isHermitian(const CrsMatrix<T>& A,bool=false)
 	return true;
 }
 
-template<class T>
-void sumBlock(CrsMatrix<T> &A,CrsMatrix<T> const &B,SizeType offset)
+template<class T, typename IndexType>
+void sumBlock(CrsMatrix<T,IndexType> &A,CrsMatrix<T,IndexType> const &B,SizeType offset)
 {
-	int counter=0;
-	CrsMatrix<T> Bfull(A.rows(),A.cols());
+	IndexType counter=0;
+	CrsMatrix<T,IndexType> Bfull(A.rows(),A.cols());
 
 	for (SizeType i=0;i<offset;i++) Bfull.setRow(i,counter);
 
 	for (SizeType ii=0;ii<B.rows();ii++) {
 		SizeType i=ii+offset;
 		Bfull.setRow(i,counter);
-		for (int jj=B.getRowPtr(ii);jj<B.getRowPtr(ii+1);jj++) {
+		for (IndexType jj=B.getRowPtr(ii);jj<B.getRowPtr(ii+1);jj++) {
 			SizeType j = B.getCol(jj)+offset;
 			T tmp  = B.getValue(jj);
 			Bfull.pushCol(j);
@@ -1090,14 +1069,14 @@ void sumBlock(CrsMatrix<T> &A,CrsMatrix<T> const &B,SizeType offset)
 	A.checkValidity();
 }
 
-template<class T>
-bool isDiagonal(const CrsMatrix<T>& A,double eps=1e-6,bool checkForIdentity=false)
+template<class T, typename IndexType>
+bool isDiagonal(const CrsMatrix<T,IndexType>& A,double eps=1e-6,bool checkForIdentity=false)
 {
 	if (A.rows()!=A.cols()) return false;
 	SizeType n = A.rows();
 	const T f1 = (-1.0);
 	for (SizeType i=0;i<n;i++) {
-		for (int k=A.getRowPtr(i);k<A.getRowPtr(i+1);k++) {
+		for (IndexType k=A.getRowPtr(i);k<A.getRowPtr(i+1);k++) {
 			SizeType col = A.getCol(k);
 			const T& val = A.getValue(k);
 			if (checkForIdentity && col==i && PsimagLite::norm(val + f1)>eps) {
@@ -1111,14 +1090,14 @@ bool isDiagonal(const CrsMatrix<T>& A,double eps=1e-6,bool checkForIdentity=fals
 	return true;
 }
 
-template<class T>
-bool isTheIdentity(const CrsMatrix<T>& A,double eps=1e-6)
+template<class T, typename IndexType>
+bool isTheIdentity(const CrsMatrix<T,IndexType>& A,double eps=1e-6)
 {
 	return isDiagonal(A,eps,true);
 }
 
-template<typename T>
-typename Real<T>::Type norm2(const CrsMatrix<T>& m)
+template<typename T, typename IndexType>
+typename Real<T>::Type norm2(const CrsMatrix<T,IndexType>& m)
 {
 	T val = 0;
 	for (SizeType i=0;i<m.values_.size();i++)
@@ -1127,11 +1106,11 @@ typename Real<T>::Type norm2(const CrsMatrix<T>& m)
 	return PsimagLite::real(val);
 }
 
-template<typename T>
-Matrix<T> multiplyTc(const CrsMatrix<T>& a,const CrsMatrix<T>& b)
+template<typename T, typename IndexType>
+Matrix<T> multiplyTc(const CrsMatrix<T,IndexType>& a,const CrsMatrix<T,IndexType>& b)
 {
 
-	CrsMatrix<T> bb,c;
+	CrsMatrix<T,IndexType> bb,c;
 	transposeConjugate(bb,b);
 	multiply(c,a,bb);
 	Matrix<T> cc;
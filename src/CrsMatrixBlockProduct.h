@@ -0,0 +1,277 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file CrsMatrixBlockProduct.h
+ *
+ *  Row kernel and pthreads helper for CrsMatrix::matrixBlockProduct
+ *
+ *  A block of p vectors is stored as a p x n Matrix, so that vector c
+ *  is row c and the p entries that multiply one non-zero are contiguous.
+ *  Each non-zero of the sparse matrix is then read once for the whole
+ *  block instead of once per vector. Rows are split among threads as
+ *  in CrsMatrixVectorProduct, and IndexType is the type of the row
+ *  pointers, as there. Offset columns (colDeltas) are read as there.
+ */
+#ifndef PSI_CRSMATRIX_BLOCK_PRODUCT_H
+#define PSI_CRSMATRIX_BLOCK_PRODUCT_H
+#include <cassert>
+#include "Matrix.h"
+#include "Concurrency.h"
+#include "CrsMatrixVectorProduct.h"
+#ifdef USE_PTHREADS
+#include "PthreadsNg.h"
+#endif
+
+namespace PsimagLite {
+
+template<typename T, typename IndexType = int>
+class CrsMatrixBlockProduct {
+
+public:
+
+	typedef typename Vector<IndexType>::Type VectorIndexType;
+	typedef Vector<int>::Type VectorIntType;
+	typedef Vector<short>::Type VectorDeltaType;
+	typedef typename Vector<T>::Type VectorType;
+	typedef Vector<SizeType>::Type VectorSizeType;
+	typedef Matrix<T> BlockType;
+	typedef CrsMatrixVectorProduct<T, VectorType, IndexType> CrsMatrixVectorProductType;
+
+	CrsMatrixBlockProduct(BlockType& x,
+	                      const BlockType& y,
+	                      const VectorIndexType& rowptr,
+	                      const VectorIntType& colind,
+	                      const VectorDeltaType& colDeltas,
+	                      const VectorType& values,
+	                      SizeType rows,
+	                      SizeType chunks)
+	    : x_(x),
+	      y_(y),
+	      rowptr_(rowptr),
+	      colind_(colind),
+	      colDeltas_(colDeltas),
+	      values_(values),
+	      chunkStart_()
+	{
+		CrsMatrixVectorProductType::nonzeroChunks(chunkStart_, rowptr, rows, chunks);
+	}
+
+	SizeType tasks() const { return chunkStart_.size() - 1; }
+
+	void doTask(SizeType taskNumber, SizeType)
+	{
+		assert(taskNumber + 1 < chunkStart_.size());
+		rows(x_,
+		     y_,
+		     rowptr_,
+		     colind_,
+		     colDeltas_,
+		     values_,
+		     chunkStart_[taskNumber],
+		     chunkStart_[taskNumber + 1]);
+	}
+
+	// x(c,i) += sum_j A(i,j) y(c,j) for start <= i < end and all c;
+	// columns are i + colDeltas[j] if colDeltas is not empty
+	static void rows(BlockType& x,
+	                 const BlockType& y,
+	                 const VectorIndexType& rowptr,
+	                 const VectorIntType& colind,
+	                 const VectorDeltaType& colDeltas,
+	                 const VectorType& values,
+	                 SizeType start,
+	                 SizeType end)
+	{
+		assert(y.rows() == x.rows());
+		switch (x.rows()) {
+		case 0:
+			return;
+		case 1:
+			return rowsFixed<1>(x, y, rowptr, colind, colDeltas, values, start, end);
+		case 2:
+			return rowsFixed<2>(x, y, rowptr, colind, colDeltas, values, start, end);
+		case 3:
+			return rowsFixed<3>(x, y, rowptr, colind, colDeltas, values, start, end);
+		case 4:
+			return rowsFixed<4>(x, y, rowptr, colind, colDeltas, values, start, end);
+		case 6:
+			return rowsFixed<6>(x, y, rowptr, colind, colDeltas, values, start, end);
+		case 8:
+			return rowsFixed<8>(x, y, rowptr, colind, colDeltas, values, start, end);
+		default:
+			break;
+		}
+
+		const SizeType p = x.rows();
+		const bool deltas = (colDeltas.size() > 0);
+		VectorType sum(p);
+		for (SizeType i = start; i < end; ++i) {
+			assert(i + 1 < rowptr.size());
+			T* xi = &x(0, i);
+			for (SizeType c = 0; c < p; ++c) sum[c] = xi[c];
+			const IndexType jend = rowptr[i + 1];
+			for (IndexType j = rowptr[i]; j < jend; ++j) {
+				const SizeType col = (deltas) ? i + colDeltas[j] : colind[j];
+				assert(col < y.cols());
+				const T value = values[j];
+				const T* yj = &y(0, col);
+				for (SizeType c = 0; c < p; ++c)
+					multiplyAdd(sum[c], value, yj[c]);
+			}
+
+			for (SizeType c = 0; c < p; ++c) xi[c] = sum[c];
+		}
+	}
+	// x += A*y for the p vectors of the block, threaded as
+	// CrsMatrixVectorProduct::product with p times the work per non-zero
+	static void product(BlockType& x,
+	                    const BlockType& y,
+	                    const VectorIndexType& rowptr,
+	                    const VectorIntType& colind,
+	                    const VectorDeltaType& colDeltas,
+	                    const VectorType& values,
+	                    SizeType nrows)
+	{
+		SizeType nthreads = Concurrency::npthreads;
+		IndexType nonzeros = (nrows < rowptr.size()) ? rowptr[nrows] : 0;
+		IndexType work = nonzeros*y.rows();
+		if (nthreads < 2 ||
+		        work < IndexType(CrsMatrixVectorProductType::MIN_NONZEROS_PER_THREAD*nthreads)) {
+			rows(x, y, rowptr, colind, colDeltas, values, 0, nrows);
+			return;
+		}
+
+#ifdef USE_PTHREADS
+		CrsMatrixBlockProduct helper(x, y, rowptr, colind, colDeltas, values, nrows, nthreads);
+		PthreadsNg<CrsMatrixBlockProduct> threads(nthreads,
+		                                          0,
+		                                          Concurrency::setAffinitiesDefault);
+		threads.loopCreate(helper);
+#else
+		rows(x, y, rowptr, colind, colDeltas, values, 0, nrows);
+#endif
+	}
+
+private:
+
+	// The block size is known at compile time, so that the p sums
+	// stay in registers; offset columns are read relative to column i
+	template<SizeType P>
+	static void rowsFixed(BlockType& x,
+	                      const BlockType& y,
+	                      const VectorIndexType& rowptr,
+	                      const VectorIntType& colind,
+	                      const VectorDeltaType& colDeltas,
+	                      const VectorType& values,
+	                      SizeType start,
+	                      SizeType end)
+	{
+		const bool deltas = (colDeltas.size() > 0);
+		for (SizeType i = start; i < end; ++i) {
+			assert(i + 1 < rowptr.size());
+			assert(rowptr[i + 1] <= IndexType(values.size()));
+			const IndexType j0 = rowptr[i];
+			const IndexType jend = rowptr[i + 1];
+			if (j0 == jend) continue;
+			if (deltas)
+				oneRow<P>(&x(0, i), &y(0, 0) + i*P, &colDeltas[j0], &values[j0], jend - j0);
+			else
+				oneRow<P>(&x(0, i), &y(0, 0), &colind[j0], &values[j0], jend - j0);
+		}
+	}
+
+	template<SizeType P, typename U, typename ColumnType>
+	static void oneRow(U* xi,
+	                   const U* y,
+	                   const ColumnType* colind,
+	                   const U* values,
+	                   int nonzeros)
+	{
+		U sum[P];
+		for (SizeType c = 0; c < P; ++c) sum[c] = xi[c];
+		for (int j = 0; j < nonzeros; ++j) {
+			const U value = values[j];
+			const U* yj = y + colind[j]*int(P);
+			for (SizeType c = 0; c < P; ++c)
+				sum[c] += value*yj[c];
+		}
+
+		for (SizeType c = 0; c < P; ++c) xi[c] = sum[c];
+	}
+
+	// real and imaginary parts are summed separately, which the
+	// compiler vectorizes, and there is no NaN recovery as in multiplyAdd
+	template<SizeType P, typename RealType, typename ColumnType>
+	static void oneRow(std::complex<RealType>* xi,
+	                   const std::complex<RealType>* y,
+	                   const ColumnType* colind,
+	                   const std::complex<RealType>* values,
+	                   int nonzeros)
+	{
+		RealType re[P];
+		RealType im[P];
+		for (SizeType c = 0; c < P; ++c) {
+			re[c] = xi[c].real();
+			im[c] = xi[c].imag();
+		}
+
+		for (int j = 0; j < nonzeros; ++j) {
+			const RealType vr = values[j].real();
+			const RealType vi = values[j].imag();
+			const RealType* yj = reinterpret_cast<const RealType*>(y + colind[j]*int(P));
+			for (SizeType c = 0; c < P; ++c) {
+				re[c] += vr*yj[2*c] - vi*yj[2*c + 1];
+				im[c] += vr*yj[2*c + 1] + vi*yj[2*c];
+			}
+		}
+
+		for (SizeType c = 0; c < P; ++c)
+			xi[c] = std::complex<RealType>(re[c], im[c]);
+	}
+
+	template<typename A, typename B, typename C>
+	static void multiplyAdd(A& sum, const B& a, const C& b)
+	{
+		sum += a*b;
+	}
+
+	template<typename RealType>
+	static void multiplyAdd(std::complex<RealType>& sum,
+	                        const std::complex<RealType>& a,
+	                        const std::complex<RealType>& b)
+	{
+		RealType re = a.real()*b.real() - a.imag()*b.imag();
+		RealType im = a.real()*b.imag() + a.imag()*b.real();
+		sum = std::complex<RealType>(sum.real() + re, sum.imag() + im);
+	}
+
+	BlockType& x_;
+	const BlockType& y_;
+	const VectorIndexType& rowptr_;
+	const VectorIntType& colind_;
+	const VectorDeltaType& colDeltas_;
+	const VectorType& values_;
+	VectorSizeType chunkStart_;
+}; // class CrsMatrixBlockProduct
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_CRSMATRIX_BLOCK_PRODUCT_H
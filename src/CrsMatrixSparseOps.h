@@ -0,0 +1,601 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file CrsMatrixSparseOps.h
+ *
+ *  Threaded engines for the sparse-sparse companion functions of
+ *  CrsMatrix: multiply (C = A*B), transposeConjugate and externalProduct
+ *  (Kronecker products).
+ *
+ *  Rows of the result are split in contiguous chunks of roughly equal
+ *  work, one task each. Each row is built by one task, in the same order
+ *  of operations whatever the number of threads, so that the result is
+ *  the same for any number of threads. Column indices of each row are
+ *  sorted.
+ *
+ *  multiply has two phases: a symbolic one that counts the columns of
+ *  each row, after which C is sized once, and a numeric one that fills
+ *  the rows in place. Both use a per-task hash table sized by the
+ *  largest number of products of a row of the task, instead of
+ *  B.cols()-sized arrays.
+ *  transposeConjugate is a counting sort: tasks count the columns of
+ *  their rows of A, and then place their entries after those of
+ *  earlier tasks, so that rows of the result are in increasing order.
+ *
+ *  Positions of non-zeros are of the IndexType of each matrix, and
+ *  counts of them, and of products, of its NonzerosType.
+ */
+#ifndef PSI_CRSMATRIX_SPARSE_OPS_H
+#define PSI_CRSMATRIX_SPARSE_OPS_H
+#include <algorithm>
+#include <cassert>
+#include "Vector.h"
+#include "Complex.h"
+#include "Concurrency.h"
+#ifdef USE_PTHREADS
+#include "PthreadsNg.h"
+#endif
+
+namespace PsimagLite {
+
+class CrsMatrixSparseOps {
+
+public:
+
+	typedef Vector<int>::Type VectorIntType;
+	typedef Vector<SizeType>::Type VectorSizeType;
+
+	// Below this amount of work (products or non-zeros) per thread,
+	// threads are not worth it
+	enum {MIN_WORK_PER_THREAD = 16384};
+
+	// Number of tasks for this total work
+	template<typename WorkType>
+	static SizeType chunks(WorkType work)
+	{
+		SizeType nthreads = Concurrency::npthreads;
+		if (nthreads < 2 || work < WorkType(MIN_WORK_PER_THREAD*nthreads)) return 1;
+		return nthreads;
+	}
+
+	// Rows of chunk c are chunkStart[c] <= i < chunkStart[c + 1], where
+	// work[i + 1] - work[i] is the work of row i; no chunk is empty
+	template<typename VectorWorkType>
+	static void workChunks(VectorSizeType& chunkStart,
+	                       const VectorWorkType& work,
+	                       SizeType chunks)
+	{
+		typedef typename VectorWorkType::value_type WorkType;
+		assert(work.size() > 0);
+		SizeType rows = work.size() - 1;
+		chunkStart.assign(1, 0);
+		for (SizeType c = 1; c < chunks; ++c) {
+			WorkType target = (work[rows]/chunks)*c;
+			SizeType row = std::lower_bound(work.begin(), work.begin() + rows, target)
+			        - work.begin();
+			if (row > chunkStart.back()) chunkStart.push_back(row);
+		}
+
+		if (rows > chunkStart.back()) chunkStart.push_back(rows);
+	}
+
+	// Runs helper.doTask(task, thread) for all tasks of helper
+	template<typename HelperType>
+	static void run(HelperType& helper)
+	{
+		SizeType tasks = helper.tasks();
+		if (tasks < 2) {
+			for (SizeType task = 0; task < tasks; ++task) helper.doTask(task, 0);
+			return;
+		}
+
+#ifdef USE_PTHREADS
+		PthreadsNg<HelperType> threads(tasks, 0, Concurrency::setAffinitiesDefault);
+		threads.loopCreate(helper);
+#else
+		for (SizeType task = 0; task < tasks; ++task) helper.doTask(task, 0);
+#endif
+	}
+
+	// Sorts entries start <= k < end of C by column, if they are not
+	template<typename CrsMatrixType>
+	static void sortRow(CrsMatrixType& c,
+	                    typename CrsMatrixType::IndexType start,
+	                    typename CrsMatrixType::IndexType end)
+	{
+		typedef typename CrsMatrixType::IndexType IndexType;
+		bool sorted = true;
+		for (IndexType k = start + 1; k < end; ++k) {
+			if (c.getCol(k - 1) < c.getCol(k)) continue;
+			sorted = false;
+			break;
+		}
+
+		if (sorted) return;
+
+		typedef typename CrsMatrixType::value_type T;
+		typedef std::pair<int, T> PairType;
+		typename Vector<PairType>::Type entries(end - start);
+		for (IndexType k = start; k < end; ++k)
+			entries[k - start] = PairType(c.getCol(k), c.getValue(k));
+
+		std::stable_sort(entries.begin(), entries.end(), LessColumn<T>());
+		for (IndexType k = start; k < end; ++k) {
+			c.setCol(k, entries[k - start].first);
+			c.setValues(k, entries[k - start].second);
+		}
+	}
+
+private:
+
+	template<typename T>
+	struct LessColumn {
+		bool operator()(const std::pair<int, T>& a, const std::pair<int, T>& b) const
+		{
+			return a.first < b.first;
+		}
+	};
+}; // class CrsMatrixSparseOps
+
+// C = A*B
+template<typename CrsMatrixType, typename CrsMatrixType3, typename CrsMatrixType2>
+class CrsMatrixSparseProduct {
+
+	typedef typename CrsMatrixType::value_type T;
+	typedef typename CrsMatrixType::IndexType IndexType;
+	typedef typename CrsMatrixType::NonzerosType NonzerosType;
+	typedef typename CrsMatrixType3::IndexType IndexType3;
+	typedef typename CrsMatrixType2::IndexType IndexType2;
+	typedef CrsMatrixSparseOps::VectorIntType VectorIntType;
+	typedef CrsMatrixSparseOps::VectorSizeType VectorSizeType;
+	typedef typename Vector<NonzerosType>::Type VectorNonzerosType;
+	typedef typename Vector<T>::Type VectorType;
+
+	enum {SYMBOLIC, NUMERIC};
+
+public:
+
+	static void multiply(CrsMatrixType& c, const CrsMatrixType3& a, const CrsMatrixType2& b)
+	{
+		assert(a.cols() == b.rows());
+		CrsMatrixSparseProduct helper(c, a, b);
+
+		helper.what_ = SYMBOLIC;
+		CrsMatrixSparseOps::run(helper);
+
+		SizeType n = a.rows();
+		NonzerosType nonzeros = 0;
+		for (SizeType i = 0; i < n; ++i) nonzeros += helper.rowSize_[i];
+
+		c.resize(n, b.cols(), nonzeros);
+		IndexType counter = 0;
+		for (SizeType i = 0; i < n; ++i) {
+			c.setRow(i, counter);
+			counter += helper.rowSize_[i];
+		}
+
+		c.setRow(n, counter);
+
+		helper.what_ = NUMERIC;
+		CrsMatrixSparseOps::run(helper);
+		c.checkValidity();
+	}
+
+	SizeType tasks() const { return chunkStart_.size() - 1; }
+
+	void doTask(SizeType taskNumber, SizeType)
+	{
+		SizeType start = chunkStart_[taskNumber];
+		SizeType end = chunkStart_[taskNumber + 1];
+
+		SizeType maxProducts = 0;
+		for (SizeType i = start; i < end; ++i)
+			maxProducts = std::max(maxProducts, SizeType(work_[i + 1] - work_[i]));
+
+		SizeType capacity = 16;
+		while (capacity < 2*maxProducts) capacity <<= 1;
+
+		// hash table of the columns of one row, and its used slots
+		VectorIntType keys(capacity, -1);
+		VectorType sums(capacity);
+		VectorSizeType used;
+		used.reserve(maxProducts);
+		VectorIntType cols;
+		const SizeType mask = capacity - 1;
+
+		for (SizeType i = start; i < end; ++i) {
+			for (IndexType3 j = a_.getRowPtr(i); j < a_.getRowPtr(i + 1); ++j) {
+				SizeType row = a_.getCol(j);
+				for (IndexType2 k = b_.getRowPtr(row); k < b_.getRowPtr(row + 1); ++k) {
+					int col = b_.getCol(k);
+					SizeType slot = hash(col) & mask;
+					while (keys[slot] >= 0 && keys[slot] != col)
+						slot = (slot + 1) & mask;
+
+					if (what_ == SYMBOLIC) {
+						if (keys[slot] < 0) {
+							keys[slot] = col;
+							used.push_back(slot);
+						}
+
+						continue;
+					}
+
+					T tmp = a_.getValue(j)*b_.getValue(k);
+					if (keys[slot] < 0) {
+						keys[slot] = col;
+						sums[slot] = tmp;
+						used.push_back(slot);
+					} else {
+						sums[slot] += tmp;
+					}
+				}
+			}
+
+			if (what_ == SYMBOLIC) {
+				rowSize_[i] = used.size();
+			} else {
+				// columns are sorted as plain integers, and their sums
+				// found again in the table, which is cheaper than sorting
+				// the slots by key
+				IndexType offset = c_.getRowPtr(i);
+				assert(offset + IndexType(used.size()) == c_.getRowPtr(i + 1));
+				cols.resize(used.size());
+				for (SizeType s = 0; s < used.size(); ++s) cols[s] = keys[used[s]];
+				std::sort(cols.begin(), cols.end());
+				for (SizeType s = 0; s < cols.size(); ++s) {
+					SizeType slot = hash(cols[s]) & mask;
+					while (keys[slot] != cols[s]) slot = (slot + 1) & mask;
+					c_.setCol(offset + s, cols[s]);
+					c_.setValues(offset + s, sums[slot]);
+				}
+			}
+
+			for (SizeType s = 0; s < used.size(); ++s)
+				keys[used[s]] = -1;
+			used.clear();
+		}
+	}
+
+private:
+
+	CrsMatrixSparseProduct(CrsMatrixType& c, const CrsMatrixType3& a, const CrsMatrixType2& b)
+	    : c_(c),
+	      a_(a),
+	      b_(b),
+	      what_(SYMBOLIC),
+	      work_(a.rows() + 1, 0),
+	      rowSize_(a.rows(), 0),
+	      chunkStart_()
+	{
+		// products per row of C, which bound its non-zeros
+		for (SizeType i = 0; i < a.rows(); ++i) {
+			NonzerosType products = 0;
+			for (IndexType3 j = a.getRowPtr(i); j < a.getRowPtr(i + 1); ++j)
+				products += b.getRowPtr(a.getCol(j) + 1) - b.getRowPtr(a.getCol(j));
+			work_[i + 1] = work_[i] + products;
+		}
+
+		SizeType chunks = CrsMatrixSparseOps::chunks(work_[a.rows()]);
+		CrsMatrixSparseOps::workChunks(chunkStart_, work_, chunks);
+	}
+
+	static SizeType hash(int col)
+	{
+		return static_cast<SizeType>(static_cast<unsigned int>(col)*2654435761u);
+	}
+
+	CrsMatrixType& c_;
+	const CrsMatrixType3& a_;
+	const CrsMatrixType2& b_;
+	SizeType what_;
+	VectorNonzerosType work_;
+	VectorSizeType rowSize_;
+	VectorSizeType chunkStart_;
+}; // class CrsMatrixSparseProduct
+
+// B = transpose(conjugate(A)), with or without the zeros of A
+template<typename CrsMatrixType, typename CrsMatrixType2>
+class CrsMatrixTranspose {
+
+	typedef typename CrsMatrixType2::value_type T2;
+	typedef typename CrsMatrixType::IndexType IndexType;
+	typedef typename CrsMatrixType::NonzerosType NonzerosType;
+	typedef typename CrsMatrixType2::IndexType IndexType2;
+	typedef CrsMatrixSparseOps::VectorSizeType VectorSizeType;
+	typedef typename Vector<IndexType>::Type VectorIndexType;
+	typedef typename Vector<VectorIndexType>::Type VectorVectorIndexType;
+	typedef typename Vector<typename CrsMatrixType2::NonzerosType>::Type VectorNonzerosType2;
+
+	enum {COUNT, FILL};
+
+public:
+
+	static void transposeConjugate(CrsMatrixType& b, const CrsMatrixType2& a, bool dropZeros)
+	{
+		CrsMatrixTranspose helper(b, a, dropZeros);
+
+		helper.what_ = COUNT;
+		CrsMatrixSparseOps::run(helper);
+
+		// entries of column c of A from task t go to position[t][c] onwards
+		SizeType tasks = helper.tasks();
+		SizeType cols = a.cols();
+		IndexType counter = 0;
+		b.resize(cols, a.rows(), helper.nonzeros());
+		for (SizeType c = 0; c < cols; ++c) {
+			b.setRow(c, counter);
+			for (SizeType t = 0; t < tasks; ++t) {
+				IndexType count = helper.position_[t][c];
+				helper.position_[t][c] = counter;
+				counter += count;
+			}
+		}
+
+		b.setRow(cols, counter);
+
+		helper.what_ = FILL;
+		CrsMatrixSparseOps::run(helper);
+	}
+
+	SizeType tasks() const { return chunkStart_.size() - 1; }
+
+	void doTask(SizeType taskNumber, SizeType)
+	{
+		VectorIndexType& position = position_[taskNumber];
+		if (what_ == COUNT) position.assign(a_.cols(), 0);
+
+		for (SizeType i = chunkStart_[taskNumber]; i < chunkStart_[taskNumber + 1]; ++i) {
+			for (IndexType2 k = a_.getRowPtr(i); k < a_.getRowPtr(i + 1); ++k) {
+				const T2& value = a_.getValue(k);
+				if (dropZeros_ && value == static_cast<T2>(0.0)) continue;
+				SizeType col = a_.getCol(k);
+				if (what_ == COUNT) {
+					++position[col];
+					continue;
+				}
+
+				IndexType p = position[col]++;
+				b_.setCol(p, i);
+				b_.setValues(p, PsimagLite::conj(value));
+			}
+		}
+	}
+
+private:
+
+	CrsMatrixTranspose(CrsMatrixType& b, const CrsMatrixType2& a, bool dropZeros)
+	    : b_(b), a_(a), dropZeros_(dropZeros), what_(COUNT), chunkStart_(), position_()
+	{
+		VectorNonzerosType2 work(a.rows() + 1, 0);
+		for (SizeType i = 0; i < a.rows(); ++i)
+			work[i + 1] = a.getRowPtr(i + 1) - a.getRowPtr(0);
+
+		SizeType chunks = CrsMatrixSparseOps::chunks(work[a.rows()]);
+		CrsMatrixSparseOps::workChunks(chunkStart_, work, chunks);
+		position_.resize(tasks());
+	}
+
+	NonzerosType nonzeros() const
+	{
+		NonzerosType sum = 0;
+		for (SizeType t = 0; t < position_.size(); ++t)
+			for (SizeType c = 0; c < position_[t].size(); ++c)
+				sum += position_[t][c];
+		return sum;
+	}
+
+	CrsMatrixType& b_;
+	const CrsMatrixType2& a_;
+	bool dropZeros_;
+	SizeType what_;
+	VectorSizeType chunkStart_;
+	VectorVectorIndexType position_;
+}; // class CrsMatrixTranspose
+
+/* Kronecker products: C = A (x) B, where row alpha + beta*na of C is
+   row alpha of A times row beta of B, with columns a + b*A.cols(),
+   times signs[alpha] (or signs[beta] if signsOfB) if signs is not empty;
+   and B = A (x) 1 or 1 (x) A, see externalProduct in CrsMatrix.h.
+   Rows are sized first, then filled by tasks */
+template<typename CrsMatrixType>
+class CrsMatrixKronecker {
+
+	typedef typename CrsMatrixType::value_type T;
+	typedef typename CrsMatrixType::IndexType IndexType;
+	typedef typename CrsMatrixType::NonzerosType NonzerosType;
+	typedef CrsMatrixSparseOps::VectorSizeType VectorSizeType;
+	typedef typename Vector<NonzerosType>::Type VectorNonzerosType;
+	typedef Vector<int>::Type VectorIntType;
+
+	enum {TWO_MATRICES, WITH_IDENTITY};
+
+public:
+
+	template<typename SignType>
+	static void product(CrsMatrixType& c,
+	                    const CrsMatrixType& a,
+	                    const CrsMatrixType& b,
+	                    const typename Vector<SignType>::Type& signs,
+	                    bool signsOfB)
+	{
+		SizeType na = a.rows();
+		SizeType n = na*b.rows();
+		VectorNonzerosType work(n + 1, 0);
+		for (SizeType i = 0; i < n; ++i) {
+			SizeType alpha = i % na;
+			SizeType beta = i / na;
+			work[i + 1] = work[i] + rowSize(a, alpha)*rowSize(b, beta);
+		}
+
+		VectorIntType factor(signs.size());
+		for (SizeType i = 0; i < signs.size(); ++i)
+			factor[i] = static_cast<int>(signs[i]);
+
+		CrsMatrixKronecker helper(c, a, b, factor, signsOfB, work, TWO_MATRICES);
+		helper.fill(work);
+	}
+
+	// order true: row i + alpha*na is row i of A; order false:
+	// row alpha + i*nout is row i of A times signs[alpha]
+	template<typename SignType>
+	static void identity(CrsMatrixType& c,
+	                     const CrsMatrixType& a,
+	                     SizeType nout,
+	                     const SignType& signs,
+	                     bool order)
+	{
+		SizeType na = a.rows();
+		SizeType n = na*nout;
+		VectorNonzerosType work(n + 1, 0);
+		for (SizeType ii = 0; ii < n; ++ii) {
+			SizeType i = (order) ? ii % na : ii / nout;
+			work[ii + 1] = work[ii] + rowSize(a, i);
+		}
+
+		VectorIntType noSigns;
+		CrsMatrixKronecker helper(c, a, a, noSigns, false, work, WITH_IDENTITY);
+		helper.nout_ = nout;
+		helper.order_ = order;
+		helper.identitySigns_.resize(signs.size());
+		for (SizeType i = 0; i < signs.size(); ++i)
+			helper.identitySigns_[i] = signs[i];
+		helper.fill(work);
+	}
+
+	SizeType tasks() const { return chunkStart_.size() - 1; }
+
+	void doTask(SizeType taskNumber, SizeType)
+	{
+		for (SizeType i = chunkStart_[taskNumber]; i < chunkStart_[taskNumber + 1]; ++i) {
+			if (what_ == TWO_MATRICES)
+				twoMatricesRow(i);
+			else
+				identityRow(i);
+
+			CrsMatrixSparseOps::sortRow(c_, c_.getRowPtr(i), c_.getRowPtr(i + 1));
+		}
+	}
+
+private:
+
+	CrsMatrixKronecker(CrsMatrixType& c,
+	                   const CrsMatrixType& a,
+	                   const CrsMatrixType& b,
+	                   const VectorIntType& signs,
+	                   bool signsOfB,
+	                   const VectorNonzerosType& work,
+	                   SizeType what)
+	    : c_(c),
+	      a_(a),
+	      b_(b),
+	      signs_(signs),
+	      signsOfB_(signsOfB),
+	      what_(what),
+	      nout_(1),
+	      order_(true),
+	      identitySigns_(),
+	      chunkStart_()
+	{
+		SizeType chunks = CrsMatrixSparseOps::chunks(work.back());
+		CrsMatrixSparseOps::workChunks(chunkStart_, work, chunks);
+	}
+
+	void fill(const VectorNonzerosType& work)
+	{
+		SizeType n = work.size() - 1;
+		if (what_ == TWO_MATRICES)
+			c_.resize(n, a_.cols()*b_.cols(), work[n]);
+		else
+			c_.resize(n, a_.cols()*nout_, work[n]);
+
+		for (SizeType i = 0; i <= n; ++i) c_.setRow(i, work[i]);
+		CrsMatrixSparseOps::run(*this);
+	}
+
+	// rows of B outside, so that columns are sorted if those of A and B are
+	void twoMatricesRow(SizeType i)
+	{
+		SizeType na = a_.rows();
+		SizeType alpha = i % na;
+		SizeType beta = i / na;
+		SizeType nacols = a_.cols();
+		IndexType counter = c_.getRowPtr(i);
+		int sign = 1;
+		if (signs_.size() > 0) sign = (signsOfB_) ? signs_[beta] : signs_[alpha];
+
+		for (IndexType kk = b_.getRowPtr(beta); kk < b_.getRowPtr(beta + 1); ++kk) {
+			SizeType offset = b_.getCol(kk)*nacols;
+			for (IndexType k = a_.getRowPtr(alpha); k < a_.getRowPtr(alpha + 1); ++k) {
+				c_.setCol(counter, a_.getCol(k) + offset);
+				T tmp = a_.getValue(k)*b_.getValue(kk);
+				if (signs_.size() > 0) tmp *= sign;
+				c_.setValues(counter, tmp);
+				++counter;
+			}
+		}
+	}
+
+	void identityRow(SizeType ii)
+	{
+		SizeType na = a_.rows();
+		SizeType i = 0;
+		SizeType alpha = 0;
+		if (order_) {
+			alpha = ii / na;
+			i = ii - alpha*na;
+		} else {
+			i = ii / nout_;
+			alpha = ii - i*nout_;
+		}
+
+		IndexType counter = c_.getRowPtr(ii);
+		for (IndexType k = a_.getRowPtr(i); k < a_.getRowPtr(i + 1); ++k) {
+			SizeType j = a_.getCol(k);
+			SizeType jj = (order_) ? j + alpha*na : alpha + j*nout_;
+			c_.setCol(counter, jj);
+			T tmp = a_.getValue(k);
+			if (!order_) tmp *= identitySigns_[alpha];
+			c_.setValues(counter, tmp);
+			++counter;
+		}
+	}
+
+	static NonzerosType rowSize(const CrsMatrixType& m, SizeType i)
+	{
+		return m.getRowPtr(i + 1) - m.getRowPtr(i);
+	}
+
+	CrsMatrixType& c_;
+	const CrsMatrixType& a_;
+	const CrsMatrixType& b_;
+	const VectorIntType& signs_;
+	bool signsOfB_;
+	SizeType what_;
+	SizeType nout_;
+	bool order_;
+	typename Vector<typename Real<T>::Type>::Type identitySigns_;
+	VectorSizeType chunkStart_;
+}; // class CrsMatrixKronecker
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_CRSMATRIX_SPARSE_OPS_H
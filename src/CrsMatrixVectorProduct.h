@@ -0,0 +1,242 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file CrsMatrixVectorProduct.h
+ *
+ *  Row kernel and pthreads helper for CrsMatrix::matrixVectorProduct
+ *
+ *  Rows are split into contiguous chunks of (roughly) equal number
+ *  of non-zeros, one chunk per thread. Each row is always summed by a
+ *  single thread and in the same order as the serial code, so that
+ *  results do not depend on the number of threads.
+ *
+ *  IndexType is the type of the row pointers, so that it can be wider
+ *  than int for matrices with more than 2^31 non-zeros. Columns can be
+ *  read from colDeltas instead of colind, when not empty: the column of
+ *  an entry of row i is i plus its delta, which halves the bytes of index
+ *  read per non-zero for banded matrices.
+ */
+#ifndef PSI_CRSMATRIX_VECTOR_PRODUCT_H
+#define PSI_CRSMATRIX_VECTOR_PRODUCT_H
+#include <algorithm>
+#include <cassert>
+#include "Vector.h"
+#include "Concurrency.h"
+#ifdef USE_PTHREADS
+#include "PthreadsNg.h"
+#endif
+
+namespace PsimagLite {
+
+template<typename T, typename VectorLikeType, typename IndexType = int>
+class CrsMatrixVectorProduct {
+
+public:
+
+	typedef typename Vector<IndexType>::Type VectorIndexType;
+	typedef Vector<int>::Type VectorIntType;
+	typedef Vector<short>::Type VectorDeltaType;
+	typedef typename Vector<T>::Type VectorType;
+	typedef Vector<SizeType>::Type VectorSizeType;
+
+	// Below this number of non-zeros per thread the cost of
+	// creating the threads is larger than the product itself
+	enum {MIN_NONZEROS_PER_THREAD = 16384};
+
+	CrsMatrixVectorProduct(VectorLikeType& x,
+	                       const VectorLikeType& y,
+	                       const VectorIndexType& rowptr,
+	                       const VectorIntType& colind,
+	                       const VectorDeltaType& colDeltas,
+	                       const VectorType& values,
+	                       SizeType rows,
+	                       SizeType chunks)
+	    : x_(x),
+	      y_(y),
+	      rowptr_(rowptr),
+	      colind_(colind),
+	      colDeltas_(colDeltas),
+	      values_(values),
+	      chunkStart_()
+	{
+		nonzeroChunks(chunkStart_, rowptr, rows, chunks);
+	}
+
+	SizeType tasks() const { return chunkStart_.size() - 1; }
+
+	// Rows of chunk c are chunkStart[c] <= i < chunkStart[c + 1]; chunks
+	// have roughly equal number of non-zeros, and none is empty
+	static void nonzeroChunks(VectorSizeType& chunkStart,
+	                          const VectorIndexType& rowptr,
+	                          SizeType rows,
+	                          SizeType chunks)
+	{
+		assert(rows < rowptr.size());
+		assert(chunks > 0);
+		chunkStart.assign(1, 0);
+		IndexType nonzeros = rowptr[rows] - rowptr[0];
+		for (SizeType c = 1; c < chunks; ++c) {
+			IndexType target = rowptr[0] + (nonzeros/chunks)*c;
+			SizeType row = std::lower_bound(rowptr.begin(),
+			                                rowptr.begin() + rows,
+			                                target) - rowptr.begin();
+			if (row > chunkStart[chunkStart.size() - 1])
+				chunkStart.push_back(row);
+		}
+
+		if (rows > chunkStart[chunkStart.size() - 1])
+			chunkStart.push_back(rows);
+	}
+
+	void doTask(SizeType taskNumber, SizeType)
+	{
+		assert(taskNumber + 1 < chunkStart_.size());
+		if (colDeltas_.size() > 0) {
+			rowsDeltas(x_,
+			           y_,
+			           rowptr_,
+			           colDeltas_,
+			           values_,
+			           chunkStart_[taskNumber],
+			           chunkStart_[taskNumber + 1]);
+			return;
+		}
+
+		rows(x_,
+		     y_,
+		     rowptr_,
+		     colind_,
+		     values_,
+		     chunkStart_[taskNumber],
+		     chunkStart_[taskNumber + 1]);
+	}
+
+	// x[i] += sum_j A(i,j) y[j] for start <= i < end
+	static void rows(VectorLikeType& x,
+	                 const VectorLikeType& y,
+	                 const VectorIndexType& rowptr,
+	                 const VectorIntType& colind,
+	                 const VectorType& values,
+	                 SizeType start,
+	                 SizeType end)
+	{
+		for (SizeType i = start; i < end; ++i) {
+			assert(i + 1 < rowptr.size());
+			typename VectorLikeType::value_type sum = x[i];
+			const IndexType jend = rowptr[i + 1];
+			for (IndexType j = rowptr[i]; j < jend; ++j) {
+				assert(static_cast<typename VectorType::size_type>(j) < values.size());
+				assert(static_cast<typename VectorType::size_type>(j) < colind.size());
+				assert(SizeType(colind[j]) < y.size());
+				multiplyAdd(sum, values[j], y[colind[j]]);
+			}
+
+			x[i] = sum;
+		}
+	}
+
+	// Same as rows, with the columns decoded from colDeltas
+	static void rowsDeltas(VectorLikeType& x,
+	                       const VectorLikeType& y,
+	                       const VectorIndexType& rowptr,
+	                       const VectorDeltaType& colDeltas,
+	                       const VectorType& values,
+	                       SizeType start,
+	                       SizeType end)
+	{
+		for (SizeType i = start; i < end; ++i) {
+			assert(i + 1 < rowptr.size());
+			typename VectorLikeType::value_type sum = x[i];
+			const typename VectorLikeType::value_type* yi = &y[0] + i;
+			const IndexType jend = rowptr[i + 1];
+			for (IndexType j = rowptr[i]; j < jend; ++j) {
+				assert(static_cast<typename VectorType::size_type>(j) < colDeltas.size());
+				assert(SizeType(i + colDeltas[j]) < y.size());
+				multiplyAdd(sum, values[j], yi[colDeltas[j]]);
+			}
+
+			x[i] = sum;
+		}
+	}
+
+	// x += A*y, threaded when Concurrency::npthreads > 1 and A is large enough;
+	// columns are read from colDeltas if not empty
+	static void product(VectorLikeType& x,
+	                    const VectorLikeType& y,
+	                    const VectorIndexType& rowptr,
+	                    const VectorIntType& colind,
+	                    const VectorDeltaType& colDeltas,
+	                    const VectorType& values,
+	                    SizeType nrows)
+	{
+		SizeType nthreads = Concurrency::npthreads;
+		IndexType nonzeros = (nrows < rowptr.size()) ? rowptr[nrows] : 0;
+		if (nthreads < 2 || nonzeros < IndexType(MIN_NONZEROS_PER_THREAD*nthreads)) {
+			if (colDeltas.size() > 0)
+				rowsDeltas(x, y, rowptr, colDeltas, values, 0, nrows);
+			else
+				rows(x, y, rowptr, colind, values, 0, nrows);
+			return;
+		}
+
+		CrsMatrixVectorProduct helper(x, y, rowptr, colind, colDeltas, values, nrows, nthreads);
+#ifdef USE_PTHREADS
+		PthreadsNg<CrsMatrixVectorProduct> threads(nthreads,
+		                                           0,
+		                                           Concurrency::setAffinitiesDefault);
+		threads.loopCreate(helper);
+#else
+		for (SizeType c = 0; c < helper.tasks(); ++c) helper.doTask(c, 0);
+#endif
+	}
+
+private:
+
+	template<typename A, typename B, typename C>
+	static void multiplyAdd(A& sum, const B& a, const C& b)
+	{
+		sum += a*b;
+	}
+
+	// Same result as sum += a*b for finite numbers, but the compiler
+	// does not emit the (non-inlined) NaN recovery of complex multiplication
+	template<typename RealType>
+	static void multiplyAdd(std::complex<RealType>& sum,
+	                        const std::complex<RealType>& a,
+	                        const std::complex<RealType>& b)
+	{
+		RealType re = a.real()*b.real() - a.imag()*b.imag();
+		RealType im = a.real()*b.imag() + a.imag()*b.real();
+		sum = std::complex<RealType>(sum.real() + re, sum.imag() + im);
+	}
+
+	VectorLikeType& x_;
+	const VectorLikeType& y_;
+	const VectorIndexType& rowptr_;
+	const VectorIntType& colind_;
+	const VectorDeltaType& colDeltas_;
+	const VectorType& values_;
+	VectorSizeType chunkStart_;
+}; // class CrsMatrixVectorProduct
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_CRSMATRIX_VECTOR_PRODUCT_H
@@ -74,9 +74,13 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 /*! \file DavidsonSolver.h
  *
- *  A class to represent a generic Davidson Solver
+ *  A class to represent a generic (block) Davidson Solver
  *  reference: Ernest R. Davidson, J. Comp. Phys. 17, 87-94 (1975).
  *
+ *  Block version with a diagonal (Jacobi) preconditioner and
+ *  restarts from the current Ritz vectors. Matrices without fullDiag()
+ *  are solved without preconditioner, from random starting vectors.
+ *
  *  http://web.eecs.utk.edu/~dongarra/etemplates/node138.html
  */
 
@@ -89,15 +93,64 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "Vector.h"
 #include "Matrix.h"
 #include "Random48.h"
+#include "LanczosOrDavidsonBase.h"
 
 namespace PsimagLite {
 
+//! True if MatrixType has fullDiag(VectorRealType&) const
+template<typename MatrixType, typename VectorRealType>
+class HasFullDiag {
+
+	typedef char One;
+	typedef struct { char a[2]; } Two;
+
+	template<typename U, void (U::*)(VectorRealType&) const>
+	struct Check;
+
+	template<typename U>
+	static One test(Check<U, &U::fullDiag>*);
+
+	template<typename U>
+	static Two test(...);
+
+public:
+
+	enum {True = (sizeof(test<MatrixType>(0)) == sizeof(One))};
+};
+
+//! MatrixType must have the following interface:
+//! 	rows() member function to indicate the rank of the matrix
+//! 	matrixVectorProduct(x,y) member function that implements x += Hy
+//! and may have
+//! 	fullDiag(d) member function that fills d with the (real) diagonal of H,
+//!     used for the Jacobi preconditioner and the starting vectors
+
 template<typename SolverParametersType,typename MatrixType,typename VectorType>
 class DavidsonSolver : public LanczosOrDavidsonBase<SolverParametersType,MatrixType,VectorType> {
 
 	typedef typename SolverParametersType::RealType RealType;
 	typedef LanczosOrDavidsonBase<SolverParametersType,MatrixType,VectorType> ParentType;
 	typedef typename VectorType::value_type ComplexOrRealType;
+	typedef typename Vector<RealType>::Type VectorRealType;
+	typedef typename Vector<VectorType>::Type VectorVectorType;
+	typedef Matrix<ComplexOrRealType> DenseMatrixType;
+	typedef typename Vector<SizeType>::Type VectorSizeType;
+
+	class LessByValue {
+
+	public:
+
+		LessByValue(const VectorRealType& values) : values_(values) {}
+
+		bool operator()(SizeType i, SizeType j) const
+		{
+			return (values_[i] < values_[j]);
+		}
+
+	private:
+
+		const VectorRealType& values_;
+	}; // class LessByValue
 
 public:
 
@@ -108,62 +161,93 @@ public:
 	      steps_(params.steps),
 	      eps_(params.tolerance),
 	      mode_(ParentType::WITH_INFO),
+	      blockSize_(params.davidsonBlockSize),
+	      maxSubspace_(params.davidsonMaxSubspace),
+	      iterations_(0),
+	      matVecs_(0),
 	      rng_(343311)
 	{
 		setMode(params.options);
+		if (blockSize_ == 0) blockSize_ = 1;
 		OstringStream msg;
 		msg<<"Constructing... mat.rank="<<mat_.rows();
-		msg<<" steps="<<steps_<<" eps="<<eps_;
+		msg<<" steps="<<steps_<<" eps="<<eps_<<" block="<<blockSize_;
 		progress_.printline(msg,std::cout);
 	}
 
 	virtual void computeGroundState(RealType& gsEnergy,VectorType& z)
 	{
-		SizeType n =mat_.rows();
-		RealType atmp=0.0;
-		VectorType y(n);
-
-		for (SizeType i=0;i<n;i++) {
-			y[i]=rng_()-0.5;
-			atmp += PsimagLite::real(y[i]*PsimagLite::conj(y[i]));
-		}
-		if (mode_ & ParentType::DEBUG) {
-			computeGroundStateTest(gsEnergy,z,y);
-			return;
-		}
-		atmp = 1.0 / sqrt (atmp);
-		for (SizeType i = 0; i < n; i++) y[i] *= atmp;
-		computeGroundState(gsEnergy,z,y);
+		computeExcitedState(gsEnergy,z,0);
 	}
 
-	virtual void computeGroundState(RealType&,
-	                                VectorType&,
-	                                const VectorType&)
+	virtual void computeGroundState(RealType& gsEnergy,
+	                                VectorType& z,
+	                                const VectorType& initialVector)
 	{
-		String s(__FILE__);
-		s += " Unimplemented\n";
-		throw RuntimeError(s.c_str());
+		computeExcitedState(gsEnergy,z,initialVector,0);
 	}
 
-	virtual void computeExcitedState(RealType&,
-	                                 VectorType&,
-	                                 SizeType)
+	// Starts from the unit vector of the lowest diagonal element of H,
+	// or from a random vector if the diagonal is not known
+	virtual void computeExcitedState(RealType& gsEnergy,
+	                                 VectorType& z,
+	                                 SizeType excited)
 	{
-		String s(__FILE__);
-		s += " computeExcitedState Unimplemented\n";
-		throw RuntimeError(s.c_str());
+		if (mode_ & ParentType::DEBUG) {
+			computeStateTest(gsEnergy,z,excited);
+			return;
+		}
+
+		SizeType n =mat_.rows();
+		VectorRealType diagonal;
+		fillDiagonal(diagonal,mat_);
+		VectorType y(n);
+		if (n > 0) startingVector(y,lowestDiagonals(diagonal,1),0);
+		computeExcitedState(gsEnergy,z,y,excited);
 	}
 
-	virtual void computeExcitedState(RealType&,
-	                                 VectorType&,
-	                                 const VectorType&,
-	                                 SizeType)
+	virtual void computeExcitedState(RealType& gsEnergy,
+	                                 VectorType& z,
+	                                 const VectorType& initialVector,
+	                                 SizeType excited)
 	{
-		String s(__FILE__);
-		s += " computeExcitedState Unimplemented\n";
-		throw RuntimeError(s.c_str());
+		if (mode_ & ParentType::DEBUG) {
+			computeStateTest(gsEnergy,z,excited);
+			return;
+		}
+
+		SizeType n = mat_.rows();
+		if (initialVector.size() != n) {
+			String msg("DavidsonSolver: vector size ");
+			msg += ttos(initialVector.size()) + " but matrix size ";
+			msg += ttos(n) + "\n";
+			throw RuntimeError(msg);
+		}
+
+		if (excited >= n)
+			throw RuntimeError("DavidsonSolver: excited state beyond matrix rank\n");
+
+		VectorRealType eigs;
+		VectorVectorType ritz;
+		RealType residual = solve(eigs,ritz,initialVector,excited);
+
+		gsEnergy = eigs[excited];
+		z = ritz[excited];
+
+		String str = "DavidsonSolver: computeExcitedState: ";
+		if (norm(z)<1e-6)
+			throw RuntimeError(str + " norm is zero\n");
+
+		if (mode_ & ParentType::WITH_INFO)
+			info(gsEnergy,initialVector,excited,residual,std::cout);
 	}
 
+	//! number of outer iterations used by the last call
+	SizeType iterations() const { return iterations_; }
+
+	//! number of products H*v used by the last call
+	SizeType matrixVectorProducts() const { return matVecs_; }
+
 private:
 
 	void setMode(const String& options)
@@ -174,48 +258,366 @@ private:
 			mode_ |= ParentType::ALLOWS_ZERO;
 	}
 
+	/* Returns the residual norm of state excited
+	 *
+	 * Basis V and W = HV are kept together with the projected matrix
+	 * V^\dagger W. Each iteration diagonalizes the projected matrix, forms
+	 * the k lowest Ritz pairs (theta, x) and their residuals r = Hx - theta x,
+	 * and, for those not converged, extends V with (theta - D)^{-1} r,
+	 * where D is the diagonal of H, or with r if D is not known. When V
+	 * would grow beyond maxSubspace the basis is collapsed to the k current
+	 * Ritz vectors, which are then extended as V would have been.
+	 */
+	RealType solve(VectorRealType& eigs,
+	               VectorVectorType& ritz,
+	               const VectorType& initialVector,
+	               SizeType excited)
+	{
+		SizeType n = mat_.rows();
+		SizeType k = std::min(std::max(blockSize_, excited + 1), n);
+		SizeType maxSubspace = maxSubspace_;
+		if (maxSubspace == 0) maxSubspace = std::max(10*k, SizeType(20));
+		if (maxSubspace < 2*k) maxSubspace = 2*k;
+		if (maxSubspace > n) maxSubspace = n;
+
+		iterations_ = matVecs_ = 0;
+
+		VectorRealType diagonal;
+		fillDiagonal(diagonal,mat_);
+
+		VectorVectorType v;
+		VectorVectorType w;
+		DenseMatrixType hproj(maxSubspace,maxSubspace);
+
+		VectorType t = initialVector;
+		addToBasis(v,w,hproj,t);
+
+		// the rest of the block starts from the unit vectors
+		// of the lowest diagonal elements of H
+		VectorSizeType lowest = lowestDiagonals(diagonal,2*k);
+		for (SizeType i = 0; i < 2*k && v.size() < k; ++i) {
+			startingVector(t,lowest,i);
+			addToBasis(v,w,hproj,t);
+		}
+
+		if (v.size() == 0)
+			throw RuntimeError("DavidsonSolver: initial vector is zero\n");
+
+		VectorRealType resNorm(k,0.0);
+		VectorVectorType hritz;
+		for (;;) {
+			SizeType nbasis = v.size();
+			SizeType kk = std::min(k, nbasis);
+			DenseMatrixType s(nbasis,nbasis);
+			for (SizeType j = 0; j < nbasis; ++j)
+				for (SizeType i = 0; i < nbasis; ++i)
+					s(i,j) = hproj(i,j);
+
+			eigs.resize(nbasis);
+			diag(s,eigs,'V');
+
+			ritzVectors(ritz,v,s,kk);
+			ritzVectors(hritz,w,s,kk);
+
+			bool converged = (kk > excited);
+			for (SizeType i = 0; i < kk; ++i) {
+				// hritz[i] becomes the residual Hx - theta x
+				RealType sum = 0.0;
+				for (SizeType j = 0; j < n; ++j) {
+					hritz[i][j] -= eigs[i]*ritz[i][j];
+					sum += PsimagLite::real(hritz[i][j]*PsimagLite::conj(hritz[i][j]));
+				}
+
+				resNorm[i] = sqrt(sum);
+				if (i <= excited && !isConverged(resNorm[i])) converged = false;
+			}
+
+			if (converged || iterations_ >= steps_ || nbasis == n) break;
+
+			++iterations_;
+
+			// the Ritz pairs and residuals found above are those of the
+			// collapsed basis too, so the corrections follow directly
+			if (nbasis + kk > maxSubspace && nbasis > kk)
+				restart(v,w,hproj,ritz,hritz,eigs,kk);
+
+			SizeType added = 0;
+			for (SizeType i = 0; i < kk; ++i) {
+				if (isConverged(resNorm[i])) continue;
+				precondition(t,hritz[i],diagonal,eigs[i],resNorm[i]);
+				if (addToBasis(v,w,hproj,t)) ++added;
+				if (v.size() == maxSubspace) break;
+			}
+
+			// the subspace is invariant, nothing else can be learned
+			if (added == 0) break;
+		}
+
+		if (iterations_ >= steps_ && !isConverged(resNorm[excited])) {
+			OstringStream msg;
+			msg<<"WARNING: Maximum number of steps used. ";
+			msg<<"Increasing this maximum is recommended.";
+			progress_.printline(msg,std::cout);
+		}
+
+		return resNorm[excited];
+	}
+
+	template<typename SomeMatrixType>
+	typename EnableIf<HasFullDiag<SomeMatrixType,VectorRealType>::True,void>::Type
+	fillDiagonal(VectorRealType& diagonal, const SomeMatrixType& mat) const
+	{
+		diagonal.resize(mat.rows());
+		mat.fullDiag(diagonal);
+	}
+
+	// an empty diagonal means no preconditioner
+	template<typename SomeMatrixType>
+	typename EnableIf<!HasFullDiag<SomeMatrixType,VectorRealType>::True,void>::Type
+	fillDiagonal(VectorRealType& diagonal, const SomeMatrixType&) const
+	{
+		diagonal.clear();
+	}
+
+	// Starting vector i of the block: the unit vector of lowest[i], or a
+	// random vector if there is no such diagonal element
+	void startingVector(VectorType& y, const VectorSizeType& lowest, SizeType i)
+	{
+		SizeType n = y.size();
+		RealType atmp = 0.0;
+		for (SizeType j = 0; j < n; ++j) {
+			y[j] = rng_() - 0.5;
+			atmp += PsimagLite::real(y[j]*PsimagLite::conj(y[j]));
+		}
+
+		if (i >= lowest.size()) return;
+
+		// a random part of norm 0.1; a bare unit vector could be an
+		// exact eigenvector of a decoupled sector of H
+		atmp = 0.1/sqrt(atmp);
+		for (SizeType j = 0; j < n; ++j) y[j] *= atmp;
+		y[lowest[i]] += 1.0;
+	}
+
+	// indices of the m lowest elements of diagonal, in increasing order
+	static VectorSizeType lowestDiagonals(const VectorRealType& diagonal, SizeType m)
+	{
+		SizeType n = diagonal.size();
+		VectorSizeType indices(n);
+		for (SizeType i = 0; i < n; ++i) indices[i] = i;
+		m = std::min(m, n);
+		std::partial_sort(indices.begin(),
+		                  indices.begin() + m,
+		                  indices.end(),
+		                  LessByValue(diagonal));
+		indices.resize(m);
+		return indices;
+	}
+
+	// tolerance applies to the eigenvalue error, which is bounded
+	// by the square of the residual norm
+	bool isConverged(RealType resNorm) const
+	{
+		return (resNorm*resNorm < eps_);
+	}
+
+	// x[i] = sum_j s(j,i) basis[j], for i < kk
+	void ritzVectors(VectorVectorType& x,
+	                 const VectorVectorType& basis,
+	                 const DenseMatrixType& s,
+	                 SizeType kk) const
+	{
+		SizeType n = mat_.rows();
+		x.resize(kk);
+		for (SizeType i = 0; i < kk; ++i) {
+			x[i].resize(n);
+			std::fill(x[i].begin(),x[i].end(),ComplexOrRealType(0.0));
+			for (SizeType j = 0; j < basis.size(); ++j) {
+				ComplexOrRealType c = s(j,i);
+				const VectorType& b = basis[j];
+				for (SizeType l = 0; l < n; ++l)
+					x[i][l] += c*b[l];
+			}
+		}
+	}
+
+	// t = (theta - D)^{-1} r, or t = r if D is empty
+	// There is an eigenvalue within resNorm of theta, so entries of D closer
+	// than that to theta are not resolved yet: their denominators are clamped
+	// to resNorm to keep the correction from collapsing onto a unit vector
+	void precondition(VectorType& t,
+	                  const VectorType& r,
+	                  const VectorRealType& diagonal,
+	                  RealType theta,
+	                  RealType resNorm) const
+	{
+		if (diagonal.size() == 0) {
+			t = r;
+			return;
+		}
+
+		const RealType small = std::max(resNorm, RealType(1e-8));
+		SizeType n = r.size();
+		t.resize(n);
+		for (SizeType i = 0; i < n; ++i) {
+			RealType denominator = theta - diagonal[i];
+			if (fabs(denominator) < small)
+				denominator = (denominator < 0) ? -small : small;
+			t[i] = r[i]/denominator;
+		}
+	}
+
+	void restart(VectorVectorType& v,
+	             VectorVectorType& w,
+	             DenseMatrixType& hproj,
+	             const VectorVectorType& ritz,
+	             const VectorVectorType& residual,
+	             const VectorRealType& eigs,
+	             SizeType kk) const
+	{
+		v.resize(kk);
+		w.resize(kk);
+		SizeType n = mat_.rows();
+		for (SizeType i = 0; i < kk; ++i) {
+			v[i] = ritz[i];
+			// residual = Hx - theta x, thus Hx = residual + theta x
+			w[i].resize(n);
+			for (SizeType j = 0; j < n; ++j)
+				w[i][j] = residual[i][j] + eigs[i]*ritz[i][j];
+		}
+
+		hproj.setTo(0.0);
+		for (SizeType i = 0; i < kk; ++i)
+			hproj(i,i) = eigs[i];
+	}
+
+	// orthonormalizes t against v, and if linearly independent
+	// adds it to v, adds H*t to w, and updates hproj
+	bool addToBasis(VectorVectorType& v,
+	                VectorVectorType& w,
+	                DenseMatrixType& hproj,
+	                VectorType& t)
+	{
+		RealType tnorm = sqrt(PsimagLite::real(dotProduct(t,t)));
+		if (tnorm == 0) return false;
+
+		for (SizeType i = 0; i < t.size(); ++i) t[i] /= tnorm;
+
+		tnorm = algorithm4_14(t,v);
+		if (tnorm < 1e-10) return false;
+
+		for (SizeType i = 0; i < t.size(); ++i) t[i] /= tnorm;
+
+		SizeType j = v.size();
+		v.push_back(t);
+		VectorType x(t.size(),0.0);
+		mat_.matrixVectorProduct(x,t);
+		++matVecs_;
+		w.push_back(x);
+
+		for (SizeType i = 0; i <= j; ++i) {
+			ComplexOrRealType tmp = dotProduct(v[i],w[j]);
+			hproj(i,j) = tmp;
+			hproj(j,i) = PsimagLite::conj(tmp);
+		}
+
+		hproj(j,j) = PsimagLite::real(hproj(j,j));
+		return true;
+	}
+
 	//! only for debugging:
-	void computeGroundStateTest(RealType&,
-	                            VectorType&,
-	                            const VectorType&)
+	void computeStateTest(RealType& energy,
+	                      VectorType& z,
+	                      SizeType excited)
 	{
-		String s(__FILE__);
-		s += " Unimplemented\n";
-		throw RuntimeError(s.c_str());
+		SizeType n =mat_.rows();
+		DenseMatrixType a(n,n);
+		VectorType x(n);
+		VectorType y(n);
+		for (SizeType i=0;i<n;i++) {
+			std::fill(x.begin(),x.end(),ComplexOrRealType(0.0));
+			std::fill(y.begin(),y.end(),ComplexOrRealType(0.0));
+			y[i] = 1.0;
+			mat_.matrixVectorProduct(x,y);
+			for (SizeType j=0;j<n;j++) a(j,i)=x[j];
+		}
+
+		bool ih  = isHermitian(a,true);
+		if (!ih) throw RuntimeError("computeGroundState: Matrix not hermitian\n");
+
+		VectorRealType eigs(n);
+		diag(a,eigs,'V');
+		assert(excited < n);
+		energy = eigs[excited];
+		z.resize(n);
+		for (SizeType i=0;i<n;i++) z[i] = a(i,excited);
+		std::cerr<<"eigs["<<excited<<"]="<<eigs[excited]<<"\n";
 	}
 
-	void algorithm4_14(VectorType& t,const typename Vector<VectorType>::Type& v)
+	// Classical Gram-Schmidt with reorthogonalization
+	// (Algorithm 4.14 in the reference in this file's header)
+	// Returns the norm of t after orthogonalization
+	RealType algorithm4_14(VectorType& t,const VectorVectorType& v) const
 	{
 		SizeType m = v.size();
-		if (m==0) return;
+		RealType tauin = PsimagLite::real(dotProduct(t,t));
+		if (m==0) return sqrt(tauin);
 		// select a value for k less than 1
 		RealType k = 0.25;
-		RealType tauin= PsimagLite::real(t*t);
 		for (SizeType i=0;i<m;i++) {
-			ComplexOrRealType tmp = scalarProduct(v[i],t);
-			t=t-tmp*t;
+			ComplexOrRealType tmp = dotProduct(v[i],t);
+			subtract(t,tmp,v[i]);
 		}
-		if (PsimagLite::real(t*t)/tauin>k) return;
+
+		RealType tauout = PsimagLite::real(dotProduct(t,t));
+		if (tauout/tauin>k) return sqrt(tauout);
 		for (SizeType i=0;i<m;i++) {
-			ComplexOrRealType tmp = scalarProduct(v[i],t);
-			t=t-tmp*v[i];
+			ComplexOrRealType tmp = dotProduct(v[i],t);
+			subtract(t,tmp,v[i]);
 		}
+
+		return sqrt(PsimagLite::real(dotProduct(t,t)));
 	}
 
-	void callMinRes()
+	// returns v1^\dagger v2
+	static ComplexOrRealType dotProduct(const VectorType& v1, const VectorType& v2)
 	{
-		String s(__FILE__);
-		s += " Unimplemented\n";
-		throw RuntimeError(s.c_str());
+		ComplexOrRealType sum = 0.0;
+		SizeType n = v1.size();
+		for (SizeType i = 0; i < n; ++i)
+			sum += PsimagLite::conj(v1[i])*v2[i];
+		return sum;
 	}
 
-	void largestEigenpair(RealType& theta,
-	                      VectorType& s,
-	                      const Matrix<ComplexOrRealType>& M)
+	static void subtract(VectorType& t,
+	                     const ComplexOrRealType& c,
+	                     const VectorType& vi)
 	{
-		String st(__FILE__);
-		st += " Unimplemented\n";
-		throw RuntimeError(st.c_str());
+		SizeType n = t.size();
+		for (SizeType i = 0; i < n; ++i)
+			t[i] -= c*vi[i];
+	}
+
+	void info(RealType energyTmp,
+	          const VectorType& x,
+	          SizeType excited,
+	          RealType residual,
+	          std::ostream& os)
+	{
+		RealType norma=norm(x);
+
+		if (norma<1e-5 || norma>100) {
+			std::cerr<<"norma="<<norma<<"\n";
+		}
+
+		OstringStream msg;
+		msg.precision(os.precision());
+		String what = "lowest";
+		if (excited > 0) what = ttos(excited) + " excited";
+		msg<<"Found "<<what<<" eigenvalue= "<<energyTmp<<" after "<<iterations_;
+		msg<<" iterations, "<<matVecs_<<" matrix vector products, residual=";
+		msg<<residual<<", orig. norm="<<norma;
+		progress_.printline(msg,os);
 	}
 
 	ProgressIndicator progress_;
@@ -223,6 +625,10 @@ private:
 	SizeType steps_;
 	RealType eps_;
 	SizeType mode_;
+	SizeType blockSize_;
+	SizeType maxSubspace_;
+	SizeType iterations_;
+	SizeType matVecs_;
 	Random48<RealType> rng_;
 }; // class DavidsonSolver
 } // namespace PsimagLite
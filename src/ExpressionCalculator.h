@@ -2,11 +2,12 @@
 #define PSI_EXPRESSIONCALCULATOR_H
 
 #include <iostream>
-#include <stack>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
 #include "Vector.h"
 #include "PsimagLite.h"
 #include "TypeToString.h"
-#include "Stack.h"
 #include "../loki/TypeTraits.h"
 #include <cmath>
 
@@ -52,151 +53,206 @@ private:
 	}
 }; // class ExpressionPrepass
 
+// An expression in prefix notation, such as *,c,%t,%v, compiled once
+// into instructions for a stack machine. %x is the variable whose letter
+// x is at that position of names, as in PrepassData; as ExpressionPrepass
+// did, only the first two characters of a token %x... are looked at.
+// Operators are + - * of two operands, c(os) s(in) e(xp) l(og) of one, and
+// ? of three, which is the second if the real part of the first is
+// positive and the third otherwise. Tokens after the first complete
+// expression are ignored, and empty tokens are skipped.
 template<typename ComplexOrRealType>
-class ExpressionCalculator {
-
-	typedef PsimagLite::Vector<SizeType>::Type VectorSizeType;
-	typedef typename PsimagLite::Vector<ComplexOrRealType>::Type VectorType;
+class ExpressionProgram {
 
-	enum NodeTypeEnum {NODE_NUMBER, NODE_OPERATOR};
+	enum OpcodeEnum {OP_CONSTANT, OP_VARIABLE, OP_PLUS, OP_MINUS, OP_TIMES,
+	                 OP_COS, OP_SIN, OP_IF, OP_EXP, OP_LOG};
 
-	static const bool debug_ = false;
+	// deeper programs evaluate with a stack in the heap; a batch is done
+	// BATCH inputs at a time
+	enum {LOCAL_DEPTH = 16, BATCH = 64};
 
-	struct Node {
+	struct Instruction {
 
-		Node(PsimagLite::String str,SizeType ind)
-		: type(NODE_OPERATOR),index(ind),ary(0),value(0.0)
-		{
-			for (SizeType i = 0; i < 4; ++i) op[i] = '\0';
-			SizeType l = str.size();
-			if (l == 0) return;
-			if (str[l-1] >= '0' && str[l-1]<='9') {
-				type = NODE_NUMBER;
-				value = atof(str.c_str());
-			} else {
-				ary = findAry(str);
-				for (SizeType i = 0; i < 4; ++i)
-					op[i] = (i < l) ? str[i] : '\0';
-			}
-		}
-
-		void print(std::ostream& os) const
-		{
-			if (type == NODE_NUMBER) {
-				os<<index<<" "<<value<<"| ";
-			} else {
-				os<<index<<" "<<op<<" "<<ary<<"| ";
-			}
-		}
+		Instruction(OpcodeEnum o, SizeType a)
+		    : opcode(o), argument(a)
+		{}
 
-		NodeTypeEnum type;
-		unsigned char op[4];
-		SizeType index;
-		SizeType ary;
-		ComplexOrRealType value;
+		OpcodeEnum opcode;
+		// index of the constant or the variable
+		SizeType argument;
 	};
 
-	typedef Node NodeType;
-	typedef typename PsimagLite::Vector<NodeType>::Type VectorNodeType;
+	typedef typename PsimagLite::Vector<Instruction>::Type VectorInstructionType;
 
 public:
 
 	typedef PsimagLite::Vector<PsimagLite::String>::Type VectorStringType;
+	typedef typename PsimagLite::Vector<ComplexOrRealType>::Type VectorType;
 
-	ExpressionCalculator(const VectorStringType& ve)
-	: ve_(ve), value_(0.0)
+	ExpressionProgram()
+	    : variables_(0), depth_(0)
+	{}
+
+	ExpressionProgram(const VectorStringType& ve, PsimagLite::String names = "")
+	    : variables_(names.size()), depth_(0)
 	{
-		VectorNodeType vne(ve.size(),NodeType("",0));
-		fillNodes(vne,ve);
-		while (!onePass(vne)) {};
+		compile(ve, names);
 	}
 
-	bool onePass(VectorNodeType& vne)
+	SizeType variables() const { return variables_; }
+
+	// variables[k] is the value of the k-th letter of names; does not
+	// allocate, unless the program needs more than LOCAL_DEPTH values
+	ComplexOrRealType operator()(const ComplexOrRealType* variables) const
 	{
-		typename Stack<Node>::Type ops;
-		SizeType numbers = 0;
-		VectorSizeType indices(3,0);
-		SizeType simplifications = 0;
-		for (SizeType i = 0; i < vne.size(); ++i) {
-			if (vne[i].type == NODE_NUMBER) {
-				if (ops.size() == 0) {
-					value_ = vne[i].value;
-					return true;
-				} else {
-					indices[numbers] = i;
-					numbers++;
-					if (ops.top().ary == numbers) {
-						simplify(vne,ops.top(),indices);
-						numbers = 0;
-						ops.pop();
-						simplifications++;
-					}
-				}
-			} else {
-				if (vne[i].op[0] == '\0') continue;
-				ops.push(vne[i]);
-				numbers = 0;
-			}
+		ComplexOrRealType local[LOCAL_DEPTH];
+		if (depth_ <= LOCAL_DEPTH) {
+			execute(local, 1, 1, variables);
+			return local[0];
 		}
 
-		if (debug_) print(vne,"vne");
-		if (simplifications > 0) return false;
-
-		String msg("ExpressionCalculator: Syntax error in expression ");
-		for (SizeType i = 0; i < ve_.size(); ++i)
-			msg += ve_[i] + " ";
-
-		throw PsimagLite::RuntimeError(msg + "\n");
+		VectorType stack(depth_);
+		execute(&stack[0], 1, 1, variables);
+		return stack[0];
 	}
 
-	const ComplexOrRealType& operator()() const
+	// results[i] for the variables inputs[i*variables() + k], for i < n
+	void operator()(ComplexOrRealType* results,
+	                const ComplexOrRealType* inputs,
+	                SizeType n) const
 	{
-		return value_;
+		VectorType stack(depth_*BATCH);
+		for (SizeType start = 0; start < n; start += BATCH) {
+			SizeType m = std::min(static_cast<SizeType>(BATCH), n - start);
+			execute(&stack[0], BATCH, m, inputs + start*variables_);
+			for (SizeType i = 0; i < m; ++i)
+				results[start + i] = stack[i];
+		}
 	}
 
 private:
 
-	void print(const VectorNodeType& vn, PsimagLite::String label) const
+	void compile(const VectorStringType& ve, PsimagLite::String names)
 	{
-		std::cout<<label<<" ";
-		for (SizeType i = 0; i < vn.size(); ++i)
-			vn[i].print(std::cout);
-		std::cout<<"\n";
+		// the end of the first complete expression
+		SizeType end = 0;
+		int needed = 1;
+		for (; end < ve.size() && needed > 0; ++end) {
+			if (ve[end] == "") continue;
+			int ary = findAry(ve[end], names);
+			if (ary < 0) syntaxError(ve);
+			needed += ary - 1;
+		}
+
+		if (needed > 0) syntaxError(ve);
+
+		// operands are pushed last first, so that the first is on top
+		SizeType depth = 0;
+		for (SizeType i = end; i > 0; --i) {
+			const PsimagLite::String& token = ve[i - 1];
+			if (token == "") continue;
+			int ary = findAry(token, names);
+			if (ary == 0) {
+				emitOperand(token, names);
+			} else {
+				assert(depth >= static_cast<SizeType>(ary));
+				code_.push_back(Instruction(opcodeOf(token), 0));
+			}
+
+			depth = depth + 1 - ary;
+			if (depth > depth_) depth_ = depth;
+		}
+
+		assert(depth == 1);
 	}
 
-	void fillNodes(VectorNodeType& vn, const VectorStringType& ve) const
+	void emitOperand(const PsimagLite::String& token, PsimagLite::String names)
 	{
-		for (SizeType i = 0; i < ve.size(); ++i)
-			vn[i] = Node(ve[i],i);
+		size_t variable = variableOf(token, names);
+		if (variable != PsimagLite::String::npos) {
+			code_.push_back(Instruction(OP_VARIABLE, variable));
+			return;
+		}
+
+		code_.push_back(Instruction(OP_CONSTANT, constants_.size()));
+		constants_.push_back(atof(token.c_str()));
 	}
 
-	void simplify(VectorNodeType& vn,
-	              const NodeType& op,
-	              const VectorSizeType& indices) const
+	// Level j of the stack is stack[j*width + i], for i < m
+	void execute(ComplexOrRealType* stack,
+	             SizeType width,
+	             SizeType m,
+	             const ComplexOrRealType* inputs) const
 	{
-		SizeType total = op.ary;
-		VectorType values(total);
-		for (SizeType i = 0; i < total; ++i) {
-			values[i] = vn[indices[i]].value;
-			vn[indices[i]] = Node("",indices[i]);
-		}
+		SizeType levels = 0;
+		SizeType n = code_.size();
+		for (SizeType k = 0; k < n; ++k) {
+			const Instruction& instruction = code_[k];
+			if (instruction.opcode == OP_CONSTANT || instruction.opcode == OP_VARIABLE) {
+				ComplexOrRealType* top = stack + levels*width;
+				++levels;
+				if (instruction.opcode == OP_CONSTANT) {
+					for (SizeType i = 0; i < m; ++i)
+						top[i] = constants_[instruction.argument];
+				} else {
+					for (SizeType i = 0; i < m; ++i)
+						top[i] = inputs[i*variables_ + instruction.argument];
+				}
+
+				continue;
+			}
 
-		ComplexOrRealType value = executeOperator(op.op,values);
-		vn[op.index] = Node(ttos(value),op.index);
+			// operands are on top, at next, and at third
+			ComplexOrRealType* top = stack + (levels - 1)*width;
+			ComplexOrRealType* next = (levels > 1) ? top - width : 0;
+			ComplexOrRealType* third = (levels > 2) ? next - width : 0;
+			switch (instruction.opcode) {
+			case OP_PLUS:
+				for (SizeType i = 0; i < m; ++i) next[i] = top[i] + next[i];
+				--levels;
+				break;
+			case OP_MINUS:
+				for (SizeType i = 0; i < m; ++i) next[i] = top[i] - next[i];
+				--levels;
+				break;
+			case OP_TIMES:
+				for (SizeType i = 0; i < m; ++i) next[i] = top[i] * next[i];
+				--levels;
+				break;
+			case OP_COS:
+				for (SizeType i = 0; i < m; ++i) top[i] = cos(top[i]);
+				break;
+			case OP_SIN:
+				for (SizeType i = 0; i < m; ++i) top[i] = sin(top[i]);
+				break;
+			case OP_IF:
+				for (SizeType i = 0; i < m; ++i)
+					if (PsimagLite::real(top[i]) > 0) third[i] = next[i];
+				levels -= 2;
+				break;
+			case OP_EXP:
+				for (SizeType i = 0; i < m; ++i) top[i] = myExponential(top[i]);
+				break;
+			case OP_LOG:
+				for (SizeType i = 0; i < m; ++i) top[i] = log(top[i]);
+				break;
+			default:
+				assert(false);
+			}
+		}
 	}
 
-	static ComplexOrRealType executeOperator(const unsigned char op[],
-	                                const VectorType& values)
+	static OpcodeEnum opcodeOf(PsimagLite::String op)
 	{
-		if (op[0] == '+') return values[0] + values[1];
-		if (op[0] == '-') return values[0] - values[1];
-		if (op[0] == '*') return values[0] * values[1];
-		if (op[0] == 'c') return cos(values[0]);
-		if (op[0] == 's') return sin(values[0]);
-		if (op[0] == '?') return (PsimagLite::real(values[0]) > 0) ? values[1] : values[2];
-		if (op[0] == 'e') return myExponential(values[0]);
-		if (op[0] == 'l') return log(values[0]);
-		return 0.0;
+		if (op == "+") return OP_PLUS;
+		if (op == "-") return OP_MINUS;
+		if (op == "*") return OP_TIMES;
+		if (op == "c") return OP_COS;
+		if (op == "s") return OP_SIN;
+		if (op == "?") return OP_IF;
+		if (op == "e") return OP_EXP;
+		assert(op == "l");
+		return OP_LOG;
 	}
 
 	template<typename T>
@@ -214,15 +270,62 @@ private:
 		return ::exp(PsimagLite::real(v))*T(cos(c),sin(c));
 	}
 
-	static SizeType findAry(PsimagLite::String op)
+	// 0 for numbers and variables, -1 if token is neither nor an operator
+	static int findAry(const PsimagLite::String& token, PsimagLite::String names)
+	{
+		if (variableOf(token, names) != PsimagLite::String::npos) return 0;
+		SizeType l = token.size();
+		if (token[l - 1] >= '0' && token[l - 1] <= '9') return 0;
+		if (token == "+" || token == "-" || token == "*") return 2;
+		if (token == "c" || token == "s" || token == "e" || token == "l") return 1;
+		if (token == "?") return 3;
+		return -1;
+	}
+
+	static size_t variableOf(const PsimagLite::String& token, PsimagLite::String names)
 	{
-		if (op == "+" || op == "-" || op == "*") return 2;
-		if (op == "c" || op == "s" || op == "e" || op == "l") return 1;
-		if (op == "?") return 3;
-		return 0;
+		if (token.size() < 2 || token[0] != '%') return PsimagLite::String::npos;
+		return names.find(token[1]);
 	}
 
-	VectorStringType ve_;
+	static void syntaxError(const VectorStringType& ve)
+	{
+		PsimagLite::String msg("ExpressionCalculator: Syntax error in expression ");
+		for (SizeType i = 0; i < ve.size(); ++i)
+			msg += ve[i] + " ";
+
+		throw PsimagLite::RuntimeError(msg + "\n");
+	}
+
+	SizeType variables_;
+	SizeType depth_;
+	VectorInstructionType code_;
+	VectorType constants_;
+}; // class ExpressionProgram
+
+// Evaluates once an expression whose variables ExpressionPrepass replaced;
+// to evaluate an expression for many values of its variables, use an
+// ExpressionProgram instead
+template<typename ComplexOrRealType>
+class ExpressionCalculator {
+
+	typedef ExpressionProgram<ComplexOrRealType> ExpressionProgramType;
+
+public:
+
+	typedef PsimagLite::Vector<PsimagLite::String>::Type VectorStringType;
+
+	ExpressionCalculator(const VectorStringType& ve)
+	    : value_(ExpressionProgramType(ve)(0))
+	{}
+
+	const ComplexOrRealType& operator()() const
+	{
+		return value_;
+	}
+
+private:
+
 	ComplexOrRealType value_;
 }; // class ExpressionCalculator
 
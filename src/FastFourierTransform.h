@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file FastFourierTransform.h
+ *
+ *  Radix-2 fast Fourier transform, and the type-III discrete cosine
+ *  transform built on it
+ *
+ */
+#ifndef PSI_FAST_FOURIER_TRANSFORM_H
+#define PSI_FAST_FOURIER_TRANSFORM_H
+#include <cmath>
+#include <complex>
+#include <cassert>
+#include "Vector.h"
+#include "TypeToString.h"
+
+namespace PsimagLite {
+
+template<typename RealType>
+class FastFourierTransform {
+
+public:
+
+	typedef std::complex<RealType> ComplexType;
+	typedef typename Vector<ComplexType>::Type VectorComplexType;
+	typedef typename Vector<RealType>::Type VectorRealType;
+
+	// v[k] = sum_j v[j] exp(sign 2 pi i j k/n), n a power of 2, not normalized
+	static void transform(VectorComplexType& v, int sign)
+	{
+		SizeType n = v.size();
+		if (n < 2) return;
+		if ((n & (n - 1)) != 0)
+			throw RuntimeError("FastFourierTransform: size " + ttos(n) +
+			                   " is not a power of 2\n");
+
+		// bit reversal
+		for (SizeType i = 1, j = 0; i < n; ++i) {
+			SizeType bit = n >> 1;
+			for (; j & bit; bit >>= 1) j ^= bit;
+			j ^= bit;
+			if (i < j) std::swap(v[i], v[j]);
+		}
+
+		VectorComplexType twiddle(n/2);
+		for (SizeType j = 0; j < n/2; ++j) {
+			RealType angle = sign*2*M_PI*j/n;
+			twiddle[j] = ComplexType(cos(angle), sin(angle));
+		}
+
+		for (SizeType len = 2; len <= n; len <<= 1) {
+			SizeType half = len/2;
+			SizeType stride = n/len;
+			for (SizeType start = 0; start < n; start += len) {
+				for (SizeType j = 0; j < half; ++j) {
+					const ComplexType& w = twiddle[j*stride];
+					ComplexType a = v[start + j];
+					ComplexType b = v[start + j + half];
+					ComplexType wb(w.real()*b.real() - w.imag()*b.imag(),
+					               w.real()*b.imag() + w.imag()*b.real());
+					v[start + j] = a + wb;
+					v[start + j + half] = a - wb;
+				}
+			}
+		}
+	}
+
+	/* y[j] = sum_{k < c.size()} c[k] cos(pi k (j + 1/2)/n) for j < n, with
+	   n a power of 2 and c.size() <= n. These are the values at the n
+	   Chebyshev nodes x_j = cos(pi (j + 1/2)/n) of sum_k c[k] T_k(x)
+	*/
+	static void cosineTransform(VectorRealType& y, const VectorRealType& c, SizeType n)
+	{
+		assert(c.size() <= n);
+		VectorComplexType v(2*n, 0.0);
+		for (SizeType k = 0; k < c.size(); ++k) {
+			RealType angle = M_PI*k/(2.0*n);
+			v[k] = ComplexType(c[k]*cos(angle), c[k]*sin(angle));
+		}
+
+		transform(v, 1);
+		y.resize(n);
+		for (SizeType j = 0; j < n; ++j)
+			y[j] = v[j].real();
+	}
+}; // class FastFourierTransform
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_FAST_FOURIER_TRANSFORM_H
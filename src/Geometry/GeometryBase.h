@@ -81,6 +81,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #ifndef GEOMETRY_BASE_H
 #define GEOMETRY_BASE_H
 
+#include <algorithm>
 #include "InputNg.h"
 #include "MemResolv.h"
 
@@ -105,6 +106,7 @@ public:
 	enum {TYPE_O,TYPE_C};
 
 	typedef AdditionalData AdditionalDataType;
+	typedef Vector<SizeType>::Type VectorSizeType;
 
 	virtual ~GeometryBase()
 	{}
@@ -125,6 +127,18 @@ public:
 
 	virtual bool connected(SizeType i1,SizeType i2) const = 0;
 
+	// Fills sites with the sites i2 < linSize for which connected(site,i2),
+	// in increasing order; this default tests every i2, so geometries
+	// with few connections per site should call connectionsAt() instead
+	virtual void connections(VectorSizeType& sites,
+	                         SizeType site,
+	                         SizeType linSize) const
+	{
+		sites.clear();
+		for (SizeType i2 = 0; i2 < linSize; ++i2)
+			if (connected(site,i2)) sites.push_back(i2);
+	}
+
 	virtual SizeType calcDir(SizeType i1,SizeType i2) const = 0;
 
 	virtual bool fringe(SizeType i,SizeType smax,SizeType emin) const = 0;
@@ -177,6 +191,31 @@ protected:
 		throw RuntimeError(str2);
 	}
 
+	// Fills sites as connections() does, testing only the sites at the
+	// given distances from site
+	void connectionsAt(VectorSizeType& sites,
+	                   SizeType site,
+	                   SizeType linSize,
+	                   const SizeType* distances,
+	                   SizeType n) const
+	{
+		sites.clear();
+		for (SizeType i = 0; i < n; ++i) {
+			sites.push_back(site + distances[i]);
+			if (site >= distances[i]) sites.push_back(site - distances[i]);
+		}
+
+		std::sort(sites.begin(),sites.end());
+		n = std::unique(sites.begin(),sites.end()) - sites.begin();
+		SizeType j = 0;
+		for (SizeType i = 0; i < n; ++i) {
+			if (sites[i] >= linSize || !connected(site,sites[i])) continue;
+			sites[j++] = sites[i];
+		}
+
+		sites.resize(j);
+	}
+
 	bool neighbors(SizeType i1,SizeType i2,bool periodic = false,SizeType period = 1) const
 	{
 		SizeType imin = (i1<i2) ? i1 : i2;
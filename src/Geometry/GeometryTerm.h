@@ -84,6 +84,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "GeometryDirection.h"
 #include "GeometryBase.h"
 #include <cassert>
+#include <algorithm>
 #include "Ladder.h"
 #include "LadderX.h"
 #include "LadderBath.h"
@@ -101,6 +102,26 @@ class GeometryTerm {
 
 	typedef GeometryBase<ComplexOrRealType, InputType> GeometryBaseType;
 	typedef GeometryDirection<ComplexOrRealType,GeometryBaseType> GeometryDirectionType;
+	typedef ExpressionProgram<ComplexOrRealType> ExpressionProgramType;
+	typedef typename GeometryBaseType::VectorSizeType VectorSizeType;
+	typedef typename Vector<ComplexOrRealType>::Type VectorType;
+
+	// a value of cacheValues() before it is sorted into rows
+	struct Entry {
+
+		Entry(SizeType k1_, SizeType k2_, const ComplexOrRealType& value_)
+		    : k1(k1_), k2(k2_), value(value_)
+		{}
+
+		bool operator<(const Entry& other) const
+		{
+			return (k1 < other.k1 || (k1 == other.k1 && k2 < other.k2));
+		}
+
+		SizeType k1;
+		SizeType k2;
+		ComplexOrRealType value;
+	}; // Entry
 
 public:
 
@@ -120,7 +141,7 @@ public:
 	}; // Auxiliary
 
 	GeometryTerm()
-	    : orbitals_(0),geometryBase_(0)
+	    : orbitals_(0),geometryBase_(0),zero_(0.0)
 	{}
 
 	/** @class hide_geometry2
@@ -131,7 +152,7 @@ public:
 	*/
 	GeometryTerm(InputType& io,
 	             const Auxiliary& aux)
-	    : aux_(aux),geometryBase_(0),gOptions_("none")
+	    : aux_(aux),geometryBase_(0),gOptions_("none"),zero_(0.0)
 	{
 		String savedPrefix = io.prefix();
 		io.prefix() += (aux.numberOfTerms > 1) ? "gt" + ttos(aux.termId) + ":" : "";
@@ -178,6 +199,12 @@ public:
 			io.readline(vModifier_,  "GeometryValueModifier=");
 		} catch (std::exception&) {}
 
+		if (vModifier_ != "") {
+			typename ExpressionProgramType::VectorStringType ve;
+			split(ve, vModifier_, ",");
+			vModifierProgram_ = ExpressionProgramType(ve, "tv");
+		}
+
 		orbitals_ = findOrbitals();
 		cacheValues();
 
@@ -185,7 +212,7 @@ public:
 
 		if (aux.debug) {
 			std::cerr<<"Cached values:\n";
-			std::cerr<<cachedValues_;
+			printCachedValues(std::cerr);
 			std::cerr<<"-----------\n";
 		}
 	}
@@ -255,7 +282,12 @@ public:
 		int k1 = geometryBase_->index(i1,edof1,orbitals_);
 		int k2 = geometryBase_->index(i2,edof2,orbitals_);
 		assert(k1>=0 && k2>=0);
-		return cachedValues_(k1,k2);
+		assert(SizeType(k1) + 1 < rowStart_.size());
+		typename VectorSizeType::const_iterator begin = columns_.begin() + rowStart_[k1];
+		typename VectorSizeType::const_iterator end = columns_.begin() + rowStart_[k1 + 1];
+		typename VectorSizeType::const_iterator it = std::lower_bound(begin, end, SizeType(k2));
+		if (it == end || *it != SizeType(k2)) return zero_;
+		return values_[it - columns_.begin()];
 	}
 
 	template<typename T>
@@ -264,21 +296,8 @@ public:
 	{
 		if (vModifier_ == "") return value;
 
-		typedef ExpressionCalculator<T> ExpressionCalculatorType;
-		typename ExpressionCalculatorType::VectorStringType ve;
-		split(ve, vModifier_, ",");
-
-		PrepassData<T> pd;
-		typename PrepassData<T>::VectorType vr(2,0);
-		vr[0] = time;
-		vr[1] = value;
-		pd.names = "tv";
-		pd.values = vr;
-
-		ExpressionPrepass<PrepassData<T> >::prepass(ve,pd);
-
-		ExpressionCalculatorType ec(ve);
-		return ec();
+		T variables[2] = {time, value};
+		return modify(variables);
 	}
 
 	//assumes 1<smax+1 < emin
@@ -415,26 +434,67 @@ public:
 
 private:
 
+	// Keeps the values of the connected pairs, in rows of k1 with
+	// increasing k2, enumerating the connections of each site
 	void cacheValues()
 	{
 		SizeType linSize = aux_.linSize;
 		SizeType matrixRank = geometryBase_->matrixRank(linSize, orbitals_);
-		cachedValues_.resize(matrixRank,matrixRank);
 
+		typename Vector<Entry>::Type entries;
+		VectorSizeType sites;
 		for (SizeType i1 = 0; i1 < linSize; ++i1) {
-			for (SizeType i2 = 0; i2 < linSize; ++i2) {
-				if (!geometryBase_->connected(i1,i2)) continue;
+			geometryBase_->connections(sites, i1, linSize);
+#ifndef NDEBUG
+			// geometries that list the connections themselves must find
+			// the same sites as testing all of them with connected()
+			VectorSizeType allSites;
+			geometryBase_->GeometryBaseType::connections(allSites, i1, linSize);
+			assert(sites == allSites);
+#endif
+
+			for (SizeType j = 0; j < sites.size(); ++j) {
+				SizeType i2 = sites[j];
 				for (SizeType edof1=0;edof1<orbitals_;edof1++) {
 					int k1 = geometryBase_->index(i1,edof1,orbitals_);
 					if (k1<0) continue;
 					for (SizeType edof2=0;edof2<orbitals_;edof2++) {
 						int k2 = geometryBase_->index(i2,edof2,orbitals_);
 						if (k2<0) continue;
-						cachedValues_(k1,k2)=calcValue(i1,edof1,i2,edof2);
+						entries.push_back(Entry(k1,k2,calcValue(i1,edof1,i2,edof2)));
 					}
 				}
 			}
 		}
+
+		// a pair written twice keeps its last value
+		std::stable_sort(entries.begin(), entries.end());
+
+		rowStart_.assign(matrixRank + 1, 0);
+		columns_.clear();
+		values_.clear();
+		for (SizeType i = 0; i < entries.size(); ++i) {
+			const Entry& entry = entries[i];
+			assert(entry.k1 < matrixRank && entry.k2 < matrixRank);
+			if (i + 1 < entries.size() && !(entry < entries[i + 1])) continue;
+			columns_.push_back(entry.k2);
+			values_.push_back(entry.value);
+			++rowStart_[entry.k1 + 1];
+		}
+
+		for (SizeType k1 = 0; k1 < matrixRank; ++k1)
+			rowStart_[k1 + 1] += rowStart_[k1];
+	}
+
+	void printCachedValues(std::ostream& os) const
+	{
+		SizeType matrixRank = rowStart_.size() - 1;
+		for (SizeType k1 = 0; k1 < matrixRank; ++k1) {
+			os<<k1<<":";
+			for (SizeType k = rowStart_[k1]; k < rowStart_[k1 + 1]; ++k)
+				os<<" "<<columns_[k]<<"="<<values_[k];
+			os<<"\n";
+		}
 	}
 
 	SizeType findOrbitals() const
@@ -468,6 +528,21 @@ private:
 		return directions_[dir](i1,edof1,i2,edof2);
 	}
 
+	// variables are the time and the value
+	ComplexOrRealType modify(const ComplexOrRealType* variables) const
+	{
+		return vModifierProgram_(variables);
+	}
+
+	// other types compile the modifier each time
+	template<typename T>
+	T modify(const T* variables) const
+	{
+		typename ExpressionProgram<T>::VectorStringType ve;
+		split(ve, vModifier_, ",");
+		return ExpressionProgram<T>(ve, "tv")(variables);
+	}
+
 	GeometryTerm(const GeometryTerm&);
 
 	GeometryTerm& operator=(const GeometryTerm&);
@@ -477,8 +552,12 @@ private:
 	GeometryBaseType* geometryBase_;
 	String gOptions_;
 	String vModifier_;
+	ExpressionProgramType vModifierProgram_;
 	typename Vector<GeometryDirectionType>::Type directions_;
-	Matrix<ComplexOrRealType> cachedValues_;
+	VectorSizeType rowStart_;
+	VectorSizeType columns_;
+	VectorType values_;
+	ComplexOrRealType zero_;
 }; // class GeometryTerm
 
 template<typename ComplexOrRealType,typename InputType>
@@ -89,6 +89,7 @@ class KTwoNiFFour : public GeometryBase<ComplexOrRealType, InputType> {
 	typedef std::pair<int,int> PairType;
 	typedef GeometryBase<ComplexOrRealType, InputType> GeometryBaseType;
 	typedef typename GeometryBaseType::AdditionalDataType AdditionalDataType;
+	typedef typename GeometryBaseType::VectorSizeType VectorSizeType;
 
 	enum {TYPE_O = GeometryBaseType::TYPE_O, TYPE_C = GeometryBaseType::TYPE_C};
 
@@ -184,6 +185,13 @@ public:
 		return false;
 	}
 
+	// connected sites are at most 3 apart
+	void connections(VectorSizeType& sites,SizeType site,SizeType linSize) const
+	{
+		SizeType distances[] = {1, 2, 3};
+		this->connectionsAt(sites,site,linSize,distances,3);
+	}
+
 	// assumes i1 and i2 are connected
 	SizeType calcDir(SizeType i1,SizeType i2) const
 	{
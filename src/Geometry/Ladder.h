@@ -86,6 +86,9 @@ namespace PsimagLite {
 template<typename ComplexOrRealType, typename InputType>
 class Ladder : public GeometryBase<ComplexOrRealType,InputType> {
 
+	typedef GeometryBase<ComplexOrRealType, InputType> GeometryBaseType;
+	typedef typename GeometryBaseType::VectorSizeType VectorSizeType;
+
 public:
 
 	enum {DIRECTION_X,DIRECTION_Y};
@@ -189,6 +192,12 @@ public:
 		return false;
 	}
 
+	void connections(VectorSizeType& sites,SizeType site,SizeType linSize) const
+	{
+		SizeType distances[] = {1, leg_ - 1, leg_, leg_*(linSize_/leg_ - 1)};
+		this->connectionsAt(sites,site,linSize,distances,4);
+	}
+
 	SizeType calcDir(SizeType i1,SizeType i2) const
 	{
 		assert(connected(i1,i2));
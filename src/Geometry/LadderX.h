@@ -87,6 +87,8 @@ template<typename ComplexOrRealType, typename InputType>
 class LadderX : public GeometryBase<ComplexOrRealType, InputType> {
 
 	typedef Ladder<ComplexOrRealType, InputType> LadderType;
+	typedef GeometryBase<ComplexOrRealType, InputType> GeometryBaseType;
+	typedef typename GeometryBaseType::VectorSizeType VectorSizeType;
 
 public:
 
@@ -139,6 +141,12 @@ public:
 		return (this->neighbors(r1,r2) && this->neighbors(c1,c2));
 	}
 
+	void connections(VectorSizeType& sites,SizeType site,SizeType linSize) const
+	{
+		SizeType distances[] = {1, leg_ - 1, leg_, leg_ + 1, leg_*(linSize_/leg_ - 1)};
+		this->connectionsAt(sites,site,linSize,distances,5);
+	}
+
 	// assumes i1 and i2 are connected
 	SizeType calcDir(SizeType i1,SizeType i2) const
 	{
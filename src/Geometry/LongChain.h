@@ -84,6 +84,9 @@ namespace PsimagLite {
 template<typename ComplexOrRealType, typename InputType>
 class LongChain : public GeometryBase<ComplexOrRealType, InputType> {
 
+	typedef GeometryBase<ComplexOrRealType, InputType> GeometryBaseType;
+	typedef typename GeometryBaseType::VectorSizeType VectorSizeType;
+
 public:
 
 	enum { DIRECTION_X };
@@ -136,6 +139,12 @@ public:
 		return (b || b2);
 	}
 
+	void connections(VectorSizeType& sites,SizeType site,SizeType linSize) const
+	{
+		SizeType distances[] = {distance_, linSize_ - distance_};
+		this->connectionsAt(sites,site,linSize,distances,2);
+	}
+
 	// assumes i1 and i2 are connected
 	SizeType calcDir(SizeType,SizeType) const
 	{
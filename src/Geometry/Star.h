@@ -84,6 +84,9 @@ namespace PsimagLite {
 template<typename ComplexOrRealType, typename InputType>
 class Star : public GeometryBase<ComplexOrRealType, InputType> {
 
+	typedef GeometryBase<ComplexOrRealType, InputType> GeometryBaseType;
+	typedef typename GeometryBaseType::VectorSizeType VectorSizeType;
+
 public:
 
 	enum { DIRECTION_S};
@@ -141,6 +144,13 @@ public:
 		return (i1 == 0 || i2 == 0);
 	}
 
+	// only the center has more than one connection
+	void connections(VectorSizeType& sites,SizeType site,SizeType linSize) const
+	{
+		if (site == 0) return GeometryBaseType::connections(sites,site,linSize);
+		this->connectionsAt(sites,site,linSize,&site,1);
+	}
+
 	// assumes i1 and i2 are connected
 	SizeType calcDir(SizeType,SizeType) const
 	{
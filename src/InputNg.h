@@ -84,6 +84,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <cassert>
 #include "Vector.h"
 #include <cstdlib>
@@ -92,35 +93,74 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "Matrix.h"
 #include "loki/TypeTraits.h"
 #include "PsiBase64.h"
+#include "InputNgNumbers.h"
 #include "Ainur/Ainur.h"
 
 namespace PsimagLite {
 
+//! True if InputCheckType has
+//! check(const String&, const InputNgNumbers&, SizeType) const,
+//! so that numbers need not be written back as tokens to be checked
+template<typename InputCheckType>
+class HasNumbersCheck {
+
+	typedef char One;
+	typedef struct { char a[2]; } Two;
+
+	template<typename U, bool (U::*)(const String&, const InputNgNumbers&, SizeType) const>
+	struct Check;
+
+	template<typename U>
+	static One test(Check<U, &U::check>*);
+
+	template<typename U>
+	static Two test(...);
+
+public:
+
+	enum {True = (sizeof(test<InputCheckType>(0)) == sizeof(One))};
+};
+
 template<typename InputCheckType>
 class InputNg {
 
+	// Labels without a number after @ first, then by root label (what is
+	// before @) and number; mysplit is called for each comparison, so that
+	// it does not copy the root label
 	class MyCompare {
 
 		enum {FIRST,SECOND};
 
 		typedef std::pair<String,SizeType> PairType;
 
+		typedef std::pair<SizeType,SizeType> PairSizeType;
+
 	public:
 
 		bool operator()(const String& x1,const String& x2) const
 		{
-			PairType p1 = mysplit(x1);
-			PairType p2 = mysplit(x2);
+			PairSizeType p1 = mysplitFast(x1);
+			PairSizeType p2 = mysplitFast(x2);
 			if (p1.second==0 && p2.second==0)
 				return (x1<x2);
 			if (p1.second==0) return true;
 			if (p2.second==0) return false;
-			if (p1.first!=p2.first) return (x1<x2);
+			if (x1.compare(0,p1.first,x2,0,p2.first) != 0) return (x1<x2);
 			return (p1.second<p2.second);
 		}
 
 	private:
 
+		// length of the root label, and number after @, as mysplit
+		PairSizeType mysplitFast(const String& x) const
+		{
+			long unsigned int at = x.find('@');
+			if (at == String::npos) return PairSizeType(x.length(),0);
+			if (x.find('@',at + 1) != String::npos)
+				return PairSizeType(at,mysplit(x).second);
+			return PairSizeType(at,atoi(x.c_str() + at + 1));
+		}
+
 		PairType mysplit(const String& x) const
 		{
 			SizeType mode=FIRST;
@@ -142,7 +182,12 @@ class InputNg {
 	typedef MyCompare MyCompareType;
 
 	typedef typename Map<String,String,MyCompareType>::Type MapStrStrType;
-	typedef typename Map<String,Vector<String>::Type,MyCompareType>::Type MapStrVecType;
+	typedef typename Map<String,InputNgNumbers,MyCompareType>::Type MapStrVecType;
+
+	typedef Map<String,SizeType>::Type MapStrSizeType;
+
+	// for each root label, the labels with it, last first
+	typedef Map<String,Vector<String>::Type>::Type IndexType;
 
 public:
 
@@ -158,7 +203,8 @@ public:
 		    : data_(""),
 		      line_(0),
 		      state_(IN_LABEL),
-		      numericVector_(0),
+		      numbers_(),
+		      tokens_(),
 		      lastLabel_(""),
 		      file_(file),
 		      inputCheck_(inputCheck),
@@ -175,7 +221,8 @@ public:
 		    : data_(""),
 		      line_(0),
 		      state_(IN_LABEL),
-		      numericVector_(0),
+		      numbers_(),
+		      tokens_(),
 		      lastLabel_(""),
 		      file_(file),
 		      inputCheck_(inputCheck),
@@ -262,10 +309,17 @@ public:
 				throw RuntimeError(s.c_str());
 			}
 
-			char c=0;
-			while (!fin.eof()) {
-				fin.get(c);
-				data_ += c;
+			// all at once, if the size of the file is known
+			fin.seekg(0,std::ios::end);
+			std::streamoff size = fin.tellg();
+			fin.seekg(0,std::ios::beg);
+			if (size > 0 && fin.good()) {
+				data_.resize(size);
+				fin.read(&data_[0],size);
+				data_.resize(fin.gcount());
+			} else {
+				fin.clear();
+				data_.assign(std::istreambuf_iterator<char>(fin),std::istreambuf_iterator<char>());
 			}
 
 			fin.close();
@@ -327,7 +381,6 @@ public:
 					if (state_==IN_VALUE_OR_LABEL) {
 						if (type==ALPHA_CHAR) {
 							checkNumbers();
-							numericVector_.clear();
 							state_=IN_LABEL;
 						} else {
 							state_=IN_VALUE_NUMERIC;
@@ -338,13 +391,14 @@ public:
 					break;
 				}
 			}
-			if (numericVector_.size()>0) checkNumbers();
+			if (numbers_.size() + tokens_.size() > 0) checkNumbers();
 		}
 
 		void saveBuffer(const String& buffer,SizeType whatchar)
 		{
-			String s(__FILE__);
-			String adjLabel="";
+			String s;
+			String adjLabel;
+			SizeType size = 0;
 			switch(state_) {
 			case IN_LABEL:
 				if (verbose_) std::cout<<"Read label="<<buffer<<"\n";
@@ -355,19 +409,24 @@ public:
 				break;
 			case IN_VALUE_OR_LABEL:
 				std::cerr<<"Line="<<line_<<"\n";
-				s += "Error while buffer=" + buffer;
+				s = String(__FILE__) + "Error while buffer=" + buffer;
 				s += String(" and current line=") + String("\n");
 				break;
 			case IN_VALUE_TEXT:
 				if (verbose_) std::cout<<"Read text value="<<buffer<<"\n";
-				adjLabel = adjLabelForDuplicates(lastLabel_,mapStrStr_);
+				adjLabel = adjLabelForDuplicates(lastLabel_,mapStrStr_,rootsStr_);
+				size = mapStrStr_.size();
 				mapStrStr_[adjLabel] = buffer;
+				if (mapStrStr_.size() > size) rootsStr_[findRootLabel(adjLabel)]++;
 				state_=IN_LABEL;
 				inputCheck_.check(adjLabel,buffer,line_);
 				break;
 			case IN_VALUE_NUMERIC:
 				if (verbose_) std::cout<<"Read numeric value="<<buffer<<"\n";
-				numericVector_.push_back(buffer);
+				if (HasNumbersCheck<InputCheckType>::True)
+					numbers_.push(buffer);
+				else
+					tokens_.push_back(buffer);
 				state_=IN_VALUE_OR_LABEL;
 				break;
 			}
@@ -385,40 +444,67 @@ public:
 			return ALPHA_CHAR;
 		}
 
+		// numbers_ goes to mapStrVec_, and is left empty; numbers_ was filled
+		// as the tokens were scanned, or, for an InputCheckType that checks
+		// tokens, is filled from tokens_ here
 		void checkNumbers()
 		{
-			if (numericVector_.size()==1) {
+			if (!HasNumbersCheck<InputCheckType>::True) numbers_.set(tokens_);
+
+			if (numbers_.size()==1) {
 				String s(__FILE__);
 				s += " use equal sign instead of space in line "+ttos(line_) + "\n";
 				throw RuntimeError(s.c_str());
 			}
 
 			String s(__FILE__);
-			if (numericVector_.size()==0) {
+			if (numbers_.size()==0) {
 				std::cerr<<"Line="<<line_<<"\n";
 				throw RuntimeError(s.c_str());
 			}
-			SizeType adjExpected = atoi(numericVector_[0].c_str());
+			SizeType adjExpected = numbers_.integer(0);
 
-			if (!inputCheck_.check(lastLabel_,numericVector_,line_) &&
-			    numericVector_.size()!=adjExpected+1) {
+			if (!inputCheckNumbers(inputCheck_) &&
+			    numbers_.size()!=adjExpected+1) {
 				std::cout<<" Number of numbers to follow is wrong, expected ";
 				std::cout<<adjExpected<<" got ";
-				std::cout<<(numericVector_.size()-1)<<"\n";
+				std::cout<<(numbers_.size()-1)<<"\n";
 				std::cerr<<"Line="<<line_<<"\n";
 				throw RuntimeError(s.c_str());
 			}
 
-			String adjLabel=adjLabelForDuplicates(lastLabel_,mapStrVec_);
-			mapStrVec_[adjLabel]=numericVector_;
+			String adjLabel=adjLabelForDuplicates(lastLabel_,mapStrVec_,rootsVec_);
+			SizeType size = mapStrVec_.size();
+			mapStrVec_[adjLabel].swap(numbers_);
+			numbers_.clear();
+			Vector<String>::Type().swap(tokens_);
+			if (mapStrVec_.size() > size) rootsVec_[findRootLabel(adjLabel)]++;
+
+		}
+
+		template<typename SomeInputCheckType>
+		typename EnableIf<HasNumbersCheck<SomeInputCheckType>::True,bool>::Type
+		inputCheckNumbers(const SomeInputCheckType& inputCheck) const
+		{
+			return inputCheck.check(lastLabel_,numbers_,line_);
+		}
 
+		template<typename SomeInputCheckType>
+		typename EnableIf<!HasNumbersCheck<SomeInputCheckType>::True,bool>::Type
+		inputCheckNumbers(const SomeInputCheckType& inputCheck) const
+		{
+			return inputCheck.check(lastLabel_,tokens_,line_);
 		}
 
+		// roots counts the labels of mymap with each root label
 		template<typename SomeMapType>
-		String adjLabelForDuplicates(const String& label,SomeMapType& mymap)
+		String adjLabelForDuplicates(const String& label,
+		                             SomeMapType&,
+		                             const MapStrSizeType& roots)
 		{
 			String rootLabel = findRootLabel(label);
-			int x = findLastOccurrence(rootLabel,mymap);
+			typename MapStrSizeType::const_iterator it = roots.find(rootLabel);
+			int x = (it == roots.end()) ? -1 : it->second - 1;
 			if (x<0) return label;
 			labelsForRemoval_.push_back(rootLabel);
 			x++;
@@ -427,17 +513,6 @@ public:
 			return newlabel;
 		}
 
-		template<typename SomeMapType>
-		int findLastOccurrence(const String& root1,SomeMapType& mymap)
-		{
-			int x = -1;
-			for (typename SomeMapType::iterator it=mymap.begin();it!=mymap.end();++it) {
-				String root2 = findRootLabel(it->first);
-				if (root1==root2) x++;
-			}
-			return x;
-		}
-
 		template<typename MapType>
 		typename EnableIf<IsMapLike<MapType>::True,void>::Type
 		printMap(MapType& mp,const String& label)
@@ -454,21 +529,24 @@ public:
 		String data_;
 		SizeType line_;
 		SizeType state_;
-		Vector<String>::Type numericVector_;
+		InputNgNumbers numbers_;
+		Vector<String>::Type tokens_;
 		String lastLabel_;
 		String file_;
 		InputCheckType inputCheck_;
 		bool verbose_;
 		bool ainurMode_;
 		typename Map<String,String,MyCompareType>::Type mapStrStr_;
-		typename Map<String,Vector<String>::Type,MyCompareType>::Type mapStrVec_;
+		typename Map<String,InputNgNumbers,MyCompareType>::Type mapStrVec_;
 		Vector<String>::Type labelsForRemoval_;
+		MapStrSizeType rootsStr_;
+		MapStrSizeType rootsVec_;
 	}; // class Writeable
 
 	class Readable {
 
 		typedef typename Map<String,String,MyCompareType>::Type::iterator MapStringIteratorType;
-		typedef typename Map<String,Vector<String>::Type,MyCompareType>::Type::iterator
+		typedef typename Map<String,InputNgNumbers,MyCompareType>::Type::iterator
 		                 MapStringVectorIteratorType;
 
 	public:
@@ -480,6 +558,11 @@ public:
 		      dummy_("")
 		{
 			inputWriteable.set(mapStrStr_,mapStrVec_,labelsForRemoval_);
+			makeIndex(indexStr_,mapStrStr_);
+			makeIndex(indexVec_,mapStrVec_);
+			removable_ = labelsForRemoval_;
+			std::sort(removable_.begin(),removable_.end());
+			removable_.erase(std::unique(removable_.begin(),removable_.end()),removable_.end());
 			if (inputWriteable.ainurMode())
 				ainur_ = new Ainur(inputWriteable.inputCheck().import() + data_);
 		}
@@ -702,7 +785,7 @@ public:
 			assert(len>1);
 			val.resize(len-1);
 			for (SizeType i=0;i<len-1;i++) {
-				val[i]=stringToComplexOrReal<NumericType>(it->second[i+1].c_str());
+				val[i]=numberToComplexOrReal<NumericType>(it->second,i+1);
 			}
 			cleanLabelsIfNeeded(label2,mapStrVec_,it);
 		}
@@ -721,7 +804,7 @@ public:
 			SizeType len =  it->second.size();
 			val.resize(len);
 			for (SizeType i=0;i<len;i++) {
-				val[i]=static_cast<NumericType>(atof(it->second[i].c_str()));
+				val[i]=static_cast<NumericType>(numberToReal(it->second,i));
 			}
 			cleanLabelsIfNeeded(label2,mapStrVec_,it);
 		}
@@ -738,15 +821,15 @@ public:
 			MapStringVectorIteratorType it =  findFirstValueForLabel(label2,mapStrVec_);
 			if (it==mapStrVec_.end()) throwWithMessage(label,label2);
 
-			if (it->second.size()<2 || atoi(it->second[0].c_str())<=0 ||
-			    atoi(it->second[1].c_str())<=0) {
+			if (it->second.size()<2 || it->second.integer(0)<=0 ||
+			    it->second.integer(1)<=0) {
 				String s(__FILE__);
 				s += " readMatrix: \n";
 				throw RuntimeError(s.c_str());
 			}
 
-			SizeType nrow = SizeType(atoi(it->second[0].c_str()));
-			SizeType ncol = SizeType(atoi(it->second[1].c_str()));
+			SizeType nrow = SizeType(it->second.integer(0));
+			SizeType ncol = SizeType(it->second.integer(1));
 			m.resize(nrow,ncol);
 			if (it->second.size()<2+nrow*ncol) {
 				String s(__FILE__);
@@ -756,7 +839,7 @@ public:
 			SizeType k = 2;
 			for (SizeType i=0;i<m.rows();i++)
 				for (SizeType j=0;j<m.cols();j++)
-					m(i,j) = atof(it->second[k++].c_str());
+					m(i,j) = numberToReal(it->second,k++);
 
 			cleanLabelsIfNeeded(label2,mapStrVec_,it);
 		}
@@ -774,15 +857,15 @@ public:
 			MapStringVectorIteratorType it =  findFirstValueForLabel(label2,mapStrVec_);
 			if (it==mapStrVec_.end()) throwWithMessage(label,label2);
 
-			if (it->second.size()<2 || atoi(it->second[0].c_str())<=0 ||
-			    atoi(it->second[1].c_str())<=0) {
+			if (it->second.size()<2 || it->second.integer(0)<=0 ||
+			    it->second.integer(1)<=0) {
 				String s(__FILE__);
 				s += " readMatrix: \n";
 				throw RuntimeError(s.c_str());
 			}
 
-			SizeType nrow = SizeType(atoi(it->second[0].c_str()));
-			SizeType ncol = SizeType(atoi(it->second[1].c_str()));
+			SizeType nrow = SizeType(it->second.integer(0));
+			SizeType ncol = SizeType(it->second.integer(1));
 			m.resize(nrow,ncol);
 			if (it->second.size()<2+nrow*ncol) {
 				String s(__FILE__);
@@ -792,7 +875,14 @@ public:
 			SizeType k = 2;
 			for (SizeType i=0;i<m.rows();i++) {
 				for (SizeType j=0;j<m.cols();j++) {
-					IstringStream is(it->second[k++]);
+					if (it->second.isNumeric()) {
+						m(i,j) = std::complex<FloatingType>(it->second.realPart(k),
+						                                    it->second.imagPart(k));
+						k++;
+						continue;
+					}
+
+					IstringStream is(it->second.token(k++));
 					is >> m(i,j);
 				}
 			}
@@ -806,18 +896,37 @@ public:
 
 	private:
 
+		// it is what findFirstValueForLabel(label,mymap) returned
 		template<typename SomeMapType>
 		void cleanLabelsIfNeeded(const String& label,
 		                         SomeMapType& mymap,
 		                         typename SomeMapType::iterator& it,
 		                         bool forceRemoval = false)
 		{
-			Vector<String>::Type::iterator it2 = find(labelsForRemoval_.begin(),
-			                                          labelsForRemoval_.end(),
-			                                          label);
-			if (it2!=labelsForRemoval_.end() || forceRemoval) mymap.erase(it);
+			bool removable = std::binary_search(removable_.begin(),removable_.end(),label);
+			if (!removable && !forceRemoval) return;
+
+			IndexType& index = indexOf(mymap);
+			typename IndexType::iterator it2 = index.find(label);
+			assert(it2 != index.end() && it2->second.back() == it->first);
+			it2->second.pop_back();
+			if (it2->second.size() == 0) index.erase(it2);
+			mymap.erase(it);
+		}
+
+		template<typename SomeMapType>
+		static void makeIndex(IndexType& index,const SomeMapType& mymap)
+		{
+			index.clear();
+			typename SomeMapType::const_reverse_iterator it = mymap.rbegin();
+			for (; it != mymap.rend(); ++it)
+				index[findRootLabel(it->first)].push_back(it->first);
 		}
 
+		IndexType& indexOf(const MapStrStrType&) { return indexStr_; }
+
+		IndexType& indexOf(const MapStrVecType&) { return indexVec_; }
+
 		String label2label(const String& label)
 		{
 			SizeType len = label.length();
@@ -830,17 +939,41 @@ public:
 			return label.substr(0,len);
 		}
 
+		// the first label of mymap, in its order, with root label label
 		template<typename SomeMapType>
 		typename SomeMapType::iterator findFirstValueForLabel(const String& label,
 		                                                      SomeMapType& mymap)
 		{
-			for (typename SomeMapType::iterator it=mymap.begin();it!=mymap.end();++it) {
-				String root2 = findRootLabel(it->first);
-				if (label==root2) {
-					return it;
-				}
-			}
-			return mymap.end();
+			IndexType& index = indexOf(mymap);
+			typename IndexType::const_iterator it = index.find(label);
+			if (it == index.end()) return mymap.end();
+			return mymap.find(it->second.back());
+		}
+
+		// the numbers were parsed when loading, unless one was not a number
+		double numberToReal(const InputNgNumbers& numbers,SizeType i) const
+		{
+			if (numbers.isNumeric()) return numbers.real(i);
+			return atof(numbers.token(i).c_str());
+		}
+
+		template<typename ComplexOrRealType>
+		typename EnableIf<IsComplexNumber<ComplexOrRealType>::True,ComplexOrRealType>::Type
+		numberToComplexOrReal(const InputNgNumbers& numbers,SizeType i) const
+		{
+			if (!numbers.isNumeric())
+				return stringToComplexOrReal<ComplexOrRealType>(numbers.token(i));
+			return ComplexOrRealType(numbers.realPart(i),numbers.imagPart(i));
+		}
+
+		template<typename ComplexOrRealType>
+		typename EnableIf<!IsComplexNumber<ComplexOrRealType>::True,
+		typename Real<ComplexOrRealType>::Type>::Type
+		numberToComplexOrReal(const InputNgNumbers& numbers,SizeType i) const
+		{
+			if (!numbers.isNumeric())
+				return stringToComplexOrReal<ComplexOrRealType>(numbers.token(i));
+			return static_cast<typename Real<ComplexOrRealType>::Type>(numbers.real(i));
 		}
 
 		template<typename ComplexOrRealType>
@@ -917,22 +1050,19 @@ public:
 		//serializr normal mapStrStr_
 		typename Map<String,String,MyCompareType>::Type mapStrStr_;
 		//serializr normal mapStrVec_
-		typename Map<String,Vector<String>::Type,MyCompareType>::Type mapStrVec_;
+		typename Map<String,InputNgNumbers,MyCompareType>::Type mapStrVec_;
 		//serializr normal labelsForRemoval_
 		Vector<String>::Type labelsForRemoval_;
 		Ainur* ainur_;
 		String dummy_;
+		IndexType indexStr_;
+		IndexType indexVec_;
+		Vector<String>::Type removable_;
 	}; // class Readable
 
 	static String findRootLabel(const String& label)
 	{
-		String buffer="";
-		SizeType len = label.length();
-		for (SizeType i=0;i<len;i++) {
-			if (label.at(i)=='@') break;
-			buffer += label.at(i);
-		}
-		return buffer;
+		return label.substr(0,label.find('@'));
 	}
 
 }; //InputNg
@@ -0,0 +1,342 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file InputNgNumbers.h
+ *
+ *  The numbers that follow a label of an InputNg file, parsed once
+ *
+ *  If every token is a real number or a complex number written as
+ *  (re,im) or (re), the numbers are kept in one vector of doubles, with
+ *  the imaginary parts interleaved if any token is complex; otherwise
+ *  the tokens are kept as strings. Tokens are parsed as they are
+ *  pushed, so that a long array is never held as strings. A real number
+ *  is parsed from its decimal digits and a power of ten when both are
+ *  exact in a double, which rounds as strtod does, and with strtod
+ *  otherwise.
+ */
+#ifndef PSI_INPUTNG_NUMBERS_H
+#define PSI_INPUTNG_NUMBERS_H
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include "Vector.h"
+#include "TypeToString.h"
+
+namespace PsimagLite {
+
+class InputNgNumbers {
+
+	// digits that an integer in a double holds exactly
+	enum {EXACT_DIGITS = 15, MAX_EXACT_POWER = 22};
+
+	// the numbers, shared by copies, so that InputNg::Readable does not
+	// copy them from InputNg::Writeable; push() makes them not shared
+	struct Storage {
+
+		Storage() : references(1) {}
+
+		SizeType references;
+		Vector<double>::Type values;
+	};
+
+public:
+
+	InputNgNumbers() : complex_(false), storage_(new Storage) {}
+
+	InputNgNumbers(const InputNgNumbers& other)
+	    : complex_(other.complex_), storage_(other.storage_), strings_(other.strings_)
+	{
+		++storage_->references;
+	}
+
+	~InputNgNumbers() { release(); }
+
+	InputNgNumbers& operator=(const InputNgNumbers& other)
+	{
+		if (storage_ == other.storage_) {
+			complex_ = other.complex_;
+			strings_ = other.strings_;
+			return *this;
+		}
+
+		release();
+		complex_ = other.complex_;
+		storage_ = other.storage_;
+		++storage_->references;
+		strings_ = other.strings_;
+		return *this;
+	}
+
+	void set(const Vector<String>::Type& tokens)
+	{
+		clear();
+		storage_->values.reserve(tokens.size());
+		for (SizeType i = 0; i < tokens.size(); ++i)
+			push(tokens[i]);
+	}
+
+	void clear()
+	{
+		complex_ = false;
+		Vector<String>::Type().swap(strings_);
+		if (storage_->references == 1) {
+			Vector<double>::Type().swap(storage_->values);
+			return;
+		}
+
+		release();
+		storage_ = new Storage;
+	}
+
+	// Appends the number of token; the first token that is not a number
+	// turns all of them into strings
+	void push(const String& token)
+	{
+		if (!isNumeric()) {
+			strings_.push_back(token);
+			return;
+		}
+
+		unshare();
+		if (!complex_ && token.length() > 0 && token[0] == '(') makeComplex();
+
+		SizeType i = size();
+		storage_->values.resize(complex_ ? 2*i + 2 : i + 1);
+		if (parse(i, token)) return;
+
+		storage_->values.resize(complex_ ? 2*i : i);
+		tokens(strings_);
+		strings_.push_back(token);
+		Vector<double>::Type().swap(storage_->values);
+		complex_ = false;
+	}
+
+	void swap(InputNgNumbers& other)
+	{
+		std::swap(complex_, other.complex_);
+		std::swap(storage_, other.storage_);
+		strings_.swap(other.strings_);
+	}
+
+	// The tokens, written again from the numbers if isNumeric(), so that
+	// they are read back as the same numbers
+	void tokens(Vector<String>::Type& v) const
+	{
+		if (!isNumeric()) {
+			v = strings_;
+			return;
+		}
+
+		SizeType n = size();
+		v.resize(n);
+		for (SizeType i = 0; i < n; ++i) {
+			if (complex_)
+				v[i] = "(" + toToken(realPart(i)) + "," + toToken(imagPart(i)) + ")";
+			else
+				v[i] = toToken(realPart(i));
+		}
+	}
+
+	SizeType size() const
+	{
+		if (strings_.size() > 0) return strings_.size();
+		return (complex_) ? storage_->values.size()/2 : storage_->values.size();
+	}
+
+	// False if the tokens are kept as strings
+	bool isNumeric() const { return (strings_.size() == 0); }
+
+	// Only if !isNumeric()
+	const String& token(SizeType i) const
+	{
+		assert(i < strings_.size());
+		return strings_[i];
+	}
+
+	// Only if isNumeric(); throws if the i-th number is not real
+	double real(SizeType i) const
+	{
+		if (imagPart(i) != 0)
+			throw RuntimeError("InputNg: number " + ttos(i) + " is complex, not real\n");
+		return realPart(i);
+	}
+
+	// Only if isNumeric()
+	double realPart(SizeType i) const
+	{
+		return (complex_) ? storage_->values[2*i] : storage_->values[i];
+	}
+
+	// Only if isNumeric()
+	double imagPart(SizeType i) const
+	{
+		return (complex_) ? storage_->values[2*i + 1] : 0;
+	}
+
+	// The i-th number as atoi converts its token, for the sizes that
+	// start the numbers of matrices
+	int integer(SizeType i) const
+	{
+		if (!isNumeric()) return atoi(strings_[i].c_str());
+		return static_cast<int>(realPart(i));
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, const InputNgNumbers& numbers)
+	{
+		SizeType n = numbers.size();
+		for (SizeType i = 0; i < n; ++i) {
+			if (i > 0) os<<" ";
+			if (!numbers.isNumeric())
+				os<<numbers.strings_[i];
+			else if (numbers.complex_)
+				os<<"("<<numbers.realPart(i)<<","<<numbers.imagPart(i)<<")";
+			else
+				os<<numbers.realPart(i);
+		}
+
+		return os;
+	}
+
+private:
+
+	// EXACT_DIGITS digits if they read back as x, else all of them
+	static String toToken(double x)
+	{
+		OstringStream msg;
+		msg.precision(EXACT_DIGITS);
+		msg<<x;
+		if (strtod(msg.str().c_str(), 0) == x) return msg.str();
+
+		OstringStream msg2;
+		msg2.precision(17);
+		msg2<<x;
+		return msg2.str();
+	}
+
+	void release()
+	{
+		if (--storage_->references == 0) delete storage_;
+	}
+
+	void unshare()
+	{
+		if (storage_->references == 1) return;
+		Storage* storage = new Storage;
+		storage->values = storage_->values;
+		release();
+		storage_ = storage;
+	}
+
+	// the reals so far become (re,0)
+	void makeComplex()
+	{
+		SizeType n = storage_->values.size();
+		storage_->values.resize(2*n);
+		for (SizeType i = n; i > 0; --i) {
+			storage_->values[2*i - 1] = 0;
+			storage_->values[2*i - 2] = storage_->values[i - 1];
+		}
+
+		complex_ = true;
+	}
+
+	bool parse(SizeType i, const String& token)
+	{
+		const char* p = token.c_str();
+		const char* end = p + token.length();
+		if (!complex_) return parseReal(storage_->values[i], p, end);
+
+		storage_->values[2*i + 1] = 0;
+		if (p == end || *p != '(') return parseReal(storage_->values[2*i], p, end);
+
+		--end;
+		if (end <= p || *end != ')') return false;
+		const char* comma = p + 1;
+		while (comma < end && *comma != ',') ++comma;
+		if (!parseReal(storage_->values[2*i], p + 1, comma)) return false;
+		return (comma == end || parseReal(storage_->values[2*i + 1], comma + 1, end));
+	}
+
+	// Parses [p, end) as sign, digits, dot, digits, and exponent, as strtod
+	// would, and returns false if it is not all a real number
+	static bool parseReal(double& x, const char* p, const char* end)
+	{
+		static const double powersOfTen[MAX_EXACT_POWER + 1] = {
+		    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '+' || *p == '-')) negative = (*p++ == '-');
+
+		double mantissa = 0;
+		SizeType digits = 0;
+		SizeType significant = 0;
+		int exponent = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+			mantissa = 10*mantissa + (*p - '0');
+			if (mantissa > 0) ++significant;
+		}
+
+		if (p < end && *p == '.') {
+			for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits, --exponent) {
+				mantissa = 10*mantissa + (*p - '0');
+				if (mantissa > 0) ++significant;
+			}
+		}
+
+		if (digits == 0) return false;
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			++p;
+			bool negativeExponent = false;
+			if (p < end && (*p == '+' || *p == '-')) negativeExponent = (*p++ == '-');
+			if (p == end) return false;
+			int e = 0;
+			for (; p < end && *p >= '0' && *p <= '9'; ++p)
+				if (e < 100000) e = 10*e + (*p - '0');
+			exponent += (negativeExponent) ? -e : e;
+		}
+
+		if (p != end) return false;
+
+		if (significant > EXACT_DIGITS ||
+		    exponent > MAX_EXACT_POWER ||
+		    exponent < -MAX_EXACT_POWER) {
+			// strtod stops where the number does
+			x = strtod(start, 0);
+			return true;
+		}
+
+		x = (exponent < 0) ? mantissa/powersOfTen[-exponent] : mantissa*powersOfTen[exponent];
+		if (negative) x = -x;
+		return true;
+	}
+
+	bool complex_;
+	Storage* storage_;
+	Vector<String>::Type strings_;
+}; // class InputNgNumbers
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_INPUTNG_NUMBERS_H
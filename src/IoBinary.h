@@ -119,7 +119,8 @@ Size of this part: 1 byte
 4.1 The 4 lower bits describe the native type, for example,
 int, SizeType, double, float, char *, ..., we have space here for 16 possibilities
 4.2 The 4 higher bits describe composite structures, for example,
-vector, matrix, etc. We might reserve the last bit to indicate complex.
+vector, matrix, etc. The highest bit means that the payload of a vector
+is compressed (see below); files without it are read as before.
 
 (5) The size of the payload
 Size of this part: sizeof(SizeType), usually 8 bytes
@@ -127,6 +128,12 @@ Size of this part: sizeof(SizeType), usually 8 bytes
 (6) The actual payload.
 Size of this part: variable
 
+Compressed vectors (Out with COMPRESS_VECTORS) have, after the size of
+the payload, the payload in chunks of COMPRESSION_CHUNK bytes (the last
+one may be shorter), each one as its stored size, sizeof(SizeType) bytes,
+and then the chunk, compressed with CompressLz, or as is if its stored
+size is its size.
+
 ----------------------------END OF SPECIFICATION -----------------------------------
 
 Example 1: print the label "Hello, World!"
@@ -172,6 +179,8 @@ If it were written in ascii = 43 bytes.
 #define IO_BINARY_H
 
 #include "BinarySaveLoad.h"
+#include "BufferedFileWriter.h"
+#include "CompressLz.h"
 #include "Stack.h"
 #include <utility>
 #include "Matrix.h"
@@ -180,6 +189,9 @@ If it were written in ascii = 43 bytes.
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <algorithm>
 
 namespace PsimagLite {
 	//! IoBinary class handles Input/Output (IO) in binary format
@@ -192,6 +204,10 @@ namespace PsimagLite {
 
 		enum {TYPE_VECTOR = 16,TYPE_MATRIX = 32, TYPE_PAIR = 48, TYPE_UNKNOWN = 64};
 
+		enum {TYPE_COMPRESSED = 128};
+
+		enum {COMPRESSION_CHUNK = 262144, MIN_COMPRESSED_BYTES = 4096};
+
 #ifdef HAVE_BINARY_IO
 		static const SizeType ENABLED=1;
 #else
@@ -200,13 +216,22 @@ namespace PsimagLite {
 
 	public:
 
+		// Writes go through a BufferedFileWriter, with a background thread
+		// if BACKGROUND_FLUSH; call flush() before reading a file that is
+		// still open. With COMPRESS_VECTORS, vectors of at least
+		// MIN_COMPRESSED_BYTES bytes are compressed
 		class Out {
 
 		public:
 
-			Out()  : rank_(0),fout_(-1) {}
+			enum OptionsEnum {BACKGROUND_FLUSH = 1, COMPRESS_VECTORS = 2};
+
+			typedef unsigned int long LongSizeType;
 
-			Out(const String& fn,int rank) : rank_(rank),filename_(fn),fout_(-1)
+			Out()  : rank_(0),fout_(-1),options_(0) {}
+
+			Out(const String& fn,int rank,SizeType options = 0)
+			    : rank_(rank),filename_(fn),fout_(-1),options_(options)
 			{
 				if (!ENABLED) return;
 				if (rank_!=0) return;
@@ -217,6 +242,8 @@ namespace PsimagLite {
 					s += "Cannot open file " + filename_ + " for writing\n";
 					throw RuntimeError(s.c_str());
 				}
+
+				writer_.attach(fout_,options_ & BACKGROUND_FLUSH);
 			}
 
 			~Out()
@@ -224,6 +251,12 @@ namespace PsimagLite {
 				if (!ENABLED) return;
 				if (rank_!=0) return;
 				if (fout_<0) return;
+				try {
+					writer_.detach();
+				} catch (std::exception& e) {
+					std::cerr<<"IoBinary::Out: "<<e.what();
+				}
+
 				::close(fout_);
 			}
 
@@ -234,6 +267,13 @@ namespace PsimagLite {
 				if (rank_!=0) return;
 				if (filename_=="OSTREAM")
 					throw RuntimeError("open: not possible\n");
+				// reopening writes out and closes the previous file
+				if (fout_>=0) {
+					writer_.detach();
+					::close(fout_);
+					fout_ = -1;
+				}
+
 				filename_=fn;
 				//if (!fout_) fout_=new std::ofstream;
 				int flags = 0;
@@ -242,6 +282,8 @@ namespace PsimagLite {
 				fout_ = ::open(fn.c_str(),flags, S_IRUSR | S_IWUSR);
 				if (fout_<0)
 					throw RuntimeError("Out: error while opening file!\n");
+
+				writer_.attach(fout_,options_ & BACKGROUND_FLUSH);
 			}
 
 			void close()
@@ -250,7 +292,17 @@ namespace PsimagLite {
 				if (fout_<0)
 					throw RuntimeError("close: not possible\n");
 				filename_="FILE_IS_CLOSED";
+				writer_.detach();
 				::close(fout_);
+				fout_ = -1;
+			}
+
+			//! Writes what is buffered to the file
+			void flush()
+			{
+				if (!ENABLED) return;
+				if (fout_<0) return;
+				writer_.flush();
 			}
 
 
@@ -272,21 +324,25 @@ namespace PsimagLite {
 				printLabel(label);
 
 				char check = 0;
-				BinarySaveLoad::mywrite(fout_, (const void *)&check,1);
+				writeBytes(&check,1);
 				SizeType total = 0;
-				BinarySaveLoad::mywrite(fout_, (const void *)&total,sizeof(total));
+				writeBytes(&total,sizeof(total));
 
 				typename X::value_type dummy;
+				SizeType length = x.size();
+				LongSizeType bytes = LongSizeType(length)*sizeof(dummy);
+				bool compressed = ((options_ & COMPRESS_VECTORS) && bytes >= MIN_COMPRESSED_BYTES);
 				TypeType type = TYPE_VECTOR | charTypeOf(dummy);
-				BinarySaveLoad::mywrite(fout_,(const void *)&type,sizeof(type));
-//				SizeType length = x.size();
-//				BinarySaveLoad::mywrite(fout_,(const void *)&length,sizeof(length));
-
-//				for (SizeType i=0;i<x.size();i++) {
-//					const typename X::value_type* const ptr = &(x[i]);
-//					BinarySaveLoad::mywrite(fout_, (const void *)ptr,sizeof(dummy));
-//				}
-				BinarySaveLoad::save(fout_,x);
+				if (compressed) type |= TYPE_COMPRESSED;
+				writeBytes(&type,sizeof(type));
+
+				writeBytes(&length,sizeof(length));
+				if (length == 0) return;
+				const char* ptr = reinterpret_cast<const char*>(&(x[0]));
+				if (compressed)
+					writeCompressed(ptr,bytes);
+				else
+					writeBytes(ptr,bytes);
 			}
 
 			template<class T>
@@ -297,15 +353,15 @@ namespace PsimagLite {
 				makeSureFileIsOpen();
 				printLabel(s);
 				char check = 0;
-				BinarySaveLoad::mywrite(fout_, (const void *)&check,1);
+				writeBytes(&check,1);
 
 				SizeType total = 1;
-				BinarySaveLoad::mywrite(fout_, (const void *)&total,sizeof(total));
+				writeBytes(&total,sizeof(total));
 
 				TypeType type = charTypeOf(something);
-				BinarySaveLoad::mywrite(fout_,(const void *)&type,sizeof(type));
+				writeBytes(&type,sizeof(type));
 
-				BinarySaveLoad::save(fout_,something);
+				printItem(something);
 			}
 
 			void print(const String& s)
@@ -313,10 +369,10 @@ namespace PsimagLite {
 				if (!ENABLED) return;
 				printLabel(s);
 				char check = 0;
-				BinarySaveLoad::mywrite(fout_, (const void *)&check,1);
+				writeBytes(&check,1);
 
 				SizeType total = 0;
-				BinarySaveLoad::mywrite(fout_, (const void *)&total,sizeof(total));
+				writeBytes(&total,sizeof(total));
 			}
 
 			template<typename SomeMatrixType>
@@ -328,13 +384,17 @@ namespace PsimagLite {
 
 				char check = 0;
 
-				BinarySaveLoad::mywrite(fout_, (const void *)&check,1);
+				writeBytes(&check,1);
 
 				SizeType total = 0;
 
-				BinarySaveLoad::mywrite(fout_, (const void *)&total,sizeof(total));
+				writeBytes(&total,sizeof(total));
+
+				typename SomeMatrixType::value_type dummy = 0;
+				TypeType type = TYPE_MATRIX | charTypeOf(dummy);
+				writeBytes(&type,sizeof(type));
 
-				BinarySaveLoad::save(fout_,mat);
+				printMatrixItem(mat);
 			}
 
 //			template<typename SomeType>
@@ -371,10 +431,68 @@ namespace PsimagLite {
 				makeSureFileIsOpen();
 
 				char label1[] = {'L','A','B','E','L'};
-				BinarySaveLoad::mywrite(fout_,label1,5);
+				writeBytes(label1,5);
 				SizeType length = s.length();
-				BinarySaveLoad::mywrite(fout_,(const void *)&length,sizeof(length));
-				BinarySaveLoad::mywrite(fout_, (const void *)&(s[0]),length);
+				writeBytes(&length,sizeof(length));
+				writeBytes(s.c_str(),length);
+			}
+
+			void writeBytes(const void* buf,LongSizeType count)
+			{
+				writer_.write(buf,count);
+			}
+
+			// chunk by chunk, as described at the top of this file
+			void writeCompressed(const char* ptr,LongSizeType bytes)
+			{
+				scratch_.resize(CompressLz::bound(COMPRESSION_CHUNK));
+				for (LongSizeType offset = 0; offset < bytes; offset += COMPRESSION_CHUNK) {
+					SizeType chunk = std::min(bytes - offset,LongSizeType(COMPRESSION_CHUNK));
+					SizeType stored = CompressLz::compress(&(scratch_[0]),ptr + offset,chunk);
+					if (stored >= chunk) {
+						writeBytes(&chunk,sizeof(chunk));
+						writeBytes(ptr + offset,chunk);
+						continue;
+					}
+
+					writeBytes(&stored,sizeof(stored));
+					writeBytes(&(scratch_[0]),stored);
+				}
+			}
+
+			template<typename T>
+			void printItem(const T& something)
+			{
+				writer_.flush();
+				BinarySaveLoad::save(fout_,something);
+			}
+
+			void printItem(int x) { writeBytes(&x,sizeof(x)); }
+
+			void printItem(SizeType x) { writeBytes(&x,sizeof(x)); }
+
+			void printItem(double x) { writeBytes(&x,sizeof(x)); }
+
+			void printItem(float x) { writeBytes(&x,sizeof(x)); }
+
+			void printItem(bool x) { writeBytes(&x,sizeof(x)); }
+
+			//! As Matrix::print(int) writes it
+			template<typename T>
+			void printMatrixItem(const Matrix<T>& mat)
+			{
+				SizeType ncol = mat.n_col();
+				SizeType nrow = mat.n_row();
+				writeBytes(&ncol,sizeof(ncol));
+				writeBytes(&nrow,sizeof(nrow));
+				if (nrow*ncol > 0) writeBytes(&(mat(0,0)),LongSizeType(nrow)*ncol*sizeof(T));
+			}
+
+			template<typename SomeMatrixType>
+			void printMatrixItem(const SomeMatrixType& mat)
+			{
+				writer_.flush();
+				mat.print(fout_);
 			}
 
 			void makeSureFileIsOpen() const
@@ -390,56 +508,52 @@ namespace PsimagLite {
 			int rank_;
 			String filename_;
 			int fout_;
+			SizeType options_;
+			BufferedFileWriter writer_;
+			Vector<char>::Type scratch_;
 		}; // class Out
 
+		// The file is mapped in memory (or read at once if it cannot be
+		// mapped), and the offsets of its labels are found in one pass, the
+		// first time they are needed; then advance only looks at the labels,
+		// and payloads are copied out of the mapping with memcpy
 		class In {
 
 		public:
 
 			static const int LAST_INSTANCE=-1;
-			static const SizeType MEMORY_POOL_SIZE = 10240;
-			typedef int long long LongIntegerType;
-			typedef unsigned int long long LongSizeType;
+			typedef int long LongIntegerType;
+			typedef unsigned int long LongSizeType;
 
-			In() : filename_(""),fin_(-1),memoryPool_(0)
+			In() : filename_(""),data_(0),size_(0),mapped_(false),pos_(0),indexed_(false)
 			{}
 
-			In(String const &fn) : filename_(fn), fin_(-1),memoryPool_(0)
+			In(String const &fn)
+			    : filename_(fn),data_(0),size_(0),mapped_(false),pos_(0),indexed_(false)
 			{
 				if (!ENABLED) return;
-				fin_= ::open(fn.c_str(),O_RDONLY);
-				if (fin_<0) {
-					String s = "IoBinary::ctor(...): Can't open file "
-							+filename_+"\n";
-					throw RuntimeError(s.c_str());
-				}
+				map("IoBinary::ctor(...): Can't open file ");
 			}
 
 			~In()
 			{
 				if (!ENABLED) return;
-				if (memoryPool_) delete [] memoryPool_;
-				if (fin_>0) ::close(fin_);
+				unmap();
 			}
 
 			void open(String const &fn)
 			{
 				if (!ENABLED) return;
+				unmap();
 				filename_=fn;
-				fin_= ::open(fn.c_str(),O_RDONLY);
-				if (fin_<0) {
-					String s = "IoBinaryIn::open(...) failed for file "
-							+ filename_ + "\n";
-					throw RuntimeError(s.c_str());
-				}
+				map("IoBinaryIn::open(...) failed for file ");
 			}
 
 			void close()
 			{
 				if (!ENABLED) return;
 				filename_="FILE_IS_CLOSED";
-				assert(fin_>=0);
-				::close(fin_);
+				unmap();
 			}
 
 			template<typename X>
@@ -460,7 +574,7 @@ namespace PsimagLite {
 					throw RuntimeError(str.c_str());
 				}
 
-				myread(fin_,&x,sizeof(x));
+				copyOut(&x,sizeof(x));
 
 				return sc.second;
 
@@ -479,8 +593,8 @@ namespace PsimagLite {
 				SizeType total = 0;
 				PairType type;
 				readCheckTotalAndType(check,total,type);
-				if (type.second == TYPE_VECTOR) {
-					readVector(x);
+				if ((type.second & ~TYPE_COMPRESSED) == TYPE_VECTOR) {
+					readVector(x,type.second & TYPE_COMPRESSED);
 					return sc;
 				}
 
@@ -534,15 +648,13 @@ namespace PsimagLite {
 //				return sc;
 //			}
 
+			//! Labels starting with s after the current position
 			SizeType count(const String& s)
 			{
 				if (!ENABLED) return 0;
 				SizeType counter = 0;
-				while(true) {
-					String temp = readNextLabel();
-					if (temp=="NOTFOUND") break;
-					counter++;
-				}
+				for (SizeType i = firstLabel(); i < labels_.size(); ++i)
+					if (labels_[i].name.substr(0,s.size())==s) counter++;
 				return counter;
 			}
 
@@ -551,17 +663,16 @@ namespace PsimagLite {
 							      bool beQuiet=false)
 			{
 				if (!ENABLED) return std::pair<String,SizeType>("NOT_ENALBED",0);
-				//String temp="NOTFOUND";
 				String tempSaved="NOTFOUND";
 				LongSizeType counter=0;
 				bool found=false;
-				//SizeType c = 0;
-				while(true) {
-
-					String temp = readNextLabel();
-					if (temp=="NOTFOUND") break;
+				SizeType i = firstLabel();
+				SizeType lastFound = labels_.size();
+				for (; i < labels_.size(); ++i) {
+					const String& temp = labels_[i].name;
 					if (temp.substr(0,s.size())==s) {
 						tempSaved = temp;
+						lastFound = i;
 						if (level>=0 && counter==LongSizeType(level)) {
 							found=true;
 							break;
@@ -569,14 +680,13 @@ namespace PsimagLite {
 						counter++;
 					}
 				}
+
 				if (level==LAST_INSTANCE && tempSaved!="NOTFOUND") {
-					::close(fin_);
-					fin_ = ::open(filename_.c_str(),O_RDONLY);
-					if (counter>1) advance(s,counter-2);
+					pos_ = labels_[lastFound].end;
 					return std::pair<String,SizeType>(tempSaved,counter);
 				}
 
-				//std::cerr<<"count="<<c<<"\n";
+				pos_ = (found) ? labels_[i].end : size_;
 				if (!found && tempSaved=="NOTFOUND") {
 					if (!beQuiet) {
 						std::cerr<<"Not found "<<s<<" in file "<<filename_;
@@ -650,13 +760,12 @@ namespace PsimagLite {
 			{
 				if (!ENABLED) return;
 				advance(s,level);
-				std::cerr<<"FOUND--------->\n";
 				char check = 0;
 				SizeType total = 0;
 				PairType type;
 				readCheckTotalAndType(check,total,type);
 				if (type.second == TYPE_MATRIX) {
-					readMatrix(mat,s);
+					readMatrix(mat);
 					return;
 				}
 
@@ -681,9 +790,7 @@ namespace PsimagLite {
 			void rewind()
 			{
 				if (!ENABLED) return;
-				throw RuntimeError("IoBinary::rewind(): Unimplemented\n");
-//				fin_.clear(); // forget we hit the end of file
-//				fin_.seekg(0, std::ios::beg); // move to the start of the file
+				pos_ = 0;
 			}
 
 			const char* filename() const
@@ -697,65 +804,26 @@ namespace PsimagLite {
 			String readNextLabel()
 			{
 				if (!ENABLED) return "NOT_ENABLED";
-				String magicLabel = "LABEL";
-				char c = 0;
-				SizeType j= 0;
-				while (true) {
-					int x = ::read(fin_,&c,1);
-					if (x!=1) {
-						String s(__FILE__);
-						s += " " + ttos(__LINE__);
-						s += "\nCannot read next label\n";
-						return "NOTFOUND";
-						//throw RuntimeError(s.c_str());
-					}
-					if (c==magicLabel[j]) {
-						j++;
-					} else {
-						j=0;
-					}
-					//std::cerr<<"j="<<j<<" "<<magicLabel.length()<<"\n";
-					if (j==magicLabel.length()) break;
+				SizeType i = firstLabel();
+				if (i == labels_.size()) {
+					pos_ = size_;
+					return "NOTFOUND";
 				}
 
-				SizeType y = 0;
-				int x = ::read(fin_,&y,sizeof(y));
-				if (x!=sizeof(y)) {
-					String s(__FILE__);
-					s += " " + ttos(__LINE__);
-					s += "\nCannot read next label (2)\n";
-					throw RuntimeError(s.c_str());
-				}
-
-				if (SizeType(y)>=MEMORY_POOL_SIZE) {
-					String s(__FILE__);
-					s += " "  + ttos(__LINE__) + "\nMemory Pool " + ttos(MEMORY_POOL_SIZE);
-					s +=  " is too small, needed " + ttos(y) + "\n";
-				}
-				if (!memoryPool_) memoryPool_ = new TypeType[MEMORY_POOL_SIZE];
-				x = ::read(fin_,memoryPool_,y);
-				if (SizeType(x)!=y) {
-					String s(__FILE__);
-					s += " " + ttos(__LINE__);
-					s += "\nCannot read next label (3)\n";
-					throw RuntimeError(s.c_str());
-				}
-				String ret="";
-				for (SizeType i=0;i<SizeType(x);i++) ret += memoryPool_[i];
-				std::cerr<<"FOUND!!! ret="<<ret<<"\n";
-				return ret;
-
+				pos_ = labels_[i].end;
+				return labels_[i].name;
 			}
 
 			void readCheckTotalAndType(char& check,SizeType& total,PairType& type)
 			{
 				if (!ENABLED) return;
 				check = 0;
-				myread(fin_,&check,1);
+				copyOut(&check,1);
 				total = 0;
-				myread(fin_,&total,sizeof(total));
-				type.first = 0;
-				myread(fin_,&type.first,1);
+				copyOut(&total,sizeof(total));
+				TypeType t = 0;
+				copyOut(&t,1);
+				type.first = t;
 				type.second = type.first;
 				type.second &= 240;
 				//type.second >>= 4;
@@ -772,53 +840,73 @@ namespace PsimagLite {
 				else if (type.first==TYPE_DOUBLE) type1="DOUBLE";
 
 				String type2 = "";
-				if (type.second==TYPE_VECTOR) type2="VECTOR";
-				if (type.second==TYPE_MATRIX) type2="MATRIX";
-				if (type.second==TYPE_PAIR) type2="PAIR";
-				if (type.second==TYPE_UNKNOWN) type2="UNKNOWN";
+				SizeType composite = type.second & ~TYPE_COMPRESSED;
+				if (composite==TYPE_VECTOR) type2="VECTOR";
+				if (composite==TYPE_MATRIX) type2="MATRIX";
+				if (composite==TYPE_PAIR) type2="PAIR";
+				if (composite==TYPE_UNKNOWN) type2="UNKNOWN";
+				if (type.second & TYPE_COMPRESSED) type2 += " COMPRESSED";
 
 				return type1 + " " + type2;
 			}
 
 		private:
 
-			template<typename X>
-			void readVector(typename Vector<X>::Type& x)
+			struct LabelType {
+
+				LabelType(const String& label,LongSizeType labelStart,LongSizeType labelEnd)
+				    : name(label),start(labelStart),end(labelEnd)
+				{}
+
+				String name;
+				LongSizeType start; // offset of the magic word LABEL
+				LongSizeType end; // offset of what follows the label
+			};
+
+			typedef Vector<LabelType>::Type VectorLabelType;
+
+			In(const In&);
+
+			In& operator=(const In&);
+
+			template<typename VectorLikeType>
+			void readVector(VectorLikeType& x,bool compressed)
 			{
 				SizeType xsize = 0;
-				myread(fin_,&xsize,sizeof(xsize));
-
-				std::cerr<<"xsize="<<xsize<<"\n";
+				copyOut(&xsize,sizeof(xsize));
 				x.resize(xsize);
-
-				X tmp;
-				for (SizeType i=0;i<xsize;i++) {
-					int l = ::read(fin_,&tmp,sizeof(tmp));
-					if (l!=sizeof(tmp)) throw RuntimeError("Mmm!\n");
-					x[i]=tmp;
-				}
+				if (xsize == 0) return;
+				LongSizeType bytes = LongSizeType(xsize)*sizeof(typename VectorLikeType::value_type);
+				char* ptr = reinterpret_cast<char*>(&(x[0]));
+				if (compressed)
+					copyOutCompressed(ptr,bytes);
+				else
+					copyOut(ptr,bytes);
 			}
 
-			void readVector(typename Vector<bool>::Type& x)
+			void readVector(Vector<bool>::Type& x,bool compressed)
 			{
 				SizeType xsize = 0;
-				myread(fin_,&xsize,sizeof(xsize));
-
-				std::cerr<<"xsize="<<xsize<<"\n";
+				copyOut(&xsize,sizeof(xsize));
 				x.resize(xsize);
 
-				typename Vector<char>::Type tmp(xsize);
-
-				int l = ::read(fin_,&(tmp[0]),xsize);
-				if (SizeType(l)!=xsize) throw RuntimeError("Mmm!\n");
+				Vector<char>::Type tmp(xsize);
+				if (xsize > 0 && compressed) copyOutCompressed(&(tmp[0]),xsize);
+				else if (xsize > 0) copyOut(&(tmp[0]),xsize);
 
 				convertToBool(x,tmp);
 			}
 
+			//! As written by Matrix::print(int)
 			template<typename X>
 			void readMatrix(Matrix<X> &mat)
 			{
-				mat.read(fin_);
+				SizeType ncol = 0;
+				SizeType nrow = 0;
+				copyOut(&ncol,sizeof(ncol));
+				copyOut(&nrow,sizeof(nrow));
+				mat.reset(nrow,ncol);
+				if (nrow*ncol > 0) copyOut(&(mat(0,0)),LongSizeType(nrow)*ncol*sizeof(X));
 			}
 
 			//! full contains label[key]=value
@@ -848,15 +936,145 @@ namespace PsimagLite {
 //				x = atof(val.c_str());
 //			}
 
-			void myread(int fd, void *buf, SizeType count)
+			void map(const String& msg)
+			{
+				int fd = ::open(filename_.c_str(),O_RDONLY);
+				if (fd<0) {
+					String s = msg + filename_ + "\n";
+					throw RuntimeError(s.c_str());
+				}
+
+				struct stat info;
+				if (fstat(fd,&info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+					void* ptr = mmap(0,info.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+					if (ptr != MAP_FAILED) {
+						data_ = static_cast<const char*>(ptr);
+						size_ = info.st_size;
+						mapped_ = true;
+					}
+				}
+
+				if (!mapped_) readAll(fd);
+
+				::close(fd);
+			}
+
+			// for files that cannot be mapped, such as pipes
+			void readAll(int fd)
 			{
-				sSizeType ret = ::read(fd,buf,count);
-				failIfNegative(ret,__FILE__,__LINE__);
+				const LongSizeType chunk = 1048576;
+				LongSizeType total = 0;
+				while (true) {
+					buffer_.resize(total + chunk);
+					ssize_t ret = ::read(fd,&(buffer_[total]),chunk);
+					failIfNegative(ret,__FILE__,__LINE__);
+					if (ret == 0) break;
+					total += ret;
+				}
+
+				buffer_.resize(total);
+				data_ = (total > 0) ? &(buffer_[0]) : 0;
+				size_ = total;
+			}
+
+			void unmap()
+			{
+				if (mapped_) munmap(const_cast<char*>(data_),size_);
+				mapped_ = false;
+				data_ = 0;
+				size_ = pos_ = 0;
+				buffer_.clear();
+				labels_.clear();
+				indexed_ = false;
+			}
+
+			// Finds each magic word LABEL, and its label, as readNextLabel
+			// used to do reading the file byte by byte
+			void index()
+			{
+				indexed_ = true;
+				const String magicLabel = "LABEL";
+				const LongSizeType m = magicLabel.length();
+				LongSizeType k = 0;
+				while (k + m <= size_) {
+					const void* ptr = memchr(data_ + k,magicLabel[0],size_ - k - m + 1);
+					if (!ptr) break;
+					k = static_cast<const char*>(ptr) - data_;
+					if (memcmp(data_ + k,magicLabel.c_str(),m) != 0) {
+						k++;
+						continue;
+					}
+
+					LongSizeType start = k;
+					k += m;
+					SizeType length = 0;
+					if (k + sizeof(length) > size_) break;
+					memcpy(&length,data_ + k,sizeof(length));
+					k += sizeof(length);
+					if (length > size_ - k) continue;
+					labels_.push_back(LabelType(String(data_ + k,length),start,k + length));
+					k += length;
+				}
+			}
+
+			// the first label not before the current position
+			SizeType firstLabel()
+			{
+				if (!indexed_) index();
+				SizeType lo = 0;
+				SizeType hi = labels_.size();
+				while (lo < hi) {
+					SizeType mid = (lo + hi)/2;
+					if (labels_[mid].start < pos_) lo = mid + 1;
+					else hi = mid;
+				}
+
+				return lo;
+			}
+
+			void checkAvailable(LongSizeType bytes) const
+			{
+				if (bytes <= size_ - pos_) return;
+				String str(__FILE__);
+				str += " " + ttos(__LINE__) + "\n";
+				str += "Reading past the end of file " + filename_ + "\n";
+				throw RuntimeError(str.c_str());
+			}
+
+			void copyOut(void* dest,LongSizeType bytes)
+			{
+				checkAvailable(bytes);
+				memcpy(dest,data_ + pos_,bytes);
+				pos_ += bytes;
+			}
+
+			// as Out::writeCompressed writes it; chunks are decompressed
+			// from the mapping into dest
+			void copyOutCompressed(char* dest,LongSizeType bytes)
+			{
+				for (LongSizeType offset = 0; offset < bytes; offset += COMPRESSION_CHUNK) {
+					SizeType chunk = std::min(bytes - offset,LongSizeType(COMPRESSION_CHUNK));
+					SizeType stored = 0;
+					copyOut(&stored,sizeof(stored));
+					if (stored == chunk) {
+						copyOut(dest + offset,chunk);
+						continue;
+					}
+
+					checkAvailable(stored);
+					CompressLz::decompress(dest + offset,chunk,data_ + pos_,stored);
+					pos_ += stored;
+				}
 			}
 
 			String filename_;
-			int 	fin_;
-			TypeType* memoryPool_;
+			const char* data_;
+			LongSizeType size_;
+			bool mapped_;
+			Vector<char>::Type buffer_;
+			LongSizeType pos_;
+			bool indexed_;
+			VectorLabelType labels_;
 		};
 
 		template<typename T>
@@ -907,7 +1125,7 @@ namespace PsimagLite {
 			}
 		}
 
-		static void failIfNegative(const sSizeType& x,const String& thisFile,int lineno)
+		static void failIfNegative(const ssize_t& x,const String& thisFile,int lineno)
 		{
 			if (x>=0) return;
 			String str(thisFile);
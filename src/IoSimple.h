@@ -88,6 +88,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "Map.h"
 #include "Concurrency.h"
 #include "Stack.h"
+#include "IoSimpleIndex.h"
 
 namespace PsimagLite {
 //! IoSimple class handles Input/Output (IO) for the Dmrg++ program
@@ -254,6 +255,8 @@ public:
 				        +filename_+"\n";
 				throw RuntimeError(s.c_str());
 			}
+
+			index_.reset(filename_);
 		}
 
 		~In()
@@ -270,16 +273,52 @@ public:
 				        + filename_ + "\n";
 				throw RuntimeError(s.c_str());
 			}
+
+			index_.reset(filename_);
 		}
 
 		void close()
 		{
 			filename_="FILE_IS_CLOSED";
 			fin_.close();
+			index_.reset(filename_);
 		}
 
+		// Labels are found with IoSimpleIndex, if s is a label, else by
+		// reading the file
 		template<typename X>
 		SizeType readline(X &x,const String &s,LongIntegerType level=0)
+		{
+			const IoSimpleIndex::VectorEntryType* occurrences = index_.find(s);
+			if (!occurrences) return readlineByScanning(x,s,level);
+
+			if (fin_.bad() || !fin_.good()) throw RuntimeError("Readline\n");
+			SizeType first = firstOccurrence(*occurrences);
+			LongSizeType counter = occurrences->size() - first;
+			if (counter == 0 || (level!=LAST_INSTANCE && LongSizeType(level)>=counter)) {
+				String emessage =
+				        "IoSimple::In::readline(): Not found "+s+
+				        " in file "+filename_;
+				throw RuntimeError(emessage.c_str());
+			}
+
+			if (level==LAST_INSTANCE) {
+				fin_.close();
+				fin_.open(filename_.c_str());
+				readline(x,s,counter-1);
+				return counter;
+			}
+
+			const IoSimpleIndex::EntryType& entry = (*occurrences)[first + level];
+			IstringStream temp2(entry.first.substr(s.size(),entry.first.size()));
+			temp2 >> x;
+			fin_.seekg(entry.second + entry.first.size(), std::ios::beg);
+			return level;
+		}
+
+		// readline, reading the file instead of using the index
+		template<typename X>
+		SizeType readlineByScanning(X &x,const String &s,LongIntegerType level=0)
 		{
 			String temp;
 			bool found=false;
@@ -400,10 +439,50 @@ public:
 			return sc;
 		}
 
+		// Labels are found with IoSimpleIndex, if s is a label, else by
+		// reading the file
 		std::pair<String,SizeType> advance(String const &s,
 		                                   LongIntegerType level=0,
 		                                   bool beQuiet=false)
 		{
+			const IoSimpleIndex::VectorEntryType* occurrences = index_.find(s);
+			if (!occurrences) return advanceByScanning(s,level,beQuiet);
+
+			SizeType first = firstOccurrence(*occurrences);
+			LongSizeType counter = occurrences->size() - first;
+			if (counter == 0) {
+				if (!beQuiet) {
+					std::cerr<<"Not found "<<s<<" in file "<<filename_;
+					std::cerr<<" level="<<level<<" counter="<<counter<<"\n";
+				}
+				throw RuntimeError("IoSimple::In::read()\n");
+			}
+
+			const String& last = occurrences->back().first;
+			if (level==LAST_INSTANCE) {
+				fin_.close();
+				fin_.open(filename_.c_str());
+				if (counter>1) advance(s,counter-2);
+				return std::pair<String,SizeType>(last,counter);
+			}
+
+			if (LongSizeType(level) >= counter) {
+				// as advanceByScanning does, the last one, at the end of the file
+				fin_.seekg(0, std::ios::end);
+				fin_.peek();
+				return std::pair<String,SizeType>(last,counter);
+			}
+
+			const IoSimpleIndex::EntryType& entry = (*occurrences)[first + level];
+			fin_.seekg(entry.second + entry.first.size(), std::ios::beg);
+			return std::pair<String,SizeType>(entry.first,level);
+		}
+
+		// advance, reading the file instead of using the index
+		std::pair<String,SizeType> advanceByScanning(String const &s,
+		                                             LongIntegerType level=0,
+		                                             bool beQuiet=false)
+		{
 
 			String temp="NOTFOUND";
 			String tempSaved="NOTFOUND";
@@ -464,6 +543,13 @@ public:
 
 		SizeType count(const String& s)
 		{
+			const IoSimpleIndex::VectorEntryType* occurrences = index_.find(s);
+			if (occurrences) {
+				SizeType n = occurrences->size() - firstOccurrence(*occurrences);
+				rewind();
+				return n;
+			}
+
 			SizeType i = 0;
 			while (i<1000) {
 				try {
@@ -477,7 +563,7 @@ public:
 
 			String ss = "IoSimple::count(...): too many "
 			        +s+" in file "+filename_+"\n";
-			throw RuntimeError(s.c_str());
+			throw RuntimeError(ss.c_str());
 
 		}
 
@@ -551,6 +637,15 @@ public:
 
 	private:
 
+		// first of occurrences not before the next character to read
+		SizeType firstOccurrence(const IoSimpleIndex::VectorEntryType& occurrences)
+		{
+			if (!fin_.good()) return occurrences.size();
+			std::streamoff offset = fin_.tellg();
+			if (offset < 0) return occurrences.size();
+			return IoSimpleIndex::firstAfter(occurrences, offset);
+		}
+
 		//! full contains label[key]=value
 		template<typename X>
 		void getKey(String& key,X& x,const String& full)
@@ -580,6 +675,7 @@ public:
 
 		String filename_;
 		std::ifstream fin_;
+		IoSimpleIndex index_;
 	};
 }; //class IoSimple
 
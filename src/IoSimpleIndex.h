@@ -0,0 +1,293 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file IoSimpleIndex.h
+ *
+ *  Byte offsets of the labels of a text file, for IoSimple::In
+ *
+ *  Tokens are separated by white space, as for operator>>. A token is a
+ *  label if it does not start as a number does (a digit, a sign, a dot
+ *  or a parenthesis), so that data is not indexed. The index is made in
+ *  one pass over the file, the first time it is needed, and, for files
+ *  of SIDECAR_MIN_SIZE bytes or more, saved next to the file, as
+ *  file + ".psiIndex", with the size, inode and modification time (to the
+ *  nanosecond) of the file, and a checksum of its first and last blocks;
+ *  it is used again if none of those have changed.
+ */
+#ifndef PSI_IOSIMPLE_INDEX_H
+#define PSI_IOSIMPLE_INDEX_H
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include "Vector.h"
+#include "Map.h"
+#include "TypeToString.h"
+
+namespace PsimagLite {
+
+class IoSimpleIndex {
+
+public:
+
+	typedef unsigned int long LongSizeType;
+	typedef std::pair<String, LongSizeType> EntryType;
+	typedef Vector<EntryType>::Type VectorEntryType;
+
+	// Smaller files are indexed in memory only
+	static const LongSizeType SIDECAR_MIN_SIZE = 16777216;
+
+	IoSimpleIndex() : built_(false), usable_(false) {}
+
+	void reset(const String& filename)
+	{
+		filename_ = filename;
+		built_ = usable_ = false;
+		entries_.clear();
+		byPrefix_.clear();
+	}
+
+	// True if all tokens that start with s are labels
+	static bool isLabel(const String& s)
+	{
+		return (s.size() > 0 && isLabelStart(s[0]));
+	}
+
+	// Tokens that start with s, and their offsets, by increasing offset;
+	// 0 if they are not indexed, because s is not a label or because the
+	// file is not a regular file
+	const VectorEntryType* find(const String& s)
+	{
+		if (!isLabel(s)) return 0;
+		if (!built_) build();
+		if (!usable_) return 0;
+
+		MapType::const_iterator it = byPrefix_.find(s);
+		if (it != byPrefix_.end()) return &(it->second);
+
+		VectorEntryType& occurrences = byPrefix_[s];
+		VectorEntryType::const_iterator e = std::lower_bound(entries_.begin(),
+		                                                     entries_.end(),
+		                                                     EntryType(s, 0));
+		for (; e != entries_.end() && e->first.compare(0, s.size(), s) == 0; ++e)
+			occurrences.push_back(*e);
+
+		std::sort(occurrences.begin(), occurrences.end(), LessOffset());
+		return &occurrences;
+	}
+
+	// First of occurrences at or after offset
+	static SizeType firstAfter(const VectorEntryType& occurrences, LongSizeType offset)
+	{
+		return std::lower_bound(occurrences.begin(),
+		                        occurrences.end(),
+		                        EntryType("", offset),
+		                        LessOffset()) - occurrences.begin();
+	}
+
+private:
+
+	typedef std::map<String, VectorEntryType> MapType;
+
+	enum {BUFFER_SIZE = 1048576, CHECKSUM_BLOCK = 4096};
+
+	struct LessOffset {
+
+		bool operator()(const EntryType& a, const EntryType& b) const
+		{
+			return a.second < b.second;
+		}
+	};
+
+	// what the sidecar remembers of the file it indexes
+	struct Stamp {
+
+		Stamp() : size(0), inode(0), mtime(0), mtimeNsec(0), checksum(0) {}
+
+		bool operator==(const Stamp& other) const
+		{
+			return (size == other.size && inode == other.inode &&
+			        mtime == other.mtime && mtimeNsec == other.mtimeNsec &&
+			        checksum == other.checksum);
+		}
+
+		LongSizeType size;
+		LongSizeType inode;
+		long mtime;
+		long mtimeNsec;
+		LongSizeType checksum;
+	};
+
+	void build()
+	{
+		built_ = true;
+		struct stat info;
+		if (stat(filename_.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) return;
+
+		Stamp stamp;
+		stamp.size = info.st_size;
+		stamp.inode = info.st_ino;
+		stamp.mtime = info.st_mtim.tv_sec;
+		stamp.mtimeNsec = info.st_mtim.tv_nsec;
+		String sidecar = filename_ + ".psiIndex";
+		bool useSidecar = (stamp.size >= SIDECAR_MIN_SIZE);
+		if (useSidecar) {
+			if (!checksum(stamp)) return;
+			if (load(sidecar, stamp)) {
+				usable_ = true;
+				return;
+			}
+		}
+
+		if (!scan()) return;
+		usable_ = true;
+		std::sort(entries_.begin(), entries_.end());
+		if (useSidecar) save(sidecar, stamp);
+	}
+
+	// FNV-1a of the first and last CHECKSUM_BLOCK bytes, so that a file
+	// rewritten with the same size within the resolution of the clock, or
+	// on a file system that keeps whole seconds only, is not taken as the same
+	bool checksum(Stamp& stamp) const
+	{
+		std::ifstream fin(filename_.c_str(), std::ios::binary);
+		if (!fin) return false;
+
+		LongSizeType block = std::min(stamp.size, static_cast<LongSizeType>(CHECKSUM_BLOCK));
+		Vector<char>::Type buffer(2*block);
+		fin.read(&buffer[0], block);
+		fin.seekg(stamp.size - block);
+		fin.read(&buffer[block], block);
+		if (!fin) return false;
+
+		LongSizeType hash = 2166136261u;
+		for (SizeType i = 0; i < buffer.size(); ++i) {
+			hash ^= static_cast<unsigned char>(buffer[i]);
+			hash = (hash*16777619u) & 0xffffffffu;
+		}
+
+		stamp.checksum = hash;
+		return true;
+	}
+
+	bool scan()
+	{
+		std::ifstream fin(filename_.c_str(), std::ios::binary);
+		if (!fin) return false;
+
+		Vector<char>::Type buffer(BUFFER_SIZE);
+		LongSizeType offset = 0;
+		bool inToken = false;
+		bool inLabel = false;
+		String token;
+		while (fin) {
+			fin.read(&buffer[0], buffer.size());
+			SizeType n = fin.gcount();
+			if (n == 0) break;
+			for (SizeType i = 0; i < n; ++i, ++offset) {
+				char c = buffer[i];
+				if (isSpace(c)) {
+					if (inLabel) entries_.push_back(EntryType(token, offset - token.size()));
+					inToken = inLabel = false;
+					continue;
+				}
+
+				if (!inToken) {
+					inToken = true;
+					inLabel = isLabelStart(c);
+					token.clear();
+				}
+
+				if (inLabel) token += c;
+			}
+		}
+
+		// a last token without white space after it is not indexed, because
+		// readline and advance, reading with operator>>, stop at end of file
+		// without looking at it
+		return true;
+	}
+
+	bool load(const String& sidecar, const Stamp& stamp)
+	{
+		std::ifstream fin(sidecar.c_str());
+		if (!fin) return false;
+
+		String magic;
+		int version = 0;
+		Stamp saved;
+		LongSizeType total = 0;
+		fin>>magic>>version;
+		if (!fin || magic != "#IoSimpleIndex" || version != 2) return false;
+
+		fin>>saved.size>>saved.inode>>saved.mtime>>saved.mtimeNsec>>saved.checksum>>total;
+		if (!fin || !(saved == stamp)) return false;
+
+		entries_.resize(total);
+		for (LongSizeType i = 0; i < total; ++i)
+			fin>>entries_[i].second>>entries_[i].first;
+
+		if (fin) return true;
+
+		entries_.clear();
+		return false;
+	}
+
+	// written to a temporary file first, so that readers never see half
+	// an index; an index that cannot be written is not an error
+	void save(const String& sidecar, const Stamp& stamp) const
+	{
+		String tmp = sidecar + ".tmp" + ttos(getpid());
+		std::ofstream fout(tmp.c_str());
+		if (!fout) return;
+
+		fout<<"#IoSimpleIndex 2 "<<stamp.size<<" "<<stamp.inode<<" "<<stamp.mtime<<" ";
+		fout<<stamp.mtimeNsec<<" "<<stamp.checksum<<" "<<entries_.size()<<"\n";
+		for (SizeType i = 0; i < entries_.size(); ++i)
+			fout<<entries_[i].second<<" "<<entries_[i].first<<"\n";
+
+		fout.close();
+		if (!fout || rename(tmp.c_str(), sidecar.c_str()) != 0)
+			remove(tmp.c_str());
+	}
+
+	static bool isLabelStart(char c)
+	{
+		return !((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == '(');
+	}
+
+	// the white space of operator>> in the C locale
+	static bool isSpace(char c)
+	{
+		return (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f');
+	}
+
+	String filename_;
+	bool built_;
+	bool usable_;
+	VectorEntryType entries_;
+	MapType byPrefix_;
+}; // class IoSimpleIndex
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_IOSIMPLE_INDEX_H
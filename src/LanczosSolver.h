@@ -89,6 +89,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "Random48.h"
 #include "ContinuedFraction.h"
 #include "LanczosOrDavidsonBase.h"
+#include <limits>
 
 namespace PsimagLite {
 
@@ -116,7 +117,12 @@ public:
 	typedef typename VectorType::value_type VectorElementType;
 	typedef ContinuedFraction<TridiagonalMatrixType> PostProcType;
 
-	enum {WITH_INFO=1,DEBUG=2,ALLOWS_ZERO=4};
+	enum {WITH_INFO=1,
+	      DEBUG=2,
+	      ALLOWS_ZERO=4,
+	      INCREMENTAL=8,
+	      PARTIAL_REORTHO=16,
+	      THICK_RESTART=32};
 
 	LanczosSolver(MatrixType const &mat,
 	              const SolverParametersType& params,
@@ -129,7 +135,23 @@ public:
 	      mode_(WITH_INFO),
 	      stepsForEnergyConvergence_(params.stepsForEnergyConvergence),
 	      rng_(343311),
-	      lanczosVectors_(mat_,params.lotaMemory,params.steps,storageForLanczosVectors)
+	      // thick restart keeps its own basis of steps vectors
+	      lanczosVectors_(mat_,
+	                      params.lotaMemory && !isThickRestart(params.options),
+	                      params.steps,
+	                      storageForLanczosVectors,
+	                      params.options),
+	      storageForLanczosVectors_(storageForLanczosVectors),
+	      eoldFromGround_(false),
+	      reorthoNext_(false),
+	      reorthoSteps_(0),
+	      reorthoProjections_(0),
+	      thickRestartRitz_(params.thickRestartRitz),
+	      thickRestartMaxRestarts_(params.thickRestartMaxRestarts),
+	      thickRestarts_(0),
+	      gershgorinLow_(0),
+	      maxAbsA_(0),
+	      maxAbsB_(0)
 	{
 		setMode(params.options);
 		OstringStream msg;
@@ -184,6 +206,12 @@ public:
 		atmp = 1.0 / sqrt (atmp);
 		for (SizeType i = 0; i < mat_.rows(); i++) y[i] *= atmp;
 
+		if (mode_ & THICK_RESTART) {
+			thickRestart(gsEnergy,z,y,0);
+			if (mode_ & WITH_INFO) info(gsEnergy,initialVector,0,std::cout);
+			return;
+		}
+
 		TridiagonalMatrixType ab;
 
 		decomposition(y,ab);
@@ -249,6 +277,12 @@ public:
 		atmp = 1.0 / sqrt (atmp);
 		for (SizeType i = 0; i < mat_.rows(); i++) y[i] *= atmp;
 
+		if (mode_ & THICK_RESTART) {
+			thickRestart(gsEnergy,z,y,excited);
+			if (mode_ & WITH_INFO) info(gsEnergy,initialVector,excited,std::cout);
+			return;
+		}
+
 		TridiagonalMatrixType ab;
 
 		decomposition(y,ab);
@@ -317,19 +351,17 @@ public:
 		SizeType j = 0;
 		RealType enew = 0;
 		lanczosVectors_.saveInitialVector(y);
-		typename Vector<RealType>::Type nullVector;
 		groundAllocations(max_nstep + 2,false);
+		bool partialReortho = partialReorthoInit(max_nstep);
 		for (; j < max_nstep; j++) {
-			for (SizeType i = 0; i < mat_.rows(); i++)
-				lanczosVectors_(i,j) = y[i];
-
 			RealType btmp = 0;
-			oneStepDecomposition(x,y,atmp,btmp,j==0);
+			lanczosVectors_.oneStepDecompositionAndSave(x,y,atmp,btmp,j);
 			ab.a(j) = atmp;
 			ab.b(j) = btmp;
+			if (partialReortho) partialReorthoStep(x,y,ab,j);
 
 			if (eps_>0) {
-				ground(enew,j+1, ab,nullVector);
+				convergenceEnergy(enew,eold,j+1,ab);
 				if (fabs (enew - eold) < eps_) exitFlag=true;
 				if (exitFlag && mat_.rows()<=4) break;
 				if (exitFlag && j >= minSteps_) break;
@@ -351,6 +383,13 @@ public:
 
 		progress_.printline(msg,std::cout);
 
+		if (partialReortho) {
+			OstringStream msg3;
+			msg3<<"Partial reorthogonalization: "<<reorthoSteps_<<" of "<<max_nstep;
+			msg3<<" steps reorthogonalized, with "<<reorthoProjections_<<" projections";
+			progress_.printline(msg3,std::cout);
+		}
+
 		if (j == max_nstep && j != mat_.rows()) {
 			OstringStream msg2;
 			msg2<<"WARNING: Maximum number of steps used. ";
@@ -371,12 +410,402 @@ public:
 
 	SizeType steps() const {return steps_; }
 
+	// steps of the last decomposition that needed reorthogonalization
+	SizeType reorthogonalizations() const { return reorthoSteps_; }
+
+	// vectors projected out in those steps
+	SizeType reorthogonalizationProjections() const { return reorthoProjections_; }
+
+	// restarts done by the last thick-restart run
+	SizeType thickRestarts() const { return thickRestarts_; }
+
 private:
 
 	void setMode(const String& options)
 	{
 		if (options.find("lanczosdebug")!=String::npos) mode_ |=  DEBUG;
 		if (options.find("lanczosAllowsZero")!=String::npos) mode_ |= ALLOWS_ZERO;
+		if (options.find("lanczosIncremental")!=String::npos) mode_ |= INCREMENTAL;
+		if (options.find("lanczosPartialReortho")!=String::npos) mode_ |= PARTIAL_REORTHO;
+		if (isThickRestart(options)) mode_ |= THICK_RESTART;
+	}
+
+	static bool isThickRestart(const String& options)
+	{
+		return (options.find("lanczosThickRestart") != String::npos);
+	}
+
+	bool partialReorthoInit(SizeType maxSteps)
+	{
+		reorthoSteps_ = reorthoProjections_ = 0;
+		reorthoNext_ = false;
+		if (!(mode_ & PARTIAL_REORTHO)) return false;
+
+		if (!lanczosVectors_.lotaMemory()) {
+			OstringStream msg;
+			msg<<"Partial reorthogonalization needs lotaMemory, ignored";
+			progress_.printline(msg,std::cout);
+			return false;
+		}
+
+		omegaOld_.assign(maxSteps + 2,0);
+		omega_.assign(maxSteps + 2,0);
+		omegaNew_.assign(maxSteps + 2,0);
+		reorthoWith_.assign(maxSteps + 2,false);
+		omega_[0] = 1;
+		return true;
+	}
+
+	/* Partial reorthogonalization (H. D. Simon, Math. Comp. 42, 115 (1984))
+	   After step j, y holds q_{j+1}. The omega recurrence estimates
+	   omega_{j+1,k} = <q_{j+1},q_k> from the a's and b's only. If some
+	   estimate exceeds sqrt(eps), q_{j+1} and, at the next step, q_{j+2},
+	   are orthogonalized against the q_k whose estimate exceeds eps^(3/4);
+	   their estimates are then reset to roundoff level.
+	*/
+	void partialReorthoStep(VectorType& x,
+	                        VectorType& y,
+	                        TridiagonalMatrixType& ab,
+	                        SizeType j)
+	{
+		const RealType eps = std::numeric_limits<RealType>::epsilon();
+		const RealType roundoff = 0.5*eps*sqrt(static_cast<RealType>(mat_.rows()));
+		RealType bj = ab.b(j);
+		if (bj < 1e-10) return;
+
+		RealType maxOmega = 0;
+		for (SizeType k = 0; k < j; ++k) {
+			RealType tmp = ab.b(k)*omega_[k + 1] + (ab.a(k) - ab.a(j))*omega_[k];
+			if (k > 0) tmp += ab.b(k - 1)*omega_[k - 1];
+			if (j > 0) tmp -= ab.b(j - 1)*omegaOld_[k];
+			RealType noise = roundoff*(ab.b(k) + bj);
+			tmp += (tmp >= 0) ? noise : -noise;
+			omegaNew_[k] = tmp/bj;
+			maxOmega = std::max(maxOmega, fabs(omegaNew_[k]));
+		}
+
+		omegaNew_[j] = roundoff;
+		omegaNew_[j + 1] = 1;
+
+		if (reorthoNext_ || maxOmega > sqrt(eps)) {
+			const RealType eta = pow(eps,0.75);
+			for (SizeType k = 0; k < j; ++k)
+				reorthoWith_[k] = reorthoWith_[k] || (fabs(omegaNew_[k]) > eta);
+			// the last two vectors lose orthogonality first
+			reorthoWith_[j] = true;
+			if (j > 0) reorthoWith_[j - 1] = true;
+
+			RealType factor = lanczosVectors_.reorthogonalize(y,j + 1,reorthoWith_);
+			// y was q_{j+1} = r/b; now it is r'/|r'| with |r'| = b*factor
+			ab.b(j) = bj*factor;
+			for (SizeType i = 0; i < x.size(); ++i) x[i] *= factor;
+
+			for (SizeType k = 0; k <= j; ++k) {
+				if (!reorthoWith_[k]) continue;
+				omegaNew_[k] = roundoff;
+				++reorthoProjections_;
+			}
+
+			++reorthoSteps_;
+			reorthoNext_ = !reorthoNext_;
+			if (!reorthoNext_) reorthoWith_.assign(reorthoWith_.size(),false);
+		}
+
+		omegaOld_.swap(omega_);
+		omega_.swap(omegaNew_);
+	}
+
+	/* Thick-restart Lanczos (K. Wu and H. Simon, SIAM J. Matrix Anal.
+	   Appl. 22, 602 (2000)). The basis holds at most steps_ vectors. When
+	   it is full, the lowest k Ritz vectors and the residual direction
+	   are kept, and the projected matrix becomes diagonal plus an arrow
+	   row coupling the Ritz vectors to the residual. New vectors are
+	   fully reorthogonalized, which is cheap for such a small basis.
+	   Converged when the residual norms r of the lowest excited + 1 Ritz
+	   pairs satisfy r*r < eps, as in DavidsonSolver.
+	   The basis is the storage for Lanczos vectors if one was given to the
+	   constructor; LanczosVectors does not allocate one in this mode.
+	*/
+	void thickRestart(RealType& energy,
+	                  VectorType& z,
+	                  const VectorType& y,
+	                  SizeType excited)
+	{
+		SizeType n = mat_.rows();
+		SizeType nwanted = excited + 1;
+		SizeType s = std::min(steps_, n);
+		if (nwanted > s || (s < n && s < nwanted + 1)) {
+			String msg("LanczosSolver: thick restart needs more than ");
+			throw RuntimeError(msg + ttos(nwanted) + " steps\n");
+		}
+
+		SizeType k = thickRestartRitz_;
+		if (k == 0) k = std::max(nwanted + 1, s/2);
+		if (k >= s) k = s - 1;
+		if (k < nwanted) k = nwanted;
+
+		DenseMatrixType ownBasis;
+		DenseMatrixType& basis = (storageForLanczosVectors_) ? *storageForLanczosVectors_
+		                                                     : ownBasis;
+		basis.reset(n,s);
+		DenseMatrixRealType t(s,s);
+		VectorType residual(n);
+		for (SizeType i = 0; i < n; ++i) basis(i,0) = y[i];
+
+		SizeType start = 0;
+		for (thickRestarts_ = 0; ; ++thickRestarts_) {
+			RealType betaLast = 0;
+			SizeType filled = thickRestartExtend(basis,t,start,residual,betaLast);
+			if (filled < nwanted)
+				throw RuntimeError("LanczosSolver: Krylov space too small\n");
+
+			DenseMatrixRealType ritz(filled,filled);
+			for (SizeType i = 0; i < filled; ++i)
+				for (SizeType j = 0; j < filled; ++j)
+					ritz(i,j) = t(i,j);
+
+			typename Vector<RealType>::Type eigs(filled);
+			diag(ritz,eigs,'V');
+
+			RealType maxResidual = 0;
+			OstringStream msg;
+			msg<<"Thick restart "<<thickRestarts_<<" residuals=";
+			for (SizeType i = 0; i < nwanted; ++i) {
+				RealType r = fabs(betaLast*ritz(filled - 1,i));
+				maxResidual = std::max(maxResidual, r);
+				msg<<" "<<r;
+			}
+
+			msg<<" energy="<<eigs[excited];
+			progress_.printline(msg,std::cout);
+
+			bool converged = (maxResidual*maxResidual < eps_ || filled < s);
+			if (converged || thickRestarts_ == thickRestartMaxRestarts_) {
+				if (!converged) {
+					OstringStream msg2;
+					msg2<<"WARNING: thick restart did not converge after ";
+					msg2<<thickRestarts_<<" restarts";
+					progress_.printline(msg2,std::cout);
+				}
+
+				energy = eigs[excited];
+				z.resize(n);
+				for (SizeType i = 0; i < n; ++i) {
+					z[i] = 0.0;
+					for (SizeType l = 0; l < filled; ++l)
+						z[i] += basis(i,l)*ritz(l,excited);
+				}
+
+				return;
+			}
+
+			// basis(:,c) = sum_l basis(:,l) ritz(l,c), for c < k, in place
+			typename Vector<VectorElementType>::Type tmp(k);
+			for (SizeType i = 0; i < n; ++i) {
+				for (SizeType c = 0; c < k; ++c) {
+					tmp[c] = 0.0;
+					for (SizeType l = 0; l < filled; ++l)
+						tmp[c] += basis(i,l)*ritz(l,c);
+				}
+
+				for (SizeType c = 0; c < k; ++c)
+					basis(i,c) = tmp[c];
+				basis(i,k) = residual[i];
+			}
+
+			t.setTo(0.0);
+			for (SizeType c = 0; c < k; ++c) {
+				t(c,c) = eigs[c];
+				t(c,k) = t(k,c) = betaLast*ritz(filled - 1,c);
+			}
+
+			start = k;
+		}
+	}
+
+	/* Lanczos steps from column start of basis to its end, with full
+	   reorthogonalization; fills the diagonal of t and the off-diagonal
+	   below start. Returns the number of basis vectors, which is less than
+	   basis.cols() if an invariant subspace was found (betaLast is then 0)
+	*/
+	SizeType thickRestartExtend(DenseMatrixType& basis,
+	                            DenseMatrixRealType& t,
+	                            SizeType start,
+	                            VectorType& residual,
+	                            RealType& betaLast)
+	{
+		SizeType n = basis.rows();
+		SizeType s = basis.cols();
+		VectorType v(n);
+		VectorType w(n);
+		typename Vector<VectorElementType>::Type h(s);
+		RealType normT = 0;
+		for (SizeType j = start; j < s; ++j) {
+			for (SizeType i = 0; i < n; ++i) {
+				v[i] = basis(i,j);
+				w[i] = 0.0;
+			}
+
+			mat_.matrixVectorProduct(w,v);
+
+			// classical Gram-Schmidt, twice
+			for (SizeType pass = 0; pass < 2; ++pass) {
+				for (SizeType l = 0; l <= j; ++l) {
+					h[l] = 0.0;
+					for (SizeType i = 0; i < n; ++i)
+						h[l] += PsimagLite::conj(basis(i,l))*w[i];
+				}
+
+				for (SizeType i = 0; i < n; ++i)
+					for (SizeType l = 0; l <= j; ++l)
+						w[i] -= basis(i,l)*h[l];
+
+				if (pass == 0) t(j,j) = PsimagLite::real(h[j]);
+			}
+
+			RealType beta = 0;
+			for (SizeType i = 0; i < n; ++i)
+				beta += PsimagLite::real(w[i]*PsimagLite::conj(w[i]));
+			beta = sqrt(beta);
+
+			normT = std::max(normT,fabs(t(j,j)) + beta);
+			if (beta <= std::numeric_limits<RealType>::epsilon()*normT) {
+				betaLast = 0;
+				return j + 1;
+			}
+
+			RealType inverseBeta = 1.0/beta;
+			if (j + 1 == s) {
+				for (SizeType i = 0; i < n; ++i) residual[i] = w[i]*inverseBeta;
+				betaLast = beta;
+				return s;
+			}
+
+			for (SizeType i = 0; i < n; ++i) basis(i,j + 1) = w[i]*inverseBeta;
+			t(j,j + 1) = t(j + 1,j) = beta;
+		}
+
+		return s;
+	}
+
+	// Sets enew to the lowest eigenvalue of the n x n leading block of ab
+	// eold is the one of the (n-1) x (n-1) block, and may be changed
+	// (see below) only when INCREMENTAL is set
+	void convergenceEnergy(RealType& enew,
+	                       RealType& eold,
+	                       SizeType n,
+	                       const TridiagonalMatrixType& ab)
+	{
+		typename Vector<RealType>::Type nullVector;
+		if (!(mode_ & INCREMENTAL)) {
+			ground(enew,n,ab,nullVector);
+			return;
+		}
+
+		bool eoldFromGround = eoldFromGround_;
+		eoldFromGround_ = false;
+		enew = groundIncremental(n,ab,eold);
+
+		// Both enew and eold agree with ground() to within a few
+		// epsilon*norm(T). If the stopping decision is too close to call,
+		// redo both with ground() so that it is the same as without INCREMENTAL
+		RealType guard = 1e2*std::numeric_limits<RealType>::epsilon()*normT();
+		if (fabs(fabs(enew - eold) - eps_) > guard) return;
+
+		ground(enew,n,ab,nullVector);
+		eoldFromGround_ = true;
+		if (n > 1 && !eoldFromGround) ground(eold,n - 1,ab,nullVector);
+	}
+
+	/* Lowest eigenvalue of the n x n leading block T of ab in O(n),
+	 * assuming this is called for n = 1, 2, 3, ... in order.
+	 *
+	 * By interlacing the answer is below upper, the lowest eigenvalue of
+	 * the (n-1) x (n-1) block, and it is above the Gershgorin lower bound.
+	 * The bracket is narrowed with Newton steps on the last pivot q(x) of
+	 * the LDL^T factorization of T - x, falling back to bisection,
+	 * with Sturm counts deciding on which side of the eigenvalue x is.
+	 * q(x) is decreasing and concave left of upper, so Newton converges
+	 * monotonically once it lands to the right of the eigenvalue.
+	 */
+	RealType groundIncremental(SizeType n,
+	                           const TridiagonalMatrixType& ab,
+	                           RealType upper)
+	{
+		assert(n > 0);
+		SizeType j = n - 1;
+		if (j == 0) {
+			eoldFromGround_ = false;
+			gershgorinLow_ = std::numeric_limits<RealType>::max();
+			maxAbsA_ = fabs(ab.a(0));
+			maxAbsB_ = 0.0;
+			return ab.a(0);
+		}
+
+		// row j - 1 is complete now
+		RealType bjm1 = fabs(ab.b(j - 1));
+		RealType bjm2 = (j > 1) ? fabs(ab.b(j - 2)) : 0.0;
+		gershgorinLow_ = std::min(gershgorinLow_, ab.a(j - 1) - bjm1 - bjm2);
+		maxAbsA_ = std::max(maxAbsA_, fabs(ab.a(j)));
+		maxAbsB_ = std::max(maxAbsB_, bjm1);
+
+		RealType lo = std::min(gershgorinLow_, ab.a(j) - bjm1);
+		RealType hi = upper;
+		RealType q = 0;
+		RealType dq = 0;
+		if (sturm(q,dq,hi,n,ab) == 0) return upper;
+
+		const RealType epsilon = std::numeric_limits<RealType>::epsilon();
+		RealType x = lo;
+		for (SizeType iter = 0; iter < 256; ++iter) {
+			SizeType count = sturm(q,dq,x,n,ab);
+			if (count == 0) lo = x;
+			else hi = x;
+
+			RealType tolerance = 2*epsilon*std::max(fabs(lo),fabs(hi));
+			if (hi - lo <= tolerance) break;
+
+			RealType xnew = x - q/dq;
+			if (dq == 0.0 || !(xnew > lo && xnew < hi)) xnew = 0.5*(lo + hi);
+			if (fabs(xnew - x) <= tolerance) {
+				x = xnew;
+				break;
+			}
+
+			x = xnew;
+		}
+
+		return x;
+	}
+
+	RealType normT() const { return maxAbsA_ + 2*maxAbsB_; }
+
+	// Returns the number of eigenvalues of the n x n leading block
+	// of ab that are below x, and sets q and dq to the last pivot of
+	// the LDL^T factorization of T - x and its derivative with respect to x
+	SizeType sturm(RealType& q,
+	               RealType& dq,
+	               RealType x,
+	               SizeType n,
+	               const TridiagonalMatrixType& ab) const
+	{
+		// as in LAPACK's dstebz, tiny pivots are taken as negative
+		RealType pivmin = std::numeric_limits<RealType>::epsilon()*normT();
+		if (pivmin == 0) pivmin = std::numeric_limits<RealType>::min();
+		q = ab.a(0) - x;
+		if (fabs(q) < pivmin) q = -pivmin;
+		dq = -1.0;
+		SizeType count = (q < 0) ? 1 : 0;
+		for (SizeType i = 1; i < n; ++i) {
+			RealType b = ab.b(i - 1);
+			RealType r = b*b/q;
+			dq = -1.0 + r*dq/q;
+			q = ab.a(i) - x - r;
+			if (fabs(q) < pivmin) q = -pivmin;
+			if (q < 0) ++count;
+		}
+
+		return count;
 	}
 
 	void info(RealType energyTmp,
@@ -397,7 +826,7 @@ private:
 		if (excited > 0) what = ttos(excited) + " excited";
 		msg<<"Found "<<what<<" eigenvalue= "<<energyTmp<<" after "<<iter;
 		msg<<" iterations, "<<" orig. norm="<<norma;
-		if (excited > 0)
+		if (excited > 0 && !(mode_ & THICK_RESTART))
 			msg<<"\nLanczosSolver: EXPERIMENTAL feature excited > 0 is in use";
 		progress_.printline(msg,os);
 	}
@@ -564,9 +993,24 @@ private:
 	SizeType stepsForEnergyConvergence_;
 	Random48<RealType> rng_;
 	LanczosVectorsType lanczosVectors_;
+	DenseMatrixType* storageForLanczosVectors_;
 	VectorRealType groundD_;
 	VectorRealType groundE_;
 	VectorRealType groundV_;
+	bool eoldFromGround_;
+	VectorRealType omegaOld_;
+	VectorRealType omega_;
+	VectorRealType omegaNew_;
+	Vector<bool>::Type reorthoWith_;
+	bool reorthoNext_;
+	SizeType reorthoSteps_;
+	SizeType reorthoProjections_;
+	SizeType thickRestartRitz_;
+	SizeType thickRestartMaxRestarts_;
+	SizeType thickRestarts_;
+	RealType gershgorinLow_;
+	RealType maxAbsA_;
+	RealType maxAbsB_;
 }; // class LanczosSolver
 
 } // namespace PsimagLite
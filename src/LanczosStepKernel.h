@@ -0,0 +1,263 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file LanczosStepKernel.h
+ *
+ *  Streaming part of a Lanczos step, after x += H*y, in two passes
+ *
+ *  Pass 1 reads x and y once and returns <y,x>, <x,x> and <y,y>, so that
+ *  a = Re<y,x> and b^2 = |x - a y|^2 = <x,x> - a^2 (2 - <y,y>).
+ *  Pass 2 reads x and y once and writes, in the same loop, the old y to
+ *  the Lanczos basis (if given), y = (x - a y)/b and x = -b y_old.
+ *  The rounding error of that formula is about eps <x,x>, or eps <x,x>/b^2
+ *  relative to b^2, while computing |x - a y|^2 directly has a relative
+ *  error of about eps |x|/b. The formula is used only if <x,x> < 16 b^2,
+ *  so that its error is at most a few times that of the direct sum;
+ *  otherwise x -= a y and b^2 = |x|^2 are computed with one more pass.
+ *
+ *  Complex vectors are handled as real vectors of twice the length,
+ *  since all the operations above are real-linear, and Re<y,x> is the
+ *  real dot product. Loops use four partial sums so that they vectorize.
+ *  Long vectors are split in chunks among Concurrency::npthreads
+ *  threads; partial sums are always added in chunk order.
+ *  Because sums are added in a different order than in the one-pass-per-
+ *  operation step, a and b differ from it in the last bits, and so do
+ *  the results of a long Lanczos run.
+ */
+#ifndef PSI_LANCZOS_STEP_KERNEL_H
+#define PSI_LANCZOS_STEP_KERNEL_H
+#include <cassert>
+#include <cmath>
+#include "Vector.h"
+#include "Concurrency.h"
+#ifdef USE_PTHREADS
+#include "PthreadsNg.h"
+#endif
+
+namespace PsimagLite {
+
+template<typename RealType>
+class LanczosStepKernel {
+
+	typedef typename Vector<RealType>::Type VectorRealType;
+
+	enum {DOTS, AXPY_NORM, UPDATE};
+
+	// b^2 = <x,x> - a^2 (2 - <y,y>) is used if <x,x> < MAX_CANCELLATION b^2
+	enum {MAX_CANCELLATION = 16};
+
+public:
+
+	// Below this number of reals per thread, threads are not worth it
+	enum {MIN_LENGTH_PER_THREAD = 65536};
+
+	LanczosStepKernel(RealType* x,
+	                  RealType* y,
+	                  RealType* save,
+	                  SizeType n)
+	    : x_(x),
+	      y_(y),
+	      save_(save),
+	      n_(n),
+	      nchunks_(1),
+	      what_(DOTS),
+	      a_(0),
+	      b_(0),
+	      partial_(0)
+	{
+		SizeType nthreads = Concurrency::npthreads;
+		if (nthreads > 1 && n >= MIN_LENGTH_PER_THREAD*nthreads)
+			nchunks_ = nthreads;
+	}
+
+	/* Given x = H y + (previous terms) and y, computes
+	   atmp = Re<y,x>, btmp = |x - atmp y|, and then
+	   save = y (if save != 0), y = (x - atmp y)/btmp, x = -btmp y
+	   If btmp is tiny y is not normalized, as in oneStepDecomposition.
+	*/
+	void step(RealType& atmp, RealType& btmp)
+	{
+		// pass 1
+		run(DOTS, 3);
+		RealType xy = sums_[0];
+		RealType xx = sums_[1];
+		RealType yy = sums_[2];
+
+		atmp = xy;
+		RealType b2 = xx - atmp*atmp*(2 - yy);
+		RealType aForUpdate = atmp;
+		if (MAX_CANCELLATION*b2 <= xx) {
+			a_ = atmp;
+			run(AXPY_NORM, 1);
+			b2 = sums_[0];
+			aForUpdate = 0;
+		}
+
+		btmp = (b2 > 0) ? sqrt(b2) : 0;
+
+		// pass 2
+		a_ = aForUpdate;
+		b_ = btmp;
+		run(UPDATE, 0);
+	}
+
+	SizeType tasks() const { return nchunks_; }
+
+	void doTask(SizeType taskNumber, SizeType)
+	{
+		SizeType start = (n_*taskNumber)/nchunks_;
+		SizeType end = (n_*(taskNumber + 1))/nchunks_;
+		RealType* sums = &partial_[taskNumber*3];
+
+		switch (what_) {
+		case DOTS:
+			dots(sums, start, end);
+			break;
+		case AXPY_NORM:
+			sums[0] = axpyNorm(start, end);
+			break;
+		case UPDATE:
+			update(start, end);
+			break;
+		}
+	}
+
+	// number of reals read and written by step(), not counting H*y,
+	// when b^2 is not recomputed (3n more if it is)
+	static SizeType realsMovedPerStep(SizeType n, bool withSave)
+	{
+		return (withSave) ? 7*n : 6*n;
+	}
+
+private:
+
+	void run(SizeType what, SizeType nsums)
+	{
+		what_ = what;
+		VectorRealType partial(3*nchunks_, 0);
+		partial_ = &partial[0];
+		if (nchunks_ == 1) {
+			doTask(0, 0);
+		} else {
+#ifdef USE_PTHREADS
+			PthreadsNg<LanczosStepKernel> threads(nchunks_,
+			                                      0,
+			                                      Concurrency::setAffinitiesDefault);
+			threads.loopCreate(*this);
+#else
+			for (SizeType c = 0; c < nchunks_; ++c) doTask(c, 0);
+#endif
+		}
+
+		for (SizeType k = 0; k < nsums; ++k) {
+			sums_[k] = 0;
+			for (SizeType c = 0; c < nchunks_; ++c)
+				sums_[k] += partial[3*c + k];
+		}
+
+		partial_ = 0;
+	}
+
+	void dots(RealType* sums, SizeType start, SizeType end) const
+	{
+		RealType xy[4] = {0, 0, 0, 0};
+		RealType xx[4] = {0, 0, 0, 0};
+		RealType yy[4] = {0, 0, 0, 0};
+		SizeType i = start;
+		for (; i + 4 <= end; i += 4) {
+			for (SizeType k = 0; k < 4; ++k) {
+				RealType xv = x_[i + k];
+				RealType yv = y_[i + k];
+				xy[k] += xv*yv;
+				xx[k] += xv*xv;
+				yy[k] += yv*yv;
+			}
+		}
+
+		for (; i < end; ++i) {
+			xy[0] += x_[i]*y_[i];
+			xx[0] += x_[i]*x_[i];
+			yy[0] += y_[i]*y_[i];
+		}
+
+		sums[0] = (xy[0] + xy[1]) + (xy[2] + xy[3]);
+		sums[1] = (xx[0] + xx[1]) + (xx[2] + xx[3]);
+		sums[2] = (yy[0] + yy[1]) + (yy[2] + yy[3]);
+	}
+
+	// x -= a y, returns |x|^2
+	RealType axpyNorm(SizeType start, SizeType end)
+	{
+		RealType s[4] = {0, 0, 0, 0};
+		const RealType a = a_;
+		SizeType i = start;
+		for (; i + 4 <= end; i += 4) {
+			for (SizeType k = 0; k < 4; ++k) {
+				RealType w = x_[i + k] - a*y_[i + k];
+				x_[i + k] = w;
+				s[k] += w*w;
+			}
+		}
+
+		for (; i < end; ++i) {
+			x_[i] -= a*y_[i];
+			s[0] += x_[i]*x_[i];
+		}
+
+		return (s[0] + s[1]) + (s[2] + s[3]);
+	}
+
+	void update(SizeType start, SizeType end)
+	{
+		const RealType a = a_;
+		const RealType b = b_;
+		const RealType invb = (fabs(b) < 1e-10) ? 1 : 1.0/b;
+		if (save_) {
+			for (SizeType i = start; i < end; ++i) {
+				RealType yold = y_[i];
+				save_[i] = yold;
+				y_[i] = (x_[i] - a*yold)*invb;
+				x_[i] = -b*yold;
+			}
+		} else {
+			for (SizeType i = start; i < end; ++i) {
+				RealType yold = y_[i];
+				y_[i] = (x_[i] - a*yold)*invb;
+				x_[i] = -b*yold;
+			}
+		}
+	}
+
+	RealType* x_;
+	RealType* y_;
+	RealType* save_;
+	SizeType n_;
+	SizeType nchunks_;
+	SizeType what_;
+	RealType a_;
+	RealType b_;
+	RealType* partial_;
+	RealType sums_[3];
+}; // class LanczosStepKernel
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_LANCZOS_STEP_KERNEL_H
@@ -74,7 +74,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 
 /*! \file LanczosVectors.h
  *
- *  to store or not to store lanczos vectors
+ *  to store or not to store lanczos vectors, and where
  *
  */
 
@@ -86,6 +86,8 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include "Matrix.h"
 #include "Random48.h"
 #include "ContinuedFraction.h"
+#include "ScratchFileMatrix.h"
+#include "LanczosStepKernel.h"
 
 namespace PsimagLite {
 
@@ -103,77 +105,218 @@ public:
 	typedef Matrix<VectorElementType> DenseMatrixType;
 	typedef Matrix<RealType> DenseMatrixRealType;
 	typedef ContinuedFraction<TridiagonalMatrixType> PostProcType;
+	typedef typename SinglePrecision<VectorElementType>::Type FloatType;
+	typedef Matrix<FloatType> DenseMatrixFloatType;
+	typedef ScratchFileMatrix<VectorElementType> ScratchFileMatrixType;
+	typedef LanczosStepKernel<RealType> LanczosStepKernelType;
 
 	enum {WITH_INFO=1,DEBUG=2,ALLOWS_ZERO=4};
 
+	// where the Lanczos vectors are kept, from fastest to slowest
+	enum StorageEnum {STORAGE_NONE, STORAGE_RAM, STORAGE_FLOAT, STORAGE_FILE};
+
+	/* If lotaMemory is set the vectors are stored in RAM, or, with
+	   option lanczosVectorsFloat, in RAM in single precision, or, with
+	   option lanczosVectorsFile, in a memory-mapped scratch file.
+	   If a tier cannot be allocated the next one is tried, and if the
+	   scratch file cannot be, the tiers in RAM are. Without storage
+	   hookForZ needs to redo the Lanczos recursion.
+	*/
 	LanczosVectors(const MatrixType& mat,
 	               bool lotaMemory,
 	               SizeType steps,
-	               DenseMatrixType* storage)
+	               DenseMatrixType* storage,
+	               const String& options = "")
 	    : progress_("LanczosVectors"),
 	      mat_(mat),
 	      lotaMemory_(lotaMemory),
 	      dummy_(0),
 	      needsDelete_(false),
 	      ysaved_(0),
-	      data_(storage)
+	      data_(storage),
+	      dataFloat_(0),
+	      dataFile_(0),
+	      storage_((storage) ? STORAGE_RAM : STORAGE_NONE),
+	      nrows_((storage) ? storage->rows() : 0),
+	      ncols_((storage) ? storage->cols() : 0)
 	{
 		if (storage || !lotaMemory)
 			return;
 
+		SizeType first = STORAGE_RAM;
+		if (options.find("lanczosVectorsFloat") != String::npos)
+			first = STORAGE_FLOAT;
+		if (options.find("lanczosVectorsFile") != String::npos)
+			first = STORAGE_FILE;
+
 		// if lotaMemory is set, we still degrade gracefully if we can't allocate
 		SizeType maxNstep =  std::min(steps , mat_.rows());
-		try {
-			data_ = new DenseMatrixType(mat_.rows(),maxNstep);
-			needsDelete_ = true;
+		for (SizeType i = 0; i < STORAGE_FILE; ++i) {
+			// first, ..., STORAGE_FILE, then STORAGE_RAM, ..., first - 1
+			SizeType tier = (first + i - 1) % STORAGE_FILE + 1;
+			String reason;
+			if (allocate(tier, mat_.rows(), maxNstep, reason)) break;
+
 			OstringStream msg;
-			msg<<"lotaMemory_=true";
+			msg<<"Memory allocation failed for "<<storageName(tier)<<": "<<reason;
 			progress_.printline(msg,std::cout);
-		} catch (std::exception&) {
-			// FIXME: option to store in secondary
+		}
+
+		if (storage_ == STORAGE_NONE) {
 			OstringStream msg;
-			msg<<"Memory allocation failed, setting lotaMemory_=false\n";
+			msg<<"No storage for Lanczos vectors, setting lotaMemory_=false\n";
 			progress_.printline(msg,std::cout);
 			lotaMemory_ = false;
-			data_ = 0;
+			return;
 		}
+
+		OstringStream msg;
+		msg<<"lotaMemory_=true, vectors in "<<storageName(storage_);
+		progress_.printline(msg,std::cout);
 	}
 
 	~LanczosVectors()
 	{
 		if (needsDelete_) delete data_;
+		delete dataFloat_;
+		delete dataFile_;
 	}
 
 	void resize(SizeType matrixRank,SizeType steps)
 	{
-		if (!lotaMemory_) return;
-		data_->reset(matrixRank,steps);
+		reset(matrixRank,steps);
 	}
 
 	void reset(SizeType matrixRank,SizeType steps)
 	{
 		if (!lotaMemory_) return;
-		data_->reset(matrixRank,steps);
+
+		nrows_ = matrixRank;
+		ncols_ = steps;
+		switch (storage_) {
+		case STORAGE_RAM:
+			data_->reset(matrixRank,steps);
+			break;
+		case STORAGE_FLOAT:
+			dataFloat_->reset(matrixRank,steps);
+			break;
+		case STORAGE_FILE:
+			dataFile_->reset(matrixRank,steps);
+			break;
+		case STORAGE_NONE:
+			break;
+		}
 	}
 
+	// Element access is not available with single precision storage
 	VectorElementType& operator()(SizeType i,SizeType j)
 	{
 		if (!lotaMemory_) return dummy_;
+		if (storage_ == STORAGE_FILE) return dataFile_->operator()(i,j);
+		checkElementAccess();
 		return data_->operator()(i,j);
 	}
 
 	const VectorElementType& operator()(SizeType i,SizeType j) const
 	{
 		if (!lotaMemory_) return dummy_;
+		if (storage_ == STORAGE_FILE) return dataFile_->operator()(i,j);
+		checkElementAccess();
 		return data_->operator()(i,j);
 	}
 
-	SizeType cols() const { return data_->cols(); }
+	SizeType cols() const { return ncols_; }
 
-	SizeType rows() const { return data_->rows(); }
+	SizeType rows() const { return nrows_; }
 
 	bool lotaMemory() const { return lotaMemory_; }
 
+	StorageEnum storage() const { return storage_; }
+
+	// stores y as the j-th Lanczos vector
+	void saveVector(const VectorType& y, SizeType j)
+	{
+		if (!lotaMemory_) return;
+
+		assert(j < ncols_ && y.size() >= nrows_);
+		switch (storage_) {
+		case STORAGE_RAM:
+			for (SizeType i = 0; i < nrows_; ++i)
+				data_->operator()(i,j) = y[i];
+			break;
+		case STORAGE_FLOAT:
+			for (SizeType i = 0; i < nrows_; ++i)
+				dataFloat_->operator()(i,j) = static_cast<FloatType>(y[i]);
+			break;
+		case STORAGE_FILE:
+			std::copy(y.begin(), y.begin() + nrows_, dataFile_->column(j));
+			dataFile_->writeBehind(j);
+			break;
+		case STORAGE_NONE:
+			break;
+		}
+	}
+
+	// copies the j-th Lanczos vector into y
+	void loadVector(VectorType& y, SizeType j) const
+	{
+		assert(lotaMemory_ && j < ncols_);
+		if (y.size() != nrows_) y.resize(nrows_);
+
+		switch (storage_) {
+		case STORAGE_RAM:
+			for (SizeType i = 0; i < nrows_; ++i)
+				y[i] = data_->operator()(i,j);
+			break;
+		case STORAGE_FLOAT:
+			for (SizeType i = 0; i < nrows_; ++i)
+				y[i] = dataFloat_->operator()(i,j);
+			break;
+		case STORAGE_FILE: {
+			const VectorElementType* ptr = dataFile_->column(j);
+			std::copy(ptr, ptr + nrows_, y.begin());
+			break;
+		}
+		case STORAGE_NONE:
+			break;
+		}
+	}
+
+	/* Orthogonalizes y against the stored vectors k < n with which[k] set,
+	   (modified Gram-Schmidt) and normalizes it; returns the norm
+	   y had before normalization. With single precision storage y is
+	   only orthogonal to single precision accuracy
+	*/
+	template<typename SomeVectorBoolType>
+	RealType reorthogonalize(VectorType& y,
+	                         SizeType n,
+	                         const SomeVectorBoolType& which) const
+	{
+		assert(lotaMemory_ && n <= ncols_);
+		VectorType q(nrows_);
+		for (SizeType k = 0; k < n; ++k) {
+			if (!which[k]) continue;
+			loadVector(q,k);
+			ComplexOrRealType c = 0.0;
+			for (SizeType i = 0; i < nrows_; ++i)
+				c += PsimagLite::conj(q[i])*y[i];
+			for (SizeType i = 0; i < nrows_; ++i)
+				y[i] -= c*q[i];
+		}
+
+		RealType norma = 0;
+		for (SizeType i = 0; i < nrows_; ++i)
+			norma += PsimagLite::real(y[i]*PsimagLite::conj(y[i]));
+		norma = sqrt(norma);
+		if (norma == 0) return 0;
+
+		RealType inverseNorm = 1.0/norma;
+		for (SizeType i = 0; i < nrows_; ++i)
+			y[i] *= inverseNorm;
+
+		return norma;
+	}
+
 	void saveInitialVector(const VectorType& y)
 	{
 		ysaved_ = y;
@@ -199,10 +342,12 @@ public:
 			return;
 		}
 
-		for (SizeType j = 0; j < data_->cols(); j++) {
+		VectorType v(nrows_);
+		for (SizeType j = 0; j < ncols_; j++) {
 			RealType ctmp = c[j];
-			for (SizeType i = 0; i < data_->rows(); i++) {
-				z[i] += ctmp * data_->operator()(i,j);
+			loadVector(v,j);
+			for (SizeType i = 0; i < nrows_; i++) {
+				z[i] += ctmp * v[i];
 			}
 		}
 
@@ -227,10 +372,12 @@ public:
 		for (SizeType i = 0; i < x.size(); i++)
 			if (PsimagLite::real(x[i]*PsimagLite::conj(x[i]))!=0) return false;
 
-		for (SizeType j=0; j < data_->cols(); j++) {
+		VectorType v(mat_.rows());
+		for (SizeType j=0; j < ncols_; j++) {
 			for (SizeType i = 0; i < mat_.rows(); i++) {
-				data_->operator()(i,j) = (i==j) ? 0.0 : 1.1;
+				v[i] = (i==j) ? 0.0 : 1.1;
 			}
+			saveVector(v,j);
 			ab.a(j) = 0.0;
 			ab.b(j) = 0.0;
 		}
@@ -244,33 +391,30 @@ public:
 	{
 		mat_.matrixVectorProduct (x, y); // x+= Hy
 
-		atmp = 0.0;
-		for (SizeType i = 0; i < mat_.rows(); i++)
-			atmp += PsimagLite::real(y[i]*PsimagLite::conj(x[i]));
-		btmp = 0.0;
-		for (SizeType i = 0; i < mat_.rows(); i++) {
-			x[i] -= atmp * y[i];
-			btmp += PsimagLite::real(x[i]*PsimagLite::conj(x[i]));
-		}
+		fusedStep(x,y,0,atmp,btmp);
+	}
 
-		btmp = sqrt (btmp);
+	// Same as saveVector(y,j) followed by oneStepDecomposition(x,y,atmp,btmp)
+	// but, if possible, y is stored while x and y are updated
+	void oneStepDecompositionAndSave(VectorType& x,
+	                                 VectorType& y,
+	                                 RealType& atmp,
+	                                 RealType& btmp,
+	                                 SizeType j)
+	{
+		VectorElementType* save = 0;
+		if (lotaMemory_ && storage_ == STORAGE_RAM && nrows_ > 0)
+			save = &(data_->operator()(0,j));
+		else if (lotaMemory_ && storage_ == STORAGE_FILE)
+			save = dataFile_->column(j);
+		else
+			saveVector(y,j);
 
-		if (fabs(btmp)<1e-10) {
-			for (SizeType i = 0; i < mat_.rows(); i++) {
-				VectorElementType tmp = y[i];
-				y[i] = x[i];
-				x[i] = -btmp * tmp;
-			}
-			return;
-		}
+		mat_.matrixVectorProduct (x, y); // x+= Hy
 
-		RealType inverseBtmp = 1.0/btmp;
-		for (SizeType i = 0; i < mat_.rows(); i++) {
-			//lanczosVectors(i,j) = y[i];
-			VectorElementType tmp = y[i];
-			y[i] = x[i] * inverseBtmp;
-			x[i] = -btmp * tmp;
-		}
+		fusedStep(x,y,save,atmp,btmp);
+
+		if (storage_ == STORAGE_FILE && save) dataFile_->writeBehind(j);
 	}
 
 	const DenseMatrixRealType& reorthogonalizationMatrix()
@@ -288,7 +432,7 @@ private:
 	{
 		if (!lotaMemory_) return;
 
-		SizeType nlanczos = data_->cols();
+		SizeType nlanczos = ncols_;
 		DenseMatrixType w(nlanczos,nlanczos);
 
 		computeOverlap(w);
@@ -302,27 +446,108 @@ private:
 	void computeOverlap(DenseMatrixType& w) const
 	{
 		SizeType nlanczos = w.rows();
+		VectorType vi(nrows_);
+		VectorType vj(nrows_);
 
 		for (SizeType i = 0; i < nlanczos; ++i) {
+			loadVector(vi,i);
 			for (SizeType j = i; j < nlanczos; ++j) {
-				w(i,j) = computeOverlap(i,j);
+				loadVector(vj,j);
+				w(i,j) = computeOverlap(vi,vj);
 			}
 		}
 	}
 
-	ComplexOrRealType computeOverlap(SizeType ind, SizeType jnd) const
+	ComplexOrRealType computeOverlap(const VectorType& vi, const VectorType& vj) const
 	{
 		ComplexOrRealType sum = 0.0;
 
-		SizeType n = data_->rows();
+		SizeType n = nrows_;
 
 		for (SizeType i = 0; i < n; ++i) {
-			sum += PsimagLite::conj(data_->operator ()(i,ind)) * data_->operator ()(i,jnd);
+			sum += PsimagLite::conj(vi[i]) * vj[i];
 		}
 
 		return sum;
 	}
 
+	// atmp = Re<y,x>, x -= atmp*y, btmp = |x|, y = x/btmp, x = -btmp*y_old
+	// and save = y_old if save is not null
+	void fusedStep(VectorType& x,
+	               VectorType& y,
+	               VectorElementType* save,
+	               RealType& atmp,
+	               RealType& btmp) const
+	{
+		SizeType n = mat_.rows();
+		if (n == 0) {
+			atmp = btmp = 0;
+			return;
+		}
+
+		assert(x.size() >= n && y.size() >= n);
+		// complex numbers are handled as pairs of reals
+		SizeType factor = sizeof(VectorElementType)/sizeof(RealType);
+		assert(factor*sizeof(RealType) == sizeof(VectorElementType));
+
+		LanczosStepKernelType kernel(reinterpret_cast<RealType*>(&x[0]),
+		                             reinterpret_cast<RealType*>(&y[0]),
+		                             reinterpret_cast<RealType*>(save),
+		                             factor*n);
+		kernel.step(atmp,btmp);
+	}
+
+	bool allocate(SizeType tier, SizeType nrows, SizeType ncols, String& reason)
+	{
+		try {
+			switch (tier) {
+			case STORAGE_RAM:
+				data_ = new DenseMatrixType(nrows,ncols);
+				needsDelete_ = true;
+				break;
+			case STORAGE_FLOAT:
+				dataFloat_ = new DenseMatrixFloatType(nrows,ncols);
+				break;
+			case STORAGE_FILE:
+				dataFile_ = new ScratchFileMatrixType(nrows,ncols);
+				break;
+			default:
+				return false;
+			}
+		} catch (std::exception& e) {
+			reason = e.what();
+			if (reason.length() > 0 && reason[reason.length() - 1] == '\n')
+				reason.erase(reason.length() - 1);
+			return false;
+		}
+
+		storage_ = static_cast<StorageEnum>(tier);
+		nrows_ = nrows;
+		ncols_ = ncols;
+		return true;
+	}
+
+	static String storageName(SizeType tier)
+	{
+		switch (tier) {
+		case STORAGE_RAM:
+			return "RAM";
+		case STORAGE_FLOAT:
+			return "RAM in single precision";
+		case STORAGE_FILE:
+			return "a scratch file";
+		}
+
+		return "nowhere";
+	}
+
+	void checkElementAccess() const
+	{
+		if (storage_ != STORAGE_FLOAT) return;
+		throw RuntimeError("LanczosVectors: no element access in single precision; "
+		                   "use saveVector/loadVector\n");
+	}
+
 	void computeS(DenseMatrixRealType& s,const DenseMatrixType& w) const
 	{
 		SizeType nlanczos = s.rows();
@@ -380,6 +605,11 @@ private:
 	bool needsDelete_;
 	VectorType ysaved_;
 	DenseMatrixType* data_;
+	DenseMatrixFloatType* dataFloat_;
+	ScratchFileMatrixType* dataFile_;
+	StorageEnum storage_;
+	SizeType nrows_;
+	SizeType ncols_;
 	DenseMatrixRealType reortho_;
 }; // class LanczosVectors
 
@@ -0,0 +1,173 @@
+#ifndef LOADBALANCERWORKSTEALING_H
+#define LOADBALANCERWORKSTEALING_H
+#include <cstdlib>
+#include <cassert>
+#include "Vector.h"
+#include "Concurrency.h"
+#include "LoadBalancerDefault.h"
+
+namespace PsimagLite {
+
+/* Tasks are first placed as LoadBalancerDefault does, one deque per
+   thread. Each thread then pops from the front of its own deque and,
+   when it runs dry, steals the back half of the deque of a victim
+   chosen at random. Weights only affect the initial placement, so a
+   thread that got underestimated tasks no longer becomes the straggler.
+
+   blockSize() and taskNumber() describe the initial placement, for
+   the serial case; PthreadsNg uses nextTask() instead.
+*/
+class LoadBalancerWorkStealing {
+
+	struct DequeType {
+		DequeType(const LoadBalancerDefault::VectorSizeType& t)
+		    : tasks(t), head(0), tail(t.size())
+		{
+			Concurrency::mutexInit(&mutex);
+		}
+
+		~DequeType()
+		{
+			Concurrency::mutexDestroy(&mutex);
+		}
+
+		Concurrency::MutexType mutex;
+		LoadBalancerDefault::VectorSizeType tasks;
+		SizeType head;
+		SizeType tail;
+		unsigned short seed[3];
+		// keep deques of different threads on different cache lines
+		char padding[64];
+	};
+
+public:
+
+	typedef LoadBalancerDefault::VectorSizeType VectorSizeType;
+
+	LoadBalancerWorkStealing(const VectorSizeType& weights, SizeType nthreads)
+	    : initial_(weights, nthreads), deques_(nthreads, 0), steals_(0)
+	{
+		for (SizeType i = 0; i < nthreads; ++i) {
+			SizeType n = initial_.blockSize(i);
+			VectorSizeType tasks(n);
+			for (SizeType p = 0; p < n; ++p)
+				tasks[p] = initial_.taskNumber(i, p);
+
+			deques_[i] = new DequeType(tasks);
+			deques_[i]->seed[0] = 0x330e;
+			deques_[i]->seed[1] = static_cast<unsigned short>(1234 + i);
+			deques_[i]->seed[2] = static_cast<unsigned short>(i >> 16);
+		}
+
+		Concurrency::mutexInit(&stealsMutex_);
+	}
+
+	~LoadBalancerWorkStealing()
+	{
+		for (SizeType i = 0; i < deques_.size(); ++i) {
+			delete deques_[i];
+			deques_[i] = 0;
+		}
+
+		Concurrency::mutexDestroy(&stealsMutex_);
+	}
+
+	SizeType blockSize(SizeType threadNum) const
+	{
+		return initial_.blockSize(threadNum);
+	}
+
+	int taskNumber(SizeType threadNum, SizeType p) const
+	{
+		return initial_.taskNumber(threadNum, p);
+	}
+
+	// Returns false when there is no work left for any thread
+	bool nextTask(SizeType& taskNumber, SizeType threadNum) const
+	{
+		assert(threadNum < deques_.size());
+		if (popFront(taskNumber, threadNum)) return true;
+
+		SizeType nthreads = deques_.size();
+		while (true) {
+			bool foundWork = false;
+			SizeType start = nrand48(deques_[threadNum]->seed) % nthreads;
+			for (SizeType k = 0; k < nthreads; ++k) {
+				SizeType victim = (start + k) % nthreads;
+				if (victim == threadNum) continue;
+				if (!stealHalf(threadNum, victim)) continue;
+				foundWork = true;
+				if (popFront(taskNumber, threadNum)) return true;
+			}
+
+			if (!foundWork) return false;
+		}
+	}
+
+	SizeType steals() const { return steals_; }
+
+private:
+
+	LoadBalancerWorkStealing(const LoadBalancerWorkStealing&);
+
+	LoadBalancerWorkStealing& operator=(const LoadBalancerWorkStealing&);
+
+	bool popFront(SizeType& taskNumber, SizeType threadNum) const
+	{
+		DequeType& deque = *deques_[threadNum];
+		Concurrency::mutexLock(&deque.mutex);
+		bool found = (deque.head < deque.tail);
+		if (found) taskNumber = deque.tasks[deque.head++];
+		Concurrency::mutexUnlock(&deque.mutex);
+		return found;
+	}
+
+	// moves the back half of victim's deque to thief's deque, which is empty
+	bool stealHalf(SizeType thief, SizeType victim) const
+	{
+		VectorSizeType stolen;
+		DequeType& v = *deques_[victim];
+		Concurrency::mutexLock(&v.mutex);
+		SizeType available = v.tail - v.head;
+		if (available > 0) {
+			SizeType n = (available + 1)/2;
+			stolen.assign(v.tasks.begin() + v.tail - n, v.tasks.begin() + v.tail);
+			v.tail -= n;
+		}
+
+		Concurrency::mutexUnlock(&v.mutex);
+		if (stolen.size() == 0) return false;
+
+		DequeType& t = *deques_[thief];
+		Concurrency::mutexLock(&t.mutex);
+		assert(t.head == t.tail);
+		t.tasks.swap(stolen);
+		t.head = 0;
+		t.tail = t.tasks.size();
+		Concurrency::mutexUnlock(&t.mutex);
+
+		Concurrency::mutexLock(&stealsMutex_);
+		++steals_;
+		Concurrency::mutexUnlock(&stealsMutex_);
+		return true;
+	}
+
+	LoadBalancerDefault initial_;
+	Vector<DequeType*>::Type deques_;
+	mutable Concurrency::MutexType stealsMutex_;
+	mutable SizeType steals_;
+}; // class LoadBalancerWorkStealing
+
+// PthreadsNg: tasks of thread threadNum for this balancer
+template<typename PthreadFunctionHolderType>
+void loadBalancerDoTasks(PthreadFunctionHolderType& pfh,
+                         const LoadBalancerWorkStealing& loadBalancer,
+                         SizeType threadNum,
+                         SizeType)
+{
+	SizeType taskNumber = 0;
+	while (loadBalancer.nextTask(taskNumber, threadNum))
+		pfh.doTask(taskNumber, threadNum);
+}
+} // namespace PsimagLite
+#endif // LOADBALANCERWORKSTEALING_H
@@ -96,6 +96,12 @@ const MPI_Datatype MpiData<double>::Type = MPI_DOUBLE;
 template<>
 const MPI_Datatype MpiData<int>::Type = MPI_INTEGER;
 
+template<>
+const MPI_Datatype MpiData<long>::Type = MPI_LONG;
+
+template<>
+const MPI_Datatype MpiData<short>::Type = MPI_SHORT;
+
 void checkError(int errorCode,PsimagLite::String caller,CommType comm)
 {
 	if (errorCode == MPI_SUCCESS)
@@ -101,14 +101,16 @@ struct ParametersForSolver {
 	ParametersForSolver()
 	    : steps(LanczosSteps),minSteps(4),tolerance(1e-12),stepsForEnergyConvergence(MaxLanczosSteps),
 	      options(""),oneOverA(0),b(0),Eg(0),weight(0),isign(0),lotaMemory(false),
-	      threadId(0)
+	      threadId(0),davidsonBlockSize(1),davidsonMaxSubspace(0),
+	      thickRestartRitz(0),thickRestartMaxRestarts(100)
 	{}
 
 	template<typename IoInputType>
 	ParametersForSolver(IoInputType& io,String prefix)
 	    : steps(LanczosSteps),minSteps(4),tolerance(1e-12),stepsForEnergyConvergence(MaxLanczosSteps),
 	      options(""),oneOverA(0),b(0),Eg(0),weight(0),isign(0),lotaMemory(true),
-	      threadId(0)
+	      threadId(0),davidsonBlockSize(1),davidsonMaxSubspace(0),
+	      thickRestartRitz(0),thickRestartMaxRestarts(100)
 	{
 		try {
 			io.readline(steps,prefix + "Steps=");
@@ -158,6 +160,22 @@ struct ParametersForSolver {
 			io.readline(x,prefix + "NoSaveLanczosVectors=");
 			lotaMemory = (x > 0) ? 0 : 1;
 		} catch (std::exception&) {}
+
+		try {
+			io.readline(davidsonBlockSize,prefix + "DavidsonBlockSize=");
+		} catch (std::exception&) {}
+
+		try {
+			io.readline(davidsonMaxSubspace,prefix + "DavidsonMaxSubspace=");
+		} catch (std::exception&) {}
+
+		try {
+			io.readline(thickRestartRitz,prefix + "ThickRestartRitz=");
+		} catch (std::exception&) {}
+
+		try {
+			io.readline(thickRestartMaxRestarts,prefix + "ThickRestartMaxRestarts=");
+		} catch (std::exception&) {}
 	}
 
 	SizeType steps;
@@ -171,6 +189,10 @@ struct ParametersForSolver {
 	int isign;
 	bool lotaMemory;
 	SizeType threadId;
+	SizeType davidsonBlockSize;
+	SizeType davidsonMaxSubspace; // 0 means chosen by the solver
+	SizeType thickRestartRitz; // 0 means chosen by the solver
+	SizeType thickRestartMaxRestarts;
 }; // class ParametersForSolver
 } // namespace PsimagLite
 
@@ -75,6 +75,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
  *
  *  A C++ PthreadsNg class that implements the Concurrency interface
  *
+ *  Loops run on the long-lived threads of PthreadsNgPool
  */
 #ifndef PSI_PTHREADS_NG_H
 #define PSI_PTHREADS_NG_H
@@ -84,6 +85,7 @@ DISCLOSED WOULD NOT INFRINGE PRIVATELY OWNED RIGHTS.
 #include <algorithm>
 #include "Vector.h"
 #include "LoadBalancerDefault.h"
+#include "PthreadsNgPool.h"
 #include <sched.h>
 #include <unistd.h>
 #ifndef _GNU_SOURCE
@@ -110,13 +112,30 @@ struct PthreadFunctionStruct {
 	SizeType cpu;
 };
 
-template<typename PthreadFunctionHolderType>
+// Tasks of thread threadNum for balancers with a static assignment;
+// balancers that assign tasks at run time overload this function
+template<typename PthreadFunctionHolderType, typename LoadBalancerType>
+void loadBalancerDoTasks(PthreadFunctionHolderType& pfh,
+                         const LoadBalancerType& loadBalancer,
+                         SizeType threadNum,
+                         SizeType total)
+{
+	SizeType blockSize = loadBalancer.blockSize(threadNum);
+
+	for (SizeType p=0; p < blockSize; ++p) {
+		SizeType taskNumber = loadBalancer.taskNumber(threadNum, p);
+		if (taskNumber > total) break;
+		pfh.doTask(taskNumber, threadNum);
+	}
+}
+
+template<typename PthreadFunctionHolderType, typename LoadBalancerType>
 void *thread_function_wrapper(void *dummyPtr)
 {
-	PthreadFunctionStruct<PthreadFunctionHolderType> *pfs =
-	        static_cast<PthreadFunctionStruct<PthreadFunctionHolderType> *>(dummyPtr);
+	typedef PthreadFunctionStruct<PthreadFunctionHolderType, LoadBalancerType>
+	        PthreadFunctionStructType;
 
-	PthreadFunctionHolderType *pfh = pfs->pfh;
+	PthreadFunctionStructType *pfs = static_cast<PthreadFunctionStructType *>(dummyPtr);
 
 	int s = 0;
 #ifdef __linux__
@@ -124,13 +143,7 @@ void *thread_function_wrapper(void *dummyPtr)
 #endif
 	if (s >= 0) pfs->cpu = s;
 
-	SizeType blockSize = pfs->loadBalancer->blockSize(pfs->threadNum);
-
-	for (SizeType p=0; p < blockSize; ++p) {
-		SizeType taskNumber = pfs->loadBalancer->taskNumber(pfs->threadNum, p);
-		if (taskNumber > pfs->total) break;
-		pfh->doTask(taskNumber, pfs->threadNum);
-	}
+	loadBalancerDoTasks(*(pfs->pfh), *(pfs->loadBalancer), pfs->threadNum, pfs->total);
 
 	return 0;
 }
@@ -143,11 +156,8 @@ public:
 	typedef LoadBalancerDefault::VectorSizeType VectorSizeType;
 
 	PthreadsNg(SizeType nPthreadsNg,int,bool setAffinityDefault)
-	    : nthreads_(nPthreadsNg),cores_(1),setAffinities_(setAffinityDefault)
-	{
-		int cores = sysconf(_SC_NPROCESSORS_ONLN);
-		cores_ = (cores > 0) ? cores : 1;
-	}
+	    : nthreads_(nPthreadsNg),setAffinities_(setAffinityDefault)
+	{}
 
 	void setAffinities(bool flag)
 	{
@@ -175,10 +185,10 @@ public:
 	void loopCreate(PthreadFunctionHolderType& pfh,
 	                const LoadBalancerType& loadBalancer)
 	{
-		PthreadFunctionStruct<PthreadFunctionHolderType>* pfs;
-		pfs = new PthreadFunctionStruct<PthreadFunctionHolderType>[nthreads_];
-		pthread_t* thread_id = new pthread_t[nthreads_];
-		pthread_attr_t** attr = new pthread_attr_t*[nthreads_];
+		typedef PthreadFunctionStruct<PthreadFunctionHolderType, LoadBalancerType>
+		        PthreadFunctionStructType;
+		typename Vector<PthreadFunctionStructType>::Type pfs(nthreads_);
+		Vector<void*>::Type args(nthreads_);
 		SizeType ntasks = pfh.tasks();
 
 		for (SizeType j=0; j <nthreads_; j++) {
@@ -187,32 +197,23 @@ public:
 			pfs[j].threadNum = j;
 			pfs[j].total = ntasks;
 			pfs[j].nthreads = nthreads_;
-
-			attr[j] = new pthread_attr_t;
-			int ret = pthread_attr_init(attr[j]);
-			checkForError(ret);
-
-			if (setAffinities_)
-				setAffinity(attr[j],j,cores_);
-
-			ret = pthread_create(&thread_id[j],
-			                     attr[j],
-			                     thread_function_wrapper<PthreadFunctionHolderType>,
-			                     &pfs[j]);
-			checkForError(ret);
+			args[j] = &pfs[j];
 		}
 
-		for (SizeType j=0; j <nthreads_; ++j) pthread_join(thread_id[j], 0);
-		for (SizeType j=0; j <nthreads_; ++j) {
-			int ret = pthread_attr_destroy(attr[j]);
-			checkForError(ret);
-			delete attr[j];
-			attr[j] = 0;
+		bool ran = PthreadsNgPool::instance().run(thread_function_wrapper<PthreadFunctionHolderType,
+		                                                                  LoadBalancerType>,
+		                                          &args[0],
+		                                          nthreads_,
+		                                          setAffinities_);
+
+		// called from within a task (nested loop): the pool's workers are
+		// busy with the outer loop, so do the threads' work here, in order
+		if (!ran) {
+			for (SizeType j=0; j <nthreads_; j++)
+				thread_function_wrapper<PthreadFunctionHolderType, LoadBalancerType>(&pfs[j]);
 		}
 
-		delete [] attr;
-
-#ifndef NDEBUG
+#ifdef DEBUG_PTHREADS_NG
 #ifdef __linux__
 		for (SizeType j=0; j <nthreads_; j++) {
 			std::cout<<"PthreadsNg: Pthread number "<<j<<" runs on core number ";
@@ -220,9 +221,6 @@ public:
 		}
 #endif
 #endif
-
-		delete [] thread_id;
-		delete [] pfs;
 	}
 
 	String name() const { return "PthreadsNg"; }
@@ -233,32 +231,7 @@ public:
 
 private:
 
-	void setAffinity(pthread_attr_t* attr,
-	                 SizeType threadNum,
-	                 SizeType cores) const
-	{
-		cpu_set_t* cpuset = new cpu_set_t;
-		int cpu = threadNum % cores;
-		CPU_ZERO(cpuset);
-		CPU_SET(cpu,cpuset);
-		std::size_t cpusetsize = sizeof(cpu_set_t);
-		int ret = pthread_attr_setaffinity_np(attr,cpusetsize,cpuset);
-		checkForError(ret);
-		// clean up
-		delete cpuset;
-		cpuset = 0;
-	}
-
-	void checkForError(int ret) const
-	{
-		if (ret == 0) return;
-#ifdef _GNU_SOURCE
-		std::cerr<<"PthreadsNg ERROR: "<<strerror(ret)<<"\n";
-#endif
-	}
-
 	SizeType nthreads_;
-	SizeType cores_;
 	bool setAffinities_;
 }; // PthreadsNg class
 
@@ -0,0 +1,294 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file PthreadsNgPool.h
+ *
+ *  Long-lived worker threads for PthreadsNg
+ *
+ *  Workers are created (and pinned, if so requested) the first time a
+ *  loop needs them, and then park on a condition variable between loops.
+ *  A loop that asks for a different affinity than the previous one does
+ *  not create threads: each worker pins itself to its core, or goes back
+ *  to the affinity of the process, when it wakes up for that loop.
+ *  A loop with function f and arguments args runs f(args[j]) on worker j,
+ *  for j < number of threads of the loop, and returns when all are done.
+ *
+ *  Only one loop runs on the pool at a time. A loop started from another
+ *  thread while the pool is busy waits for the pool. A loop started from
+ *  one of the pool's workers, that is, when loopCreate is called from
+ *  within a task, cannot wait for the pool it is running on, so run()
+ *  returns false and the caller must do the work itself.
+ */
+#ifndef PSI_PTHREADS_NG_POOL_H
+#define PSI_PTHREADS_NG_POOL_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <iostream>
+#include <cassert>
+#include "Vector.h"
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#ifdef _GNU_SOURCE
+#include <errno.h>
+#include <string.h>
+#endif
+
+namespace PsimagLite {
+
+class PthreadsNgPool {
+
+	struct WorkerStruct {
+		WorkerStruct() : pool(0), threadNum(0), generation(0), pinned(false) {}
+
+		PthreadsNgPool* pool;
+		SizeType threadNum;
+		SizeType generation;
+		bool pinned;
+	};
+
+public:
+
+	typedef void* (*FunctionType)(void*);
+
+	static PthreadsNgPool& instance()
+	{
+		static PthreadsNgPool pool;
+		return pool;
+	}
+
+	~PthreadsNgPool()
+	{
+		pthread_mutex_lock(&mutex_);
+		destroyWorkers();
+		pthread_mutex_unlock(&mutex_);
+		pthread_cond_destroy(&doneCond_);
+		pthread_cond_destroy(&workCond_);
+		pthread_mutex_destroy(&mutex_);
+		pthread_mutex_destroy(&loopMutex_);
+		pthread_key_delete(workerKey_);
+	}
+
+	// Returns false, having done nothing, if called from a worker of the
+	// pool; other callers wait until the pool is free
+	bool run(FunctionType function,
+	         void** args,
+	         SizeType nthreads,
+	         bool setAffinities)
+	{
+		if (pthread_getspecific(workerKey_) == this) return false;
+
+		pthread_mutex_lock(&loopMutex_);
+
+		pthread_mutex_lock(&mutex_);
+		setAffinities_ = setAffinities;
+		if (workers_.size() < nthreads)
+			createWorkers(nthreads);
+
+		function_ = function;
+		args_ = args;
+		activeThreads_ = nthreads;
+		pending_ = workers_.size();
+		++generation_;
+		pthread_cond_broadcast(&workCond_);
+		while (pending_ > 0)
+			pthread_cond_wait(&doneCond_, &mutex_);
+
+		function_ = 0;
+		args_ = 0;
+		pthread_mutex_unlock(&mutex_);
+
+		pthread_mutex_unlock(&loopMutex_);
+		return true;
+	}
+
+	SizeType threads() const { return workers_.size(); }
+
+	SizeType threadsCreated() const { return threadsCreated_; }
+
+private:
+
+	PthreadsNgPool()
+	    : function_(0),
+	      args_(0),
+	      activeThreads_(0),
+	      pending_(0),
+	      generation_(0),
+	      shutdown_(false),
+	      setAffinities_(false),
+	      threadsCreated_(0)
+	{
+		pthread_mutex_init(&loopMutex_, 0);
+		pthread_mutex_init(&mutex_, 0);
+		pthread_cond_init(&workCond_, 0);
+		pthread_cond_init(&doneCond_, 0);
+		pthread_key_create(&workerKey_, 0);
+		int cores = sysconf(_SC_NPROCESSORS_ONLN);
+		cores_ = (cores > 0) ? cores : 1;
+		CPU_ZERO(&processCpus_);
+		int ret = sched_getaffinity(0, sizeof(cpu_set_t), &processCpus_);
+		if (ret != 0) checkForError(errno);
+	}
+
+	PthreadsNgPool(const PthreadsNgPool&);
+
+	PthreadsNgPool& operator=(const PthreadsNgPool&);
+
+	static void* workerFunction(void* ptr)
+	{
+		WorkerStruct* ws = static_cast<WorkerStruct*>(ptr);
+		ws->pool->workerLoop(ws->threadNum, ws->generation, ws->pinned);
+		return 0;
+	}
+
+	void workerLoop(SizeType threadNum, SizeType generation, bool pinned)
+	{
+		pthread_setspecific(workerKey_, this);
+		pthread_mutex_lock(&mutex_);
+		while (true) {
+			while (generation == generation_ && !shutdown_)
+				pthread_cond_wait(&workCond_, &mutex_);
+
+			if (shutdown_) break;
+
+			generation = generation_;
+			if (pinned != setAffinities_) {
+				pinned = setAffinities_;
+				setOwnAffinity(threadNum, pinned);
+			}
+
+			if (threadNum < activeThreads_) {
+				FunctionType function = function_;
+				void* arg = args_[threadNum];
+				pthread_mutex_unlock(&mutex_);
+				function(arg);
+				pthread_mutex_lock(&mutex_);
+			}
+
+			assert(pending_ > 0);
+			if (--pending_ == 0)
+				pthread_cond_signal(&doneCond_);
+		}
+
+		pthread_mutex_unlock(&mutex_);
+	}
+
+	// mutex_ must be held; workers are recreated only to have more of them
+	void createWorkers(SizeType nthreads)
+	{
+		destroyWorkers();
+
+		shutdown_ = false;
+		workers_.resize(nthreads);
+		threadIds_.resize(nthreads);
+		for (SizeType j = 0; j < nthreads; ++j) {
+			workers_[j].pool = this;
+			workers_[j].threadNum = j;
+			workers_[j].generation = generation_;
+			workers_[j].pinned = setAffinities_;
+
+			pthread_attr_t attr;
+			int ret = pthread_attr_init(&attr);
+			checkForError(ret);
+
+			if (setAffinities_)
+				setAffinity(&attr, j);
+
+			ret = pthread_create(&threadIds_[j], &attr, workerFunction, &workers_[j]);
+			checkForError(ret);
+
+			ret = pthread_attr_destroy(&attr);
+			checkForError(ret);
+			++threadsCreated_;
+		}
+	}
+
+	// mutex_ must be held
+	void destroyWorkers()
+	{
+		if (workers_.size() == 0) return;
+
+		shutdown_ = true;
+		pthread_cond_broadcast(&workCond_);
+		pthread_mutex_unlock(&mutex_);
+		for (SizeType j = 0; j < threadIds_.size(); ++j)
+			pthread_join(threadIds_[j], 0);
+		pthread_mutex_lock(&mutex_);
+
+		workers_.clear();
+		threadIds_.clear();
+	}
+
+	void setAffinity(pthread_attr_t* attr, SizeType threadNum) const
+	{
+		cpu_set_t cpuset;
+		int cpu = threadNum % cores_;
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu, &cpuset);
+		int ret = pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &cpuset);
+		checkForError(ret);
+	}
+
+	// called by a worker, without mutex_, when a loop asks for another affinity
+	void setOwnAffinity(SizeType threadNum, bool pinned) const
+	{
+		cpu_set_t cpuset = processCpus_;
+		if (pinned) {
+			CPU_ZERO(&cpuset);
+			CPU_SET(threadNum % cores_, &cpuset);
+		}
+
+		int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+		checkForError(ret);
+	}
+
+	void checkForError(int ret) const
+	{
+		if (ret == 0) return;
+#ifdef _GNU_SOURCE
+		std::cerr<<"PthreadsNgPool ERROR: "<<strerror(ret)<<"\n";
+#endif
+	}
+
+	pthread_mutex_t loopMutex_;
+	pthread_mutex_t mutex_;
+	pthread_cond_t workCond_;
+	pthread_cond_t doneCond_;
+	pthread_key_t workerKey_;
+	FunctionType function_;
+	void** args_;
+	SizeType activeThreads_;
+	SizeType pending_;
+	SizeType generation_;
+	bool shutdown_;
+	bool setAffinities_;
+	SizeType cores_;
+	cpu_set_t processCpus_;
+	SizeType threadsCreated_;
+	Vector<WorkerStruct>::Type workers_;
+	Vector<pthread_t>::Type threadIds_;
+}; // class PthreadsNgPool
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_PTHREADS_NG_POOL_H
@@ -0,0 +1,179 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file ScratchFileMatrix.h
+ *
+ *  A column-major dense matrix stored in a memory-mapped scratch file
+ *
+ *  The file is created in $TMPDIR (or /tmp) and unlinked right away, so
+ *  it goes away with the process. After a column has been written,
+ *  writeBehind(col) starts writing its pages back without waiting;
+ *  clean pages can then be dropped by the kernel under memory pressure,
+ *  so only the columns in use need to be resident. The file's blocks are
+ *  allocated up front, so a full disk is an error of the constructor or
+ *  of reset(), and not a fault when a column is written.
+ *  T must be copyable with memcpy (real or std::complex numbers).
+ */
+#ifndef PSI_SCRATCH_FILE_MATRIX_H
+#define PSI_SCRATCH_FILE_MATRIX_H
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include "Vector.h"
+#include "TypeToString.h"
+
+namespace PsimagLite {
+
+template<typename T>
+class ScratchFileMatrix {
+
+public:
+
+	ScratchFileMatrix(SizeType nrow, SizeType ncol)
+	    : nrow_(0), ncol_(0), fd_(-1), data_(0), bytes_(0)
+	{
+		const char* tmpdir = getenv("TMPDIR");
+		String filename = (tmpdir) ? tmpdir : "/tmp";
+		filename += "/PsimagLiteScratchXXXXXX";
+		Vector<char>::Type name(filename.begin(), filename.end());
+		name.push_back('\0');
+		fd_ = mkstemp(&name[0]);
+		if (fd_ < 0)
+			throw RuntimeError("ScratchFileMatrix: cannot create " + filename + "\n");
+
+		unlink(&name[0]);
+		reset(nrow, ncol);
+	}
+
+	~ScratchFileMatrix()
+	{
+		unmap();
+		if (fd_ >= 0) close(fd_);
+	}
+
+	SizeType rows() const { return nrow_; }
+
+	SizeType cols() const { return ncol_; }
+
+	// Shrinking the number of columns keeps the data
+	void reset(SizeType nrow, SizeType ncol)
+	{
+		off_t bytes = static_cast<off_t>(nrow)*ncol*sizeof(T);
+		if (nrow == nrow_ && bytes <= bytes_) {
+			ncol_ = ncol;
+			return;
+		}
+
+		unmap();
+		nrow_ = ncol_ = 0;
+		if (bytes == 0) return;
+
+		// posix_fallocate returns the error instead of setting errno
+		int ret = posix_fallocate(fd_, 0, bytes);
+		if (ret != 0)
+			throw RuntimeError("ScratchFileMatrix: cannot allocate "
+			                   + ttos(bytes) + " bytes for the scratch file: "
+			                   + strerror(ret) + "\n");
+
+		// a larger file from before is shrunk
+		if (ftruncate(fd_, bytes) != 0)
+			throw RuntimeError("ScratchFileMatrix: cannot resize scratch file to "
+			                   + ttos(bytes) + " bytes\n");
+
+		void* ptr = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (ptr == MAP_FAILED)
+			throw RuntimeError("ScratchFileMatrix: mmap failed\n");
+
+		data_ = static_cast<T*>(ptr);
+		bytes_ = bytes;
+		nrow_ = nrow;
+		ncol_ = ncol;
+	}
+
+	T& operator()(SizeType i, SizeType j)
+	{
+		assert(i < nrow_ && j < ncol_);
+		return data_[i + j*nrow_];
+	}
+
+	const T& operator()(SizeType i, SizeType j) const
+	{
+		assert(i < nrow_ && j < ncol_);
+		return data_[i + j*nrow_];
+	}
+
+	T* column(SizeType j)
+	{
+		assert(j < ncol_);
+		return data_ + j*nrow_;
+	}
+
+	const T* column(SizeType j) const
+	{
+		assert(j < ncol_);
+		return data_ + j*nrow_;
+	}
+
+	// Starts writing column j to disk, does not wait for it
+	void writeBehind(SizeType j)
+	{
+		assert(j < ncol_);
+		off_t start = static_cast<off_t>(j)*nrow_*sizeof(T);
+		off_t length = static_cast<off_t>(nrow_)*sizeof(T);
+#ifdef __linux__
+		sync_file_range(fd_, start, length, SYNC_FILE_RANGE_WRITE);
+#else
+		off_t page = sysconf(_SC_PAGESIZE);
+		off_t aligned = (start/page)*page;
+		msync(reinterpret_cast<char*>(data_) + aligned, length + start - aligned, MS_ASYNC);
+#endif
+	}
+
+private:
+
+	ScratchFileMatrix(const ScratchFileMatrix&);
+
+	ScratchFileMatrix& operator=(const ScratchFileMatrix&);
+
+	void unmap()
+	{
+		if (data_) munmap(data_, bytes_);
+		data_ = 0;
+		bytes_ = 0;
+	}
+
+	SizeType nrow_;
+	SizeType ncol_;
+	int fd_;
+	T* data_;
+	off_t bytes_;
+}; // class ScratchFileMatrix
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_SCRATCH_FILE_MATRIX_H
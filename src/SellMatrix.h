@@ -0,0 +1,295 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file SellMatrix.h
+ *
+ *  A sparse matrix in SELL-C-sigma format, for matrixVectorProduct only
+ *
+ *  Rows are sorted by decreasing length within windows of sigma rows,
+ *  and then grouped in chunks of C consecutive (sorted) rows. Each chunk
+ *  is padded with zeros to the length of its longest row and stored
+ *  column-major, so that entry j of the C rows of a chunk is contiguous:
+ *  the C sums of a chunk advance together, which the compiler vectorizes.
+ *  Padding entries have value zero and a column of their row (or 0).
+ *
+ *  Each row is summed in the same order as in CrsMatrix, starting from
+ *  x[i], so results are the same as those of CrsMatrix (zeros added
+ *  aside). Chunks are split among threads as rows are in
+ *  CrsMatrixVectorProduct.
+ */
+#ifndef PSI_SELL_MATRIX_H
+#define PSI_SELL_MATRIX_H
+#include <algorithm>
+#include <cassert>
+#include "Vector.h"
+#include "Concurrency.h"
+#include "CrsMatrix.h"
+#ifdef USE_PTHREADS
+#include "PthreadsNg.h"
+#endif
+
+namespace PsimagLite {
+
+template<typename T, SizeType C = 8>
+class SellMatrix {
+
+	typedef typename Vector<T>::Type VectorType;
+	typedef Vector<int>::Type VectorIntType;
+	typedef Vector<SizeType>::Type VectorSizeType;
+	typedef CrsMatrixVectorProduct<T, VectorType> CrsMatrixVectorProductType;
+
+public:
+
+	typedef T value_type;
+
+	enum {CHUNK = C};
+
+	// Default sorting window, in rows
+	enum {SIGMA = 32*C};
+
+	SellMatrix() : nrow_(0), ncol_(0), nonzeros_(0) {}
+
+	explicit SellMatrix(const CrsMatrix<T>& crs, SizeType sigma = SIGMA)
+	    : nrow_(crs.rows()), ncol_(crs.cols()), nonzeros_(crs.nonZeros())
+	{
+		if (sigma == 0)
+			throw RuntimeError("SellMatrix: sigma must be positive\n");
+
+		VectorSizeType length(nrow_);
+		for (SizeType i = 0; i < nrow_; ++i)
+			length[i] = crs.getRowPtr(i + 1) - crs.getRowPtr(i);
+
+		sortedRows(perm_, length, sigma);
+
+		SizeType nchunks = (nrow_ + C - 1)/C;
+		chunkPtr_.resize(nchunks + 1);
+		chunkLength_.resize(nchunks);
+		chunkPtr_[0] = 0;
+		for (SizeType ch = 0; ch < nchunks; ++ch) {
+			SizeType maxLength = 0;
+			for (SizeType r = 0; r < C; ++r) {
+				SizeType row = perm_[ch*C + r];
+				if (row < nrow_) maxLength = std::max(maxLength, length[row]);
+			}
+
+			chunkLength_[ch] = maxLength;
+			chunkPtr_[ch + 1] = chunkPtr_[ch] + maxLength*C;
+		}
+
+		colind_.assign(chunkPtr_[nchunks], 0);
+		values_.assign(chunkPtr_[nchunks], 0.0);
+		for (SizeType ch = 0; ch < nchunks; ++ch) {
+			for (SizeType r = 0; r < C; ++r) {
+				SizeType row = perm_[ch*C + r];
+				if (row >= nrow_) continue;
+				int start = crs.getRowPtr(row);
+				int col = 0;
+				for (SizeType j = 0; j < chunkLength_[ch]; ++j) {
+					SizeType k = chunkPtr_[ch] + j*C + r;
+					if (j < length[row]) {
+						col = crs.getCol(start + j);
+						values_[k] = crs.getValue(start + j);
+					}
+
+					colind_[k] = col;
+				}
+			}
+		}
+	}
+
+	SizeType rows() const { return nrow_; }
+
+	SizeType cols() const { return ncol_; }
+
+	SizeType nonZeros() const { return nonzeros_; }
+
+	// Non-zeros plus padding
+	SizeType storedEntries() const { return values_.size(); }
+
+	// Stored entries over non-zeros, if rows of these lengths were
+	// stored in SELL-C-sigma, without building it
+	static double paddingRatio(const VectorSizeType& length, SizeType sigma = SIGMA)
+	{
+		VectorSizeType perm;
+		sortedRows(perm, length, sigma);
+		SizeType n = length.size();
+		SizeType nonzeros = 0;
+		SizeType stored = 0;
+		for (SizeType ch = 0; ch*C < n; ++ch) {
+			SizeType maxLength = 0;
+			for (SizeType r = 0; r < C; ++r) {
+				SizeType row = perm[ch*C + r];
+				if (row >= n) continue;
+				nonzeros += length[row];
+				maxLength = std::max(maxLength, length[row]);
+			}
+
+			stored += maxLength*C;
+		}
+
+		return (nonzeros == 0) ? 1.0 : static_cast<double>(stored)/nonzeros;
+	}
+
+	/** performs x = x + A * y
+		 ** where x and y are vectors and A is this matrix */
+	template<typename VectorLikeType>
+	void matrixVectorProduct(VectorLikeType& x, const VectorLikeType& y) const
+	{
+		assert(x.size() == nrow_ && y.size() == ncol_);
+		if (values_.size() == 0) return;
+		SizeType nchunks = chunkLength_.size();
+		SizeType nthreads = Concurrency::npthreads;
+		if (nthreads < 2 ||
+		        values_.size() < CrsMatrixVectorProductType::MIN_NONZEROS_PER_THREAD*nthreads) {
+			chunks(x, y, 0, nchunks);
+			return;
+		}
+
+		Helper<VectorLikeType> helper(*this, x, y, nthreads);
+#ifdef USE_PTHREADS
+		PthreadsNg<Helper<VectorLikeType> > threads(helper.tasks(),
+		                                            0,
+		                                            Concurrency::setAffinitiesDefault);
+		threads.loopCreate(helper);
+#else
+		for (SizeType task = 0; task < helper.tasks(); ++task) helper.doTask(task, 0);
+#endif
+	}
+
+private:
+
+	template<typename VectorLikeType>
+	class Helper {
+
+	public:
+
+		Helper(const SellMatrix& m,
+		       VectorLikeType& x,
+		       const VectorLikeType& y,
+		       SizeType nthreads)
+		    : m_(m), x_(x), y_(y)
+		{
+			CrsMatrixVectorProductType::nonzeroChunks(chunkStart_,
+			                                          m.chunkPtr_,
+			                                          m.chunkLength_.size(),
+			                                          nthreads);
+		}
+
+		SizeType tasks() const { return chunkStart_.size() - 1; }
+
+		void doTask(SizeType taskNumber, SizeType)
+		{
+			m_.chunks(x_, y_, chunkStart_[taskNumber], chunkStart_[taskNumber + 1]);
+		}
+
+	private:
+
+		const SellMatrix& m_;
+		VectorLikeType& x_;
+		const VectorLikeType& y_;
+		VectorSizeType chunkStart_;
+	}; // class Helper
+
+	// perm[p] is the row at sorted position p, and perm.size() is a
+	// multiple of C, with rows >= length.size() for the padding
+	static void sortedRows(VectorSizeType& perm, const VectorSizeType& length, SizeType sigma)
+	{
+		SizeType n = length.size();
+		SizeType nchunks = (n + C - 1)/C;
+		perm.resize(nchunks*C);
+		for (SizeType p = 0; p < perm.size(); ++p) perm[p] = p;
+
+		for (SizeType start = 0; start < n; start += sigma) {
+			SizeType end = std::min(start + sigma, n);
+			std::stable_sort(perm.begin() + start, perm.begin() + end, LongerRow(length));
+		}
+	}
+
+	class LongerRow {
+
+	public:
+
+		LongerRow(const VectorSizeType& length) : length_(length) {}
+
+		bool operator()(SizeType a, SizeType b) const
+		{
+			return length_[a] > length_[b];
+		}
+
+	private:
+
+		const VectorSizeType& length_;
+	}; // class LongerRow
+
+	template<typename VectorLikeType>
+	void chunks(VectorLikeType& x, const VectorLikeType& y, SizeType start, SizeType end) const
+	{
+		typedef typename VectorLikeType::value_type ValueType;
+		ValueType sum[C];
+		for (SizeType ch = start; ch < end; ++ch) {
+			const SizeType* rows = &perm_[ch*C];
+			for (SizeType r = 0; r < C; ++r)
+				sum[r] = (rows[r] < nrow_) ? x[rows[r]] : ValueType(0.0);
+
+			const T* values = &values_[0] + chunkPtr_[ch];
+			const int* colind = &colind_[0] + chunkPtr_[ch];
+			const SizeType length = chunkLength_[ch];
+			for (SizeType j = 0; j < length; ++j) {
+				for (SizeType r = 0; r < C; ++r)
+					multiplyAdd(sum[r], values[j*C + r], y[colind[j*C + r]]);
+			}
+
+			for (SizeType r = 0; r < C; ++r)
+				if (rows[r] < nrow_) x[rows[r]] = sum[r];
+		}
+	}
+
+	template<typename A, typename B, typename D>
+	static void multiplyAdd(A& sum, const B& a, const D& b)
+	{
+		sum += a*b;
+	}
+
+	// Same as sum += a*b for finite numbers, without the NaN recovery
+	// of complex multiplication
+	template<typename RealType>
+	static void multiplyAdd(std::complex<RealType>& sum,
+	                        const std::complex<RealType>& a,
+	                        const std::complex<RealType>& b)
+	{
+		RealType re = a.real()*b.real() - a.imag()*b.imag();
+		RealType im = a.real()*b.imag() + a.imag()*b.real();
+		sum = std::complex<RealType>(sum.real() + re, sum.imag() + im);
+	}
+
+	SizeType nrow_;
+	SizeType ncol_;
+	SizeType nonzeros_;
+	VectorSizeType perm_;
+	VectorIntType chunkPtr_;
+	VectorSizeType chunkLength_;
+	VectorIntType colind_;
+	VectorType values_;
+}; // class SellMatrix
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_SELL_MATRIX_H
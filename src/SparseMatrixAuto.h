@@ -0,0 +1,173 @@
+/*
+Copyright (c) 2009-2017, UT-Battelle, LLC
+All rights reserved
+
+[PsimagLite, Version 1.]
+
+*********************************************************
+THE SOFTWARE IS SUPPLIED BY THE COPYRIGHT HOLDERS AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+PARTICULAR PURPOSE ARE DISCLAIMED.
+
+Please see full open source license included in file LICENSE.
+*********************************************************
+
+*/
+/** \ingroup PsimagLite */
+/*@{*/
+
+/*! \file SparseMatrixAuto.h
+ *
+ *  A sparse matrix for matrixVectorProduct, stored as CrsMatrix,
+ *  SellMatrix or BsrMatrix, as chosen by chooseFormat
+ *
+ *  chooseFormat looks at the structure of the CrsMatrix only:
+ *  BSR if, for some block size b that divides the rank, at least
+ *  MIN_BLOCK_FILL of the entries of the non-zero b x b blocks are
+ *  non-zeros (the largest such b);
+ *  else SELL if rows are short, at most MAX_SELL_ROW non-zeros on
+ *  average, so that the inner loop of CRS is too short, and if padding
+ *  adds at most MAX_SELL_PADDING - 1 of the non-zeros;
+ *  else CRS.
+ *  It can be used as MatrixType of LanczosSolver or ChebyshevSolver.
+ */
+#ifndef PSI_SPARSE_MATRIX_AUTO_H
+#define PSI_SPARSE_MATRIX_AUTO_H
+#include "CrsMatrix.h"
+#include "SellMatrix.h"
+#include "BsrMatrix.h"
+
+namespace PsimagLite {
+
+template<typename T>
+class SparseMatrixAuto {
+
+	typedef Vector<SizeType>::Type VectorSizeType;
+
+public:
+
+	typedef T value_type;
+	typedef CrsMatrix<T> CrsMatrixType;
+	typedef SellMatrix<T> SellMatrixType;
+	typedef BsrMatrix<T> BsrMatrixType;
+
+	enum FormatEnum {CRS, SELL, BSR};
+
+	// Below this average row length SELL is considered
+	enum {MAX_SELL_ROW = 32};
+
+	// Block sizes tried by chooseFormat, largest first
+	enum {MAX_BLOCK = 8};
+
+	static const double MIN_BLOCK_FILL;
+
+	static const double MAX_SELL_PADDING;
+
+	explicit SparseMatrixAuto(const CrsMatrixType& crs)
+	    : blockSize_(1), format_(chooseFormat(crs, blockSize_))
+	{
+		convert(crs);
+	}
+
+	SparseMatrixAuto(const CrsMatrixType& crs, FormatEnum format, SizeType blockSize = 1)
+	    : blockSize_(blockSize), format_(format)
+	{
+		convert(crs);
+	}
+
+	static FormatEnum chooseFormat(const CrsMatrixType& crs, SizeType& blockSize)
+	{
+		blockSize = 1;
+		SizeType n = crs.rows();
+		if (n == 0 || crs.nonZeros() == 0) return CRS;
+
+		for (SizeType b = MAX_BLOCK; b > 1; --b) {
+			if (BsrMatrixType::fillRatio(crs, b) < MIN_BLOCK_FILL) continue;
+			blockSize = b;
+			return BSR;
+		}
+
+		if (crs.nonZeros() > MAX_SELL_ROW*n) return CRS;
+
+		VectorSizeType length(n);
+		for (SizeType i = 0; i < n; ++i)
+			length[i] = crs.getRowPtr(i + 1) - crs.getRowPtr(i);
+
+		return (SellMatrixType::paddingRatio(length) <= MAX_SELL_PADDING) ? SELL : CRS;
+	}
+
+	static String formatName(FormatEnum format)
+	{
+		switch (format) {
+		case SELL:
+			return "SELL";
+		case BSR:
+			return "BSR";
+		default:
+			return "CRS";
+		}
+	}
+
+	FormatEnum format() const { return format_; }
+
+	SizeType blockSize() const { return blockSize_; }
+
+	SizeType rows() const { return rows_; }
+
+	SizeType cols() const { return cols_; }
+
+	/** performs x = x + A * y
+		 ** where x and y are vectors and A is this matrix */
+	template<typename VectorLikeType>
+	void matrixVectorProduct(VectorLikeType& x, const VectorLikeType& y) const
+	{
+		switch (format_) {
+		case SELL:
+			return sell_.matrixVectorProduct(x, y);
+		case BSR:
+			return bsr_.matrixVectorProduct(x, y);
+		default:
+			return crs_.matrixVectorProduct(x, y);
+		}
+	}
+
+private:
+
+	void convert(const CrsMatrixType& crs)
+	{
+		rows_ = crs.rows();
+		cols_ = crs.cols();
+		switch (format_) {
+		case SELL:
+			sell_ = SellMatrixType(crs);
+			break;
+		case BSR:
+			bsr_ = BsrMatrixType(crs, blockSize_);
+			break;
+		default:
+			crs_ = crs;
+			break;
+		}
+	}
+
+	SizeType blockSize_;
+	FormatEnum format_;
+	SizeType rows_;
+	SizeType cols_;
+	CrsMatrixType crs_;
+	SellMatrixType sell_;
+	BsrMatrixType bsr_;
+}; // class SparseMatrixAuto
+
+template<typename T>
+const double SparseMatrixAuto<T>::MIN_BLOCK_FILL = 0.75;
+
+template<typename T>
+const double SparseMatrixAuto<T>::MAX_SELL_PADDING = 1.2;
+
+} // namespace PsimagLite
+
+/*@}*/
+#endif // PSI_SPARSE_MATRIX_AUTO_H